@@ -0,0 +1,195 @@
+#include "BlobSegmentation.h"
+#include <algorithm>
+#include <cstdlib>
+
+using namespace DirectX;
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    void BlobSegmenter::Accumulator::Merge(const Accumulator& other)
+    {
+        count += other.count;
+        sumX += other.sumX; sumY += other.sumY; sumZ += other.sumZ;
+        sumDepth += other.sumDepth;
+        colMin = (std::min)(colMin, other.colMin); rowMin = (std::min)(rowMin, other.rowMin);
+        colMax = (std::max)(colMax, other.colMax); rowMax = (std::max)(rowMax, other.rowMax);
+    }
+
+    UINT BlobSegmenter::NewLabel(UINT row, UINT col)
+    {
+        UINT label = (UINT)m_parent.size();
+        m_parent.push_back(label);
+        Accumulator accumulator;
+        accumulator.colMin = accumulator.colMax = col;
+        accumulator.rowMin = accumulator.rowMax = row;
+        m_accumulators.push_back(accumulator);
+        return label;
+    }
+
+    UINT BlobSegmenter::Find(UINT label)
+    {
+        // path halving keeps the trees flat without recursion
+        while (m_parent[label] != label)
+        {
+            m_parent[label] = m_parent[m_parent[label]];
+            label = m_parent[label];
+        }
+        return label;
+    }
+
+    UINT BlobSegmenter::Union(UINT a, UINT b)
+    {
+        UINT rootA = Find(a), rootB = Find(b);
+        // the smaller label becomes the root, so roots are always the first label of their blob
+        if (rootA < rootB)
+        {
+            m_parent[rootB] = rootA;
+            return rootA;
+        }
+        m_parent[rootA] = rootB;
+        return rootB;
+    }
+
+    void BlobSegmenter::Update(const BlobSegmentationSettings& settings, const AhatFrameParams& params, const UINT16* pDepth,
+        const XMFLOAT3* pUnitRays, const UINT8* pValidMask)
+    {
+        m_parent.assign(1, 0);
+        m_accumulators.assign(1, Accumulator());
+        m_blobs.clear();
+
+        const auto& bounds = params.roiImageBounds;
+        XMMATRIX depthToWorld = XMLoadFloat4x4(&params.depthToWorld);
+        XMVECTOR roiCenter = XMLoadFloat3(&params.roiCenter);
+        XMVECTOR roiBound = XMLoadFloat3(&params.roiBound);
+        UINT step = (std::max)(settings.gridStep, 1u);
+        UINT rowEnd = (std::min)(bounds.rowEnd, params.height);
+        UINT colEnd = (std::min)(bounds.colEnd, params.width);
+        if (bounds.rowBegin >= rowEnd || bounds.colBegin >= colEnd)
+        {
+            return;
+        }
+        UINT gridWidth = (colEnd - bounds.colBegin + step - 1) / step;
+        for (int r = 0; r < 2; r++)
+        {
+            m_rowLabels[r].assign(gridWidth, 0);
+            m_rowDepths[r].assign(gridWidth, 0);
+        }
+        const int maxDepthJump = settings.maxDepthJump;
+
+        // first pass: provisional labels from the left and upper neighbors, statistics per provisional label
+        UINT gridRow = 0;
+        for (UINT i = bounds.rowBegin; i < rowEnd; i += step, gridRow++)
+        {
+            UINT* pLabels = m_rowLabels[gridRow & 1].data();
+            UINT16* pDepths = m_rowDepths[gridRow & 1].data();
+            const UINT* pUpLabels = m_rowLabels[(gridRow & 1) ^ 1].data();
+            const UINT16* pUpDepths = m_rowDepths[(gridRow & 1) ^ 1].data();
+            bool firstRow = gridRow == 0;
+
+            UINT g = 0;
+            for (UINT j = bounds.colBegin; j < colEnd; j += step, g++)
+            {
+                pLabels[g] = 0;
+                auto idx = params.width * i + j;
+                UINT16 depth = pDepth[idx];
+                depth = (depth > 4090) ? 0 : depth - params.depthOffset;
+                if (depth < bounds.depthMin || depth > bounds.depthMax || pUnitRays[idx].z == 0 || (pValidMask && !pValidMask[idx]))
+                {
+                    continue;
+                }
+                XMFLOAT3 ray = pUnitRays[idx];
+                float range = (float)depth / 1000;
+                if (params.useRoiFilter &&
+                    !XMVector3InBounds(XMVector3Transform(range * XMLoadFloat3(&ray), depthToWorld) - roiCenter, roiBound))
+                {
+                    continue;
+                }
+
+                UINT left = (g > 0 && pLabels[g - 1] && abs((int)depth - (int)pDepths[g - 1]) <= maxDepthJump) ? pLabels[g - 1] : 0;
+                UINT up = (!firstRow && pUpLabels[g] && abs((int)depth - (int)pUpDepths[g]) <= maxDepthJump) ? pUpLabels[g] : 0;
+                UINT label;
+                if (left && up)
+                {
+                    label = left == up ? left : Union(left, up);
+                }
+                else if (left || up)
+                {
+                    label = left ? left : up;
+                }
+                else
+                {
+                    label = NewLabel(i, j);
+                }
+                pLabels[g] = label;
+                pDepths[g] = depth;
+
+                auto& accumulator = m_accumulators[label];
+                accumulator.count++;
+                accumulator.sumX += range * ray.x; accumulator.sumY += range * ray.y; accumulator.sumZ += range * ray.z;
+                accumulator.sumDepth += range;
+                accumulator.colMin = (std::min)(accumulator.colMin, j); accumulator.colMax = (std::max)(accumulator.colMax, j);
+                accumulator.rowMin = (std::min)(accumulator.rowMin, i); accumulator.rowMax = (std::max)(accumulator.rowMax, i);
+            }
+        }
+
+        // second pass over the label table: merge every provisional label into its root
+        for (UINT label = 1; label < (UINT)m_parent.size(); label++)
+        {
+            UINT root = Find(label);
+            if (root != label)
+            {
+                m_accumulators[root].Merge(m_accumulators[label]);
+            }
+        }
+
+        const UINT pixelsPerSample = step * step;
+        for (UINT label = 1; label < (UINT)m_parent.size(); label++)
+        {
+            const auto& accumulator = m_accumulators[label];
+            if (m_parent[label] != label || accumulator.count * pixelsPerSample < settings.minPixels)
+            {
+                continue;
+            }
+            DepthBlob blob;
+            blob.pixelCount = accumulator.count * pixelsPerSample;
+            double scale = 1.0 / accumulator.count;
+            XMVECTOR centroid = XMVectorSet((float)(accumulator.sumX * scale), (float)(accumulator.sumY * scale), (float)(accumulator.sumZ * scale), 1);
+            XMStoreFloat3(&blob.centroid, XMVector3Transform(centroid, depthToWorld));
+            blob.colMin = accumulator.colMin;
+            blob.rowMin = accumulator.rowMin;
+            blob.colMax = (std::min)(accumulator.colMax + step - 1, params.width - 1);
+            blob.rowMax = (std::min)(accumulator.rowMax + step - 1, params.height - 1);
+            blob.meanDepth = (float)(accumulator.sumDepth * scale);
+            m_blobs.push_back(blob);
+        }
+
+        auto larger = [](const DepthBlob& a, const DepthBlob& b) { return a.pixelCount > b.pixelCount; };
+        if (m_blobs.size() > settings.maxBlobs)
+        {
+            std::partial_sort(m_blobs.begin(), m_blobs.begin() + settings.maxBlobs, m_blobs.end(), larger);
+            m_blobs.resize(settings.maxBlobs);
+        }
+        else
+        {
+            std::sort(m_blobs.begin(), m_blobs.end(), larger);
+        }
+    }
+
+    void BlobSegmenter::Pack(std::vector<float>& packed) const
+    {
+        packed.clear();
+        packed.reserve(m_blobs.size() * kPackedBlobSize);
+        for (const auto& blob : m_blobs)
+        {
+            packed.push_back((float)blob.pixelCount);
+            packed.push_back(blob.centroid.x);
+            packed.push_back(blob.centroid.y);
+            packed.push_back(-blob.centroid.z);
+            packed.push_back((float)blob.colMin);
+            packed.push_back((float)blob.rowMin);
+            packed.push_back((float)blob.colMax);
+            packed.push_back((float)blob.rowMax);
+            packed.push_back(blob.meanDepth);
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "SensorKernels.h"
+#include <DirectXMath.h>
+#include <vector>
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    struct BlobSegmentationSettings {
+        UINT gridStep = 2;              // label every gridStep-th pixel of the organized grid
+        UINT16 maxDepthJump = 30;       // Unit: mm, grid neighbors closer in depth belong to the same blob
+        UINT minPixels = 200;           // smaller blobs are dropped, in image pixels
+        UINT maxBlobs = 16;             // only the largest blobs are kept
+    };
+
+    struct DepthBlob {
+        UINT pixelCount = 0;                // image pixels covered (samples * gridStep^2)
+        DirectX::XMFLOAT3 centroid{ 0,0,0 };// world space
+        UINT colMin = 0, rowMin = 0;        // image bounding box, inclusive
+        UINT colMax = 0, rowMax = 0;
+        float meanDepth = 0;                // Unit: m, along the pixel rays
+    };
+
+    // Connected components of the depth-continuous pixels within the clip range, labeled in two passes over the
+    // organized AHAT grid. The first pass assigns provisional labels from the left and upper neighbors, records label
+    // equivalences in a union-find forest and accumulates the statistics per provisional label; the second pass only
+    // walks the label table and merges the statistics into their roots, so no label image is kept beyond one grid row.
+    class BlobSegmenter
+    {
+    public:
+        static const size_t kPackedBlobSize = 9;
+
+        // Label the pixels within params.roiImageBounds (and pValidMask if set, and the Roi if params.useRoiFilter)
+        void Update(const BlobSegmentationSettings& settings, const AhatFrameParams& params, const UINT16* pDepth,
+            const DirectX::XMFLOAT3* pUnitRays, const UINT8* pValidMask);
+
+        // Blobs of the last frame, largest first
+        const std::vector<DepthBlob>& Blobs() const { return m_blobs; }
+
+        // Blobs of the last frame as kPackedBlobSize floats each, centroid in output coordinates (x, y, -z):
+        // pixel count, centroid x, y, z, column min, row min, column max, row max, mean depth
+        void Pack(std::vector<float>& packed) const;
+
+    private:
+        // statistics of the samples of one label, camera space sums
+        struct Accumulator {
+            UINT count = 0;
+            double sumX = 0, sumY = 0, sumZ = 0;
+            double sumDepth = 0;
+            UINT colMin = 0, rowMin = 0, colMax = 0, rowMax = 0;
+            void Merge(const Accumulator& other);
+        };
+
+        UINT NewLabel(UINT row, UINT col);
+        UINT Find(UINT label);
+        UINT Union(UINT a, UINT b);
+
+        std::vector<UINT> m_rowLabels[2];   // labels of the previous and current grid row, 0 = background
+        std::vector<UINT16> m_rowDepths[2];
+        std::vector<UINT> m_parent;         // union-find forest over the provisional labels, m_parent[0] unused
+        std::vector<Accumulator> m_accumulators;
+        std::vector<DepthBlob> m_blobs;
+    };
+}
@@ -0,0 +1,157 @@
+#include "ChangeDetection.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+using namespace DirectX;
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    void ChangeDetector::Reset()
+    {
+        m_hasReference = false;
+        m_unchangedInRow = 0;
+        std::lock_guard<std::mutex> l(m_mutex);
+        m_changedTiles.clear();
+        m_tilesX = m_tilesY = 0;
+        m_lastChangedTiles = 0;
+        m_frames = 0;
+        m_unchanged = 0;
+    }
+
+    ChangeResult ChangeDetector::Compare(const ChangeDetectionSettings& settings, const UINT16* pDepth, UINT width, UINT height,
+        FXMMATRIX cameraToWorld)
+    {
+        auto start = StreamStats::Clock::now();
+        ChangeResult result;
+
+        const UINT tileSize = (std::max)(settings.tileSize, 1u);
+        const UINT step = (std::max)(settings.sampleStep, 1u);
+        const UINT tilesX = (width + tileSize - 1) / tileSize;
+        const UINT tilesY = (height + tileSize - 1) / tileSize;
+        std::vector<UINT8> changedTiles(tilesX * tilesY, 1);
+
+        bool comparable = m_hasReference && m_width == width && m_height == height;
+        if (comparable)
+        {
+            // camera motion: translation distance and the rotation angle from the trace of R_ref^T * R
+            XMFLOAT4X4 pose;
+            XMStoreFloat4x4(&pose, cameraToWorld);
+            float distanceSquared = 0, trace = 0;
+            for (int i = 0; i < 3; i++)
+            {
+                float d = pose.m[3][i] - m_referencePose.m[3][i];
+                distanceSquared += d * d;
+                for (int j = 0; j < 3; j++)
+                {
+                    trace += pose.m[i][j] * m_referencePose.m[i][j];
+                }
+            }
+            float angle = acosf((std::min)((std::max)((trace - 1) / 2, -1.0f), 1.0f));
+            result.poseChanged = distanceSquared > settings.maxTranslation * settings.maxTranslation ||
+                angle > settings.maxRotation;
+        }
+
+        if (comparable && !result.poseChanged)
+        {
+            // fixed point relative threshold, depths fit 12 bits so the products fit 32 bits
+            const int thresholdAbsolute = settings.depthThreshold;
+            const int thresholdRelative = (int)((std::max)(settings.depthThresholdRelative, 0.0f) * 1024);
+            const UINT16* pReference = m_reference.data();
+            for (UINT ty = 0; ty < tilesY; ty++)
+            {
+                UINT rowBegin = ty * tileSize, rowEnd = (std::min)(rowBegin + tileSize, height);
+                for (UINT tx = 0; tx < tilesX; tx++)
+                {
+                    UINT colBegin = tx * tileSize, colEnd = (std::min)(colBegin + tileSize, width);
+                    UINT samples = 0, changed = 0;
+                    for (UINT i = rowBegin; i < rowEnd; i += step)
+                    {
+                        const UINT16* pRow = pDepth + i * width;
+                        const UINT16* pReferenceRow = pReference + i * width;
+                        for (UINT j = colBegin; j < colEnd; j++)
+                        {
+                            // invalid pixels (> 4090) count as 0, so pixels turning valid or invalid change
+                            int a = pRow[j], b = pReferenceRow[j];
+                            a = a > 4090 ? 0 : a;
+                            b = b > 4090 ? 0 : b;
+                            int threshold = (std::max)(thresholdAbsolute, ((std::max)(a, b) * thresholdRelative) >> 10);
+                            changed += abs(a - b) > threshold;
+                        }
+                        samples += colEnd - colBegin;
+                    }
+                    bool tileChanged = changed > settings.tileChangeFraction * samples;
+                    changedTiles[ty * tilesX + tx] = tileChanged;
+                    result.changedTiles += tileChanged;
+                }
+            }
+            result.changed = result.changedTiles > 0 || m_unchangedInRow + 1 >= settings.maxUnchangedFrames;
+        }
+        else
+        {
+            result.changedTiles = tilesX * tilesY;
+        }
+
+        m_unchangedInRow = result.changed ? 0 : m_unchangedInRow + 1;
+        m_durations.Add(std::chrono::duration<float, std::micro>(StreamStats::Clock::now() - start).count());
+
+        std::lock_guard<std::mutex> l(m_mutex);
+        m_changedTiles.swap(changedTiles);
+        m_tilesX = tilesX;
+        m_tilesY = tilesY;
+        m_lastChangedTiles = result.changedTiles;
+        m_frames++;
+        m_unchanged += !result.changed;
+        return result;
+    }
+
+    void ChangeDetector::SetReference(const UINT16* pDepth, UINT width, UINT height, FXMMATRIX cameraToWorld)
+    {
+        m_reference.assign(pDepth, pDepth + width * height);
+        m_width = width;
+        m_height = height;
+        XMStoreFloat4x4(&m_referencePose, cameraToWorld);
+        m_hasReference = true;
+    }
+
+    void ChangeDetector::ChangedTiles(std::vector<UINT8>& mask, UINT& tilesX, UINT& tilesY) const
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+        mask = m_changedTiles;
+        tilesX = m_tilesX;
+        tilesY = m_tilesY;
+    }
+
+    std::string ChangeDetector::StatusJson() const
+    {
+        auto durations = m_durations.Summarize();
+        std::lock_guard<std::mutex> l(m_mutex);
+        std::stringstream ss;
+        ss << "{\"frames\":" << m_frames
+            << ",\"unchanged\":" << m_unchanged
+            << ",\"changed_tiles\":" << m_lastChangedTiles
+            << ",\"tiles\":" << m_tilesX * m_tilesY
+            << ",\"compare_us\":{\"mean\":" << durations.mean
+            << ",\"p50\":" << durations.p50
+            << ",\"p95\":" << durations.p95
+            << ",\"max\":" << durations.max << "}}";
+        return ss.str();
+    }
+
+    bool SameAhatOutputSettings(const AhatFrameParams& a, const AhatFrameParams& b)
+    {
+        auto sameFloat3 = [](const XMFLOAT3& u, const XMFLOAT3& v) { return u.x == v.x && u.y == v.y && u.z == v.z; };
+        const auto& la = a.textureLayout;
+        const auto& lb = b.textureLayout;
+        return a.width == b.width && a.height == b.height && a.depthOffset == b.depthOffset &&
+            a.useRoiFilter == b.useRoiFilter && sameFloat3(a.roiCenter, b.roiCenter) && sameFloat3(a.roiBound, b.roiBound) &&
+            a.depthNearClip == b.depthNearClip && a.depthFarClip == b.depthFarClip &&
+            a.pointCloudStep == b.pointCloudStep && a.pointCloudFormat == b.pointCloudFormat &&
+            la.mode == lb.mode && la.factor == lb.factor && la.x0 == lb.x0 && la.y0 == lb.y0 &&
+            la.width == lb.width && la.height == lb.height &&
+            a.pDepthColormap == b.pDepthColormap && a.pAbColormap == b.pAbColormap &&
+            a.pDepthTextureLut == b.pDepthTextureLut && a.pAbTextureLut == b.pAbTextureLut;
+    }
+}
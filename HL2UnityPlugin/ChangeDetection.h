@@ -0,0 +1,72 @@
+#pragma once
+#include "PipelineStats.h"
+#include "SensorKernels.h"
+#include "Platform.h"
+#include <DirectXMath.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    struct ChangeDetectionSettings {
+        UINT tileSize = 32;                 // Unit: pixels
+        UINT sampleStep = 2;                // compare every sampleStep-th row, whole rows keep the comparison vectorizable
+        UINT16 depthThreshold = 15;         // Unit: mm, a sample changed if its depth moved by more than
+        float depthThresholdRelative = 0.02f;// max(depthThreshold, depthThresholdRelative * depth)
+        float tileChangeFraction = 0.05f;   // a tile changed if more of its samples changed
+        float maxTranslation = 0.005f;      // Unit: m, camera motion since the reference frame that changes every tile
+        float maxRotation = 0.005f;         // Unit: rad
+        UINT maxUnchangedFrames = 45;       // a frame is reported changed at least this often
+    };
+
+    struct ChangeResult {
+        bool changed = true;
+        bool poseChanged = false;
+        UINT changedTiles = 0;
+    };
+
+    // Per-tile comparison of the depth of a frame with the depth of the last processed frame (the reference), together
+    // with the camera motion in between. Frames without significant change can skip processing and keep the outputs of
+    // the reference frame; the reference only moves on when a frame is processed, so slow drift still accumulates.
+    class ChangeDetector
+    {
+    public:
+        void Reset();
+
+        // Drop the reference, e.g. when the outputs of the reference frame no longer apply; the next frame is changed
+        void Invalidate() { m_hasReference = false; }
+
+        // Compare the frame with the reference. The frame is changed if any tile or the pose changed, there is no
+        // reference yet, or maxUnchangedFrames frames were unchanged in a row.
+        ChangeResult Compare(const ChangeDetectionSettings& settings, const UINT16* pDepth, UINT width, UINT height,
+            DirectX::FXMMATRIX cameraToWorld);
+
+        // Make the frame the reference, after it was processed
+        void SetReference(const UINT16* pDepth, UINT width, UINT height, DirectX::FXMMATRIX cameraToWorld);
+
+        // Changed tiles of the last compared frame, row-major, 1 = changed
+        void ChangedTiles(std::vector<UINT8>& mask, UINT& tilesX, UINT& tilesY) const;
+
+        // {"frames":...,"unchanged":...,"changed_tiles":...,"tiles":...,"compare_us":{"mean":...,"p50":...,"p95":...,"max":...}}
+        std::string StatusJson() const;
+
+    private:
+        std::vector<UINT16> m_reference;
+        UINT m_width = 0, m_height = 0;
+        DirectX::XMFLOAT4X4 m_referencePose;
+        bool m_hasReference = false;
+        UINT m_unchangedInRow = 0;
+
+        mutable std::mutex m_mutex;     // guards the members below, read by the status getters
+        std::vector<UINT8> m_changedTiles;
+        UINT m_tilesX = 0, m_tilesY = 0;
+        UINT m_lastChangedTiles = 0;
+        UINT64 m_frames = 0;
+        UINT64 m_unchanged = 0;
+        StageHistogram m_durations;
+    };
+
+    // True if frames processed with a and b produce their outputs the same way, so outputs of one can stand in for the other
+    bool SameAhatOutputSettings(const AhatFrameParams& a, const AhatFrameParams& b);
+}
@@ -0,0 +1,76 @@
+#include "Colormap.h"
+#include <cmath>
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    static float Saturate(float x)
+    {
+        return (std::min)(1.0f, (std::max)(0.0f, x));
+    }
+
+    static float Polynomial(const float (&c)[7], float t)
+    {
+        return c[0] + t * (c[1] + t * (c[2] + t * (c[3] + t * (c[4] + t * (c[5] + t * c[6])))));
+    }
+
+    // color of t in [0, 1] as r, g, b in [0, 1]
+    static void ColormapColor(Colormap colormap, float t, float (&rgb)[3])
+    {
+        switch (colormap)
+        {
+        case Colormap::Jet:
+            rgb[0] = Saturate(1.5f - fabsf(4 * t - 3));
+            rgb[1] = Saturate(1.5f - fabsf(4 * t - 2));
+            rgb[2] = Saturate(1.5f - fabsf(4 * t - 1));
+            break;
+        case Colormap::Turbo:
+        {
+            // polynomial approximation of Turbo (A. Mikhailov, 2019)
+            static const float r[7] = { 0.13572138f, 4.61539260f, -42.66032258f, 132.13108234f, -152.94239396f, 59.28637943f, 0 };
+            static const float g[7] = { 0.09140261f, 2.19418839f, 4.84296658f, -14.18503333f, 4.27729857f, 2.82956604f, 0 };
+            static const float b[7] = { 0.10667330f, 12.64194608f, -60.58204836f, 110.36276771f, -89.90310912f, 27.34824973f, 0 };
+            rgb[0] = Saturate(Polynomial(r, t));
+            rgb[1] = Saturate(Polynomial(g, t));
+            rgb[2] = Saturate(Polynomial(b, t));
+            break;
+        }
+        case Colormap::Viridis:
+        {
+            // polynomial fit of matplotlib's viridis
+            static const float r[7] = { 0.27772733f, 0.10509304f, -0.33086183f, -4.63423050f, 6.22826994f, 4.77638500f, -5.43545586f };
+            static const float g[7] = { 0.00540734f, 1.40461353f, 0.21484756f, -5.79910097f, 14.17993337f, -13.74514538f, 4.64585261f };
+            static const float b[7] = { 0.33409981f, 1.38459016f, 0.09509516f, -19.33244096f, 56.69055260f, -65.35303263f, 26.31243525f };
+            rgb[0] = Saturate(Polynomial(r, t));
+            rgb[1] = Saturate(Polynomial(g, t));
+            rgb[2] = Saturate(Polynomial(b, t));
+            break;
+        }
+        default:
+            rgb[0] = rgb[1] = rgb[2] = t;
+            break;
+        }
+    }
+
+    void ColormapLut::Build(Colormap colormap, UINT16 rangeMin, UINT16 rangeMax)
+    {
+        float scale = rangeMax > rangeMin ? 1.0f / (rangeMax - rangeMin) : 0.0f;
+        m_table[0] = 0;
+        for (UINT value = 1; value < kSize; value++)
+        {
+            float rgb[3];
+            ColormapColor(colormap, Saturate(((float)value - rangeMin) * scale), rgb);
+            m_table[value] = (UINT32)(rgb[0] * 255 + 0.5f) | ((UINT32)(rgb[1] * 255 + 0.5f) << 8) |
+                ((UINT32)(rgb[2] * 255 + 0.5f) << 16) | 0xFF000000u;
+        }
+    }
+
+    void TextureLut::Build(UINT16 rangeMin, UINT16 rangeMax)
+    {
+        float scale = rangeMax > rangeMin ? 255.0f / (rangeMax - rangeMin) : 0.0f;
+        for (UINT value = 0; value < kSize; value++)
+        {
+            float texel = value <= rangeMin ? 0.0f : (value >= rangeMax ? 255.0f : ((float)value - rangeMin) * scale);
+            m_table[value] = (UINT8)(texel + 0.5f);
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "Platform.h"
+#include <algorithm>
+#include <vector>
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    enum class Colormap {
+        None = 0,       // no color texture is generated
+        Grayscale = 1,
+        Jet = 2,
+        Turbo = 3,
+        Viridis = 4,
+    };
+
+    // Lookup table from raw 12-bit depth or AbImage values to packed RGBA8 (R in the lowest byte).
+    // Values are clamped to the table, value 0 (no signal) maps to transparent black.
+    class ColormapLut
+    {
+    public:
+        static const UINT kSize = 4096;
+
+        // Map [rangeMin, rangeMax] onto the colormap, values outside the range get the end colors
+        void Build(Colormap colormap, UINT16 rangeMin, UINT16 rangeMax);
+        UINT32 operator[](UINT value) const { return m_table[(std::min)(value, kSize - 1)]; }
+
+    private:
+        std::vector<UINT32> m_table = std::vector<UINT32>(kSize, 0);
+    };
+
+    // Lookup table from raw 12-bit depth or AbImage values to 8-bit grayscale texels, values are clamped to the table
+    class TextureLut
+    {
+    public:
+        static const UINT kSize = 4096;
+
+        // Map [rangeMin, rangeMax] linearly onto 0-255, values outside the range get the end values
+        void Build(UINT16 rangeMin, UINT16 rangeMax);
+        UINT8 operator[](UINT value) const { return m_table[(std::min)(value, kSize - 1)]; }
+
+    private:
+        std::vector<UINT8> m_table = std::vector<UINT8>(kSize, 0);
+    };
+}
@@ -0,0 +1,175 @@
+#include "DepthQuery.h"
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    static const UINT16 kMinDepthJump = 10;         // Unit: mm, 4 pixels within max(kMinDepthJump, kRelativeDepthJump * depth)
+    static const float kRelativeDepthJump = 0.03f;  // are interpolated
+    static const float kRayStep = 0.01f;            // Unit: m
+    static const float kOcclusionJump = 0.05f;      // Unit: m, change of the surface distance between ray steps at a foreground edge
+
+    void CaptureDepthQueryFrame(const UINT16* pDepth, UINT width, UINT height, UINT16 depthOffset, UINT64 hostTicks,
+        FXMMATRIX cameraToWorld, std::shared_ptr<const DepthQueryGeometry> pGeometry, DepthQueryFrame& frame)
+    {
+        size_t pixelCount = (size_t)width * height;
+        frame.depth.resize(pixelCount);
+        UINT16* pOut = frame.depth.data();
+        for (size_t k = 0; k < pixelCount; k++)
+        {
+            UINT16 depth = pDepth[k];
+            // no return, saturated, or within the offset (as DepthRegistration::SampleFrame), which would wrap around
+            pOut[k] = (depth == 0 || depth > 4090 || depth <= depthOffset) ? 0 : depth - depthOffset;
+        }
+        frame.width = width;
+        frame.height = height;
+        frame.hostTicks = hostTicks;
+        XMStoreFloat4x4(&frame.cameraToWorld, cameraToWorld);
+        XMStoreFloat4x4(&frame.worldToCamera, XMMatrixInverse(nullptr, cameraToWorld));
+        frame.pGeometry = std::move(pGeometry);
+    }
+
+    // Depth (m) and camera ray at a fractional pixel
+    static DepthQueryStatus SampleDepth(const DepthQueryFrame& frame, float u, float v, float& depth, XMVECTOR& ray)
+    {
+        if (!(u >= 0 && v >= 0 && u <= frame.width - 1 && v <= frame.height - 1) || frame.width < 2 || frame.height < 2)
+        {
+            return DepthQueryStatus::Invalid;
+        }
+        UINT x = (std::min)((UINT)u, frame.width - 2);
+        UINT y = (std::min)((UINT)v, frame.height - 2);
+        float fx = u - x, fy = v - y;
+        size_t idx[4] = { frame.width * y + x, frame.width * y + x + 1, frame.width * (y + 1) + x, frame.width * (y + 1) + x + 1 };
+        float weights[4] = { (1 - fx) * (1 - fy), fx * (1 - fy), (1 - fx) * fy, fx * fy };
+        const XMFLOAT3* pRays = frame.pGeometry->unitRays.data();
+
+        UINT16 depthMin = UINT16_MAX, depthMax = 0;
+        int nearest = -1;
+        bool allValid = true;
+        for (int k = 0; k < 4; k++)
+        {
+            UINT16 d = frame.depth[idx[k]];
+            if (d == 0 || pRays[idx[k]].z == 0)
+            {
+                allValid = false;
+                continue;
+            }
+            depthMin = (std::min)(depthMin, d);
+            depthMax = (std::max)(depthMax, d);
+            if (nearest < 0 || weights[k] > weights[nearest])
+            {
+                nearest = k;
+            }
+        }
+        if (nearest < 0)
+        {
+            return DepthQueryStatus::Invalid;
+        }
+
+        // interpolating across a depth edge would create a point between the surfaces
+        if (allValid && depthMax - depthMin <= (std::max)(kMinDepthJump, (UINT16)(kRelativeDepthJump * depthMin)))
+        {
+            float sum = 0;
+            XMVECTOR raySum = XMVectorZero();
+            for (int k = 0; k < 4; k++)
+            {
+                sum += weights[k] * frame.depth[idx[k]];
+                raySum += weights[k] * XMLoadFloat3(&pRays[idx[k]]);
+            }
+            depth = sum / 1000;
+            ray = XMVector3Normalize(raySum);
+            return DepthQueryStatus::Bilinear;
+        }
+        depth = (float)frame.depth[idx[nearest]] / 1000;
+        ray = XMLoadFloat3(&pRays[idx[nearest]]);
+        return DepthQueryStatus::Nearest;
+    }
+
+    static void WriteResult(DepthQueryStatus status, float value, FXMVECTOR pointInWorld, float* pResult)
+    {
+        XMFLOAT3 point;
+        XMStoreFloat3(&point, pointInWorld);
+        pResult[0] = (float)status;
+        pResult[1] = value;
+        pResult[2] = point.x;
+        pResult[3] = point.y;
+        pResult[4] = -point.z;
+    }
+
+    void SampleDepthPixels(const DepthQueryFrame& frame, const float* pPixels, size_t count, float* pResults)
+    {
+        XMMATRIX cameraToWorld = XMLoadFloat4x4(&frame.cameraToWorld);
+        for (size_t q = 0; q < count; q++)
+        {
+            float depth = 0;
+            XMVECTOR ray = XMVectorZero();
+            auto status = SampleDepth(frame, pPixels[2 * q], pPixels[2 * q + 1], depth, ray);
+            if (status == DepthQueryStatus::Invalid)
+            {
+                WriteResult(status, 0, XMVectorZero(), pResults + kDepthQueryResultSize * q);
+                continue;
+            }
+            WriteResult(status, depth, XMVector3Transform(depth * ray, cameraToWorld), pResults + kDepthQueryResultSize * q);
+        }
+    }
+
+    void CastDepthRays(const DepthQueryFrame& frame, const float* pRays, size_t count, float maxDistance, float* pResults)
+    {
+        XMMATRIX worldToCamera = XMLoadFloat4x4(&frame.worldToCamera);
+        const auto& projection = frame.pGeometry->projection;
+        for (size_t q = 0; q < count; q++)
+        {
+            const float* r = pRays + 6 * q;
+            XMVECTOR origin = XMVectorSet(r[0], r[1], -r[2], 1);
+            XMVECTOR direction = XMVector3Normalize(XMVectorSet(r[3], r[4], -r[5], 0));
+            XMVECTOR originInCam = XMVector3Transform(origin, worldToCamera);
+            XMVECTOR directionInCam = XMVector3TransformNormal(direction, worldToCamera);
+
+            // march until the ray point is farther from the camera than the surface seen along its pixel ray
+            auto status = DepthQueryStatus::Invalid;
+            float hitDistance = 0;
+            float tPrev = 0, fPrev = 0;
+            bool prevValid = false;
+            float marchDistance = projection.IsBuilt() ? maxDistance : -1;
+            for (float t = 0; t <= marchDistance; t += kRayStep)
+            {
+                XMFLOAT3 p;
+                XMStoreFloat3(&p, originInCam + t * directionInCam);
+                float u, v, depth;
+                XMVECTOR pixelRay;
+                DepthQueryStatus sampleStatus = DepthQueryStatus::Invalid;
+                if (p.z > 0 && projection.Project(p.x / p.z, p.y / p.z, u, v))
+                {
+                    sampleStatus = SampleDepth(frame, u, v, depth, pixelRay);
+                }
+                if (sampleStatus == DepthQueryStatus::Invalid)
+                {
+                    prevValid = false;
+                    continue;
+                }
+
+                float f = XMVectorGetX(XMVector3Length(XMLoadFloat3(&p))) - depth;
+                if (f >= 0)
+                {
+                    if (prevValid && f - fPrev <= kOcclusionJump)
+                    {
+                        hitDistance = tPrev + (t - tPrev) * -fPrev / (f - fPrev);
+                        status = sampleStatus;
+                    }
+                    else
+                    {
+                        hitDistance = t;
+                        status = DepthQueryStatus::Occluded;
+                    }
+                    break;
+                }
+                tPrev = t;
+                fPrev = f;
+                prevValid = true;
+            }
+            WriteResult(status, hitDistance, status == DepthQueryStatus::Invalid ? XMVectorZero() : origin + hitDistance * direction,
+                pResults + kDepthQueryResultSize * q);
+        }
+    }
+}
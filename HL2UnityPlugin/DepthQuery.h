@@ -0,0 +1,45 @@
+#pragma once
+#include "VlcReprojection.h"
+#include <DirectXMath.h>
+#include <memory>
+#include <vector>
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    enum class DepthQueryStatus {
+        Invalid = 0,    // no valid depth (outside the image, no return) or no hit along the ray
+        Bilinear = 1,   // interpolated from 4 consistent pixels
+        Nearest = 2,    // at a depth edge or next to invalid pixels: nearest valid pixel
+        Occluded = 3,   // rays only: the ray passes behind a foreground edge, the hit is the first unseen point
+    };
+
+    // Fixed camera geometry of the AHAT sensor, shared by all query frames
+    struct DepthQueryGeometry {
+        std::vector<DirectX::XMFLOAT3> unitRays;
+        CameraProjectionLut projection;
+    };
+
+    // Depth frame kept for queries
+    struct DepthQueryFrame {
+        std::vector<UINT16> depth;      // Unit: mm, offset applied, 0 = invalid
+        UINT width = 0;
+        UINT height = 0;
+        UINT64 hostTicks = 0;
+        DirectX::XMFLOAT4X4 cameraToWorld;
+        DirectX::XMFLOAT4X4 worldToCamera;
+        std::shared_ptr<const DepthQueryGeometry> pGeometry;
+    };
+
+    static const size_t kDepthQueryResultSize = 5;
+
+    void CaptureDepthQueryFrame(const UINT16* pDepth, UINT width, UINT height, UINT16 depthOffset, UINT64 hostTicks,
+        DirectX::FXMMATRIX cameraToWorld, std::shared_ptr<const DepthQueryGeometry> pGeometry, DepthQueryFrame& frame);
+
+    // For each image point (u, v pairs in pixels), write kDepthQueryResultSize floats to pResults:
+    // status, depth (Unit: m, along the pixel ray), world point x, y, z in output coordinates (x, y, -z)
+    void SampleDepthPixels(const DepthQueryFrame& frame, const float* pPixels, size_t count, float* pResults);
+
+    // For each ray (origin x, y, z and direction x, y, z in output coordinates), march up to maxDistance (m) and write
+    // kDepthQueryResultSize floats to pResults: status, distance from the origin to the hit (m), hit point x, y, z
+    void CastDepthRays(const DepthQueryFrame& frame, const float* pRays, size_t count, float maxDistance, float* pResults);
+}
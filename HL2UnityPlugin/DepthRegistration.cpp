@@ -0,0 +1,424 @@
+#include "pch.h"
+#include "DepthRegistration.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <sstream>
+
+using namespace DirectX;
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    static const XMFLOAT4X4 kIdentity(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1);
+
+    void DepthRegistration::Grid::Resize(UINT gridWidth, UINT gridHeight)
+    {
+        width = gridWidth;
+        height = gridHeight;
+        size_t size = (size_t)gridWidth * gridHeight;
+        x.resize(size); y.resize(size); z.resize(size);
+        nx.resize(size); ny.resize(size); nz.resize(size);
+        weight.assign(size, 0);
+    }
+
+    void DepthRegistration::Reset()
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+        m_hasReference = false;
+        m_correction = kIdentity;
+        m_lastResult = RegistrationResult();
+        m_frames = 0;
+        m_accepted = 0;
+        m_rejected = 0;
+    }
+
+    void DepthRegistration::SampleFrame(const UINT16* pDepth, UINT width, UINT height, UINT16 depthOffset, const XMFLOAT3* pUnitRays,
+        const UINT8* pValidMask)
+    {
+        UINT step = m_gridStep;
+        m_frame.Resize(width / step, height / step);
+
+        auto cameraPoint = [&](UINT i, UINT j, XMVECTOR& point) {
+            auto idx = width * i + j;
+            UINT16 depth = pDepth[idx];
+            if (depth > 4090 || depth <= depthOffset || pUnitRays[idx].z == 0 || (pValidMask && !pValidMask[idx]))
+            {
+                return false;
+            }
+            point = (float)(depth - depthOffset) / 1000 * XMLoadFloat3(&pUnitRays[idx]);
+            return true;
+        };
+
+        for (UINT gi = 0; gi < m_frame.height; gi++)
+        {
+            UINT i = gi * step;
+            for (UINT gj = 0; gj < m_frame.width; gj++)
+            {
+                UINT j = gj * step;
+                XMVECTOR point, right, down;
+                if (i + step >= height || j + step >= width ||
+                    !cameraPoint(i, j, point) || !cameraPoint(i, j + step, right) || !cameraPoint(i + step, j, down))
+                {
+                    continue;
+                }
+
+                // neighbors across a depth discontinuity do not give a surface normal
+                float maxNeighborDistance = 0.025f * step * XMVectorGetX(XMVector3Length(point));
+                if (XMVectorGetX(XMVector3Length(right - point)) > maxNeighborDistance ||
+                    XMVectorGetX(XMVector3Length(down - point)) > maxNeighborDistance)
+                {
+                    continue;
+                }
+                XMVECTOR normal = XMVector3Normalize(XMVector3Cross(down - point, right - point));
+                if (XMVectorGetX(XMVector3Dot(normal, point)) > 0)
+                {
+                    normal = -normal;
+                }
+
+                size_t k = (size_t)m_frame.width * gi + gj;
+                XMFLOAT3 p, n;
+                XMStoreFloat3(&p, point);
+                XMStoreFloat3(&n, normal);
+                m_frame.x[k] = p.x; m_frame.y[k] = p.y; m_frame.z[k] = p.z;
+                m_frame.nx[k] = n.x; m_frame.ny[k] = n.y; m_frame.nz[k] = n.z;
+                m_frame.weight[k] = 1;
+            }
+        }
+    }
+
+    UINT DepthRegistration::Associate(const RegistrationSettings& settings, const CameraProjectionLut& projection, FXMMATRIX cameraToWorld)
+    {
+        m_px.clear(); m_py.clear(); m_pz.clear();
+        m_nx.clear(); m_ny.clear(); m_nz.clear();
+        m_residual.clear();
+
+        // projective association: the reference sample in the grid cell the frame sample projects to
+        XMMATRIX toReferenceCamera = cameraToWorld * XMLoadFloat4x4(&m_referenceWorldToCamera);
+        const float maxDistanceSq = settings.maxPointDistance * settings.maxPointDistance;
+        const float cellScale = 1.0f / m_gridStep;
+        const auto& ref = m_reference;
+        for (size_t k = 0; k < m_frame.Size(); k++)
+        {
+            if (m_frame.weight[k] == 0)
+            {
+                continue;
+            }
+            XMVECTOR point = XMVectorSet(m_frame.x[k], m_frame.y[k], m_frame.z[k], 1);
+            XMFLOAT3 pr;
+            XMStoreFloat3(&pr, XMVector3Transform(point, toReferenceCamera));
+            float u, v;
+            if (pr.z <= 0 || !projection.Project(pr.x / pr.z, pr.y / pr.z, u, v))
+            {
+                continue;
+            }
+            UINT gi = (UINT)(v * cellScale + 0.5f), gj = (UINT)(u * cellScale + 0.5f);
+            if (gi >= ref.height || gj >= ref.width)
+            {
+                continue;
+            }
+            size_t r = (size_t)ref.width * gi + gj;
+            if (ref.weight[r] == 0)
+            {
+                continue;
+            }
+
+            XMVECTOR pointInWorld = XMVector3Transform(point, cameraToWorld);
+            XMVECTOR normalInWorld = XMVector3TransformNormal(XMVectorSet(m_frame.nx[k], m_frame.ny[k], m_frame.nz[k], 0), cameraToWorld);
+            XMVECTOR refNormal = XMVectorSet(ref.nx[r], ref.ny[r], ref.nz[r], 0);
+            XMVECTOR diff = pointInWorld - XMVectorSet(ref.x[r], ref.y[r], ref.z[r], 1);
+            if (XMVectorGetX(XMVector3LengthSq(diff)) > maxDistanceSq ||
+                XMVectorGetX(XMVector3Dot(normalInWorld, refNormal)) < settings.minNormalCosine)
+            {
+                continue;
+            }
+            XMFLOAT3 p;
+            XMStoreFloat3(&p, pointInWorld);
+            m_px.push_back(p.x); m_py.push_back(p.y); m_pz.push_back(p.z);
+            m_nx.push_back(ref.nx[r]); m_ny.push_back(ref.ny[r]); m_nz.push_back(ref.nz[r]);
+            m_residual.push_back(XMVectorGetX(XMVector3Dot(refNormal, diff)));
+        }
+        return (UINT)m_residual.size();
+    }
+
+    bool DepthRegistration::Solve(FXMVECTOR pivot, XMMATRIX& update, float& rmse, float& step) const
+    {
+        // Linearized residual of a correspondence after a small rotation w about pivot and a translation t:
+        // r + dot(c, w) + dot(n, t) with c = (p - pivot) x n. The 6x6 normal equations are accumulated in 3x3 blocks,
+        // each block row as one vector multiply-add.
+        XMVECTOR cc0 = XMVectorZero(), cc1 = XMVectorZero(), cc2 = XMVectorZero();
+        XMVECTOR cn0 = XMVectorZero(), cn1 = XMVectorZero(), cn2 = XMVectorZero();
+        XMVECTOR nn0 = XMVectorZero(), nn1 = XMVectorZero(), nn2 = XMVectorZero();
+        XMVECTOR bc = XMVectorZero(), bn = XMVectorZero();
+        float sumSq = 0;
+        size_t count = m_residual.size();
+        for (size_t k = 0; k < count; k++)
+        {
+            XMVECTOR n = XMVectorSet(m_nx[k], m_ny[k], m_nz[k], 0);
+            XMVECTOR c = XMVector3Cross(XMVectorSet(m_px[k], m_py[k], m_pz[k], 0) - pivot, n);
+            XMVECTOR r = XMVectorReplicate(m_residual[k]);
+            XMVECTOR cx = XMVectorSplatX(c), cy = XMVectorSplatY(c), cz = XMVectorSplatZ(c);
+            cc0 = XMVectorMultiplyAdd(c, cx, cc0); cc1 = XMVectorMultiplyAdd(c, cy, cc1); cc2 = XMVectorMultiplyAdd(c, cz, cc2);
+            cn0 = XMVectorMultiplyAdd(n, cx, cn0); cn1 = XMVectorMultiplyAdd(n, cy, cn1); cn2 = XMVectorMultiplyAdd(n, cz, cn2);
+            nn0 = XMVectorMultiplyAdd(n, XMVectorSplatX(n), nn0);
+            nn1 = XMVectorMultiplyAdd(n, XMVectorSplatY(n), nn1);
+            nn2 = XMVectorMultiplyAdd(n, XMVectorSplatZ(n), nn2);
+            bc = XMVectorMultiplyAdd(c, r, bc);
+            bn = XMVectorMultiplyAdd(n, r, bn);
+            sumSq += m_residual[k] * m_residual[k];
+        }
+        if (count == 0)
+        {
+            return false;
+        }
+        rmse = sqrtf(sumSq / count);
+
+        XMFLOAT3 rows[9], b[2];
+        const XMVECTOR blocks[9] = { cc0, cc1, cc2, cn0, cn1, cn2, nn0, nn1, nn2 };
+        for (int k = 0; k < 9; k++) XMStoreFloat3(&rows[k], blocks[k]);
+        XMStoreFloat3(&b[0], bc);
+        XMStoreFloat3(&b[1], bn);
+        double A[6][6], x[6];
+        for (int i = 0; i < 3; i++)
+        {
+            const float* cc = &rows[i].x;
+            const float* cn = &rows[3 + i].x;
+            const float* nn = &rows[6 + i].x;
+            for (int j = 0; j < 3; j++)
+            {
+                A[i][j] = cc[j];
+                A[i][3 + j] = cn[j];
+                A[3 + j][i] = cn[j];
+                A[3 + i][3 + j] = nn[j];
+            }
+            x[i] = -(&b[0].x)[i];
+            x[3 + i] = -(&b[1].x)[i];
+        }
+
+        // Cholesky factorization in place, light damping keeps degenerate directions (e.g. a single plane) from moving
+        for (int i = 0; i < 6; i++)
+        {
+            A[i][i] += 1e-6 * count;
+        }
+        for (int j = 0; j < 6; j++)
+        {
+            double d = A[j][j];
+            for (int k = 0; k < j; k++) d -= A[j][k] * A[j][k];
+            if (d <= 0)
+            {
+                return false;
+            }
+            A[j][j] = sqrt(d);
+            for (int i = j + 1; i < 6; i++)
+            {
+                double s = A[i][j];
+                for (int k = 0; k < j; k++) s -= A[i][k] * A[j][k];
+                A[i][j] = s / A[j][j];
+            }
+        }
+        for (int i = 0; i < 6; i++)
+        {
+            for (int k = 0; k < i; k++) x[i] -= A[i][k] * x[k];
+            x[i] /= A[i][i];
+        }
+        for (int i = 5; i >= 0; i--)
+        {
+            for (int k = i + 1; k < 6; k++) x[i] -= A[k][i] * x[k];
+            x[i] /= A[i][i];
+        }
+
+        XMVECTOR rotation = XMVectorSet((float)x[0], (float)x[1], (float)x[2], 0);
+        XMVECTOR translation = XMVectorSet((float)x[3], (float)x[4], (float)x[5], 0);
+        float angle = XMVectorGetX(XMVector3Length(rotation));
+        XMMATRIX rotate = angle > 0 ? XMMatrixRotationAxis(rotation / angle, angle) : XMMatrixIdentity();
+        update = XMMatrixTranslationFromVector(-pivot) * rotate * XMMatrixTranslationFromVector(pivot) *
+            XMMatrixTranslationFromVector(translation);
+        step = angle + XMVectorGetX(XMVector3Length(translation));
+        return true;
+    }
+
+    void DepthRegistration::UpdateReference(const RegistrationSettings& settings, const CameraProjectionLut& projection, FXMMATRIX cameraToWorld)
+    {
+        XMMATRIX worldToCamera = XMMatrixInverse(nullptr, cameraToWorld);
+        auto& out = m_resampled;
+        out.Resize(m_frame.width, m_frame.height);
+
+        // model: splat the previous model into the new view, keeping the nearest sample of each cell
+        bool fuse = settings.reference == RegistrationReference::Model && m_hasReference;
+        if (fuse)
+        {
+            m_resampledDepth.assign(out.Size(), FLT_MAX);
+            const float cellScale = 1.0f / m_gridStep;
+            for (size_t r = 0; r < m_reference.Size(); r++)
+            {
+                if (m_reference.weight[r] == 0)
+                {
+                    continue;
+                }
+                XMFLOAT3 pc;
+                XMStoreFloat3(&pc, XMVector3Transform(XMVectorSet(m_reference.x[r], m_reference.y[r], m_reference.z[r], 1), worldToCamera));
+                float u, v;
+                if (pc.z <= 0 || !projection.Project(pc.x / pc.z, pc.y / pc.z, u, v))
+                {
+                    continue;
+                }
+                UINT gi = (UINT)(v * cellScale + 0.5f), gj = (UINT)(u * cellScale + 0.5f);
+                if (gi >= out.height || gj >= out.width)
+                {
+                    continue;
+                }
+                size_t k = (size_t)out.width * gi + gj;
+                if (pc.z >= m_resampledDepth[k])
+                {
+                    continue;
+                }
+                m_resampledDepth[k] = pc.z;
+                out.x[k] = m_reference.x[r]; out.y[k] = m_reference.y[r]; out.z[k] = m_reference.z[r];
+                out.nx[k] = m_reference.nx[r]; out.ny[k] = m_reference.ny[r]; out.nz[k] = m_reference.nz[r];
+                out.weight[k] = m_reference.weight[r];
+            }
+        }
+
+        // merge the frame: running average where it agrees with the model, replace it where it does not, and let
+        // model samples the frame did not see fade out
+        const float maxDistanceSq = settings.maxPointDistance * settings.maxPointDistance;
+        for (size_t k = 0; k < m_frame.Size(); k++)
+        {
+            if (m_frame.weight[k] == 0)
+            {
+                out.weight[k] = (std::max)(out.weight[k] - 1, 0.0f);
+                continue;
+            }
+            XMVECTOR point = XMVector3Transform(XMVectorSet(m_frame.x[k], m_frame.y[k], m_frame.z[k], 1), cameraToWorld);
+            XMVECTOR normal = XMVector3TransformNormal(XMVectorSet(m_frame.nx[k], m_frame.ny[k], m_frame.nz[k], 0), cameraToWorld);
+            float weight = out.weight[k];
+            if (weight > 0)
+            {
+                XMVECTOR modelPoint = XMVectorSet(out.x[k], out.y[k], out.z[k], 1);
+                if (XMVectorGetX(XMVector3LengthSq(point - modelPoint)) <= maxDistanceSq)
+                {
+                    point = (weight * modelPoint + point) / (weight + 1);
+                    normal = XMVector3Normalize(weight * XMVectorSet(out.nx[k], out.ny[k], out.nz[k], 0) + normal);
+                    weight = (std::min)(weight + 1, settings.maxModelWeight);
+                }
+                else
+                {
+                    weight = 1;
+                }
+            }
+            else
+            {
+                weight = 1;
+            }
+            XMFLOAT3 p, n;
+            XMStoreFloat3(&p, point);
+            XMStoreFloat3(&n, normal);
+            out.x[k] = p.x; out.y[k] = p.y; out.z[k] = p.z;
+            out.nx[k] = n.x; out.ny[k] = n.y; out.nz[k] = n.z;
+            out.weight[k] = weight;
+        }
+
+        std::swap(m_reference, m_resampled);
+        XMStoreFloat4x4(&m_referenceWorldToCamera, worldToCamera);
+        m_hasReference = true;
+    }
+
+    RegistrationResult DepthRegistration::Register(const RegistrationSettings& settings, const UINT16* pDepth, UINT width, UINT height,
+        UINT16 depthOffset, const XMFLOAT3* pUnitRays, const UINT8* pValidMask, const CameraProjectionLut& projection, XMMATRIX& cameraToWorld)
+    {
+        auto start = StreamStats::Clock::now();
+        UINT step = (std::max)(settings.gridStep, 1u);
+        if (step != m_gridStep || width != m_imageWidth || height != m_imageHeight)
+        {
+            m_gridStep = step;
+            m_imageWidth = width;
+            m_imageHeight = height;
+            m_hasReference = false;
+        }
+        SampleFrame(pDepth, width, height, depthOffset, pUnitRays, pValidMask);
+
+        RegistrationResult result;
+        XMMATRIX locator = cameraToWorld;
+        XMMATRIX estimate = locator * XMLoadFloat4x4(&m_correction);
+        bool attempted = m_hasReference && projection.IsBuilt();
+        if (attempted)
+        {
+            bool solved = false;
+            for (int iteration = 0; iteration < settings.iterations; iteration++)
+            {
+                result.correspondences = Associate(settings, projection, estimate);
+                XMMATRIX update;
+                float step;
+                if (result.correspondences < settings.minCorrespondences ||
+                    !Solve(XMVector3Transform(XMVectorZero(), estimate), update, result.rmse, step))
+                {
+                    solved = false;
+                    break;
+                }
+                estimate = estimate * update;
+                result.iterations = iteration + 1;
+                solved = true;
+
+                // converged: the update moves points within a meter of the camera by well under a millimeter
+                if (step < 1e-4f)
+                {
+                    break;
+                }
+            }
+
+            // difference between the refined and the locator pose, as camera displacement and rotation angle
+            XMMATRIX relative = estimate * XMMatrixInverse(nullptr, locator);
+            float trace = XMVectorGetX(relative.r[0]) + XMVectorGetY(relative.r[1]) + XMVectorGetZ(relative.r[2]);
+            result.correctionAngle = acosf((std::min)((std::max)((trace - 1) / 2, -1.0f), 1.0f));
+            result.correctionDistance = XMVectorGetX(XMVector3Length(
+                XMVector3Transform(XMVectorZero(), estimate) - XMVector3Transform(XMVectorZero(), locator)));
+            result.accepted = solved && result.correctionDistance <= settings.maxCorrectionDistance &&
+                result.correctionAngle <= settings.maxCorrectionAngle;
+        }
+
+        if (result.accepted)
+        {
+            cameraToWorld = estimate;
+            XMStoreFloat4x4(&m_correction, XMMatrixInverse(nullptr, locator) * estimate);
+        }
+        else
+        {
+            // restart from the locator pose, the reference does not fit it
+            m_correction = kIdentity;
+            m_hasReference = false;
+        }
+        if (projection.IsBuilt())
+        {
+            UpdateReference(settings, projection, cameraToWorld);
+        }
+
+        m_durations.Add(std::chrono::duration<float, std::micro>(StreamStats::Clock::now() - start).count());
+        std::lock_guard<std::mutex> l(m_mutex);
+        m_frames++;
+        if (attempted)
+        {
+            (result.accepted ? m_accepted : m_rejected)++;
+        }
+        m_lastResult = result;
+        return result;
+    }
+
+    std::string DepthRegistration::StatusJson() const
+    {
+        auto durations = m_durations.Summarize();
+        std::lock_guard<std::mutex> l(m_mutex);
+        std::stringstream ss;
+        ss << "{\"frames\":" << m_frames
+            << ",\"accepted\":" << m_accepted
+            << ",\"rejected\":" << m_rejected
+            << ",\"correspondences\":" << m_lastResult.correspondences
+            << ",\"iterations\":" << m_lastResult.iterations
+            << ",\"rmse_mm\":" << m_lastResult.rmse * 1000
+            << ",\"correction_mm\":" << m_lastResult.correctionDistance * 1000
+            << ",\"correction_deg\":" << m_lastResult.correctionAngle * 57.29578f
+            << ",\"register_us\":{\"mean\":" << durations.mean
+            << ",\"p50\":" << durations.p50
+            << ",\"p95\":" << durations.p95
+            << ",\"max\":" << durations.max << "}}";
+        return ss.str();
+    }
+}
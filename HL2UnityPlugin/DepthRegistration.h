@@ -0,0 +1,95 @@
+#pragma once
+#include "PipelineStats.h"
+#include "VlcReprojection.h"
+#include <windows.h>
+#include <DirectXMath.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    enum class RegistrationReference {
+        PreviousFrame = 0,  // the last registered frame
+        Model = 1,          // running average of the registered frames, resampled in the view of the last one
+    };
+
+    struct RegistrationSettings {
+        RegistrationReference reference = RegistrationReference::Model;
+        UINT gridStep = 4;                  // register every gridStep-th pixel of the organized grid
+        int iterations = 6;                 // Gauss-Newton iterations per frame
+        float maxPointDistance = 0.05f;     // Unit: m, correspondences farther apart are rejected
+        float minNormalCosine = 0.8f;       // min cosine between the normals of a correspondence
+        UINT minCorrespondences = 300;
+        float maxCorrectionDistance = 0.05f;// Unit: m, refined poses farther from the locator pose are rejected
+        float maxCorrectionAngle = 0.05f;   // Unit: rad
+        float maxModelWeight = 16;          // observations after which the model average stops slowing down
+    };
+
+    struct RegistrationResult {
+        bool accepted = false;
+        UINT correspondences = 0;
+        int iterations = 0;
+        float rmse = 0;                     // Unit: m, point to plane
+        float correctionDistance = 0;       // Unit: m, camera position of the refined pose relative to the locator pose
+        float correctionAngle = 0;          // Unit: rad
+    };
+
+    // Point-to-plane ICP of AHAT frames against the previous frame or a fused model, starting from the locator pose.
+    // Correspondences come from projecting the grid samples of the frame into the reference view (projective data
+    // association on the organized grid), and the normal equations are accumulated with DirectXMath vectors. The
+    // correction of the locator pose is carried over to the next frame; a refinement that fails or moves too far from the
+    // locator pose is rejected and restarts the reference from the frame at its locator pose, so the refined pose stays
+    // close to the drift-free head tracking.
+    class DepthRegistration
+    {
+    public:
+        void Reset();
+
+        // Refine cameraToWorld (the locator pose of the frame, p_world = p_camera * cameraToWorld) in place and make the
+        // frame the reference of the next one. pUnitRays and projection describe the depth camera.
+        RegistrationResult Register(const RegistrationSettings& settings, const UINT16* pDepth, UINT width, UINT height,
+            UINT16 depthOffset, const DirectX::XMFLOAT3* pUnitRays, const UINT8* pValidMask, const CameraProjectionLut& projection,
+            DirectX::XMMATRIX& cameraToWorld);
+
+        // {"frames":...,"accepted":...,"rejected":...,"correspondences":...,"iterations":...,"rmse_mm":...,
+        //  "correction_mm":...,"correction_deg":...,"register_us":{"mean":...,"p50":...,"p95":...,"max":...}}
+        std::string StatusJson() const;
+
+    private:
+        // samples on the organized grid with normals, structure of arrays; weight 0 marks an empty cell
+        struct Grid {
+            UINT width = 0, height = 0;
+            std::vector<float> x, y, z, nx, ny, nz, weight;
+            void Resize(UINT gridWidth, UINT gridHeight);
+            size_t Size() const { return weight.size(); }
+        };
+
+        void SampleFrame(const UINT16* pDepth, UINT width, UINT height, UINT16 depthOffset, const DirectX::XMFLOAT3* pUnitRays,
+            const UINT8* pValidMask);
+        UINT Associate(const RegistrationSettings& settings, const CameraProjectionLut& projection, DirectX::FXMMATRIX cameraToWorld);
+        // one Gauss-Newton step; step is the size of the update (translation in m plus rotation in rad)
+        bool Solve(DirectX::FXMVECTOR pivot, DirectX::XMMATRIX& update, float& rmse, float& step) const;
+        void UpdateReference(const RegistrationSettings& settings, const CameraProjectionLut& projection, DirectX::FXMMATRIX cameraToWorld);
+
+        Grid m_frame;                       // camera space
+        Grid m_reference;                   // world space, organized in the view of m_referenceWorldToCamera
+        Grid m_resampled;
+        std::vector<float> m_resampledDepth;
+        DirectX::XMFLOAT4X4 m_referenceWorldToCamera;
+        bool m_hasReference = false;
+        // world space correction of the locator pose, refined = locator * correction
+        DirectX::XMFLOAT4X4 m_correction{ 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+        UINT m_imageWidth = 0, m_imageHeight = 0, m_gridStep = 1;
+
+        // correspondences of the current iteration: frame point in world space, reference normal and residual
+        std::vector<float> m_px, m_py, m_pz, m_nx, m_ny, m_nz, m_residual;
+
+        mutable std::mutex m_mutex;
+        StageHistogram m_durations;
+        RegistrationResult m_lastResult;
+        UINT64 m_frames = 0;
+        UINT64 m_accepted = 0;
+        UINT64 m_rejected = 0;
+    };
+}
@@ -0,0 +1,3 @@
+#include "pch.h"
+#include "FrameArrivedEventArgs.h"
+#include "FrameArrivedEventArgs.g.cpp"
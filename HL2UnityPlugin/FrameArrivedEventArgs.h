@@ -0,0 +1,22 @@
+#pragma once
+#include "FrameArrivedEventArgs.g.h"
+#include "FrameNotification.h"
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    struct FrameArrivedEventArgs : FrameArrivedEventArgsT<FrameArrivedEventArgs>
+    {
+        FrameArrivedEventArgs(const FrameInfo& info) : m_info(info) {}
+
+        HL2UnityPlugin::SensorStream Stream() { return m_info.stream; }
+        uint64_t FrameIndex() { return m_info.frameIndex; }
+        uint64_t HostTicks() { return m_info.hostTicks; }
+        int32_t Width() { return (int32_t)m_info.width; }
+        int32_t Height() { return (int32_t)m_info.height; }
+        int32_t PointCount() { return (int32_t)m_info.pointCount; }
+        bool Unchanged() { return m_info.unchanged; }
+
+    private:
+        FrameInfo m_info;
+    };
+}
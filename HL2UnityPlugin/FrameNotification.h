@@ -0,0 +1,88 @@
+#pragma once
+#include <windows.h>
+#include <winrt/HL2UnityPlugin.h>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    // Metadata of a frame published by a sensor loop
+    struct FrameInfo {
+        HL2UnityPlugin::SensorStream stream = HL2UnityPlugin::SensorStream::Depth;
+        UINT64 frameIndex = 0;      // counts published frames of the stream since its loop started, unchanged ones included
+        UINT64 hostTicks = 0;       // sensor timestamp, Unit: 100 ns
+        UINT width = 0;
+        UINT height = 0;
+        size_t pointCount = 0;      // points in the published point cloud (AHAT only)
+        bool unchanged = false;     // no significant change since the last processed frame, whose outputs stay published (AHAT only)
+    };
+
+    // Subscribers to the frames of one stream. Callbacks run on the sensor thread right after a frame is published
+    // and outside the buffer lock, so the Get*Buffer getters can be called from them; they should return quickly.
+    template <typename TArg>
+    class Notifier
+    {
+    public:
+        using Callback = std::function<void(const TArg&)>;
+
+        // Returns a token for Unsubscribe, never 0
+        UINT64 Subscribe(Callback callback)
+        {
+            std::lock_guard<std::mutex> l(m_mutex);
+            auto subscribers = std::make_shared<Subscribers>(*m_subscribers);
+            UINT64 token = m_nextToken++;
+            subscribers->emplace_back(token, std::move(callback));
+            m_subscribers = std::move(subscribers);
+            return token;
+        }
+
+        void Unsubscribe(UINT64 token)
+        {
+            std::lock_guard<std::mutex> l(m_mutex);
+            auto subscribers = std::make_shared<Subscribers>(*m_subscribers);
+            subscribers->erase(std::remove_if(subscribers->begin(), subscribers->end(),
+                [token](const typename Subscribers::value_type& subscriber) { return subscriber.first == token; }), subscribers->end());
+            m_subscribers = std::move(subscribers);
+        }
+
+        bool HasSubscribers() const
+        {
+            std::lock_guard<std::mutex> l(m_mutex);
+            return !m_subscribers->empty();
+        }
+
+        void Notify(const TArg& arg) const
+        {
+            // callbacks may subscribe or unsubscribe, so call them on a snapshot of the list
+            std::shared_ptr<const Subscribers> subscribers;
+            {
+                std::lock_guard<std::mutex> l(m_mutex);
+                subscribers = m_subscribers;
+            }
+            for (const auto& subscriber : *subscribers)
+            {
+                try
+                {
+                    subscriber.second(arg);
+                }
+                catch (...)
+                {
+                    // a failing subscriber must not stop the sensor loop or the other subscribers
+                    OutputDebugString(L"Frame callback failed\n");
+                }
+            }
+        }
+
+    private:
+        using Subscribers = std::vector<std::pair<UINT64, Callback>>;
+        mutable std::mutex m_mutex;
+        std::shared_ptr<const Subscribers> m_subscribers = std::make_shared<const Subscribers>(); // copied on write
+        UINT64 m_nextToken = 1;
+    };
+
+    using FrameNotifier = Notifier<FrameInfo>;
+    using FrameCallback = FrameNotifier::Callback;
+}
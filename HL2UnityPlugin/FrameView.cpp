@@ -0,0 +1,67 @@
+#include "pch.h"
+#include "FrameView.h"
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    FrameImage MakeFrameImage(const void* pData, UINT width, UINT height, UINT bytesPerPixel)
+    {
+        FrameImage image;
+        image.pData = pData;
+        image.width = width;
+        image.height = height;
+        image.stride = width * bytesPerPixel;
+        image.bytesPerPixel = bytesPerPixel;
+        return image;
+    }
+
+    void PooledFrameView::HoldSensorFrame(IResearchModeSensorFrame* pSensorFrame)
+    {
+        pSensorFrame->AddRef();
+        sensorFrames.push_back(pSensorFrame);
+    }
+
+    void PooledFrameView::Recycle()
+    {
+        for (auto pSensorFrame : sensorFrames)
+        {
+            pSensorFrame->Release();
+        }
+        sensorFrames.clear();
+        pointCloud.clear();
+        depthCopy.clear();
+        LFKeypoints.clear();
+        RFKeypoints.clear();
+        static_cast<FrameView&>(*this) = FrameView();
+    }
+
+    std::shared_ptr<PooledFrameView> FrameViewPool::Acquire()
+    {
+        std::unique_ptr<PooledFrameView> pView;
+        {
+            std::lock_guard<std::mutex> l(m_freeList->mutex);
+            if (!m_freeList->views.empty())
+            {
+                pView = std::move(m_freeList->views.back());
+                m_freeList->views.pop_back();
+            }
+        }
+        if (!pView)
+        {
+            pView = std::make_unique<PooledFrameView>();
+        }
+
+        auto freeList = m_freeList;
+        return std::shared_ptr<PooledFrameView>(pView.release(), [freeList](PooledFrameView* pReleased) {
+            pReleased->Recycle();
+            std::lock_guard<std::mutex> l(freeList->mutex);
+            if (freeList->views.size() < kMaxFreeViews)
+            {
+                freeList->views.emplace_back(pReleased);
+            }
+            else
+            {
+                delete pReleased;
+            }
+        });
+    }
+}
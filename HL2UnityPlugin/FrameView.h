@@ -0,0 +1,76 @@
+#pragma once
+#include "ResearchModeApi.h"
+#include "FrameNotification.h"
+#include <DirectXMath.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    // One image plane of a frame view, rows are stride bytes apart
+    struct FrameImage {
+        const void* pData = nullptr;
+        UINT width = 0;
+        UINT height = 0;
+        UINT stride = 0;
+        UINT bytesPerPixel = 0;
+    };
+
+    FrameImage MakeFrameImage(const void* pData, UINT width, UINT height, UINT bytesPerPixel);
+
+    // Read-only view of one published frame for native consumers in the same process. Raw images point into the
+    // sensor frame, which is kept alive while the view is referenced. Release views promptly: the sensor has a
+    // limited number of frame buffers.
+    struct FrameView {
+        HL2UnityPlugin::SensorStream stream = HL2UnityPlugin::SensorStream::Depth;
+        UINT64 frameIndex = 0;
+        UINT64 hostTicks = 0;                   // Unit: 100 ns
+        FrameImage depth;                       // AHAT, long throw: UINT16 as published (after the temporal filter)
+        FrameImage abImage;                     // AHAT: UINT16
+        FrameImage sigma;                       // long throw: UINT8
+        FrameImage LF;                          // spatial cameras: UINT8
+        FrameImage RF;
+        const float* pPointCloud = nullptr;     // AHAT: x, y, -z in world space, as GetPointCloudBuffer
+        size_t pointCount = 0;
+        const float* pLFKeypoints = nullptr;    // spatial cameras with feature extraction: x, y, score, level as GetLFKeypoints
+        size_t LFKeypointCount = 0;
+        const float* pRFKeypoints = nullptr;
+        size_t RFKeypointCount = 0;
+        DirectX::XMFLOAT4X4 cameraToWorld;      // depth or LF camera, p_world = p_camera * cameraToWorld
+        DirectX::XMFLOAT4X4 RFCameraToWorld;    // spatial cameras only
+    };
+
+    using FrameViewNotifier = Notifier<std::shared_ptr<const FrameView>>;
+    using FrameViewCallback = FrameViewNotifier::Callback;
+
+    // Frame view together with the storage it points to
+    struct PooledFrameView : FrameView {
+        std::vector<IResearchModeSensorFrame*> sensorFrames;
+        std::vector<float> pointCloud;
+        std::vector<UINT16> depthCopy; // depth that does not live in a sensor frame
+        std::vector<float> LFKeypoints;
+        std::vector<float> RFKeypoints;
+
+        // Keep a reference on the sensor frame until the view is recycled
+        void HoldSensorFrame(IResearchModeSensorFrame* pSensorFrame);
+        // Release the sensor frames and clear the view, buffers keep their capacity
+        void Recycle();
+    };
+
+    // Recycles frame views and their buffers. Views are reference counted and go back to the pool when the
+    // last reference is dropped, also if the pool is destroyed first.
+    class FrameViewPool
+    {
+    public:
+        std::shared_ptr<PooledFrameView> Acquire();
+
+    private:
+        static const size_t kMaxFreeViews = 4;
+        struct FreeList {
+            std::mutex mutex;
+            std::vector<std::unique_ptr<PooledFrameView>> views;
+        };
+        std::shared_ptr<FreeList> m_freeList = std::make_shared<FreeList>();
+    };
+}
@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "HL2ResearchMode.h"
 #include "HL2ResearchMode.g.cpp"
+#include "FrameArrivedEventArgs.h"
 
 extern "C"
 HMODULE LoadLibraryA(
@@ -21,8 +22,25 @@ namespace winrt::HL2UnityPlugin::implementation
 {
     HL2ResearchMode::HL2ResearchMode() 
     {
-        // Load Research Mode library
         camConsentGiven = CreateEvent(nullptr, true, false, nullptr);
+
+        // load the library and enumerate the sensors off the calling thread; Initialize and Start wait for it
+        m_sensorInit.OpenDevice([this]() { OpenSensorDevice(); });
+    }
+
+    // Join the loop threads, including a loop that was stopped from its own callback and not joined since
+    HL2ResearchMode::~HL2ResearchMode()
+    {
+        StopDepthSensorLoop();
+        StopLongDepthSensorLoop();
+        StopSpatialCamerasFrontLoop();
+    }
+
+    void HL2ResearchMode::OpenSensorDevice()
+    {
+        auto start = StreamStats::Clock::now();
+
+        // Load Research Mode library
         HMODULE hrResearchMode = LoadLibraryA("ResearchModeAPI");
         HRESULT hr = S_OK;
 
@@ -39,6 +57,10 @@ namespace winrt::HL2UnityPlugin::implementation
                 winrt::check_hresult(E_INVALIDARG);
             }
         }
+        if (!m_pSensorDevice)
+        {
+            winrt::check_hresult(E_FAIL);
+        }
 
         // get spatial locator of rigNode
         GUID guid;
@@ -58,11 +80,81 @@ namespace winrt::HL2UnityPlugin::implementation
         winrt::check_hresult(m_pSensorDevice->GetSensorCount(&sensorCount));
         m_sensorDescriptors.resize(sensorCount);
         winrt::check_hresult(m_pSensorDevice->GetSensorDescriptors(m_sensorDescriptors.data(), m_sensorDescriptors.size(), &sensorCount));
+
+        std::lock_guard<std::mutex> l(mu);
+        m_deviceOpenMs = MillisecondsSince(start);
+    }
+
+    void HL2ResearchMode::WaitForSensorDevice()
+    {
+        m_sensorInit.WaitForDevice();   // rethrows errors of OpenSensorDevice
+        if (!m_pSensorDevice)
+        {
+            winrt::check_hresult(E_ILLEGAL_METHOD_CALL); // after StopAllSensorDevice
+        }
     }
 
     void HL2ResearchMode::InitializeDepthSensor() 
     {
-       
+        InitializeSensors(true, false, false);
+        WaitForSensorInit(SensorStream::Depth);
+    }
+
+    void HL2ResearchMode::InitializeLongDepthSensor()
+    {
+        InitializeSensors(false, true, false);
+        WaitForSensorInit(SensorStream::LongDepth);
+    }
+
+    void HL2ResearchMode::InitializeSpatialCamerasFront()
+    {
+        InitializeSensors(false, false, true);
+        WaitForSensorInit(SensorStream::SpatialCamerasFront);
+    }
+
+    // Acquire the sensors of the selected streams off the calling thread and return right away; the acquisitions wait for
+    // the device open and run one at a time (see SensorInitScheduler). The Start calls of the streams wait for their
+    // sensors; sensors are kept until StopAllSensorDevice.
+    void HL2ResearchMode::InitializeSensors(bool depth, bool longDepth, bool spatialCamerasFront)
+    {
+        if (depth) LaunchSensorInit(SensorStream::Depth);
+        if (longDepth) LaunchSensorInit(SensorStream::LongDepth);
+        if (spatialCamerasFront) LaunchSensorInit(SensorStream::SpatialCamerasFront);
+    }
+
+    // True once the sensors of all streams passed to InitializeSensors are acquired
+    bool HL2ResearchMode::SensorsInitialized()
+    {
+        return m_sensorInit.AllReady();
+    }
+
+    void HL2ResearchMode::LaunchSensorInit(HL2UnityPlugin::SensorStream stream)
+    {
+        m_sensorInit.Launch((int)stream, [this, stream]() {
+            WaitForSensorDevice();
+            auto start = StreamStats::Clock::now();
+            switch (stream)
+            {
+            case SensorStream::Depth: AcquireDepthSensor(); break;
+            case SensorStream::LongDepth: AcquireLongDepthSensor(); break;
+            default: AcquireSpatialCamerasFront(); break;
+            }
+            std::lock_guard<std::mutex> l(mu);
+            m_sensorLifecycle[(int)stream].initMs = MillisecondsSince(start);
+        });
+    }
+
+    // Rethrows errors of the acquisition
+    void HL2ResearchMode::WaitForSensorInit(HL2UnityPlugin::SensorStream stream)
+    {
+        if (!m_sensorInit.Wait((int)stream))
+        {
+            winrt::check_hresult(E_ILLEGAL_METHOD_CALL); // released by StopAllSensorDevice
+        }
+    }
+
+    void HL2ResearchMode::AcquireDepthSensor()
+    {
         for (auto sensorDescriptor : m_sensorDescriptors)
         {
             if (sensorDescriptor.sensorType == DEPTH_AHAT)
@@ -76,7 +168,7 @@ namespace winrt::HL2UnityPlugin::implementation
         }
     }
 
-    void HL2ResearchMode::InitializeLongDepthSensor()
+    void HL2ResearchMode::AcquireLongDepthSensor()
     {
         for (auto sensorDescriptor : m_sensorDescriptors)
         {
@@ -91,7 +183,7 @@ namespace winrt::HL2UnityPlugin::implementation
         }
     }
 
-    void HL2ResearchMode::InitializeSpatialCamerasFront()
+    void HL2ResearchMode::AcquireSpatialCamerasFront()
     {
         for (auto sensorDescriptor : m_sensorDescriptors)
         {
@@ -112,29 +204,151 @@ namespace winrt::HL2UnityPlugin::implementation
         }
     }
 
-    void HL2ResearchMode::StartDepthSensorLoop() 
+    // Start the loop thread of a stream and return right away; the thread waits for the sensor, which is acquired
+    // here if InitializeSensors was not called for the stream. A loop that ended is joined first.
+    void HL2ResearchMode::StartSensorLoop(HL2UnityPlugin::SensorStream stream, std::atomic_bool& loopStarted, std::thread*& pThread,
+        void (*loop)(HL2ResearchMode*))
     {
-        //std::thread th1([this] {this->DepthSensorLoopTest(); });
-        if (m_refFrame == nullptr) 
+        std::unique_lock<std::mutex> l(m_lifecycleMutex);
+        if (pThread && pThread->get_id() == std::this_thread::get_id())
         {
-            m_refFrame = m_locator.GetDefault().CreateStationaryFrameOfReferenceAtCurrentLocation().CoordinateSystem();
+            // Start from a callback on the loop thread: the loop keeps running unless a Stop is joining it
+            if (!m_sensorLoopJoining[(int)stream])
+            {
+                loopStarted = true;
+            }
+            return;
         }
-
-        m_pDepthUpdateThread = new std::thread(HL2ResearchMode::DepthSensorLoop, this);
+        m_lifecycleChanged.wait(l, [&]() { return !m_sensorLoopJoining[(int)stream]; });
+        // prevent starting loop for multiple times
+        if (loopStarted)
+        {
+            return;
+        }
+        JoinSensorLoop(stream, l, pThread);
+        LaunchSensorInit(stream);
+        {
+            std::lock_guard<std::mutex> lock(mu);
+            auto& lifecycle = m_sensorLifecycle[(int)stream];
+            lifecycle.startRequested = StreamStats::Clock::now();
+            lifecycle.startMs = lifecycle.firstFrameMs = -1;
+            lifecycle.starts++;
+        }
+        loopStarted = true;
+        pThread = new std::thread(loop, this);
     }
 
-    void HL2ResearchMode::DepthSensorLoop(HL2ResearchMode* pHL2ResearchMode)
+    // Stop the loop of a stream and join its thread. Sensors, buffers and pools are kept, so the stream restarts with
+    // only the stream open; joining waits for the frame the loop is blocked on.
+    void HL2ResearchMode::StopSensorLoop(HL2UnityPlugin::SensorStream stream, std::atomic_bool& loopStarted, std::thread*& pThread)
     {
-        // prevent starting loop for multiple times
-        if (!pHL2ResearchMode->m_depthSensorLoopStarted)
+        auto start = StreamStats::Clock::now();
+        std::unique_lock<std::mutex> l(m_lifecycleMutex);
+        loopStarted = false;
+        if (pThread && pThread->get_id() == std::this_thread::get_id())
+        {
+            // Stop from a callback on the loop thread: the loop ends after the callback, its thread is joined by the
+            // next Start or Stop of the stream, or by the destructor
+            return;
+        }
+        m_lifecycleChanged.wait(l, [&]() { return !m_sensorLoopJoining[(int)stream]; });
+        if (!pThread)
         {
-            pHL2ResearchMode->m_depthSensorLoopStarted = true;
+            return;
         }
-        else {
+        JoinSensorLoop(stream, l, pThread);
+        std::lock_guard<std::mutex> lock(mu);
+        m_sensorLifecycle[(int)stream].stopMs = MillisecondsSince(start);
+    }
+
+    // Join the thread of a loop that was told to stop. Called with m_lifecycleMutex held and not from the loop thread;
+    // the mutex is released while joining, so callbacks of the loop can start and stop other streams. Starts and stops
+    // of this stream wait on m_lifecycleChanged until the thread is joined.
+    void HL2ResearchMode::JoinSensorLoop(HL2UnityPlugin::SensorStream stream, std::unique_lock<std::mutex>& lifecycleLock,
+        std::thread*& pThread)
+    {
+        if (!pThread)
+        {
             return;
         }
+        std::thread* pJoined = pThread;
+        m_sensorLoopJoining[(int)stream] = true;
+        lifecycleLock.unlock();
+        if (pJoined->joinable())
+        {
+            pJoined->join();
+        }
+        lifecycleLock.lock();
+        delete pJoined;
+        pThread = nullptr;
+        m_sensorLoopJoining[(int)stream] = false;
+        m_lifecycleChanged.notify_all();
+    }
+
+    // Called by a loop thread before it opens its stream: waits for the sensor and the reference frame. False if the
+    // sensor could not be acquired or the loop was stopped in the meantime.
+    bool HL2ResearchMode::PrepareSensorLoop(HL2UnityPlugin::SensorStream stream, const std::atomic_bool& loopStarted)
+    {
+        try
+        {
+            WaitForSensorInit(stream);
+            std::lock_guard<std::mutex> l(mu);
+            if (m_refFrame == nullptr)
+            {
+                m_refFrame = m_locator.GetDefault().CreateStationaryFrameOfReferenceAtCurrentLocation().CoordinateSystem();
+            }
+        }
+        catch (...)
+        {
+            OutputDebugString(L"Failed to initialize the sensor of the loop\n");
+            return false;
+        }
+        return loopStarted;
+    }
+
+    void HL2ResearchMode::RecordSensorLoopEvent(HL2UnityPlugin::SensorStream stream, bool firstFrame)
+    {
+        std::lock_guard<std::mutex> l(mu);
+        auto& lifecycle = m_sensorLifecycle[(int)stream];
+        (firstFrame ? lifecycle.firstFrameMs : lifecycle.startMs) = MillisecondsSince(lifecycle.startRequested);
+    }
+
+    float HL2ResearchMode::MillisecondsSince(StreamStats::Clock::time_point start)
+    {
+        return std::chrono::duration<float, std::milli>(StreamStats::Clock::now() - start).count();
+    }
+
+    void HL2ResearchMode::StartDepthSensorLoop() 
+    {
+        StartSensorLoop(SensorStream::Depth, m_depthSensorLoopStarted, m_pDepthUpdateThread, HL2ResearchMode::DepthSensorLoop);
+    }
+
+    void HL2ResearchMode::StopDepthSensorLoop()
+    {
+        StopSensorLoop(SensorStream::Depth, m_depthSensorLoopStarted, m_pDepthUpdateThread);
+    }
 
+    void HL2ResearchMode::DepthSensorLoop(HL2ResearchMode* pHL2ResearchMode)
+    {
+        if (!pHL2ResearchMode->PrepareSensorLoop(SensorStream::Depth, pHL2ResearchMode->m_depthSensorLoopStarted))
+        {
+            pHL2ResearchMode->m_depthSensorLoopStarted = false;
+            return;
+        }
         pHL2ResearchMode->m_depthSensor->OpenStream();
+        pHL2ResearchMode->RecordSensorLoopEvent(SensorStream::Depth, false);
+
+        // filter histories of a previous run do not apply after a restart
+        pHL2ResearchMode->m_temporalDepthFilterResetRequested = true;
+        pHL2ResearchMode->m_depthRegistrationResetRequested = true;
+        UINT64 frameIndex = 0;
+        UINT64 sharedRingGeneration = 0;
+        bool firstFrame = true;
+        bool textureWasEnabled = false;
+        AhatFrameParams processedParams;    // of the last processed frame, for change detection
+        size_t processedPointCount = 0;
+        std::vector<UINT8> depthTexture;    // sized to the texture layout, kept across frames
+        std::vector<UINT8> abTexture;
 
         try 
         {
@@ -142,7 +356,37 @@ namespace winrt::HL2UnityPlugin::implementation
             {
                 IResearchModeSensorFrame* pDepthSensorFrame = nullptr;
                 ResearchModeSensorResolution resolution;
+                auto& stats = pHL2ResearchMode->m_depthStats;
+                auto stageStart = StreamStats::Clock::now();
                 pHL2ResearchMode->m_depthSensor->GetNextBuffer(&pDepthSensorFrame);
+                stats.Record(PipelineStage::GetNextBuffer, stageStart);
+                if (firstFrame)
+                {
+                    pHL2ResearchMode->RecordSensorLoopEvent(SensorStream::Depth, true);
+                    firstFrame = false;
+                }
+
+                // let the governor skip the frame before any processing and pick the processing level
+                GovernorDecision governorDecision;
+                if (pHL2ResearchMode->m_useGovernor)
+                {
+                    ResearchModeSensorTimestamp frameTimestamp;
+                    pDepthSensorFrame->GetTimeStamp(&frameTimestamp);
+                    GovernorInput governorInput;
+                    governorInput.hostTicks = frameTimestamp.HostTicks;
+                    governorInput.previousConsumed = !pHL2ResearchMode->m_pointCloudUpdated ||
+                        (textureWasEnabled && !pHL2ResearchMode->m_depthMapTextureUpdated);
+                    governorInput.needsEveryFrame = pHL2ResearchMode->m_frameViewNotifiers[(int)SensorStream::Depth].HasSubscribers() ||
+                        pHL2ResearchMode->m_useWorldPointMap || pHL2ResearchMode->m_pointCloudExportInterval > 0;
+                    governorInput.queueDepth = pHL2ResearchMode->m_pointCloudExporter.QueueDepth();
+                    governorDecision = pHL2ResearchMode->m_governor.Decide(governorInput);
+                    if (!governorDecision.process)
+                    {
+                        stats.CountSkipped();
+                        pDepthSensorFrame->Release();
+                        continue;
+                    }
+                }
 
                 // process sensor frame
                 pDepthSensorFrame->GetResolution(&resolution);
@@ -159,18 +403,21 @@ namespace winrt::HL2UnityPlugin::implementation
                 const UINT16* pAbImage = nullptr;
                 pDepthFrame->GetAbDepthBuffer(&pAbImage, &outAbBufferCount);
 
-                auto pDepthTexture = std::make_unique<uint8_t[]>(outBufferCount);
-                auto pAbTexture = std::make_unique<uint8_t[]>(outAbBufferCount);
                 std::vector<float> pointCloud;
 
                 // get tracking transform
                 ResearchModeSensorTimestamp timestamp;
                 pDepthSensorFrame->GetTimeStamp(&timestamp);
 
+                stageStart = StreamStats::Clock::now();
                 auto ts = PerceptionTimestampHelper::FromSystemRelativeTargetTime(HundredsOfNanoseconds(checkAndConvertUnsigned(timestamp.HostTicks)));
                 auto transToWorld = pHL2ResearchMode->m_locator.TryLocateAtTimestamp(ts, pHL2ResearchMode->m_refFrame);
+                stats.Record(PipelineStage::Locate, stageStart);
                 if (transToWorld == nullptr)
                 {
+                    stats.CountDropped();
+                    pDepthFrame->Release();
+                    pDepthSensorFrame->Release();
                     continue;
                 }
                 auto rot = transToWorld.Orientation();
@@ -187,85 +434,319 @@ namespace winrt::HL2UnityPlugin::implementation
                 auto posMat = XMMatrixTranslation(pos.x, pos.y, pos.z);
                 auto depthToWorld = pHL2ResearchMode->m_depthCameraPoseInvMatrix * rotMat * posMat;
 
+                stageStart = StreamStats::Clock::now();
+
+                // camera rays of all pixels are fixed, map them once
+                if (pHL2ResearchMode->m_depthUnitRays.size() != outBufferCount)
+                {
+                    auto unitRays = MapDepthUnitRays(pHL2ResearchMode->m_pDepthCameraSensor, resolution);
+                    auto pQueryGeometry = std::make_shared<DepthQueryGeometry>();
+                    pQueryGeometry->unitRays = unitRays;
+                    pQueryGeometry->projection.Build(pHL2ResearchMode->m_pDepthCameraSensor, resolution.Width, resolution.Height);
+                    std::lock_guard<std::mutex> l(pHL2ResearchMode->mu);
+                    pHL2ResearchMode->m_depthUnitRayAngle = MaxNeighborRayAngle(unitRays.data(), resolution.Width, resolution.Height);
+                    pHL2ResearchMode->m_depthUnitRays = std::move(unitRays);
+                    pHL2ResearchMode->m_depthQueryGeometry = std::move(pQueryGeometry);
+                }
+
+                // smooth raw depth over time before any other processing
+                if (pHL2ResearchMode->m_useTemporalDepthFilter)
+                {
+                    TemporalDepthFilterSettings filterSettings;
+                    {
+                        std::lock_guard<std::mutex> l(pHL2ResearchMode->mu);
+                        filterSettings = pHL2ResearchMode->m_temporalDepthFilterSettings;
+                    }
+                    if (pHL2ResearchMode->m_temporalDepthFilterResetRequested.exchange(false))
+                    {
+                        pHL2ResearchMode->m_temporalDepthFilter.Reset();
+                    }
+                    pHL2ResearchMode->m_filteredDepth.resize(outBufferCount);
+                    pHL2ResearchMode->m_temporalDepthFilter.Apply(filterSettings, pDepth, pAbImage, pHL2ResearchMode->m_depthUnitRays.data(),
+                        outBufferCount, depthToWorld, pHL2ResearchMode->m_filteredDepth.data());
+                    pDepth = pHL2ResearchMode->m_filteredDepth.data();
+                }
+
+                // refine the locator pose against the previous frames, everything below uses the refined pose
+                if (pHL2ResearchMode->m_useDepthRegistration)
+                {
+                    auto registerStart = StreamStats::Clock::now();
+                    RegistrationSettings registrationSettings;
+                    std::shared_ptr<const DepthQueryGeometry> pGeometry;
+                    {
+                        std::lock_guard<std::mutex> l(pHL2ResearchMode->mu);
+                        registrationSettings = pHL2ResearchMode->m_depthRegistrationSettings;
+                        pGeometry = pHL2ResearchMode->m_depthQueryGeometry;
+                    }
+                    if (pHL2ResearchMode->m_depthRegistrationResetRequested.exchange(false))
+                    {
+                        pHL2ResearchMode->m_depthRegistration.Reset();
+                    }
+                    pHL2ResearchMode->m_depthRegistration.Register(registrationSettings, pDepth, resolution.Width, resolution.Height,
+                        pHL2ResearchMode->m_depthOffset, pHL2ResearchMode->m_depthUnitRays.data(), nullptr, pGeometry->projection, depthToWorld);
+                    stats.Record(PipelineStage::Register, registerStart);
+                }
+
+                AhatFrameParams params;
+                params.width = resolution.Width;
+                params.height = resolution.Height;
+                params.depthOffset = pHL2ResearchMode->m_depthOffset;
+                params.useRoiFilter = pHL2ResearchMode->m_useRoiFilter;
+                params.depthNearClip = pHL2ResearchMode->depthCamRoi.depthNearClip;
+                params.depthFarClip = pHL2ResearchMode->depthCamRoi.depthFarClip;
+                params.centerRow = (UINT)(0.35 * resolution.Height);
+                params.centerCol = (UINT)(0.5 * resolution.Width);
+                XMStoreFloat4x4(&params.depthToWorld, depthToWorld);
                 pHL2ResearchMode->mu.lock();
-                auto roiCenterFloat = XMFLOAT3(pHL2ResearchMode->m_roiCenter[0], pHL2ResearchMode->m_roiCenter[1], pHL2ResearchMode->m_roiCenter[2]);
-                auto roiBoundFloat = XMFLOAT3(pHL2ResearchMode->m_roiBound[0], pHL2ResearchMode->m_roiBound[1], pHL2ResearchMode->m_roiBound[2]);
+                params.roiCenter = XMFLOAT3(pHL2ResearchMode->m_roiCenter[0], pHL2ResearchMode->m_roiCenter[1], pHL2ResearchMode->m_roiCenter[2]);
+                params.roiBound = XMFLOAT3(pHL2ResearchMode->m_roiBound[0], pHL2ResearchMode->m_roiBound[1], pHL2ResearchMode->m_roiBound[2]);
+                params.textureLayout = pHL2ResearchMode->m_depthTextureSettings.Layout(resolution);
+                auto pDepthColormap = pHL2ResearchMode->m_depthColormap;
+                auto pAbColormap = pHL2ResearchMode->m_abColormap;
                 pHL2ResearchMode->mu.unlock();
-                XMVECTOR roiCenter = XMLoadFloat3(&roiCenterFloat);
-                XMVECTOR roiBound = XMLoadFloat3(&roiBoundFloat);
-                
-                UINT16 maxAbValue = 0;
-                for (UINT i = 0; i < resolution.Height; i++)
+                bool textureEnabled = params.textureLayout.mode != TextureMode::Off;
+                params.pDepthColormap = pDepthColormap.get();
+                params.pAbColormap = pAbColormap.get();
+
+                // texture ranges follow the histograms of the previous frames
+                bool normalizeTextures = textureEnabled && pHL2ResearchMode->m_useTextureNormalization;
+                TextureNormalizationSettings normalizationSettings;
+                if (pHL2ResearchMode->m_depthNormalizationResetRequested.exchange(false))
                 {
-                    for (UINT j = 0; j < resolution.Width; j++)
-                    {
-                        auto idx = resolution.Width * i + j;
-                        UINT16 depth = pDepth[idx];
-                        depth = (depth > 4090) ? 0 : depth - pHL2ResearchMode->m_depthOffset;
+                    pHL2ResearchMode->m_depthNormalizer.Reset();
+                    pHL2ResearchMode->m_abNormalizer.Reset();
+                }
+                if (normalizeTextures)
+                {
+                    std::lock_guard<std::mutex> l(pHL2ResearchMode->mu);
+                    normalizationSettings = pHL2ResearchMode->m_textureNormalizationSettings;
+                }
+                params.pDepthTextureLut = normalizeTextures ? pHL2ResearchMode->m_depthNormalizer.Lut() : nullptr;
+                params.pAbTextureLut = normalizeTextures ? pHL2ResearchMode->m_abNormalizer.Lut() : nullptr;
+
+                // cull pixels whose rays can never hit the region of interest before back-projecting them
+                params.roiImageBounds = pHL2ResearchMode->ComputeDepthRoiImageBounds(params);
+                params.pointCloudFormat = pHL2ResearchMode->m_pointCloudFormat;
+                params.pointCloudStep = governorDecision.pointCloudStep;
 
-                        // back-project point cloud within Roi
-                        if (i > pHL2ResearchMode->depthCamRoi.kRowLower*resolution.Height&& i < pHL2ResearchMode->depthCamRoi.kRowUpper * resolution.Height &&
-                            j > pHL2ResearchMode->depthCamRoi.kColLower* resolution.Width&& j < pHL2ResearchMode->depthCamRoi.kColUpper * resolution.Width &&
-                            depth > pHL2ResearchMode->depthCamRoi.depthNearClip && depth < pHL2ResearchMode->depthCamRoi.depthFarClip)
+                // skip frames without significant change since the last processed one, whose outputs stay published
+                if (pHL2ResearchMode->m_useChangeDetection)
+                {
+                    ChangeDetectionSettings changeSettings;
+                    {
+                        std::lock_guard<std::mutex> l(pHL2ResearchMode->mu);
+                        changeSettings = pHL2ResearchMode->m_changeDetectionSettings;
+                    }
+                    auto& changeDetector = pHL2ResearchMode->m_changeDetector;
+                    if (pHL2ResearchMode->m_changeDetectionResetRequested.exchange(false))
+                    {
+                        changeDetector.Reset();
+                    }
+                    if (!SameAhatOutputSettings(params, processedParams))
+                    {
+                        changeDetector.Invalidate();
+                    }
+                    if (!changeDetector.Compare(changeSettings, pDepth, resolution.Width, resolution.Height, depthToWorld).changed)
+                    {
+                        // outputs are not republished, so consumers polling the updated flags do not upload the same
+                        // outputs again; depth queries, the world point map and the export still follow the frame
+                        auto pQueryFrame = pHL2ResearchMode->CaptureDepthQuery(pDepth, resolution, params.depthOffset,
+                            timestamp.HostTicks, depthToWorld);
+                        bool exportDue = pHL2ResearchMode->PointCloudExportDue(frameIndex);
+                        std::vector<float> processedPointCloud;
+                        std::vector<float> processedColoredPointCloud;
                         {
-                            float xy[2] = { 0, 0 };
-                            float uv[2] = { j, i };
-                            pHL2ResearchMode->m_pDepthCameraSensor->MapImagePointToCameraUnitPlane(uv, xy);
-                            auto pointOnUnitPlane = XMFLOAT3(xy[0], xy[1], 1);
-                            auto tempPoint = (float)depth / 1000 * XMVector3Normalize(XMLoadFloat3(&pointOnUnitPlane));
-                            // apply transformation
-                            auto pointInWorld = XMVector3Transform(tempPoint, depthToWorld);
-
-                            // filter point cloud based on region of interest
-                            if (!pHL2ResearchMode->m_useRoiFilter ||
-                                (pHL2ResearchMode->m_useRoiFilter && XMVector3InBounds(pointInWorld - roiCenter, roiBound)))
+                            std::lock_guard<std::mutex> l(pHL2ResearchMode->mu);
+                            if (pQueryFrame)
                             {
-                                pointCloud.push_back(XMVectorGetX(pointInWorld));
-                                pointCloud.push_back(XMVectorGetY(pointInWorld));
-                                pointCloud.push_back(-XMVectorGetZ(pointInWorld));
+                                pHL2ResearchMode->StoreDepthQueryFrame(std::move(pQueryFrame));
+                            }
+                            bool integrate = pHL2ResearchMode->m_useWorldPointMap || pHL2ResearchMode->m_useOccupancyMap;
+                            if ((integrate || exportDue) && pHL2ResearchMode->m_pointCloud)
+                            {
+                                processedPointCloud.assign(pHL2ResearchMode->m_pointCloud,
+                                    pHL2ResearchMode->m_pointCloud + pHL2ResearchMode->m_pointcloudLength);
+                            }
+                            if (exportDue)
+                            {
+                                processedColoredPointCloud = pHL2ResearchMode->m_coloredPointCloud;
                             }
                         }
+                        pHL2ResearchMode->IntegrateDepthPoints(processedPointCloud, depthToWorld);
+                        if (exportDue)
+                        {
+                            pHL2ResearchMode->SubmitPointCloudExport(frameIndex, timestamp.HostTicks, processedPointCloud,
+                                processedColoredPointCloud);
+                        }
+                        stats.Record(PipelineStage::Process, stageStart);
+                        stats.CountSkipped();
+                        pHL2ResearchMode->DumpPipelineStatsIfDue(stats);
+
+                        FrameInfo frameInfo;
+                        frameInfo.stream = SensorStream::Depth;
+                        frameInfo.frameIndex = frameIndex++;
+                        frameInfo.hostTicks = timestamp.HostTicks;
+                        frameInfo.width = resolution.Width;
+                        frameInfo.height = resolution.Height;
+                        frameInfo.pointCount = processedPointCount;
+                        frameInfo.unchanged = true;
+                        pHL2ResearchMode->PublishFrameArrived(frameInfo);
+
+                        pDepthFrame->Release();
+                        pDepthSensorFrame->Release();
+                        continue;
+                    }
+                    changeDetector.SetReference(pDepth, resolution.Width, resolution.Height, depthToWorld);
+                }
+                processedParams = params;
+
+                // reject flying pixels and outliers before they are back-projected
+                const UINT8* pValidMask = nullptr;
+                if (pHL2ResearchMode->m_useFlyingPixelFilter)
+                {
+                    FlyingPixelFilterSettings filterSettings;
+                    {
+                        std::lock_guard<std::mutex> l(pHL2ResearchMode->mu);
+                        filterSettings = pHL2ResearchMode->m_flyingPixelFilterSettings;
+                    }
+                    if (pHL2ResearchMode->m_depthValidMask.size() != outBufferCount)
+                    {
+                        // image border is never marked and stays invalid
+                        pHL2ResearchMode->m_depthValidMask.assign(outBufferCount, 0);
+                    }
+                    MarkFlyingPixels(filterSettings, pDepth, pAbImage, resolution.Width, resolution.Height, params.roiImageBounds,
+                        pHL2ResearchMode->m_depthValidMask.data());
+                    pValidMask = pHL2ResearchMode->m_depthValidMask.data();
+                }
+
+                // encoded point cloud: relative to the Roi center (or the sensor) with a scale covering the Roi (or the far clip)
+                std::vector<UINT16> encodedPointCloud;
+                if (params.pointCloudFormat == PointCloudFormat::Fixed16)
+                {
+                    XMFLOAT3 sensorPos;
+                    XMStoreFloat3(&sensorPos, XMVector3Transform(XMVectorZero(), depthToWorld));
+                    float extent = params.useRoiFilter ?
+                        (std::max)({ params.roiBound.x, params.roiBound.y, params.roiBound.z }) : params.depthFarClip / 1000.0f;
+                    params.encodingOffset = params.useRoiFilter ?
+                        XMFLOAT3(params.roiCenter.x, params.roiCenter.y, -params.roiCenter.z) : XMFLOAT3(sensorPos.x, sensorPos.y, -sensorPos.z);
+                    params.encodingScale = (std::max)(extent, 0.001f) / 32767;
+                }
 
-                        // save depth map as grayscale texture pixel into temp buffer
-                        if (depth == 0) { pDepthTexture.get()[idx] = 0; }
-                        else { pDepthTexture.get()[idx] = (uint8_t)((float)depth / 1000 * 255); }
+                // native frame views recycle the point cloud storage through the pool
+                auto pFrameView = pHL2ResearchMode->AcquireFrameView(SensorStream::Depth);
+                if (pFrameView)
+                {
+                    pointCloud.swap(pFrameView->pointCloud);
+                }
 
-                        // save AbImage as grayscale texture pixel into temp buffer
-                        UINT16 abValue = pAbImage[idx];
-                        uint8_t processedAbValue = 0;
-                        if (abValue > 1000) { processedAbValue = 0xFF; }
-                        else { processedAbValue = (uint8_t)((float)abValue / 1000 * 255); }
+                size_t textureSize = params.textureLayout.width * params.textureLayout.height;
+                depthTexture.resize(textureSize);
+                abTexture.resize(textureSize);
+                std::vector<UINT32> depthColorTexture(pDepthColormap ? textureSize : 0);
+                std::vector<UINT32> abColorTexture(pAbColormap ? textureSize : 0);
+
+                AhatFrameOutputs outputs;
+                outputs.pDepthTexture = textureEnabled ? depthTexture.data() : nullptr;
+                outputs.pAbTexture = textureEnabled ? abTexture.data() : nullptr;
+                outputs.pDepthColorTexture = depthColorTexture.empty() ? nullptr : depthColorTexture.data();
+                outputs.pAbColorTexture = abColorTexture.empty() ? nullptr : abColorTexture.data();
+                outputs.pPointCloud = &pointCloud;
+                outputs.pEncodedPointCloud = &encodedPointCloud;
+                if (normalizeTextures)
+                {
+                    outputs.pDepthHistogram = pHL2ResearchMode->m_depthNormalizer.BeginFrame();
+                    outputs.pAbHistogram = pHL2ResearchMode->m_abNormalizer.BeginFrame();
+                }
+                auto frameResult = ProcessAhatFrame(params, pDepth, pAbImage, pHL2ResearchMode->m_depthUnitRays.data(), pValidMask, outputs);
+                if (normalizeTextures)
+                {
+                    pHL2ResearchMode->m_depthNormalizer.Update(normalizationSettings);
+                    pHL2ResearchMode->m_abNormalizer.Update(normalizationSettings);
+                }
 
-                        /*if (abValue > maxAbValue) 
-                        {
-                            maxAbValue = abValue;
-                            std::stringstream ss;
-                            ss << "Non zero valule. Idx: " << idx << " Raw Value: " << abValue << "Processed: " << (int)processedAbValue << "\n";
-                            std::string msg = ss.str();
-                            std::wstring widemsg = std::wstring(msg.begin(), msg.end());
-                            OutputDebugString(widemsg.c_str());
-                        }*/
-                        pAbTexture.get()[idx] = processedAbValue;
-
-                        // save the depth of center pixel
-                        if (i == (UINT)(0.35 * resolution.Height) && j == (UINT)(0.5 * resolution.Width)
-                            && pointCloud.size()>=3)
-                        {
-                            pHL2ResearchMode->m_centerDepth = depth;
-                            if (depth > pHL2ResearchMode->depthCamRoi.depthNearClip && depth < pHL2ResearchMode->depthCamRoi.depthFarClip)
-                            {
-                                std::lock_guard<std::mutex> l(pHL2ResearchMode->mu);
-                                pHL2ResearchMode->m_centerPoint[0] = *(pointCloud.end() - 3);
-                                pHL2ResearchMode->m_centerPoint[1] = *(pointCloud.end() - 2);
-                                pHL2ResearchMode->m_centerPoint[2] = *(pointCloud.end() - 1);
-                            }
-                        }
+                pHL2ResearchMode->m_centerDepth = frameResult.centerDepth;
+                if (frameResult.centerPointValid)
+                {
+                    std::lock_guard<std::mutex> l(pHL2ResearchMode->mu);
+                    std::copy(frameResult.centerPoint, frameResult.centerPoint + 3, pHL2ResearchMode->m_centerPoint);
+                }
+
+                // keep the depth for batched queries once queries are in use
+                auto pQueryFrame = pHL2ResearchMode->CaptureDepthQuery(pDepth, resolution, params.depthOffset, timestamp.HostTicks,
+                    depthToWorld);
+
+                // fit planes on the organized grid, only the compact plane list is published
+                std::vector<float> planes;
+                if (pHL2ResearchMode->m_usePlaneDetection)
+                {
+                    PlaneDetectionSettings planeSettings;
+                    {
+                        std::lock_guard<std::mutex> l(pHL2ResearchMode->mu);
+                        planeSettings = pHL2ResearchMode->m_planeDetectionSettings;
+                    }
+                    if (pHL2ResearchMode->m_planeDetectionResetRequested.exchange(false))
+                    {
+                        pHL2ResearchMode->m_planeDetector.Reset();
+                    }
+                    pHL2ResearchMode->m_planeDetector.Update(planeSettings, params, pDepth, pHL2ResearchMode->m_depthUnitRays.data(), pValidMask);
+                    pHL2ResearchMode->m_planeDetector.Pack(planes);
+                }
+
+                // label depth-continuous blobs within the clip range, only the compact blob list is published
+                std::vector<float> blobs;
+                if (pHL2ResearchMode->m_useBlobSegmentation)
+                {
+                    BlobSegmentationSettings blobSettings;
+                    {
+                        std::lock_guard<std::mutex> l(pHL2ResearchMode->mu);
+                        blobSettings = pHL2ResearchMode->m_blobSegmentationSettings;
+                    }
+                    pHL2ResearchMode->m_blobSegmenter.Update(blobSettings, params, pDepth, pHL2ResearchMode->m_depthUnitRays.data(), pValidMask);
+                    pHL2ResearchMode->m_blobSegmenter.Pack(blobs);
+                }
+
+                // accumulate the frame into the persistent world point map and the occupancy map
+                pHL2ResearchMode->IntegrateDepthPoints(pointCloud, depthToWorld);
+
+                // attach the intensity of the nearest-in-time LF/RF image to each point
+                std::vector<float> coloredPointCloud;
+                if (pHL2ResearchMode->m_usePointCloudIntensity)
+                {
+                    std::shared_ptr<const VlcFrameSnapshot> pLF, pRF;
+                    {
+                        std::lock_guard<std::mutex> l(pHL2ResearchMode->mu);
+                        pLF = NearestVlcFrame(pHL2ResearchMode->m_LFHistory, timestamp.HostTicks);
+                        pRF = NearestVlcFrame(pHL2ResearchMode->m_RFHistory, timestamp.HostTicks);
+                    }
+                    if (pLF && !pHL2ResearchMode->m_LFProjectionLut.IsBuilt())
+                    {
+                        pHL2ResearchMode->m_LFProjectionLut.Build(pHL2ResearchMode->m_LFCameraSensor, pLF->width, pLF->height);
+                    }
+                    if (pRF && !pHL2ResearchMode->m_RFProjectionLut.IsBuilt())
+                    {
+                        pHL2ResearchMode->m_RFProjectionLut.Build(pHL2ResearchMode->m_RFCameraSensor, pRF->width, pRF->height);
                     }
+                    SampleVlcIntensity(pointCloud, pLF.get(), pHL2ResearchMode->m_LFProjectionLut,
+                        pRF.get(), pHL2ResearchMode->m_RFProjectionLut, coloredPointCloud);
+                }
+
+                // hand a copy of every n-th cloud to the export thread, dropped if the writer falls behind
+                if (pHL2ResearchMode->PointCloudExportDue(frameIndex))
+                {
+                    pHL2ResearchMode->SubmitPointCloudExport(frameIndex, timestamp.HostTicks, pointCloud, coloredPointCloud);
                 }
 
+                if (pHL2ResearchMode->m_useGovernor)
+                {
+                    pHL2ResearchMode->m_governor.RecordProcessTime(
+                        std::chrono::duration<float, std::micro>(StreamStats::Clock::now() - stageStart).count());
+                }
+                stats.Record(PipelineStage::Process, stageStart);
+
                 // save data
+                stageStart = StreamStats::Clock::now();
                 {
-                    std::lock_guard<std::mutex> l(pHL2ResearchMode->mu);
+                    auto l = stats.LockAndRecordWait(pHL2ResearchMode->mu);
 
                     // save point cloud
                     if (!pHL2ResearchMode->m_pointCloud)
@@ -276,6 +757,21 @@ namespace winrt::HL2UnityPlugin::implementation
 
                     memcpy(pHL2ResearchMode->m_pointCloud, pointCloud.data(), pointCloud.size() * sizeof(float));
                     pHL2ResearchMode->m_pointcloudLength = pointCloud.size();
+                    pHL2ResearchMode->m_coloredPointCloud.swap(coloredPointCloud);
+                    pHL2ResearchMode->m_planes.swap(planes);
+                    pHL2ResearchMode->m_blobs.swap(blobs);
+                    if (pQueryFrame)
+                    {
+                        pHL2ResearchMode->StoreDepthQueryFrame(std::move(pQueryFrame));
+                    }
+                    pHL2ResearchMode->m_encodedPointCloud.swap(encodedPointCloud);
+                    pHL2ResearchMode->m_encodedPointCloudFormat = params.pointCloudFormat;
+                    pHL2ResearchMode->m_encodingOffset = params.encodingOffset;
+                    pHL2ResearchMode->m_encodingScale = params.encodingScale;
+                    XMFLOAT4X4 flipZ(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, -1, 0, 0, 0, 0, 1);
+                    XMStoreFloat4x4(&pHL2ResearchMode->m_depthFramePose, depthToWorld * XMLoadFloat4x4(&flipZ));
+                    std::copy(pHL2ResearchMode->m_depthFramePose.m[3], pHL2ResearchMode->m_depthFramePose.m[3] + 3,
+                        pHL2ResearchMode->m_depthSensorPosition);
 
                     // save raw depth map
                     if (!pHL2ResearchMode->m_depthMap)
@@ -291,7 +787,13 @@ namespace winrt::HL2UnityPlugin::implementation
                         OutputDebugString(L"Create Space for depth map texture...\n");
                         pHL2ResearchMode->m_depthMapTexture = new UINT8[outBufferCount];
                     }
-                    memcpy(pHL2ResearchMode->m_depthMapTexture, pDepthTexture.get(), outBufferCount * sizeof(UINT8));
+                    if (textureEnabled)
+                    {
+                        memcpy(pHL2ResearchMode->m_depthMapTexture, depthTexture.data(), textureSize * sizeof(UINT8));
+                        pHL2ResearchMode->m_depthTextureLayout = params.textureLayout;
+                        pHL2ResearchMode->m_depthMapColorTexture.swap(depthColorTexture);
+                        pHL2ResearchMode->m_shortAbImageColorTexture.swap(abColorTexture);
+                    }
 
                     // save raw AbImage
                     if (!pHL2ResearchMode->m_shortAbImage)
@@ -307,13 +809,61 @@ namespace winrt::HL2UnityPlugin::implementation
                         OutputDebugString(L"Create Space for short AbImage texture...\n");
                         pHL2ResearchMode->m_shortAbImageTexture = new UINT8[outBufferCount];
                     }
-                    memcpy(pHL2ResearchMode->m_shortAbImageTexture, pAbTexture.get(), outBufferCount * sizeof(UINT8));
+                    if (textureEnabled)
+                    {
+                        memcpy(pHL2ResearchMode->m_shortAbImageTexture, abTexture.data(), textureSize * sizeof(UINT8));
+                    }
+                }
+                {
+                    SharedFramePlane planes[] = { { pDepth, sizeof(UINT16) }, { pAbImage, sizeof(UINT16) } };
+                    pHL2ResearchMode->PublishSharedFrame(SharedRingStream::Depth, sharedRingGeneration,
+                        MakeSharedFrameInfo(frameIndex, timestamp.HostTicks, resolution, depthToWorld), planes, 2);
+                }
+                stats.Record(PipelineStage::Publish, stageStart);
+                if (pHL2ResearchMode->m_depthMapTextureUpdated || pHL2ResearchMode->m_pointCloudUpdated)
+                {
+                    stats.CountOverwritten();
+                }
+                stats.CountFrame();
+                pHL2ResearchMode->DumpPipelineStatsIfDue(stats);
+                if (textureEnabled)
+                {
+                    pHL2ResearchMode->m_shortAbImageTextureUpdated = true;
+                    pHL2ResearchMode->m_depthMapTextureUpdated = true;
                 }
-                pHL2ResearchMode->m_shortAbImageTextureUpdated = true;
-                pHL2ResearchMode->m_depthMapTextureUpdated = true;
                 pHL2ResearchMode->m_pointCloudUpdated = true;
-
-                pDepthTexture.reset();
+                textureWasEnabled = textureEnabled;
+
+                FrameInfo frameInfo;
+                frameInfo.stream = SensorStream::Depth;
+                frameInfo.frameIndex = frameIndex++;
+                frameInfo.hostTicks = timestamp.HostTicks;
+                frameInfo.width = resolution.Width;
+                frameInfo.height = resolution.Height;
+                frameInfo.pointCount = pointCloud.size() / 3;
+                processedPointCount = frameInfo.pointCount;
+
+                if (pFrameView)
+                {
+                    pFrameView->HoldSensorFrame(pDepthSensorFrame);
+                    if (pDepth == pHL2ResearchMode->m_filteredDepth.data())
+                    {
+                        // the filtered depth buffer is reused by the next frame
+                        pFrameView->depthCopy.assign(pDepth, pDepth + outBufferCount);
+                        pDepth = pFrameView->depthCopy.data();
+                    }
+                    pFrameView->pointCloud.swap(pointCloud);
+                    pFrameView->stream = frameInfo.stream;
+                    pFrameView->frameIndex = frameInfo.frameIndex;
+                    pFrameView->hostTicks = frameInfo.hostTicks;
+                    pFrameView->depth = MakeFrameImage(pDepth, resolution.Width, resolution.Height, sizeof(UINT16));
+                    pFrameView->abImage = MakeFrameImage(pAbImage, resolution.Width, resolution.Height, sizeof(UINT16));
+                    pFrameView->pPointCloud = pFrameView->pointCloud.data();
+                    pFrameView->pointCount = frameInfo.pointCount;
+                    XMStoreFloat4x4(&pFrameView->cameraToWorld, depthToWorld);
+                    pHL2ResearchMode->m_frameViewNotifiers[(int)SensorStream::Depth].Notify(std::move(pFrameView));
+                }
+                pHL2ResearchMode->PublishFrameArrived(frameInfo);
 
                 // release space
                 if (pDepthFrame) {
@@ -327,46 +877,210 @@ namespace winrt::HL2UnityPlugin::implementation
             }
         }
         catch (...)  {}
+        // the sensor is kept for a restart and released by StopAllSensorDevice
         pHL2ResearchMode->m_depthSensor->CloseStream();
-        pHL2ResearchMode->m_depthSensor->Release();
-        pHL2ResearchMode->m_depthSensor = nullptr;
+        pHL2ResearchMode->m_sharedRings[(int)SharedRingStream::Depth].Close();
+        pHL2ResearchMode->m_depthSensorLoopStarted = false;
         
     }
 
-    void HL2ResearchMode::StartLongDepthSensorLoop()
+    // Keep the depth of an AHAT frame for batched queries once queries are in use, recycling the oldest history entry
+    // when no query holds it. Returns nullptr while queries are not in use.
+    std::shared_ptr<DepthQueryFrame> HL2ResearchMode::CaptureDepthQuery(const UINT16* pDepth, const ResearchModeSensorResolution& resolution,
+        UINT16 depthOffset, UINT64 hostTicks, FXMMATRIX depthToWorld)
     {
-        if (m_refFrame == nullptr)
+        if (!m_useDepthQueries)
+        {
+            return nullptr;
+        }
+        std::shared_ptr<DepthQueryFrame> pQueryFrame;
+        std::shared_ptr<const DepthQueryGeometry> pQueryGeometry;
         {
-            m_refFrame = m_locator.GetDefault().CreateStationaryFrameOfReferenceAtCurrentLocation().CoordinateSystem();
+            std::lock_guard<std::mutex> l(mu);
+            auto& oldest = m_depthQueryHistory[kDepthQueryHistorySize - 1];
+            if (oldest && oldest.use_count() == 1)
+            {
+                pQueryFrame = std::move(oldest);
+            }
+            pQueryGeometry = m_depthQueryGeometry;
+        }
+        if (!pQueryFrame)
+        {
+            pQueryFrame = std::make_shared<DepthQueryFrame>();
         }
+        CaptureDepthQueryFrame(pDepth, resolution.Width, resolution.Height, depthOffset, hostTicks, depthToWorld,
+            std::move(pQueryGeometry), *pQueryFrame);
+        return pQueryFrame;
+    }
 
-        m_pLongDepthUpdateThread = new std::thread(HL2ResearchMode::LongDepthSensorLoop, this);
+    // Make a captured frame the latest of the query history, the caller holds mu
+    void HL2ResearchMode::StoreDepthQueryFrame(std::shared_ptr<DepthQueryFrame> pQueryFrame)
+    {
+        std::move_backward(m_depthQueryHistory, m_depthQueryHistory + kDepthQueryHistorySize - 1,
+            m_depthQueryHistory + kDepthQueryHistorySize);
+        m_depthQueryHistory[0] = std::move(pQueryFrame);
     }
 
-    void HL2ResearchMode::LongDepthSensorLoop(HL2ResearchMode* pHL2ResearchMode)
+    // Accumulate an AHAT point cloud (output coordinates) into the world point map and the occupancy map if enabled
+    void HL2ResearchMode::IntegrateDepthPoints(const std::vector<float>& pointCloud, FXMMATRIX depthToWorld)
     {
-        // prevent starting loop for multiple times
-        if (!pHL2ResearchMode->m_longDepthSensorLoopStarted)
+        if (!m_useWorldPointMap && !m_useOccupancyMap)
         {
-            pHL2ResearchMode->m_longDepthSensorLoopStarted = true;
-        }
-        else {
             return;
         }
+        XMFLOAT3 sensorPosition;
+        XMStoreFloat3(&sensorPosition, XMVector3Transform(XMVectorZero(), depthToWorld));
+        sensorPosition.z = -sensorPosition.z;
+        if (m_useWorldPointMap)
+        {
+            m_worldPointMap.Integrate(pointCloud.data(), pointCloud.size() / 3, sensorPosition);
+        }
+        if (m_useOccupancyMap)
+        {
+            m_occupancyMap.Integrate(pointCloud.data(), pointCloud.size() / 3, sensorPosition);
+        }
+    }
 
-        pHL2ResearchMode->m_longDepthSensor->OpenStream();
+    // Whether the AHAT frame frameIndex is exported, every n-th frame while the exporter runs
+    bool HL2ResearchMode::PointCloudExportDue(UINT64 frameIndex)
+    {
+        int exportInterval = m_pointCloudExportInterval;
+        return exportInterval > 0 && frameIndex % (UINT64)exportInterval == 0 && m_pointCloudExporter.IsRunning();
+    }
 
-        try
+    // Hand a copy of a point cloud to the export thread, dropped if the writer falls behind
+    void HL2ResearchMode::SubmitPointCloudExport(UINT64 frameIndex, UINT64 hostTicks, const std::vector<float>& pointCloud,
+        const std::vector<float>& coloredPointCloud)
+    {
+        ExportFrame exportFrame;
+        char name[32];
+        sprintf_s(name, "pointcloud_%06llu", frameIndex);
+        exportFrame.name = name;
+        exportFrame.frameIndex = frameIndex;
+        exportFrame.hostTicks = hostTicks;
+        if (!coloredPointCloud.empty())
         {
-            while (pHL2ResearchMode->m_longDepthSensorLoopStarted)
-            {
-                IResearchModeSensorFrame* pDepthSensorFrame = nullptr;
-                ResearchModeSensorResolution resolution;
-                pHL2ResearchMode->m_longDepthSensor->GetNextBuffer(&pDepthSensorFrame);
-
-                // process sensor frame
-                pDepthSensorFrame->GetResolution(&resolution);
-                pHL2ResearchMode->m_longDepthResolution = resolution;
+            exportFrame.points = coloredPointCloud;
+            exportFrame.fieldCount = 4;
+            exportFrame.attributeName = "intensity";
+        }
+        else
+        {
+            exportFrame.points = pointCloud;
+        }
+        m_pointCloudExporter.Submit(std::move(exportFrame));
+    }
+
+    // Compute the part of the depth image that needs to be back-projected for the frame of params.
+    // Without Roi filter this is the fixed depthCamRoi window. With Roi filter, the window shrinks to the pixels
+    // whose rays can reach the world-space Roi box, and the depth range is limited to the distance interval
+    // between the sensor and the box.
+    DepthRoiImageBounds HL2ResearchMode::ComputeDepthRoiImageBounds(const AhatFrameParams& params)
+    {
+        DepthRoiImageBounds bounds;
+        bounds.rowBegin = (UINT)floorf(depthCamRoi.kRowLower * params.height) + 1;
+        bounds.rowEnd = (UINT)ceilf(depthCamRoi.kRowUpper * params.height);
+        bounds.colBegin = (UINT)floorf(depthCamRoi.kColLower * params.width) + 1;
+        bounds.colEnd = (UINT)ceilf(depthCamRoi.kColUpper * params.width);
+        bounds.depthMin = params.depthNearClip + 1;
+        bounds.depthMax = params.depthFarClip - 1;
+
+        if (!params.useRoiFilter)
+        {
+            return bounds;
+        }
+
+        // depth interval: closest point of the box and farthest corner from the sensor
+        XMMATRIX depthToWorld = XMLoadFloat4x4(&params.depthToWorld);
+        XMVECTOR roiCenter = XMLoadFloat3(&params.roiCenter);
+        XMVECTOR roiBound = XMLoadFloat3(&params.roiBound);
+        XMVECTOR sensorPos = XMVector3Transform(XMVectorZero(), depthToWorld);
+        XMVECTOR boxMin = roiCenter - roiBound;
+        XMVECTOR boxMax = roiCenter + roiBound;
+        float nearest = XMVectorGetX(XMVector3Length(XMVectorClamp(sensorPos, boxMin, boxMax) - sensorPos));
+        float farthest = 0;
+        for (int c = 0; c < 8; c++)
+        {
+            XMVECTOR corner = XMVectorSelect(boxMin, boxMax, XMVectorSelectControl(c & 1, (c >> 1) & 1, (c >> 2) & 1, 0));
+            farthest = (std::max)(farthest, XMVectorGetX(XMVector3Length(corner - sensorPos)));
+        }
+
+        // image rectangle: pixels whose ray cones reach the box, which also holds where the fisheye bends the box edges
+        BoundRoiImageWindow(m_depthUnitRays.data(), params.width, depthToWorld, roiCenter, roiBound, m_depthUnitRayAngle, farthest, bounds);
+
+        // depth interval in mm
+        float depthMin = (std::min)(floorf(nearest * 1000), (float)UINT16_MAX);
+        float depthMax = ceilf(farthest * 1000);
+        bounds.depthMin = (UINT16)(std::max)((float)bounds.depthMin, depthMin);
+        bounds.depthMax = (UINT16)(std::min)((float)bounds.depthMax, depthMax);
+
+        return bounds;
+    }
+
+    // Map every depth pixel to its normalized camera ray. Pixels the sensor cannot map get a zero ray.
+    std::vector<XMFLOAT3> HL2ResearchMode::MapDepthUnitRays(IResearchModeCameraSensor* pCameraSensor, const ResearchModeSensorResolution& resolution)
+    {
+        std::vector<XMFLOAT3> unitRays(resolution.Width * resolution.Height, XMFLOAT3(0, 0, 0));
+        for (UINT i = 0; i < resolution.Height; i++)
+        {
+            for (UINT j = 0; j < resolution.Width; j++)
+            {
+                float xy[2] = { 0, 0 };
+                float uv[2] = { (float)j, (float)i };
+                if (FAILED(pCameraSensor->MapImagePointToCameraUnitPlane(uv, xy)))
+                {
+                    continue;
+                }
+                auto pointOnUnitPlane = XMFLOAT3(xy[0], xy[1], 1);
+                XMStoreFloat3(&unitRays[resolution.Width * i + j], XMVector3Normalize(XMLoadFloat3(&pointOnUnitPlane)));
+            }
+        }
+        return unitRays;
+    }
+
+    void HL2ResearchMode::StartLongDepthSensorLoop()
+    {
+        StartSensorLoop(SensorStream::LongDepth, m_longDepthSensorLoopStarted, m_pLongDepthUpdateThread, HL2ResearchMode::LongDepthSensorLoop);
+    }
+
+    void HL2ResearchMode::StopLongDepthSensorLoop()
+    {
+        StopSensorLoop(SensorStream::LongDepth, m_longDepthSensorLoopStarted, m_pLongDepthUpdateThread);
+    }
+
+    void HL2ResearchMode::LongDepthSensorLoop(HL2ResearchMode* pHL2ResearchMode)
+    {
+        if (!pHL2ResearchMode->PrepareSensorLoop(SensorStream::LongDepth, pHL2ResearchMode->m_longDepthSensorLoopStarted))
+        {
+            pHL2ResearchMode->m_longDepthSensorLoopStarted = false;
+            return;
+        }
+        pHL2ResearchMode->m_longDepthSensor->OpenStream();
+        pHL2ResearchMode->RecordSensorLoopEvent(SensorStream::LongDepth, false);
+        bool firstFrame = true;
+        UINT64 frameIndex = 0;
+        UINT64 sharedRingGeneration = 0;
+        std::vector<UINT8> depthTexture;    // sized to the texture layout, kept across frames
+
+        try
+        {
+            while (pHL2ResearchMode->m_longDepthSensorLoopStarted)
+            {
+                IResearchModeSensorFrame* pDepthSensorFrame = nullptr;
+                ResearchModeSensorResolution resolution;
+                auto& stats = pHL2ResearchMode->m_longDepthStats;
+                auto stageStart = StreamStats::Clock::now();
+                pHL2ResearchMode->m_longDepthSensor->GetNextBuffer(&pDepthSensorFrame);
+                stats.Record(PipelineStage::GetNextBuffer, stageStart);
+                if (firstFrame)
+                {
+                    pHL2ResearchMode->RecordSensorLoopEvent(SensorStream::LongDepth, true);
+                    firstFrame = false;
+                }
+
+                // process sensor frame
+                pDepthSensorFrame->GetResolution(&resolution);
+                pHL2ResearchMode->m_longDepthResolution = resolution;
 
                 IResearchModeSensorDepthFrame* pDepthFrame = nullptr;
                 winrt::check_hresult(pDepthSensorFrame->QueryInterface(IID_PPV_ARGS(&pDepthFrame)));
@@ -379,36 +1093,94 @@ namespace winrt::HL2UnityPlugin::implementation
                 pDepthFrame->GetBuffer(&pDepth, &outBufferCount);
                 pHL2ResearchMode->m_longDepthBufferSize = outBufferCount;
 
-                auto pDepthTexture = std::make_unique<uint8_t[]>(outBufferCount);
-
                 // get tracking transform
                 ResearchModeSensorTimestamp timestamp;
                 pDepthSensorFrame->GetTimeStamp(&timestamp);
 
+                stageStart = StreamStats::Clock::now();
                 auto ts = PerceptionTimestampHelper::FromSystemRelativeTargetTime(HundredsOfNanoseconds(checkAndConvertUnsigned(timestamp.HostTicks)));
                 auto transToWorld = pHL2ResearchMode->m_locator.TryLocateAtTimestamp(ts, pHL2ResearchMode->m_refFrame);
+                stats.Record(PipelineStage::Locate, stageStart);
                 if (transToWorld == nullptr)
                 {
+                    stats.CountDropped();
+                    pDepthFrame->Release();
+                    pDepthSensorFrame->Release();
                     continue;
                 }
+                auto rot = transToWorld.Orientation();
+                auto quatInDx = XMFLOAT4(rot.x, rot.y, rot.z, rot.w);
+                auto pos = transToWorld.Position();
+                auto depthToWorld = pHL2ResearchMode->m_longDepthCameraPoseInvMatrix * XMMatrixRotationQuaternion(XMLoadFloat4(&quatInDx)) *
+                    XMMatrixTranslation(pos.x, pos.y, pos.z);
 
-                for (UINT i = 0; i < resolution.Height; i++)
+                stageStart = StreamStats::Clock::now();
+                TextureLayout textureLayout;
+                std::shared_ptr<const ColormapLut> pColormap;
                 {
-                    for (UINT j = 0; j < resolution.Width; j++)
+                    std::lock_guard<std::mutex> l(pHL2ResearchMode->mu);
+                    textureLayout = pHL2ResearchMode->m_longDepthTextureSettings.Layout(resolution);
+                    pColormap = pHL2ResearchMode->m_longDepthColormap;
+                }
+                bool textureEnabled = textureLayout.mode != TextureMode::Off;
+                depthTexture.resize(textureLayout.width * textureLayout.height);
+                std::vector<UINT32> depthColorTexture(pColormap ? textureLayout.width * textureLayout.height : 0);
+
+                // texture range from the histograms of the previous frames, counted again by this pass
+                auto& normalizer = pHL2ResearchMode->m_longDepthNormalizer;
+                bool normalizeTexture = textureEnabled && pHL2ResearchMode->m_useTextureNormalization;
+                if (pHL2ResearchMode->m_longDepthNormalizationResetRequested.exchange(false))
+                {
+                    normalizer.Reset();
+                }
+                ProcessLongThrowFrame(pDepth, pSigma, resolution.Width, resolution.Height, pHL2ResearchMode->m_depthOffset,
+                    textureLayout, textureEnabled ? depthTexture.data() : nullptr, pColormap.get(), depthColorTexture.empty() ? nullptr : depthColorTexture.data(),
+                    normalizeTexture ? normalizer.Lut() : nullptr, normalizeTexture ? normalizer.BeginFrame() : nullptr);
+                if (normalizeTexture)
+                {
+                    TextureNormalizationSettings normalizationSettings;
                     {
-                        auto idx = resolution.Width * i + j;
-                        UINT16 depth = pDepth[idx];
-                        depth = (pSigma[idx] & 0x80) ? 0 : depth - pHL2ResearchMode->m_depthOffset;
+                        std::lock_guard<std::mutex> l(pHL2ResearchMode->mu);
+                        normalizationSettings = pHL2ResearchMode->m_textureNormalizationSettings;
+                    }
+                    normalizer.Update(normalizationSettings);
+                }
 
-                        // save as grayscale texture pixel into temp buffer
-                        if (depth == 0) { pDepthTexture.get()[idx] = 0; }
-                        else { pDepthTexture.get()[idx] = (uint8_t)((float)depth / 4000 * 255); }
+                // the long-throw range covers the room around the user, integrate its valid pixels into the occupancy map
+                if (pHL2ResearchMode->m_useOccupancyMap)
+                {
+                    auto& unitRays = pHL2ResearchMode->m_longDepthUnitRays;
+                    if (unitRays.size() != outBufferCount)
+                    {
+                        unitRays = MapDepthUnitRays(pHL2ResearchMode->m_pLongDepthCameraSensor, resolution);
+                    }
+                    std::vector<float> points;
+                    points.reserve(outBufferCount * 3);
+                    for (size_t idx = 0; idx < outBufferCount; idx++)
+                    {
+                        int depth = (int)pDepth[idx] - pHL2ResearchMode->m_depthOffset;
+                        if ((pSigma[idx] & 0x80) || depth <= 0 || unitRays[idx].z == 0)
+                        {
+                            continue;
+                        }
+                        XMFLOAT3 point;
+                        XMStoreFloat3(&point, XMVector3Transform((float)depth / 1000 * XMLoadFloat3(&unitRays[idx]), depthToWorld));
+                        points.push_back(point.x);
+                        points.push_back(point.y);
+                        points.push_back(-point.z);
                     }
+                    XMFLOAT3 sensorPosition;
+                    XMStoreFloat3(&sensorPosition, XMVector3Transform(XMVectorZero(), depthToWorld));
+                    sensorPosition.z = -sensorPosition.z;
+                    pHL2ResearchMode->m_occupancyMap.Integrate(points.data(), points.size() / 3, sensorPosition);
                 }
 
+                stats.Record(PipelineStage::Process, stageStart);
+
                 // save data
+                stageStart = StreamStats::Clock::now();
                 {
-                    std::lock_guard<std::mutex> l(pHL2ResearchMode->mu);
+                    auto l = stats.LockAndRecordWait(pHL2ResearchMode->mu);
 
                     // save raw depth map
                     if (!pHL2ResearchMode->m_longDepthMap)
@@ -424,12 +1196,50 @@ namespace winrt::HL2UnityPlugin::implementation
                         OutputDebugString(L"Create Space for depth map texture...\n");
                         pHL2ResearchMode->m_longDepthMapTexture = new UINT8[outBufferCount];
                     }
-                    memcpy(pHL2ResearchMode->m_longDepthMapTexture, pDepthTexture.get(), outBufferCount * sizeof(UINT8));
+                    if (textureEnabled)
+                    {
+                        memcpy(pHL2ResearchMode->m_longDepthMapTexture, depthTexture.data(), textureLayout.width * textureLayout.height * sizeof(UINT8));
+                        pHL2ResearchMode->m_longDepthTextureLayout = textureLayout;
+                        pHL2ResearchMode->m_longDepthMapColorTexture.swap(depthColorTexture);
+                    }
+                }
+                {
+                    SharedFramePlane planes[] = { { pDepth, sizeof(UINT16) }, { pSigma, sizeof(BYTE) } };
+                    pHL2ResearchMode->PublishSharedFrame(SharedRingStream::LongDepth, sharedRingGeneration,
+                        MakeSharedFrameInfo(frameIndex, timestamp.HostTicks, resolution, depthToWorld), planes, 2);
+                }
+                stats.Record(PipelineStage::Publish, stageStart);
+                if (pHL2ResearchMode->m_longDepthMapTextureUpdated)
+                {
+                    stats.CountOverwritten();
+                }
+                stats.CountFrame();
+                pHL2ResearchMode->DumpPipelineStatsIfDue(stats);
+
+                if (textureEnabled)
+                {
+                    pHL2ResearchMode->m_longDepthMapTextureUpdated = true;
                 }
 
-                pHL2ResearchMode->m_longDepthMapTextureUpdated = true;
+                FrameInfo frameInfo;
+                frameInfo.stream = SensorStream::LongDepth;
+                frameInfo.frameIndex = frameIndex++;
+                frameInfo.hostTicks = timestamp.HostTicks;
+                frameInfo.width = resolution.Width;
+                frameInfo.height = resolution.Height;
 
-                pDepthTexture.reset();
+                if (auto pFrameView = pHL2ResearchMode->AcquireFrameView(SensorStream::LongDepth))
+                {
+                    pFrameView->HoldSensorFrame(pDepthSensorFrame);
+                    pFrameView->stream = frameInfo.stream;
+                    pFrameView->frameIndex = frameInfo.frameIndex;
+                    pFrameView->hostTicks = frameInfo.hostTicks;
+                    pFrameView->depth = MakeFrameImage(pDepth, resolution.Width, resolution.Height, sizeof(UINT16));
+                    pFrameView->sigma = MakeFrameImage(pSigma, resolution.Width, resolution.Height, sizeof(BYTE));
+                    XMStoreFloat4x4(&pFrameView->cameraToWorld, depthToWorld);
+                    pHL2ResearchMode->m_frameViewNotifiers[(int)SensorStream::LongDepth].Notify(std::move(pFrameView));
+                }
+                pHL2ResearchMode->PublishFrameArrived(frameInfo);
 
                 // release space
                 if (pDepthFrame) {
@@ -444,34 +1254,36 @@ namespace winrt::HL2UnityPlugin::implementation
         }
         catch (...) {}
         pHL2ResearchMode->m_longDepthSensor->CloseStream();
-        pHL2ResearchMode->m_longDepthSensor->Release();
-        pHL2ResearchMode->m_longDepthSensor = nullptr;
+        pHL2ResearchMode->m_sharedRings[(int)SharedRingStream::LongDepth].Close();
+        pHL2ResearchMode->m_longDepthSensorLoopStarted = false;
 
     }
 
     void HL2ResearchMode::StartSpatialCamerasFrontLoop()
     {
-        if (m_refFrame == nullptr)
-        {
-            m_refFrame = m_locator.GetDefault().CreateStationaryFrameOfReferenceAtCurrentLocation().CoordinateSystem();
-        }
+        StartSensorLoop(SensorStream::SpatialCamerasFront, m_spatialCamerasFrontLoopStarted, m_pSpatialCamerasFrontUpdateThread,
+            HL2ResearchMode::SpatialCamerasFrontLoop);
+    }
 
-        m_pSpatialCamerasFrontUpdateThread = new std::thread(HL2ResearchMode::SpatialCamerasFrontLoop, this);
+    void HL2ResearchMode::StopSpatialCamerasFrontLoop()
+    {
+        StopSensorLoop(SensorStream::SpatialCamerasFront, m_spatialCamerasFrontLoopStarted, m_pSpatialCamerasFrontUpdateThread);
     }
 
     void HL2ResearchMode::SpatialCamerasFrontLoop(HL2ResearchMode* pHL2ResearchMode)
     {
-        // prevent starting loop for multiple times
-        if (!pHL2ResearchMode->m_spatialCamerasFrontLoopStarted)
+        if (!pHL2ResearchMode->PrepareSensorLoop(SensorStream::SpatialCamerasFront, pHL2ResearchMode->m_spatialCamerasFrontLoopStarted))
         {
-            pHL2ResearchMode->m_spatialCamerasFrontLoopStarted = true;
-        }
-        else {
+            pHL2ResearchMode->m_spatialCamerasFrontLoopStarted = false;
             return;
         }
-
         pHL2ResearchMode->m_LFSensor->OpenStream();
         pHL2ResearchMode->m_RFSensor->OpenStream();
+        pHL2ResearchMode->RecordSensorLoopEvent(SensorStream::SpatialCamerasFront, false);
+        bool firstFrame = true;
+        UINT64 frameIndex = 0;
+        UINT64 LFRingGeneration = 0;
+        UINT64 RFRingGeneration = 0;
 
         try
         {
@@ -481,8 +1293,16 @@ namespace winrt::HL2UnityPlugin::implementation
                 IResearchModeSensorFrame* pRFCameraFrame = nullptr;
                 ResearchModeSensorResolution LFResolution;
                 ResearchModeSensorResolution RFResolution;
+                auto& stats = pHL2ResearchMode->m_spatialCamerasFrontStats;
+                auto stageStart = StreamStats::Clock::now();
                 pHL2ResearchMode->m_LFSensor->GetNextBuffer(&pLFCameraFrame);
 				pHL2ResearchMode->m_RFSensor->GetNextBuffer(&pRFCameraFrame);
+                stats.Record(PipelineStage::GetNextBuffer, stageStart);
+                if (firstFrame)
+                {
+                    pHL2ResearchMode->RecordSensorLoopEvent(SensorStream::SpatialCamerasFront, true);
+                    firstFrame = false;
+                }
 
                 // process sensor frame
                 pLFCameraFrame->GetResolution(&LFResolution);
@@ -508,10 +1328,17 @@ namespace winrt::HL2UnityPlugin::implementation
                 ResearchModeSensorTimestamp timestamp;
                 pLFCameraFrame->GetTimeStamp(&timestamp);
 
+                stageStart = StreamStats::Clock::now();
                 auto ts = PerceptionTimestampHelper::FromSystemRelativeTargetTime(HundredsOfNanoseconds(checkAndConvertUnsigned(timestamp.HostTicks)));
                 auto transToWorld = pHL2ResearchMode->m_locator.TryLocateAtTimestamp(ts, pHL2ResearchMode->m_refFrame);
+                stats.Record(PipelineStage::Locate, stageStart);
                 if (transToWorld == nullptr)
                 {
+                    stats.CountDropped();
+                    pLFFrame->Release();
+                    pRFFrame->Release();
+                    pLFCameraFrame->Release();
+                    pRFCameraFrame->Release();
                     continue;
                 }
                 auto rot = transToWorld.Orientation();
@@ -529,9 +1356,60 @@ namespace winrt::HL2UnityPlugin::implementation
                 auto LfToWorld = pHL2ResearchMode->m_LFCameraPoseInvMatrix * rotMat * posMat;
 				auto RfToWorld = pHL2ResearchMode->m_RFCameraPoseInvMatrix * rotMat * posMat;
 
+                // keep posed copies of the latest frames for point cloud intensity
+                std::shared_ptr<VlcFrameSnapshot> pLFSnapshot, pRFSnapshot;
+                if (pHL2ResearchMode->m_usePointCloudIntensity)
+                {
+                    auto makeSnapshot = [&](const BYTE* pImage, const ResearchModeSensorResolution& res, FXMMATRIX camToWorld) {
+                        auto pSnapshot = std::make_shared<VlcFrameSnapshot>();
+                        pSnapshot->image.assign(pImage, pImage + res.Width * res.Height);
+                        pSnapshot->width = res.Width;
+                        pSnapshot->height = res.Height;
+                        pSnapshot->hostTicks = timestamp.HostTicks;
+                        XMStoreFloat4x4(&pSnapshot->worldToCamera, XMMatrixInverse(nullptr, camToWorld));
+                        return pSnapshot;
+                    };
+                    pLFSnapshot = makeSnapshot(pLFImage, LFResolution, LfToWorld);
+                    pRFSnapshot = makeSnapshot(pRFImage, RFResolution, RfToWorld);
+                }
+
+                // detect keypoints next to the images, only the compact keypoint lists are published
+                std::vector<float> LFKeypoints, RFKeypoints;
+                bool featuresExtracted = pHL2ResearchMode->m_useFeatureExtraction;
+                if (featuresExtracted)
+                {
+                    stageStart = StreamStats::Clock::now();
+                    FeatureExtractionSettings featureSettings;
+                    {
+                        std::lock_guard<std::mutex> l(pHL2ResearchMode->mu);
+                        featureSettings = pHL2ResearchMode->m_featureExtractionSettings;
+                    }
+                    pHL2ResearchMode->m_LFFeatureExtractor.Extract(featureSettings, pLFImage, LFResolution.Width, LFResolution.Height);
+                    pHL2ResearchMode->m_LFFeatureExtractor.Pack(LFKeypoints);
+                    pHL2ResearchMode->m_RFFeatureExtractor.Extract(featureSettings, pRFImage, RFResolution.Width, RFResolution.Height);
+                    pHL2ResearchMode->m_RFFeatureExtractor.Pack(RFKeypoints);
+                    stats.Record(PipelineStage::Process, stageStart);
+                }
+
                 // save data
+                stageStart = StreamStats::Clock::now();
                 {
-                    std::lock_guard<std::mutex> l(pHL2ResearchMode->mu);
+                    auto l = stats.LockAndRecordWait(pHL2ResearchMode->mu);
+
+                    if (featuresExtracted)
+                    {
+                        // the lists stay with the frame for its view
+                        pHL2ResearchMode->m_LFKeypoints = LFKeypoints;
+                        pHL2ResearchMode->m_RFKeypoints = RFKeypoints;
+                    }
+
+                    if (pLFSnapshot && pRFSnapshot)
+                    {
+                        pHL2ResearchMode->m_LFHistory[1] = std::move(pHL2ResearchMode->m_LFHistory[0]);
+                        pHL2ResearchMode->m_LFHistory[0] = std::move(pLFSnapshot);
+                        pHL2ResearchMode->m_RFHistory[1] = std::move(pHL2ResearchMode->m_RFHistory[0]);
+                        pHL2ResearchMode->m_RFHistory[0] = std::move(pRFSnapshot);
+                    }
 
 					// save LF and RF images
 					if (!pHL2ResearchMode->m_LFImage)
@@ -548,9 +1426,53 @@ namespace winrt::HL2UnityPlugin::implementation
 					}
 					memcpy(pHL2ResearchMode->m_RFImage, pRFImage, RFOutBufferCount * sizeof(UINT8));
                 }
+                SharedFramePlane LFPlane{ pLFImage, sizeof(BYTE) };
+                pHL2ResearchMode->PublishSharedFrame(SharedRingStream::LeftFront, LFRingGeneration,
+                    MakeSharedFrameInfo(frameIndex, timestamp.HostTicks, LFResolution, LfToWorld), &LFPlane, 1);
+                SharedFramePlane RFPlane{ pRFImage, sizeof(BYTE) };
+                pHL2ResearchMode->PublishSharedFrame(SharedRingStream::RightFront, RFRingGeneration,
+                    MakeSharedFrameInfo(frameIndex, timestamp.HostTicks, RFResolution, RfToWorld), &RFPlane, 1);
+                stats.Record(PipelineStage::Publish, stageStart);
+                if (pHL2ResearchMode->m_LFImageUpdated || pHL2ResearchMode->m_RFImageUpdated)
+                {
+                    stats.CountOverwritten();
+                }
+                stats.CountFrame();
+                pHL2ResearchMode->DumpPipelineStatsIfDue(stats);
 				pHL2ResearchMode->m_LFImageUpdated = true;
 				pHL2ResearchMode->m_RFImageUpdated = true;
 
+                FrameInfo frameInfo;
+                frameInfo.stream = SensorStream::SpatialCamerasFront;
+                frameInfo.frameIndex = frameIndex++;
+                frameInfo.hostTicks = timestamp.HostTicks;
+                frameInfo.width = LFResolution.Width;
+                frameInfo.height = LFResolution.Height;
+
+                if (auto pFrameView = pHL2ResearchMode->AcquireFrameView(SensorStream::SpatialCamerasFront))
+                {
+                    pFrameView->HoldSensorFrame(pLFCameraFrame);
+                    pFrameView->HoldSensorFrame(pRFCameraFrame);
+                    pFrameView->stream = frameInfo.stream;
+                    pFrameView->frameIndex = frameInfo.frameIndex;
+                    pFrameView->hostTicks = frameInfo.hostTicks;
+                    pFrameView->LF = MakeFrameImage(pLFImage, LFResolution.Width, LFResolution.Height, sizeof(BYTE));
+                    pFrameView->RF = MakeFrameImage(pRFImage, RFResolution.Width, RFResolution.Height, sizeof(BYTE));
+                    XMStoreFloat4x4(&pFrameView->cameraToWorld, LfToWorld);
+                    XMStoreFloat4x4(&pFrameView->RFCameraToWorld, RfToWorld);
+                    if (featuresExtracted)
+                    {
+                        pFrameView->LFKeypoints.swap(LFKeypoints);
+                        pFrameView->RFKeypoints.swap(RFKeypoints);
+                        pFrameView->pLFKeypoints = pFrameView->LFKeypoints.data();
+                        pFrameView->LFKeypointCount = pFrameView->LFKeypoints.size() / VlcFeatureExtractor::kPackedKeypointSize;
+                        pFrameView->pRFKeypoints = pFrameView->RFKeypoints.data();
+                        pFrameView->RFKeypointCount = pFrameView->RFKeypoints.size() / VlcFeatureExtractor::kPackedKeypointSize;
+                    }
+                    pHL2ResearchMode->m_frameViewNotifiers[(int)SensorStream::SpatialCamerasFront].Notify(std::move(pFrameView));
+                }
+                pHL2ResearchMode->PublishFrameArrived(frameInfo);
+
                 // release space
 				if (pLFFrame) pLFFrame->Release();
 				if (pRFFrame) pRFFrame->Release();
@@ -561,12 +1483,70 @@ namespace winrt::HL2UnityPlugin::implementation
         }
         catch (...) {}
         pHL2ResearchMode->m_LFSensor->CloseStream();
-        pHL2ResearchMode->m_LFSensor->Release();
-        pHL2ResearchMode->m_LFSensor = nullptr;
-
 		pHL2ResearchMode->m_RFSensor->CloseStream();
-		pHL2ResearchMode->m_RFSensor->Release();
-		pHL2ResearchMode->m_RFSensor = nullptr;
+        pHL2ResearchMode->m_sharedRings[(int)SharedRingStream::LeftFront].Close();
+        pHL2ResearchMode->m_sharedRings[(int)SharedRingStream::RightFront].Close();
+        pHL2ResearchMode->m_spatialCamerasFrontLoopStarted = false;
+    }
+
+    SharedFrameInfo HL2ResearchMode::MakeSharedFrameInfo(UINT64 frameIndex, UINT64 hostTicks, const ResearchModeSensorResolution& resolution,
+        FXMMATRIX cameraToWorld)
+    {
+        SharedFrameInfo info;
+        info.frameIndex = frameIndex;
+        info.hostTicks = hostTicks;
+        info.width = resolution.Width;
+        info.height = resolution.Height;
+        XMFLOAT4X4 pose;
+        XMStoreFloat4x4(&pose, cameraToWorld);
+        memcpy(info.cameraToWorld, &pose, sizeof(info.cameraToWorld));
+        return info;
+    }
+
+    // Called by the sensor loop of the stream: (re)opens or closes its ring after StartSharedMemoryTransport and
+    // StopSharedMemoryTransport, sized by the first frame, and copies the frame into it
+    bool HL2ResearchMode::PublishSharedFrame(SharedRingStream stream, UINT64& ringGeneration, const SharedFrameInfo& info,
+        const SharedFramePlane* pPlanes, uint32_t planeCount)
+    {
+        auto& ring = m_sharedRings[(int)stream];
+        UINT64 generation = m_sharedRingGeneration;
+        if (generation != ringGeneration)
+        {
+            ringGeneration = generation;
+            ring.Close();
+            if (m_useSharedRings)
+            {
+                std::filesystem::path directory;
+                UINT32 slotCount;
+                {
+                    std::lock_guard<std::mutex> l(mu);
+                    directory = m_sharedRingDirectory;
+                    slotCount = m_sharedRingSlotCount;
+                }
+                size_t payloadSize = 0;
+                for (uint32_t p = 0; p < planeCount; p++)
+                {
+                    payloadSize += (size_t)info.width * info.height * pPlanes[p].bytesPerPixel;
+                }
+                if (!ring.Create(directory / kSharedRingFileNames[(int)stream], stream, slotCount, payloadSize))
+                {
+                    OutputDebugString(L"Failed to create shared memory ring\n");
+                }
+            }
+        }
+        return ring.IsOpen() && ring.Publish(info, pPlanes, planeCount);
+    }
+
+    std::shared_ptr<const VlcFrameSnapshot> HL2ResearchMode::NearestVlcFrame(const std::shared_ptr<const VlcFrameSnapshot> (&history)[2], UINT64 hostTicks)
+    {
+        auto distance = [hostTicks](const std::shared_ptr<const VlcFrameSnapshot>& pFrame) {
+            return pFrame->hostTicks > hostTicks ? pFrame->hostTicks - hostTicks : hostTicks - pFrame->hostTicks;
+        };
+        if (!history[0] || !history[1])
+        {
+            return history[0];
+        }
+        return distance(history[0]) <= distance(history[1]) ? history[0] : history[1];
     }
 
     void HL2ResearchMode::CamAccessOnComplete(ResearchModeSensorConsent consent)
@@ -593,6 +1573,83 @@ namespace winrt::HL2UnityPlugin::implementation
 
 	inline bool HL2ResearchMode::RFImageUpdated() { return m_RFImageUpdated; }
 
+    // Frame events are raised on the sensor thread after the frame is published; handlers should return quickly
+    // and marshal to their own thread if needed. Every subscriber sees every frame, unlike the *Updated flags.
+    winrt::event_token HL2ResearchMode::DepthFrameArrived(FrameArrivedHandler const& handler)
+    {
+        return m_frameArrivedEvents[(int)SensorStream::Depth].add(handler);
+    }
+
+    void HL2ResearchMode::DepthFrameArrived(winrt::event_token const& token) noexcept
+    {
+        m_frameArrivedEvents[(int)SensorStream::Depth].remove(token);
+    }
+
+    winrt::event_token HL2ResearchMode::LongDepthFrameArrived(FrameArrivedHandler const& handler)
+    {
+        return m_frameArrivedEvents[(int)SensorStream::LongDepth].add(handler);
+    }
+
+    void HL2ResearchMode::LongDepthFrameArrived(winrt::event_token const& token) noexcept
+    {
+        m_frameArrivedEvents[(int)SensorStream::LongDepth].remove(token);
+    }
+
+    winrt::event_token HL2ResearchMode::SpatialCamerasFrontFrameArrived(FrameArrivedHandler const& handler)
+    {
+        return m_frameArrivedEvents[(int)SensorStream::SpatialCamerasFront].add(handler);
+    }
+
+    void HL2ResearchMode::SpatialCamerasFrontFrameArrived(winrt::event_token const& token) noexcept
+    {
+        m_frameArrivedEvents[(int)SensorStream::SpatialCamerasFront].remove(token);
+    }
+
+    UINT64 HL2ResearchMode::SubscribeFrameArrived(SensorStream stream, FrameCallback callback)
+    {
+        return m_frameNotifiers[(int)stream].Subscribe(std::move(callback));
+    }
+
+    void HL2ResearchMode::UnsubscribeFrameArrived(SensorStream stream, UINT64 token)
+    {
+        m_frameNotifiers[(int)stream].Unsubscribe(token);
+    }
+
+    UINT64 HL2ResearchMode::SubscribeFrameViews(SensorStream stream, FrameViewCallback callback)
+    {
+        return m_frameViewNotifiers[(int)stream].Subscribe(std::move(callback));
+    }
+
+    void HL2ResearchMode::UnsubscribeFrameViews(SensorStream stream, UINT64 token)
+    {
+        m_frameViewNotifiers[(int)stream].Unsubscribe(token);
+    }
+
+    // Frame view to fill for the current frame of the stream, or nullptr without native view subscribers
+    std::shared_ptr<PooledFrameView> HL2ResearchMode::AcquireFrameView(SensorStream stream)
+    {
+        return m_frameViewNotifiers[(int)stream].HasSubscribers() ? m_frameViewPool.Acquire() : nullptr;
+    }
+
+    void HL2ResearchMode::PublishFrameArrived(const FrameInfo& info)
+    {
+        // native subscribers first, they do not pay for the event args
+        m_frameNotifiers[(int)info.stream].Notify(info);
+
+        auto& frameArrived = m_frameArrivedEvents[(int)info.stream];
+        if (frameArrived)
+        {
+            try
+            {
+                frameArrived(*this, winrt::make<FrameArrivedEventArgs>(info));
+            }
+            catch (...)
+            {
+                OutputDebugString(L"Frame event handler failed\n");
+            }
+        }
+    }
+
     hstring HL2ResearchMode::PrintDepthResolution()
     {
         std::string res_c_ctr = std::to_string(m_depthResolution.Height) + "x" + std::to_string(m_depthResolution.Width) + "x" + std::to_string(m_depthResolution.BytesPerPixel);
@@ -655,49 +1712,76 @@ namespace winrt::HL2UnityPlugin::implementation
         return ss.str();
     }
     
-    // Stop the sensor loop and release buffer space.
-    // Sensor object should be released at the end of the loop function
+    // Stop the sensor loops, joining their threads, and release buffer space, the sensors and the sensor device
     void HL2ResearchMode::StopAllSensorDevice()
     {
-        m_depthSensorLoopStarted = false;
-        //m_pDepthUpdateThread->join();
-        if (m_depthMap) 
-        {
-            delete[] m_depthMap;
-            m_depthMap = nullptr;
-        }
-        if (m_depthMapTexture) 
-        {
-            delete[] m_depthMapTexture;
-            m_depthMapTexture = nullptr;
-        }
-        if (m_pointCloud) 
-        {
-            m_pointcloudLength = 0;
-            delete[] m_pointCloud;
-            m_pointCloud = nullptr;
-        }
+        StopDepthSensorLoop();
+        StopLongDepthSensorLoop();
+        StopSpatialCamerasFrontLoop();
+        StopPointCloudExport();
 
-        m_longDepthSensorLoopStarted = false;
-        if (m_longDepthMap)
-        {
-            delete[] m_longDepthMap;
-            m_longDepthMap = nullptr;
-        }
-        if (m_longDepthMapTexture)
         {
-            delete[] m_longDepthMapTexture;
-            m_longDepthMapTexture = nullptr;
+            std::lock_guard<std::mutex> l(mu);
+            if (m_depthMap) 
+            {
+                delete[] m_depthMap;
+                m_depthMap = nullptr;
+            }
+            if (m_depthMapTexture) 
+            {
+                delete[] m_depthMapTexture;
+                m_depthMapTexture = nullptr;
+            }
+            if (m_pointCloud) 
+            {
+                m_pointcloudLength = 0;
+                delete[] m_pointCloud;
+                m_pointCloud = nullptr;
+            }
+
+            if (m_longDepthMap)
+            {
+                delete[] m_longDepthMap;
+                m_longDepthMap = nullptr;
+            }
+            if (m_longDepthMapTexture)
+            {
+                delete[] m_longDepthMapTexture;
+                m_longDepthMapTexture = nullptr;
+            }
         }
 
-		m_pSensorDevice->Release();
-		m_pSensorDevice = nullptr;
-		m_pSensorDeviceConsent->Release();
-		m_pSensorDeviceConsent = nullptr;
+        // waits for sensor acquisitions in flight, which record their timing under mu
+        ReleaseSensors();
+    }
+
+    // Called with the loops joined
+    void HL2ResearchMode::ReleaseSensors()
+    {
+        m_sensorInit.Release();
+
+        auto release = [](auto*& pInterface) {
+            if (pInterface)
+            {
+                pInterface->Release();
+                pInterface = nullptr;
+            }
+        };
+        release(m_pDepthCameraSensor);
+        release(m_depthSensor);
+        release(m_pLongDepthCameraSensor);
+        release(m_longDepthSensor);
+        release(m_LFCameraSensor);
+        release(m_LFSensor);
+        release(m_RFCameraSensor);
+        release(m_RFSensor);
+        release(m_pSensorDeviceConsent);
+        release(m_pSensorDevice);
     }
 
     com_array<uint16_t> HL2ResearchMode::GetDepthMapBuffer()
     {
+        ScopedStageTimer fetchTimer(m_depthStats, PipelineStage::Fetch);
         std::lock_guard<std::mutex> l(mu);
         if (!m_depthMap)
         {
@@ -710,6 +1794,7 @@ namespace winrt::HL2UnityPlugin::implementation
 
     com_array<uint16_t> HL2ResearchMode::GetShortAbImageBuffer()
     {
+        ScopedStageTimer fetchTimer(m_depthStats, PipelineStage::Fetch);
         std::lock_guard<std::mutex> l(mu);
         if (!m_shortAbImage)
         {
@@ -723,12 +1808,13 @@ namespace winrt::HL2UnityPlugin::implementation
     // Get depth map texture buffer. (For visualization purpose)
     com_array<uint8_t> HL2ResearchMode::GetDepthMapTextureBuffer()
     {
+        ScopedStageTimer fetchTimer(m_depthStats, PipelineStage::Fetch);
         std::lock_guard<std::mutex> l(mu);
         if (!m_depthMapTexture) 
         {
             return com_array<UINT8>();
         }
-        com_array<UINT8> tempBuffer = com_array<UINT8>(std::move_iterator(m_depthMapTexture), std::move_iterator(m_depthMapTexture + m_depthBufferSize));
+        com_array<UINT8> tempBuffer = com_array<UINT8>(std::move_iterator(m_depthMapTexture), std::move_iterator(m_depthMapTexture + m_depthTextureLayout.width * m_depthTextureLayout.height));
 
         m_depthMapTextureUpdated = false;
         return tempBuffer;
@@ -737,12 +1823,13 @@ namespace winrt::HL2UnityPlugin::implementation
     // Get depth map texture buffer. (For visualization purpose)
     com_array<uint8_t> HL2ResearchMode::GetShortAbImageTextureBuffer()
     {
+        ScopedStageTimer fetchTimer(m_depthStats, PipelineStage::Fetch);
         std::lock_guard<std::mutex> l(mu);
         if (!m_shortAbImageTexture)
         {
             return com_array<UINT8>();
         }
-        com_array<UINT8> tempBuffer = com_array<UINT8>(std::move_iterator(m_shortAbImageTexture), std::move_iterator(m_shortAbImageTexture + m_depthBufferSize));
+        com_array<UINT8> tempBuffer = com_array<UINT8>(std::move_iterator(m_shortAbImageTexture), std::move_iterator(m_shortAbImageTexture + m_depthTextureLayout.width * m_depthTextureLayout.height));
 
         m_shortAbImageTextureUpdated = false;
         return tempBuffer;
@@ -750,6 +1837,7 @@ namespace winrt::HL2UnityPlugin::implementation
 
     com_array<uint16_t> HL2ResearchMode::GetLongDepthMapBuffer()
     {
+        ScopedStageTimer fetchTimer(m_longDepthStats, PipelineStage::Fetch);
         std::lock_guard<std::mutex> l(mu);
         if (!m_longDepthMap)
         {
@@ -762,12 +1850,13 @@ namespace winrt::HL2UnityPlugin::implementation
 
     com_array<uint8_t> HL2ResearchMode::GetLongDepthMapTextureBuffer()
     {
+        ScopedStageTimer fetchTimer(m_longDepthStats, PipelineStage::Fetch);
         std::lock_guard<std::mutex> l(mu);
         if (!m_longDepthMapTexture)
         {
             return com_array<UINT8>();
         }
-        com_array<UINT8> tempBuffer = com_array<UINT8>(std::move_iterator(m_longDepthMapTexture), std::move_iterator(m_longDepthMapTexture + m_longDepthBufferSize));
+        com_array<UINT8> tempBuffer = com_array<UINT8>(std::move_iterator(m_longDepthMapTexture), std::move_iterator(m_longDepthMapTexture + m_longDepthTextureLayout.width * m_longDepthTextureLayout.height));
 
         m_longDepthMapTextureUpdated = false;
         return tempBuffer;
@@ -775,6 +1864,7 @@ namespace winrt::HL2UnityPlugin::implementation
 
 	com_array<uint8_t> HL2ResearchMode::GetLFCameraBuffer()
 	{
+		ScopedStageTimer fetchTimer(m_spatialCamerasFrontStats, PipelineStage::Fetch);
 		std::lock_guard<std::mutex> l(mu);
 		if (!m_LFImage)
 		{
@@ -788,6 +1878,7 @@ namespace winrt::HL2UnityPlugin::implementation
 
 	com_array<uint8_t> HL2ResearchMode::GetRFCameraBuffer()
 	{
+		ScopedStageTimer fetchTimer(m_spatialCamerasFrontStats, PipelineStage::Fetch);
 		std::lock_guard<std::mutex> l(mu);
 		if (!m_RFImage)
 		{
@@ -804,6 +1895,7 @@ namespace winrt::HL2UnityPlugin::implementation
     // There will be 3n elements in the array where the 3i, 3i+1, 3i+2 element correspond to x, y, z component of the i'th point. (i->[0,n-1])
     com_array<float> HL2ResearchMode::GetPointCloudBuffer()
     {
+        ScopedStageTimer fetchTimer(m_depthStats, PipelineStage::Fetch);
         std::lock_guard<std::mutex> l(mu);
         if (m_pointcloudLength == 0)
         {
@@ -814,6 +1906,219 @@ namespace winrt::HL2UnityPlugin::implementation
         return tempBuffer;
     }
 
+    // Get the point cloud with the intensity sampled from the LF/RF cameras, in the form of float array.
+    // There will be 4n elements in the array: x, y, z as in GetPointCloudBuffer and the intensity in [0, 1],
+    // or -1 for points not visible in either camera. Requires SetPointCloudIntensityEnabled(true) and the spatial camera loop.
+    com_array<float> HL2ResearchMode::GetColoredPointCloudBuffer()
+    {
+        ScopedStageTimer fetchTimer(m_depthStats, PipelineStage::Fetch);
+        std::lock_guard<std::mutex> l(mu);
+        return com_array<float>(m_coloredPointCloud.begin(), m_coloredPointCloud.end());
+    }
+
+    void HL2ResearchMode::SetPointCloudIntensityEnabled(bool enabled)
+    {
+        m_usePointCloudIntensity = enabled;
+        if (!enabled)
+        {
+            std::lock_guard<std::mutex> l(mu);
+            m_coloredPointCloud.clear();
+            for (auto& pFrame : m_LFHistory) pFrame.reset();
+            for (auto& pFrame : m_RFHistory) pFrame.reset();
+        }
+    }
+
+    // Select the encoding of GetEncodedPointCloudBuffer: 0 = none (float only), 1 = float16 x, y, z, 2 = int16 fixed point.
+    void HL2ResearchMode::SetPointCloudFormat(int32_t format)
+    {
+        m_pointCloudFormat = (format == (int32_t)PointCloudFormat::Half || format == (int32_t)PointCloudFormat::Fixed16) ?
+            (PointCloudFormat)format : PointCloudFormat::Float;
+    }
+
+    // Get the point cloud in the format selected by SetPointCloudFormat, 3 values (x, y, z) per point in the same order as GetPointCloudBuffer.
+    // float16: the values are the IEEE half bits. int16 fixed point: the values are two's complement, point = value * scale + offset.
+    // offset and scale belong to the returned frame (offset = 0, scale = 1 for float16).
+    com_array<uint16_t> HL2ResearchMode::GetEncodedPointCloudBuffer(float& offsetX, float& offsetY, float& offsetZ, float& scale)
+    {
+        ScopedStageTimer fetchTimer(m_depthStats, PipelineStage::Fetch);
+        std::lock_guard<std::mutex> l(mu);
+        bool fixed = m_encodedPointCloudFormat == PointCloudFormat::Fixed16;
+        offsetX = fixed ? m_encodingOffset.x : 0;
+        offsetY = fixed ? m_encodingOffset.y : 0;
+        offsetZ = fixed ? m_encodingOffset.z : 0;
+        scale = fixed ? m_encodingScale : 1;
+        return com_array<uint16_t>(m_encodedPointCloud.begin(), m_encodedPointCloud.end());
+    }
+
+    // Select how the depth and AbImage textures are generated: 0 = off, 1 = full resolution, 2 = 2x downsampled,
+    // 3 = 4x downsampled, 4 = crop of cropWidth x cropHeight pixels at (cropX, cropY). Turn textures off when they are not shown.
+    void HL2ResearchMode::SetDepthTextureMode(int32_t mode, int32_t cropX, int32_t cropY, int32_t cropWidth, int32_t cropHeight)
+    {
+        std::lock_guard<std::mutex> l(mu);
+        m_depthTextureSettings = TextureSettings::From(mode, cropX, cropY, cropWidth, cropHeight);
+    }
+
+    void HL2ResearchMode::SetLongDepthTextureMode(int32_t mode, int32_t cropX, int32_t cropY, int32_t cropWidth, int32_t cropHeight)
+    {
+        std::lock_guard<std::mutex> l(mu);
+        m_longDepthTextureSettings = TextureSettings::From(mode, cropX, cropY, cropWidth, cropHeight);
+    }
+
+    // Get the width and height (int[2]) of the latest depth and AbImage textures
+    com_array<int32_t> HL2ResearchMode::GetDepthTextureSize()
+    {
+        std::lock_guard<std::mutex> l(mu);
+        return com_array<int32_t>({ (int32_t)m_depthTextureLayout.width, (int32_t)m_depthTextureLayout.height });
+    }
+
+    com_array<int32_t> HL2ResearchMode::GetLongDepthTextureSize()
+    {
+        std::lock_guard<std::mutex> l(mu);
+        return com_array<int32_t>({ (int32_t)m_longDepthTextureLayout.width, (int32_t)m_longDepthTextureLayout.height });
+    }
+
+    // Select the colormap of the RGBA depth, AbImage and long-throw depth textures: 0 = none (no color texture), 1 = grayscale,
+    // 2 = jet, 3 = turbo, 4 = viridis. Raw values (mm for depth) in [rangeMin, rangeMax] span the colormap; values are clamped
+    // to 4095 and 0 (no signal) is transparent. The color textures follow the texture mode and size of the 8-bit textures.
+    void HL2ResearchMode::SetDepthColormap(int32_t colormap, uint16_t rangeMin, uint16_t rangeMax)
+    {
+        auto pLut = MakeColormapLut(colormap, rangeMin, rangeMax);
+        std::lock_guard<std::mutex> l(mu);
+        m_depthColormap = pLut;
+        if (!pLut) m_depthMapColorTexture.clear();
+    }
+
+    void HL2ResearchMode::SetShortAbImageColormap(int32_t colormap, uint16_t rangeMin, uint16_t rangeMax)
+    {
+        auto pLut = MakeColormapLut(colormap, rangeMin, rangeMax);
+        std::lock_guard<std::mutex> l(mu);
+        m_abColormap = pLut;
+        if (!pLut) m_shortAbImageColorTexture.clear();
+    }
+
+    void HL2ResearchMode::SetLongDepthColormap(int32_t colormap, uint16_t rangeMin, uint16_t rangeMax)
+    {
+        auto pLut = MakeColormapLut(colormap, rangeMin, rangeMax);
+        std::lock_guard<std::mutex> l(mu);
+        m_longDepthColormap = pLut;
+        if (!pLut) m_longDepthMapColorTexture.clear();
+    }
+
+    std::shared_ptr<const ColormapLut> HL2ResearchMode::MakeColormapLut(int32_t colormap, uint16_t rangeMin, uint16_t rangeMax)
+    {
+        if (colormap <= (int32_t)Colormap::None || colormap > (int32_t)Colormap::Viridis)
+        {
+            return nullptr;
+        }
+        auto pLut = std::make_shared<ColormapLut>();
+        pLut->Build((Colormap)colormap, rangeMin, rangeMax);
+        return pLut;
+    }
+
+    com_array<uint8_t> HL2ResearchMode::ColorTextureBytes(const std::vector<UINT32>& texture)
+    {
+        auto pBytes = reinterpret_cast<const uint8_t*>(texture.data());
+        return com_array<uint8_t>(pBytes, pBytes + texture.size() * sizeof(UINT32));
+    }
+
+    // Get the RGBA8 textures (4 bytes per pixel, size from GetDepthTextureSize / GetLongDepthTextureSize).
+    // They are published together with the 8-bit textures and clear the same updated flags.
+    com_array<uint8_t> HL2ResearchMode::GetDepthMapColorTextureBuffer()
+    {
+        ScopedStageTimer fetchTimer(m_depthStats, PipelineStage::Fetch);
+        std::lock_guard<std::mutex> l(mu);
+        m_depthMapTextureUpdated = false;
+        return ColorTextureBytes(m_depthMapColorTexture);
+    }
+
+    com_array<uint8_t> HL2ResearchMode::GetShortAbImageColorTextureBuffer()
+    {
+        ScopedStageTimer fetchTimer(m_depthStats, PipelineStage::Fetch);
+        std::lock_guard<std::mutex> l(mu);
+        m_shortAbImageTextureUpdated = false;
+        return ColorTextureBytes(m_shortAbImageColorTexture);
+    }
+
+    com_array<uint8_t> HL2ResearchMode::GetLongDepthMapColorTextureBuffer()
+    {
+        ScopedStageTimer fetchTimer(m_longDepthStats, PipelineStage::Fetch);
+        std::lock_guard<std::mutex> l(mu);
+        m_longDepthMapTextureUpdated = false;
+        return ColorTextureBytes(m_longDepthMapColorTexture);
+    }
+
+    // Keep the recent AHAT frames for QueryDepthPixels and QueryDepthRays. The first query enables this as well, but
+    // finds no frame yet; enable it beforehand to query right away.
+    void HL2ResearchMode::EnableDepthQueries()
+    {
+        m_useDepthQueries = true;
+    }
+
+    // Stop keeping frames for queries and drop the kept ones; the next query enables them again
+    void HL2ResearchMode::DisableDepthQueries()
+    {
+        m_useDepthQueries = false;
+        std::lock_guard<std::mutex> l(mu);
+        for (auto& pFrame : m_depthQueryHistory)
+        {
+            pFrame.reset();
+        }
+    }
+
+    // Depth frame from the query history closest in time to hostTicks, the latest one for 0
+    std::shared_ptr<const DepthQueryFrame> HL2ResearchMode::DepthQueryFrameAt(uint64_t hostTicks)
+    {
+        // the depth loop keeps frames from now on
+        m_useDepthQueries = true;
+        auto distance = [hostTicks](const DepthQueryFrame& frame) {
+            return frame.hostTicks > hostTicks ? frame.hostTicks - hostTicks : hostTicks - frame.hostTicks;
+        };
+        std::lock_guard<std::mutex> l(mu);
+        std::shared_ptr<const DepthQueryFrame> pFrame = m_depthQueryHistory[0];
+        for (const auto& pCandidate : m_depthQueryHistory)
+        {
+            if (hostTicks != 0 && pCandidate && pFrame && distance(*pCandidate) < distance(*pFrame))
+            {
+                pFrame = pCandidate;
+            }
+        }
+        return pFrame && pFrame->pGeometry ? pFrame : nullptr;
+    }
+
+    // Sample the AHAT depth at a batch of image points (u, v pairs in pixels, sub-pixel positions are interpolated),
+    // in the latest frame or for hostTicks != 0 the recent frame closest in time. Returns 5 floats per point: status
+    // (0 = invalid, 1 = bilinear, 2 = nearest pixel at a depth edge), depth along the pixel ray (m), world point x, y, z
+    // in the coordinates of GetPointCloudBuffer.
+    com_array<float> HL2ResearchMode::QueryDepthPixels(array_view<float const> pixels, uint64_t hostTicks)
+    {
+        ScopedStageTimer fetchTimer(m_depthStats, PipelineStage::Fetch);
+        size_t count = pixels.size() / 2;
+        com_array<float> results(count * kDepthQueryResultSize, 0.0f);
+        auto pFrame = DepthQueryFrameAt(hostTicks);
+        if (pFrame)
+        {
+            SampleDepthPixels(*pFrame, pixels.data(), count, results.data());
+        }
+        return results;
+    }
+
+    // Intersect a batch of world rays (origin x, y, z, direction x, y, z, in the coordinates of GetPointCloudBuffer) with
+    // the AHAT depth up to maxDistance (m) from their origin. Frame selection as QueryDepthPixels. Returns 5 floats per ray:
+    // status (0 = no hit, 1 = hit, 2 = hit at a depth edge, 3 = the ray disappears behind a foreground edge), distance
+    // to the hit (m), hit point x, y, z.
+    com_array<float> HL2ResearchMode::QueryDepthRays(array_view<float const> rays, float maxDistance, uint64_t hostTicks)
+    {
+        ScopedStageTimer fetchTimer(m_depthStats, PipelineStage::Fetch);
+        size_t count = rays.size() / 6;
+        com_array<float> results(count * kDepthQueryResultSize, 0.0f);
+        auto pFrame = DepthQueryFrameAt(hostTicks);
+        if (pFrame)
+        {
+            CastDepthRays(*pFrame, rays.data(), count, maxDistance, results.data());
+        }
+        return results;
+    }
+
     // Get the 3D point (float[3]) of center point in depth map. Can be used to render depth cursor.
     com_array<float> HL2ResearchMode::GetCenterPoint()
     {
@@ -856,6 +2161,540 @@ namespace winrt::HL2UnityPlugin::implementation
         m_depthOffset = offset;
     }
 
+    // Get the per-stage timings (mean/p50/p95/p99/max over the recent frames) and frame counters of all streams.
+    hstring HL2ResearchMode::GetPipelineStats()
+    {
+        std::string msg = m_depthStats.ToString() + m_longDepthStats.ToString() + m_spatialCamerasFrontStats.ToString();
+        return winrt::to_hstring(msg);
+    }
+
+    // Print the pipeline stats of each stream to debug output every intervalMs. 0 disables the periodic dump.
+    void HL2ResearchMode::SetPipelineStatsDumpInterval(int32_t intervalMs)
+    {
+        m_statsDumpIntervalMs = intervalMs;
+    }
+
+    void HL2ResearchMode::DumpPipelineStatsIfDue(StreamStats& stats)
+    {
+        std::string msg;
+        if (stats.DumpIfDue(m_statsDumpIntervalMs, msg))
+        {
+            std::wstring widemsg = std::wstring(msg.begin(), msg.end());
+            OutputDebugString(widemsg.c_str());
+        }
+    }
+
+    // Benchmark the processing kernels on synthetic frames, and on the latest AHAT frame if the depth loop has produced one.
+    // Returns the results as JSON. Runs on the calling thread, so do not call it from the Unity main thread during interaction.
+    hstring HL2ResearchMode::RunProcessingBenchmark(int32_t frameCount)
+    {
+        std::vector<UINT16> depthMap, abImage;
+        RecordedAhatFrame recordedFrame;
+        {
+            std::lock_guard<std::mutex> l(mu);
+            size_t pixelCount = m_depthResolution.Width * m_depthResolution.Height;
+            if (m_depthMap && m_shortAbImage && m_depthUnitRays.size() == pixelCount && m_depthBufferSize == pixelCount)
+            {
+                depthMap.assign(m_depthMap, m_depthMap + pixelCount);
+                abImage.assign(m_shortAbImage, m_shortAbImage + pixelCount);
+                recordedFrame.pDepth = depthMap.data();
+                recordedFrame.pAbImage = abImage.data();
+                recordedFrame.pUnitRays = m_depthUnitRays.data();
+                recordedFrame.width = m_depthResolution.Width;
+                recordedFrame.height = m_depthResolution.Height;
+            }
+        }
+        return winrt::to_hstring(BenchmarkProcessingKernels(frameCount, &recordedFrame, LocalFolderPath().wstring()));
+    }
+
+    // Smooth the AHAT depth over time with an exponential moving average. alpha is the weight of the new frame,
+    // pixels with AbImage intensity below minAbValue keep their previous average. Affects the depth map, textures and point cloud.
+    void HL2ResearchMode::EnableTemporalDepthFilter(float alpha, uint16_t minAbValue)
+    {
+        {
+            std::lock_guard<std::mutex> l(mu);
+            m_temporalDepthFilterSettings.alpha = (std::min)((std::max)(alpha, 0.0f), 1.0f);
+            m_temporalDepthFilterSettings.minAbValue = minAbValue;
+        }
+        m_temporalDepthFilterResetRequested = true;
+        m_useTemporalDepthFilter = true;
+    }
+
+    void HL2ResearchMode::DisableTemporalDepthFilter()
+    {
+        m_useTemporalDepthFilter = false;
+    }
+
+    // Drop point cloud pixels whose depth is inconsistent with their 3x3 neighborhood (flying pixels at depth edges and
+    // isolated outliers). Neighbors within max(10mm, relativeThreshold * depth) count as consistent; at least 4 of 8 are required.
+    // Pixels with AbImage intensity below minAbValue are dropped as well.
+    void HL2ResearchMode::EnableFlyingPixelFilter(float relativeThreshold, uint16_t minAbValue)
+    {
+        {
+            std::lock_guard<std::mutex> l(mu);
+            m_flyingPixelFilterSettings.thresholdRelative = relativeThreshold;
+            m_flyingPixelFilterSettings.minAbValue = minAbValue;
+        }
+        m_useFlyingPixelFilter = true;
+    }
+
+    void HL2ResearchMode::DisableFlyingPixelFilter()
+    {
+        m_useFlyingPixelFilter = false;
+    }
+
+    // Detect up to maxPlanes planes (tables, floors, walls) in the AHAT Roi every frame. Samples within distanceThreshold (m)
+    // of a plane and with a similar normal are its inliers. Planes are tracked across frames and keep their id.
+    void HL2ResearchMode::EnablePlaneDetection(int32_t maxPlanes, float distanceThreshold)
+    {
+        {
+            std::lock_guard<std::mutex> l(mu);
+            m_planeDetectionSettings.maxPlanes = (std::max)(maxPlanes, 1);
+            m_planeDetectionSettings.distanceThreshold = (std::max)(distanceThreshold, 0.001f);
+        }
+        m_planeDetectionResetRequested = true;
+        m_usePlaneDetection = true;
+    }
+
+    void HL2ResearchMode::DisablePlaneDetection()
+    {
+        m_usePlaneDetection = false;
+        std::lock_guard<std::mutex> l(mu);
+        m_planes.clear();
+    }
+
+    // Get the planes of the latest frame, 11 floats per plane in the coordinates of GetPointCloudBuffer:
+    // id, normal (x, y, z), offset (dot(normal, p) = offset), center (x, y, z), extent (2, Unit: m), inlier sample count
+    com_array<float> HL2ResearchMode::GetPlanes()
+    {
+        ScopedStageTimer fetchTimer(m_depthStats, PipelineStage::Fetch);
+        std::lock_guard<std::mutex> l(mu);
+        return com_array<float>(m_planes.begin(), m_planes.end());
+    }
+
+    // Segment the AHAT depth within the clip range (and the Roi if the Roi filter is on) into connected blobs: grid
+    // neighbors closer than maxDepthJump (mm) in depth are connected, blobs smaller than minPixels are dropped
+    void HL2ResearchMode::EnableBlobSegmentation(int32_t minPixels, uint16_t maxDepthJump)
+    {
+        {
+            std::lock_guard<std::mutex> l(mu);
+            m_blobSegmentationSettings.minPixels = (UINT)(std::max)(minPixels, 1);
+            m_blobSegmentationSettings.maxDepthJump = (std::max)(maxDepthJump, (uint16_t)1);
+        }
+        m_useBlobSegmentation = true;
+    }
+
+    void HL2ResearchMode::DisableBlobSegmentation()
+    {
+        m_useBlobSegmentation = false;
+        std::lock_guard<std::mutex> l(mu);
+        m_blobs.clear();
+    }
+
+    // Get the blobs of the latest frame, largest first, 9 floats per blob: pixel count, centroid (x, y, z in the
+    // coordinates of GetPointCloudBuffer), image bounding box (column min, row min, column max, row max), mean depth (Unit: m)
+    com_array<float> HL2ResearchMode::GetBlobs()
+    {
+        ScopedStageTimer fetchTimer(m_depthStats, PipelineStage::Fetch);
+        std::lock_guard<std::mutex> l(mu);
+        return com_array<float>(m_blobs.begin(), m_blobs.end());
+    }
+
+    // Accumulate the AHAT point clouds into a persistent map with one point per voxel of voxelSize (m), merging repeated
+    // observations into running averages. At most maxPoints points are kept (least recently observed are evicted first);
+    // points farther than maxDistance (m) from the sensor or not observed for maxAgeFrames frames are evicted, 0 = no limit.
+    void HL2ResearchMode::EnableWorldPointMap(float voxelSize, int32_t maxPoints, float maxDistance, int32_t maxAgeFrames)
+    {
+        WorldPointMapSettings settings;
+        settings.voxelSize = voxelSize;
+        settings.maxPoints = (size_t)(std::max)(maxPoints, 1);
+        settings.maxDistance = (std::max)(maxDistance, 0.0f);
+        settings.maxAge = (UINT64)(std::max)(maxAgeFrames, 0);
+        m_worldPointMap.Configure(settings);
+        m_useWorldPointMap = true;
+    }
+
+    // Stop accumulating, the map is kept
+    void HL2ResearchMode::DisableWorldPointMap()
+    {
+        m_useWorldPointMap = false;
+    }
+
+    void HL2ResearchMode::ClearWorldPointMap()
+    {
+        m_worldPointMap.Clear();
+    }
+
+    // Maintain a probabilistic occupancy map of voxelSize (m) voxels from the AHAT point clouds and the long-throw depth:
+    // voxels of points become occupied, voxels between the sensor and the points free (up to maxRange, m). Memory is
+    // bounded to maxBlocks blocks of 8^3 voxels, the least recently updated are evicted first.
+    void HL2ResearchMode::EnableOccupancyMap(float voxelSize, int32_t maxBlocks, float maxRange)
+    {
+        OccupancyMapSettings settings;
+        settings.voxelSize = voxelSize;
+        settings.maxBlocks = (size_t)(std::max)(maxBlocks, 1);
+        settings.maxRange = maxRange;
+        m_occupancyMap.Configure(settings);
+        m_useOccupancyMap = true;
+    }
+
+    void HL2ResearchMode::DisableOccupancyMap()
+    {
+        m_useOccupancyMap = false;
+    }
+
+    void HL2ResearchMode::ClearOccupancyMap()
+    {
+        m_occupancyMap.Clear();
+    }
+
+    // Occupancy of a batch of points (x, y, z in the coordinates of GetPointCloudBuffer), one float per point:
+    // occupancy probability of its voxel (occupied above 0.5), -1 if it was never observed
+    com_array<float> HL2ResearchMode::QueryOccupancyPoints(array_view<float const> points)
+    {
+        size_t count = points.size() / 3;
+        com_array<float> results(count, 0.0f);
+        m_occupancyMap.QueryPoints(points.data(), count, results.data());
+        return results;
+    }
+
+    // Occupancy of a batch of axis aligned boxes (min x, y, z, max x, y, z), one float per box: 1 if any voxel in the
+    // box is occupied, 0 if the whole box is observed free, -1 if it is not occupied but partly unobserved
+    com_array<float> HL2ResearchMode::QueryOccupancyBoxes(array_view<float const> boxes)
+    {
+        size_t count = boxes.size() / 6;
+        com_array<float> results(count, 0.0f);
+        m_occupancyMap.QueryBoxes(boxes.data(), count, results.data());
+        return results;
+    }
+
+    // Clearance along a batch of rays (origin x, y, z, direction x, y, z) up to maxDistance (m), 2 floats per ray: distance
+    // to the first occupied voxel (maxDistance if none), status (1 = hit, 0 = free, -1 = passes unobserved voxels)
+    com_array<float> HL2ResearchMode::QueryOccupancyRays(array_view<float const> rays, float maxDistance)
+    {
+        size_t count = rays.size() / 6;
+        com_array<float> results(count * OccupancyMap::kRayResultSize, 0.0f);
+        m_occupancyMap.QueryRays(rays.data(), count, maxDistance, results.data());
+        return results;
+    }
+
+    // {"enabled":...,"blocks":...,"max_blocks":...,"voxel_size":...,"memory_kb":...,"frames":...,"evicted_blocks":...,
+    //  "hits":...,"misses":...,"integrate_us":{...}}
+    hstring HL2ResearchMode::GetOccupancyMapStatus()
+    {
+        std::string status = m_occupancyMap.StatusJson();
+        return winrt::to_hstring(std::string("{\"enabled\":") + (m_useOccupancyMap ? "true," : "false,") + status.substr(1));
+    }
+
+    // Get the world point map changes since sinceSequence (0 for all points), 4 floats per point in the coordinates of
+    // GetPointCloudBuffer: x, y, z, observation count. Evicted points come first with count 0. Pass the returned sequence
+    // to the next call; if fullResync is set, the result is the whole map and earlier points should be discarded.
+    com_array<float> HL2ResearchMode::GetWorldPointMapChanges(uint64_t sinceSequence, uint64_t& sequence, bool& fullResync)
+    {
+        std::vector<float> changes;
+        sequence = m_worldPointMap.ChangedSince(sinceSequence, changes, fullResync);
+        return com_array<float>(changes.begin(), changes.end());
+    }
+
+    std::filesystem::path HL2ResearchMode::LocalFolderPath()
+    {
+        return std::filesystem::path(Windows::Storage::ApplicationData::Current().LocalFolder().Path().c_str());
+    }
+
+    // Write every frameInterval-th AHAT point cloud on a background thread, as one binary file per frame (format 0 = PLY,
+    // 1 = PCD) or appended to a single stream file (2, layout in PointCloudExporter.h). x, y, z as in GetPointCloudBuffer,
+    // plus intensity while SetPointCloudIntensityEnabled is on. A relative directory is inside the app's LocalFolder.
+    // frameInterval 0 only writes ExportWorldPointMap snapshots. Frames are dropped rather than delaying the sensor loop.
+    void HL2ResearchMode::StartPointCloudExport(hstring const& directory, int32_t format, int32_t frameInterval)
+    {
+        std::filesystem::path path(directory.c_str());
+        if (path.is_relative())
+        {
+            path = LocalFolderPath() / path;
+        }
+        auto fileFormat = (format >= (int32_t)PointCloudFileFormat::Ply && format <= (int32_t)PointCloudFileFormat::Stream) ?
+            (PointCloudFileFormat)format : PointCloudFileFormat::Ply;
+        m_pointCloudExportInterval = 0;
+        m_pointCloudExporter.Start(path, fileFormat, 8);
+        m_pointCloudExportInterval = (std::max)(frameInterval, 0);
+    }
+
+    // Stop exporting after the queued frames are written
+    void HL2ResearchMode::StopPointCloudExport()
+    {
+        m_pointCloudExportInterval = 0;
+        m_pointCloudExporter.Stop();
+    }
+
+    // Queue the whole world point map for export (x, y, z, observation count). Returns false if it was dropped.
+    bool HL2ResearchMode::ExportWorldPointMap()
+    {
+        ExportFrame exportFrame;
+        exportFrame.frameIndex = m_worldPointMap.Snapshot(exportFrame.points);
+        exportFrame.name = "worldpointmap_" + std::to_string(exportFrame.frameIndex);
+        exportFrame.fieldCount = (UINT)WorldPointMap::kPackedPointSize;
+        exportFrame.attributeName = "count";
+        return m_pointCloudExporter.Submit(std::move(exportFrame));
+    }
+
+    // {"running":...,"format":...,"queued":...,"written":...,"dropped":...,"errors":...,"bytes":...}
+    hstring HL2ResearchMode::GetPointCloudExportStatus()
+    {
+        return winrt::to_hstring(m_pointCloudExporter.StatusJson());
+    }
+
+    // Adapt the AHAT processing to the load: skip frames while the last published one has not been fetched (unless
+    // skipUnconsumedFrames is off, frame views are subscribed, or the world point map or per-frame export is on), and
+    // reduce the point cloud to every 2nd or 4th pixel and then to none (textures only) while processing takes more than
+    // loadBudget of the frame interval. Full processing resumes when the headroom returns.
+    void HL2ResearchMode::EnableProcessingGovernor(float loadBudget, bool skipUnconsumedFrames)
+    {
+        GovernorSettings settings;
+        settings.loadBudget = (std::min)((std::max)(loadBudget, 0.1f), 1.0f);
+        settings.recoverLoad = settings.loadBudget / 2;
+        settings.skipUnconsumedFrames = skipUnconsumedFrames;
+        m_governor.Configure(settings);
+        m_useGovernor = true;
+    }
+
+    void HL2ResearchMode::DisableProcessingGovernor()
+    {
+        m_useGovernor = false;
+    }
+
+    // {"level":...,"load":...,"frame_interval_us":...,"consumer_fps":...,"processed":...,"skipped":...,"degrades":...,"recoveries":...}
+    hstring HL2ResearchMode::GetProcessingGovernorStatus()
+    {
+        return winrt::to_hstring(m_governor.StatusJson());
+    }
+
+    // Drive the governor with a synthetic load over four phases of framesPerPhase AHAT frames each, see SimulateGovernorLoad
+    hstring HL2ResearchMode::RunGovernorSimulation(int32_t framesPerPhase)
+    {
+        return winrt::to_hstring(SimulateGovernorLoad(GovernorSettings(), framesPerPhase));
+    }
+
+    // Publish the raw frames of all running sensor loops into shared memory rings of slotCount frames, one memory mapped
+    // file per stream in directory (a relative directory is inside the app's LocalFolder): hl2_depth.ring (depth and
+    // AbImage), hl2_long_depth.ring (depth and sigma), hl2_left_front.ring and hl2_right_front.ring, each frame with its
+    // timestamp and camera to world pose. Layout in SharedFrameRing.h, reader in python/shared_ring_reader.py.
+    void HL2ResearchMode::StartSharedMemoryTransport(hstring const& directory, int32_t slotCount)
+    {
+        std::filesystem::path path(directory.c_str());
+        if (path.is_relative())
+        {
+            path = LocalFolderPath() / path;
+        }
+        std::error_code error;
+        std::filesystem::create_directories(path, error);
+        {
+            std::lock_guard<std::mutex> l(mu);
+            m_sharedRingDirectory = path;
+            m_sharedRingSlotCount = (UINT32)(std::min)((std::max)(slotCount, 2), 64);
+        }
+        m_useSharedRings = true;
+        m_sharedRingGeneration++;
+    }
+
+    // The loops close their rings with their next frame; the files are left for attached readers
+    void HL2ResearchMode::StopSharedMemoryTransport()
+    {
+        m_useSharedRings = false;
+        m_sharedRingGeneration++;
+    }
+
+    // {"enabled":...,"directory":...,"slots":...,"streams":[{"file":...,"published":...,"oversized":...}, ...]}
+    hstring HL2ResearchMode::GetSharedMemoryTransportStatus()
+    {
+        std::stringstream ss;
+        {
+            std::lock_guard<std::mutex> l(mu);
+            ss << "{\"enabled\":" << (m_useSharedRings ? "true" : "false")
+                << ",\"directory\":\"" << m_sharedRingDirectory.generic_string() << "\""
+                << ",\"slots\":" << m_sharedRingSlotCount;
+        }
+        ss << ",\"streams\":[";
+        for (UINT32 k = 0; k < kSharedRingStreamCount; k++)
+        {
+            ss << (k ? "," : "") << "{\"file\":\"" << kSharedRingFileNames[k] << "\""
+                << ",\"published\":" << m_sharedRings[k].Published()
+                << ",\"oversized\":" << m_sharedRings[k].Oversized() << "}";
+        }
+        ss << "]}";
+        return winrt::to_hstring(ss.str());
+    }
+
+    // Refine the AHAT camera pose of every frame by point-to-plane ICP against the previous frame (reference 0) or a fused
+    // model of the previous frames (reference 1), starting from the head tracking pose. Point clouds, planes, queries and
+    // frame views then use the refined pose.
+    void HL2ResearchMode::EnableDepthRegistration(int32_t reference, int32_t iterations)
+    {
+        {
+            std::lock_guard<std::mutex> l(mu);
+            m_depthRegistrationSettings.reference = reference == (int32_t)RegistrationReference::PreviousFrame ?
+                RegistrationReference::PreviousFrame : RegistrationReference::Model;
+            m_depthRegistrationSettings.iterations = (std::max)(iterations, 1);
+        }
+        m_depthRegistrationResetRequested = true;
+        m_useDepthRegistration = true;
+    }
+
+    void HL2ResearchMode::DisableDepthRegistration()
+    {
+        m_useDepthRegistration = false;
+    }
+
+    // {"enabled":...,"frames":...,"accepted":...,"rejected":...,"correspondences":...,"iterations":...,"rmse_mm":...,
+    //  "correction_mm":...,"correction_deg":...,"register_us":{...}}
+    hstring HL2ResearchMode::GetDepthRegistrationStatus()
+    {
+        std::string status = m_depthRegistration.StatusJson();
+        return winrt::to_hstring(std::string("{\"enabled\":") + (m_useDepthRegistration ? "true," : "false,") + status.substr(1));
+    }
+
+    // Get the pose of the latest AHAT frame (refined if registration is enabled), 16 floats row-major in the coordinates of
+    // GetPointCloudBuffer: p = p_camera * pose with p_camera a camera space point (Unit: m) as a row vector
+    com_array<float> HL2ResearchMode::GetDepthCameraPose()
+    {
+        std::lock_guard<std::mutex> l(mu);
+        return com_array<float>(&m_depthFramePose.m[0][0], &m_depthFramePose.m[0][0] + 16);
+    }
+
+    // Skip the processing of AHAT frames without significant change since the last processed frame: no depth sample of
+    // a tile moved by more than depthThreshold (mm, or 2% of the depth) beyond a few percent of the tile, and the camera
+    // moved less than maxTranslation (m). Skipped frames leave all outputs and updated flags as they are and arrive
+    // with their own frame index and Unchanged set; depth queries, the world point map and the point cloud export still
+    // follow them. At least every maxUnchangedFrames-th frame is processed.
+    void HL2ResearchMode::EnableChangeDetection(uint16_t depthThreshold, float maxTranslation, int32_t maxUnchangedFrames)
+    {
+        {
+            std::lock_guard<std::mutex> l(mu);
+            m_changeDetectionSettings.depthThreshold = depthThreshold;
+            m_changeDetectionSettings.maxTranslation = (std::max)(maxTranslation, 0.0f);
+            m_changeDetectionSettings.maxUnchangedFrames = (UINT)(std::max)(maxUnchangedFrames, 1);
+        }
+        m_changeDetectionResetRequested = true;
+        m_useChangeDetection = true;
+    }
+
+    void HL2ResearchMode::DisableChangeDetection()
+    {
+        m_useChangeDetection = false;
+    }
+
+    // {"enabled":...,"frames":...,"unchanged":...,"changed_tiles":...,"tiles":...,"compare_us":{...}}
+    hstring HL2ResearchMode::GetDepthChangeStatus()
+    {
+        std::string status = m_changeDetector.StatusJson();
+        return winrt::to_hstring(std::string("{\"enabled\":") + (m_useChangeDetection ? "true," : "false,") + status.substr(1));
+    }
+
+    // Changed tiles (32 x 32 pixels) of the latest AHAT frame against the last processed frame, tilesY rows of tilesX
+    // tiles, 1 = changed. Consumers can limit texture uploads to the changed tiles.
+    com_array<uint8_t> HL2ResearchMode::GetDepthChangedTiles(int32_t& tilesX, int32_t& tilesY)
+    {
+        std::vector<UINT8> mask;
+        UINT x = 0, y = 0;
+        m_changeDetector.ChangedTiles(mask, x, y);
+        tilesX = (int32_t)x;
+        tilesY = (int32_t)y;
+        return com_array<uint8_t>(mask.begin(), mask.end());
+    }
+
+    // Detect FAST corners on an image pyramid of levels levels (each half the size of the previous) of the LF and RF
+    // images, threshold being the intensity difference of the corner test. The image is split into a grid of 32 x 32
+    // pixel cells, each keeping its 2 strongest corners per level, and at most maxKeypoints keypoints are kept per image.
+    void HL2ResearchMode::EnableVlcFeatureExtraction(int32_t levels, int32_t threshold, int32_t maxKeypoints)
+    {
+        std::lock_guard<std::mutex> l(mu);
+        m_featureExtractionSettings.levels = (UINT)(std::min)((std::max)(levels, 1), 5);
+        m_featureExtractionSettings.threshold = (UINT8)(std::min)((std::max)(threshold, 1), 255);
+        m_featureExtractionSettings.maxKeypoints = (UINT)(std::max)(maxKeypoints, 1);
+        m_useFeatureExtraction = true;
+    }
+
+    // Stop extracting, the keypoints of the last frame are kept
+    void HL2ResearchMode::DisableVlcFeatureExtraction()
+    {
+        m_useFeatureExtraction = false;
+    }
+
+    // Get the keypoints of the latest LF image, strongest first, 4 floats each: x, y (full image pixels), score,
+    // pyramid level
+    com_array<float> HL2ResearchMode::GetLFKeypoints()
+    {
+        ScopedStageTimer fetchTimer(m_spatialCamerasFrontStats, PipelineStage::Fetch);
+        std::lock_guard<std::mutex> l(mu);
+        return com_array<float>(m_LFKeypoints.begin(), m_LFKeypoints.end());
+    }
+
+    // Get the keypoints of the latest RF image, as GetLFKeypoints
+    com_array<float> HL2ResearchMode::GetRFKeypoints()
+    {
+        ScopedStageTimer fetchTimer(m_spatialCamerasFrontStats, PipelineStage::Fetch);
+        std::lock_guard<std::mutex> l(mu);
+        return com_array<float>(m_RFKeypoints.begin(), m_RFKeypoints.end());
+    }
+
+    // Stretch the 8-bit AHAT depth, AbImage and long-throw depth textures over the range of the values seen instead of
+    // the fixed 0-1000 / 0-4000 ranges: values below the lowPercentile and above the highPercentile of the recent frames
+    // become 0 and 255, with the range averaged over frames by smoothing (weight of the newest frame, 0-1). Each range
+    // is taken from the previous frames and applies from the second frame on. Colormap textures keep their ranges.
+    void HL2ResearchMode::EnableTextureNormalization(float lowPercentile, float highPercentile, float smoothing)
+    {
+        {
+            std::lock_guard<std::mutex> l(mu);
+            m_textureNormalizationSettings.lowPercentile = (std::min)((std::max)(lowPercentile, 0.0f), 1.0f);
+            m_textureNormalizationSettings.highPercentile = (std::min)((std::max)(highPercentile, m_textureNormalizationSettings.lowPercentile), 1.0f);
+            m_textureNormalizationSettings.smoothing = (std::min)((std::max)(smoothing, 0.01f), 1.0f);
+        }
+        m_depthNormalizationResetRequested = true;
+        m_longDepthNormalizationResetRequested = true;
+        m_useTextureNormalization = true;
+    }
+
+    void HL2ResearchMode::DisableTextureNormalization()
+    {
+        m_useTextureNormalization = false;
+    }
+
+    // {"enabled":...,"depth":{"min":...,"max":...,"frames":...,"update_us":{...}},"ab":{...},"long_depth":{...}}
+    hstring HL2ResearchMode::GetTextureNormalizationStatus()
+    {
+        return winrt::to_hstring(std::string("{\"enabled\":") + (m_useTextureNormalization ? "true" : "false") +
+            ",\"depth\":" + m_depthNormalizer.StatusJson() +
+            ",\"ab\":" + m_abNormalizer.StatusJson() +
+            ",\"long_depth\":" + m_longDepthNormalizer.StatusJson() + "}");
+    }
+
+    // Timing of the sensor setup in ms, -1 until measured: {"device_open_ms":...,"depth":{"initialized":...,"running":...,
+    //  "starts":...,"init_ms":...,"start_ms":...,"first_frame_ms":...,"stop_ms":...},"long_depth":{...},"spatial_cameras_front":{...}}
+    // init_ms is the sensor acquisition, start_ms and first_frame_ms run from the last Start call to the stream open and
+    // the first frame, stop_ms from the last Stop call to the loop thread joined.
+    hstring HL2ResearchMode::GetSensorLifecycleStatus()
+    {
+        const bool initialized[3] = { m_sensorInit.Ready(0), m_sensorInit.Ready(1), m_sensorInit.Ready(2) };
+        const bool running[3] = { m_depthSensorLoopStarted, m_longDepthSensorLoopStarted, m_spatialCamerasFrontLoopStarted };
+        const char* names[3] = { "depth", "long_depth", "spatial_cameras_front" };
+
+        std::lock_guard<std::mutex> l(mu);
+        std::stringstream ss;
+        ss << "{\"device_open_ms\":" << m_deviceOpenMs;
+        for (int i = 0; i < 3; i++)
+        {
+            const auto& lifecycle = m_sensorLifecycle[i];
+            ss << ",\"" << names[i] << "\":{\"initialized\":" << (initialized[i] ? "true" : "false")
+                << ",\"running\":" << (running[i] ? "true" : "false")
+                << ",\"starts\":" << lifecycle.starts
+                << ",\"init_ms\":" << lifecycle.initMs
+                << ",\"start_ms\":" << lifecycle.startMs
+                << ",\"first_frame_ms\":" << lifecycle.firstFrameMs
+                << ",\"stop_ms\":" << lifecycle.stopMs << "}";
+        }
+        ss << "}";
+        return winrt::to_hstring(ss.str());
+    }
+
     long long HL2ResearchMode::checkAndConvertUnsigned(UINT64 val)
     {
         assert(val <= kMaxLongLong);
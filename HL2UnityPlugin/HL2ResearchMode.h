@@ -1,6 +1,26 @@
 #pragma once
 #include "HL2ResearchMode.g.h"
 #include "ResearchModeApi.h"
+#include "PipelineStats.h"
+#include "SensorKernels.h"
+#include "ProcessingBenchmark.h"
+#include "TemporalDepthFilter.h"
+#include "VlcReprojection.h"
+#include "FrameNotification.h"
+#include "FrameView.h"
+#include "PlaneDetection.h"
+#include "BlobSegmentation.h"
+#include "WorldPointMap.h"
+#include "OccupancyMap.h"
+#include "PointCloudExporter.h"
+#include "ProcessingGovernor.h"
+#include "DepthQuery.h"
+#include "SharedFrameRing.h"
+#include "DepthRegistration.h"
+#include "ChangeDetection.h"
+#include "TextureNormalization.h"
+#include "VlcFeatures.h"
+#include "SensorInit.h"
 #include <stdio.h>
 #include <iostream>
 #include <sstream>
@@ -9,17 +29,23 @@
 #include <mutex>
 #include <atomic>
 #include <future>
+#include <condition_variable>
 #include <cmath>
+#include <cfloat>
+#include <algorithm>
 #include <DirectXMath.h>
 #include <vector>
+#include <memory>
 #include<winrt/Windows.Perception.Spatial.h>
 #include<winrt/Windows.Perception.Spatial.Preview.h>
+#include<winrt/Windows.Storage.h>
 
 namespace winrt::HL2UnityPlugin::implementation
 {
     struct HL2ResearchMode : HL2ResearchModeT<HL2ResearchMode>
     {
         HL2ResearchMode();
+        ~HL2ResearchMode();
 
         UINT16 GetCenterDepth();
         int GetDepthBufferSize();
@@ -34,12 +60,18 @@ namespace winrt::HL2UnityPlugin::implementation
         void InitializeDepthSensor();
         void InitializeLongDepthSensor();
         void InitializeSpatialCamerasFront();
+        void InitializeSensors(bool depth, bool longDepth, bool spatialCamerasFront);
+        bool SensorsInitialized();
 
         void StartDepthSensorLoop();
         void StartLongDepthSensorLoop();
         void StartSpatialCamerasFrontLoop();
+        void StopDepthSensorLoop();
+        void StopLongDepthSensorLoop();
+        void StopSpatialCamerasFrontLoop();
 
         void StopAllSensorDevice();
+        hstring GetSensorLifecycleStatus();
 
         bool DepthMapTextureUpdated();
         bool ShortAbImageTextureUpdated();
@@ -48,9 +80,75 @@ namespace winrt::HL2UnityPlugin::implementation
 		bool LFImageUpdated();
 		bool RFImageUpdated();
 
+        using FrameArrivedHandler = Windows::Foundation::TypedEventHandler<HL2UnityPlugin::HL2ResearchMode, HL2UnityPlugin::FrameArrivedEventArgs>;
+        winrt::event_token DepthFrameArrived(FrameArrivedHandler const& handler);
+        void DepthFrameArrived(winrt::event_token const& token) noexcept;
+        winrt::event_token LongDepthFrameArrived(FrameArrivedHandler const& handler);
+        void LongDepthFrameArrived(winrt::event_token const& token) noexcept;
+        winrt::event_token SpatialCamerasFrontFrameArrived(FrameArrivedHandler const& handler);
+        void SpatialCamerasFrontFrameArrived(winrt::event_token const& token) noexcept;
+
+        // Native consumers in the same process (reach this object with winrt::get_self<implementation::HL2ResearchMode>):
+        // the callback runs on the sensor thread of the stream right after each frame is published, for every subscriber
+        // independently. Returns the token for UnsubscribeFrameArrived.
+        UINT64 SubscribeFrameArrived(HL2UnityPlugin::SensorStream stream, FrameCallback callback);
+        void UnsubscribeFrameArrived(HL2UnityPlugin::SensorStream stream, UINT64 token);
+
+        // Native consumers in the same process: the callback receives a reference counted, read-only view of each
+        // published frame without copies. The view may be kept after the callback returns, but holds the sensor frame.
+        UINT64 SubscribeFrameViews(HL2UnityPlugin::SensorStream stream, FrameViewCallback callback);
+        void UnsubscribeFrameViews(HL2UnityPlugin::SensorStream stream, UINT64 token);
+
         void SetReferenceCoordinateSystem(Windows::Perception::Spatial::SpatialCoordinateSystem refCoord);
         void SetPointCloudRoiInSpace(float centerX, float centerY, float centerZ, float boundX, float boundY, float boundZ);
         void SetPointCloudDepthOffset(uint16_t offset);
+        void EnableTemporalDepthFilter(float alpha, uint16_t minAbValue);
+        void DisableTemporalDepthFilter();
+        void EnableFlyingPixelFilter(float relativeThreshold, uint16_t minAbValue);
+        void DisableFlyingPixelFilter();
+        void EnablePlaneDetection(int32_t maxPlanes, float distanceThreshold);
+        void DisablePlaneDetection();
+        com_array<float> GetPlanes();
+        void EnableBlobSegmentation(int32_t minPixels, uint16_t maxDepthJump);
+        void DisableBlobSegmentation();
+        com_array<float> GetBlobs();
+        void EnableWorldPointMap(float voxelSize, int32_t maxPoints, float maxDistance, int32_t maxAgeFrames);
+        void DisableWorldPointMap();
+        void ClearWorldPointMap();
+        void EnableOccupancyMap(float voxelSize, int32_t maxBlocks, float maxRange);
+        void DisableOccupancyMap();
+        void ClearOccupancyMap();
+        com_array<float> QueryOccupancyPoints(array_view<float const> points);
+        com_array<float> QueryOccupancyBoxes(array_view<float const> boxes);
+        com_array<float> QueryOccupancyRays(array_view<float const> rays, float maxDistance);
+        hstring GetOccupancyMapStatus();
+        com_array<float> GetWorldPointMapChanges(uint64_t sinceSequence, uint64_t& sequence, bool& fullResync);
+        void StartPointCloudExport(hstring const& directory, int32_t format, int32_t frameInterval);
+        void StopPointCloudExport();
+        bool ExportWorldPointMap();
+        hstring GetPointCloudExportStatus();
+        void EnableProcessingGovernor(float loadBudget, bool skipUnconsumedFrames);
+        void DisableProcessingGovernor();
+        hstring GetProcessingGovernorStatus();
+        hstring RunGovernorSimulation(int32_t framesPerPhase);
+        void StartSharedMemoryTransport(hstring const& directory, int32_t slotCount);
+        void StopSharedMemoryTransport();
+        hstring GetSharedMemoryTransportStatus();
+        void EnableDepthRegistration(int32_t reference, int32_t iterations);
+        void DisableDepthRegistration();
+        hstring GetDepthRegistrationStatus();
+        com_array<float> GetDepthCameraPose();
+        void EnableChangeDetection(uint16_t depthThreshold, float maxTranslation, int32_t maxUnchangedFrames);
+        void DisableChangeDetection();
+        hstring GetDepthChangeStatus();
+        com_array<uint8_t> GetDepthChangedTiles(int32_t& tilesX, int32_t& tilesY);
+        void EnableVlcFeatureExtraction(int32_t levels, int32_t threshold, int32_t maxKeypoints);
+        void DisableVlcFeatureExtraction();
+        com_array<float> GetLFKeypoints();
+        com_array<float> GetRFKeypoints();
+        void EnableTextureNormalization(float lowPercentile, float highPercentile, float smoothing);
+        void DisableTextureNormalization();
+        hstring GetTextureNormalizationStatus();
         com_array<uint16_t> GetDepthMapBuffer();
         com_array<uint8_t> GetDepthMapTextureBuffer();
         com_array<uint16_t> GetShortAbImageBuffer();
@@ -60,8 +158,30 @@ namespace winrt::HL2UnityPlugin::implementation
 		com_array<uint8_t> GetLFCameraBuffer();
 		com_array<uint8_t> GetRFCameraBuffer();
         com_array<float> GetPointCloudBuffer();
+        com_array<float> GetColoredPointCloudBuffer();
+        void SetPointCloudIntensityEnabled(bool enabled);
+        void SetPointCloudFormat(int32_t format);
+        com_array<uint16_t> GetEncodedPointCloudBuffer(float& offsetX, float& offsetY, float& offsetZ, float& scale);
+        void SetDepthTextureMode(int32_t mode, int32_t cropX, int32_t cropY, int32_t cropWidth, int32_t cropHeight);
+        void SetLongDepthTextureMode(int32_t mode, int32_t cropX, int32_t cropY, int32_t cropWidth, int32_t cropHeight);
+        com_array<int32_t> GetDepthTextureSize();
+        com_array<int32_t> GetLongDepthTextureSize();
+        void SetDepthColormap(int32_t colormap, uint16_t rangeMin, uint16_t rangeMax);
+        void SetShortAbImageColormap(int32_t colormap, uint16_t rangeMin, uint16_t rangeMax);
+        void SetLongDepthColormap(int32_t colormap, uint16_t rangeMin, uint16_t rangeMax);
+        com_array<uint8_t> GetDepthMapColorTextureBuffer();
+        com_array<uint8_t> GetShortAbImageColorTextureBuffer();
+        com_array<uint8_t> GetLongDepthMapColorTextureBuffer();
         com_array<float> GetCenterPoint();
+        com_array<float> QueryDepthPixels(array_view<float const> pixels, uint64_t hostTicks);
+        com_array<float> QueryDepthRays(array_view<float const> rays, float maxDistance, uint64_t hostTicks);
+        void EnableDepthQueries();
+        void DisableDepthQueries();
         com_array<float> GetDepthSensorPosition();
+
+        hstring GetPipelineStats();
+        void SetPipelineStatsDumpInterval(int32_t intervalMs);
+        hstring RunProcessingBenchmark(int32_t frameCount);
         std::mutex mu;
 
     private:
@@ -110,6 +230,18 @@ namespace winrt::HL2UnityPlugin::implementation
 		std::atomic_bool m_LFImageUpdated = false;
 		std::atomic_bool m_RFImageUpdated = false;
 
+        StreamStats m_depthStats{ "AHAT" };
+        StreamStats m_longDepthStats{ "LongThrow" };
+        StreamStats m_spatialCamerasFrontStats{ "SpatialCamerasFront" };
+        std::atomic_int m_statsDumpIntervalMs = 0;
+
+        FrameNotifier m_frameNotifiers[3]; // indexed by SensorStream
+        winrt::event<FrameArrivedHandler> m_frameArrivedEvents[3];
+        void PublishFrameArrived(const FrameInfo& info);
+        FrameViewNotifier m_frameViewNotifiers[3]; // indexed by SensorStream
+        FrameViewPool m_frameViewPool;
+        std::shared_ptr<PooledFrameView> AcquireFrameView(HL2UnityPlugin::SensorStream stream);
+
         float m_roiBound[3]{ 0,0,0 };
         float m_roiCenter[3]{ 0,0,0 };
         static void DepthSensorLoop(HL2ResearchMode* pHL2ResearchMode);
@@ -117,6 +249,7 @@ namespace winrt::HL2UnityPlugin::implementation
         static void SpatialCamerasFrontLoop(HL2ResearchMode* pHL2ResearchMode);
         static void CamAccessOnComplete(ResearchModeSensorConsent consent);
         std::string MatrixToString(DirectX::XMFLOAT4X4 mat);
+        void DumpPipelineStatsIfDue(StreamStats& stats);
         DirectX::XMFLOAT4X4 m_depthCameraPose;
         DirectX::XMMATRIX m_depthCameraPoseInvMatrix;
         DirectX::XMFLOAT4X4 m_longDepthCameraPose;
@@ -125,9 +258,38 @@ namespace winrt::HL2UnityPlugin::implementation
         DirectX::XMMATRIX m_LFCameraPoseInvMatrix;
         DirectX::XMFLOAT4X4 m_RFCameraPose;
         DirectX::XMMATRIX m_RFCameraPoseInvMatrix;
-        std::thread* m_pDepthUpdateThread;
-        std::thread* m_pLongDepthUpdateThread;
-        std::thread* m_pSpatialCamerasFrontUpdateThread;
+        std::thread* m_pDepthUpdateThread = nullptr;
+        std::thread* m_pLongDepthUpdateThread = nullptr;
+        std::thread* m_pSpatialCamerasFrontUpdateThread = nullptr;
+        void OpenSensorDevice();
+        void WaitForSensorDevice();
+        void LaunchSensorInit(HL2UnityPlugin::SensorStream stream);
+        void WaitForSensorInit(HL2UnityPlugin::SensorStream stream);
+        void AcquireDepthSensor();
+        void AcquireLongDepthSensor();
+        void AcquireSpatialCamerasFront();
+        void StartSensorLoop(HL2UnityPlugin::SensorStream stream, std::atomic_bool& loopStarted, std::thread*& pThread,
+            void (*loop)(HL2ResearchMode*));
+        void StopSensorLoop(HL2UnityPlugin::SensorStream stream, std::atomic_bool& loopStarted, std::thread*& pThread);
+        void JoinSensorLoop(HL2UnityPlugin::SensorStream stream, std::unique_lock<std::mutex>& lifecycleLock,
+            std::thread*& pThread);
+        bool PrepareSensorLoop(HL2UnityPlugin::SensorStream stream, const std::atomic_bool& loopStarted);
+        void RecordSensorLoopEvent(HL2UnityPlugin::SensorStream stream, bool firstFrame);
+        void ReleaseSensors();
+        static float MillisecondsSince(StreamStats::Clock::time_point start);
+        struct SensorLifecycle {       // Unit: ms, -1 until measured
+            float initMs = -1;
+            float startMs = -1;         // last Start call to stream open
+            float firstFrameMs = -1;    // last Start call to first frame
+            float stopMs = -1;          // last Stop call to loop thread joined
+            UINT starts = 0;
+            StreamStats::Clock::time_point startRequested;
+        };
+        SensorLifecycle m_sensorLifecycle[3]; // indexed by SensorStream, guarded by mu
+        float m_deviceOpenMs = -1;
+        std::mutex m_lifecycleMutex;    // serializes loop starts and stops, released while joining
+        std::condition_variable m_lifecycleChanged;
+        bool m_sensorLoopJoining[3] = {}; // indexed by SensorStream, guarded by m_lifecycleMutex
         static long long checkAndConvertUnsigned(UINT64 val);
         struct DepthCamRoi {
             float kRowLower = 0.2;
@@ -137,7 +299,128 @@ namespace winrt::HL2UnityPlugin::implementation
             UINT16 depthNearClip = 200; // Unit: mm
             UINT16 depthFarClip = 800;
         } depthCamRoi;
+        DepthRoiImageBounds ComputeDepthRoiImageBounds(const AhatFrameParams& params);
+        static std::vector<DirectX::XMFLOAT3> MapDepthUnitRays(IResearchModeCameraSensor* pCameraSensor, const ResearchModeSensorResolution& resolution);
+        std::vector<DirectX::XMFLOAT3> m_depthUnitRays;
+        float m_depthUnitRayAngle = 0;  // largest angle between neighboring depth unit rays, rad
+        static const size_t kDepthQueryHistorySize = 4;
+        std::shared_ptr<const DepthQueryGeometry> m_depthQueryGeometry;
+        std::shared_ptr<DepthQueryFrame> m_depthQueryHistory[kDepthQueryHistorySize]; // latest first
+        std::atomic_bool m_useDepthQueries = false;  // frames are only kept once queries are in use
+        std::shared_ptr<const DepthQueryFrame> DepthQueryFrameAt(uint64_t hostTicks);
+        std::shared_ptr<DepthQueryFrame> CaptureDepthQuery(const UINT16* pDepth, const ResearchModeSensorResolution& resolution,
+            UINT16 depthOffset, UINT64 hostTicks, DirectX::FXMMATRIX depthToWorld);
+        void StoreDepthQueryFrame(std::shared_ptr<DepthQueryFrame> pQueryFrame);
+        TemporalDepthFilter m_temporalDepthFilter;
+        TemporalDepthFilterSettings m_temporalDepthFilterSettings;
+        std::atomic_bool m_useTemporalDepthFilter = false;
+        std::atomic_bool m_temporalDepthFilterResetRequested = false;
+        std::vector<UINT16> m_filteredDepth;
+        FlyingPixelFilterSettings m_flyingPixelFilterSettings;
+        std::atomic_bool m_useFlyingPixelFilter = false;
+        std::vector<UINT8> m_depthValidMask;
+        PlaneDetector m_planeDetector;
+        PlaneDetectionSettings m_planeDetectionSettings;
+        std::atomic_bool m_usePlaneDetection = false;
+        std::atomic_bool m_planeDetectionResetRequested = false;
+        std::vector<float> m_planes;
+        BlobSegmenter m_blobSegmenter;
+        BlobSegmentationSettings m_blobSegmentationSettings;
+        std::atomic_bool m_useBlobSegmentation = false;
+        std::vector<float> m_blobs;
+        DepthRegistration m_depthRegistration;
+        RegistrationSettings m_depthRegistrationSettings;
+        std::atomic_bool m_useDepthRegistration = false;
+        std::atomic_bool m_depthRegistrationResetRequested = false;
+        DirectX::XMFLOAT4X4 m_depthFramePose{ 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, -1, 0, 0, 0, 0, 1 }; // output coordinates
+        ChangeDetector m_changeDetector;
+        ChangeDetectionSettings m_changeDetectionSettings;
+        std::atomic_bool m_useChangeDetection = false;
+        std::atomic_bool m_changeDetectionResetRequested = false;
+        WorldPointMap m_worldPointMap;
+        std::atomic_bool m_useWorldPointMap = false;
+        OccupancyMap m_occupancyMap;
+        std::atomic_bool m_useOccupancyMap = false;
+        std::vector<DirectX::XMFLOAT3> m_longDepthUnitRays;  // only used by the long-throw loop
+        PointCloudExporter m_pointCloudExporter;
+        std::atomic_int m_pointCloudExportInterval = 0;
+        void IntegrateDepthPoints(const std::vector<float>& pointCloud, DirectX::FXMMATRIX depthToWorld);
+        bool PointCloudExportDue(UINT64 frameIndex);
+        void SubmitPointCloudExport(UINT64 frameIndex, UINT64 hostTicks, const std::vector<float>& pointCloud,
+            const std::vector<float>& coloredPointCloud);
+        ProcessingGovernor m_governor;
+        std::atomic_bool m_useGovernor = false;
+        SharedFrameRing m_sharedRings[kSharedRingStreamCount]; // indexed by SharedRingStream, each only used by its sensor loop
+        std::filesystem::path m_sharedRingDirectory;
+        UINT32 m_sharedRingSlotCount = 4;
+        std::atomic<UINT64> m_sharedRingGeneration = 0; // changes on start and stop, the loops then reopen or close their rings
+        std::atomic_bool m_useSharedRings = false;
+        bool PublishSharedFrame(SharedRingStream stream, UINT64& ringGeneration, const SharedFrameInfo& info,
+            const SharedFramePlane* pPlanes, uint32_t planeCount);
+        static SharedFrameInfo MakeSharedFrameInfo(UINT64 frameIndex, UINT64 hostTicks, const ResearchModeSensorResolution& resolution,
+            DirectX::FXMMATRIX cameraToWorld);
+        static std::filesystem::path LocalFolderPath();
+        std::atomic_bool m_usePointCloudIntensity = false;
+        std::shared_ptr<const VlcFrameSnapshot> m_LFHistory[2];
+        std::shared_ptr<const VlcFrameSnapshot> m_RFHistory[2];
+        CameraProjectionLut m_LFProjectionLut;
+        CameraProjectionLut m_RFProjectionLut;
+        VlcFeatureExtractor m_LFFeatureExtractor;  // only used by the spatial cameras loop
+        VlcFeatureExtractor m_RFFeatureExtractor;
+        FeatureExtractionSettings m_featureExtractionSettings;
+        std::atomic_bool m_useFeatureExtraction = false;
+        std::vector<float> m_LFKeypoints;
+        std::vector<float> m_RFKeypoints;
+        TextureNormalizer m_depthNormalizer;       // only used by the depth sensor loop
+        TextureNormalizer m_abNormalizer;
+        TextureNormalizer m_longDepthNormalizer;   // only used by the long-throw loop
+        TextureNormalizationSettings m_textureNormalizationSettings;
+        std::atomic_bool m_useTextureNormalization = false;
+        std::atomic_bool m_depthNormalizationResetRequested = false;
+        std::atomic_bool m_longDepthNormalizationResetRequested = false;
+        std::vector<float> m_coloredPointCloud;
+        std::atomic<PointCloudFormat> m_pointCloudFormat = PointCloudFormat::Float;
+        std::vector<UINT16> m_encodedPointCloud;
+        PointCloudFormat m_encodedPointCloudFormat = PointCloudFormat::Float;
+        DirectX::XMFLOAT3 m_encodingOffset{ 0,0,0 };
+        float m_encodingScale = 1;
+        struct TextureSettings {
+            TextureMode mode = TextureMode::Full;
+            UINT cropX = 0;
+            UINT cropY = 0;
+            UINT cropWidth = 0;
+            UINT cropHeight = 0;
+            static TextureSettings From(int32_t mode, int32_t cropX, int32_t cropY, int32_t cropWidth, int32_t cropHeight)
+            {
+                TextureSettings settings;
+                settings.mode = (mode >= (int32_t)TextureMode::Off && mode <= (int32_t)TextureMode::Crop) ? (TextureMode)mode : TextureMode::Full;
+                settings.cropX = (UINT)(std::max)(cropX, 0);
+                settings.cropY = (UINT)(std::max)(cropY, 0);
+                settings.cropWidth = (UINT)(std::max)(cropWidth, 0);
+                settings.cropHeight = (UINT)(std::max)(cropHeight, 0);
+                return settings;
+            }
+            TextureLayout Layout(const ResearchModeSensorResolution& resolution) const
+            {
+                return MakeTextureLayout(mode, resolution.Width, resolution.Height, cropX, cropY, cropWidth, cropHeight);
+            }
+        };
+        TextureSettings m_depthTextureSettings;
+        TextureSettings m_longDepthTextureSettings;
+        TextureLayout m_depthTextureLayout{ TextureMode::Off };
+        TextureLayout m_longDepthTextureLayout{ TextureMode::Off };
+        std::shared_ptr<const ColormapLut> m_depthColormap;
+        std::shared_ptr<const ColormapLut> m_abColormap;
+        std::shared_ptr<const ColormapLut> m_longDepthColormap;
+        std::vector<UINT32> m_depthMapColorTexture;
+        std::vector<UINT32> m_shortAbImageColorTexture;
+        std::vector<UINT32> m_longDepthMapColorTexture;
+        static std::shared_ptr<const ColormapLut> MakeColormapLut(int32_t colormap, uint16_t rangeMin, uint16_t rangeMax);
+        static com_array<uint8_t> ColorTextureBytes(const std::vector<UINT32>& texture);
+        static std::shared_ptr<const VlcFrameSnapshot> NearestVlcFrame(const std::shared_ptr<const VlcFrameSnapshot> (&history)[2], UINT64 hostTicks);
         UINT16 m_depthOffset = 0;
+        // declared last so it is destroyed first, waiting for the tasks still using the members above
+        SensorInitScheduler m_sensorInit;
     };
 }
 namespace winrt::HL2UnityPlugin::factory_implementation
@@ -0,0 +1,381 @@
+#include "OccupancyMap.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
+using namespace DirectX;
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    static const float kUnknownLogOdds = -FLT_MAX;
+    static const int kVoxelOffset = 1 << 20;
+
+    static float OccupancyProbability(float logOdds)
+    {
+        return 1.0f - 1.0f / (1.0f + expf(logOdds));
+    }
+
+    // Visit the voxels along the segment from begin to end (in voxel units) in order with the segment parameter
+    // (0 to 1) at which the segment enters them, the voxel of end only if includeEnd. Stops when visit returns false.
+    template <typename F>
+    static void TraverseVoxels(const XMFLOAT3& begin, const XMFLOAT3& end, bool includeEnd, F&& visit)
+    {
+        const float from[3] = { begin.x, begin.y, begin.z };
+        const float to[3] = { end.x, end.y, end.z };
+        int voxel[3], step[3];
+        float tMax[3], tDelta[3];
+        int remaining = 0;
+        for (int a = 0; a < 3; a++)
+        {
+            voxel[a] = (int)floorf(from[a]);
+            int last = (int)floorf(to[a]);
+            remaining += abs(last - voxel[a]);
+            float delta = to[a] - from[a];
+            step[a] = delta > 0 ? 1 : -1;
+            if (delta != 0)
+            {
+                float boundary = delta > 0 ? voxel[a] + 1 - from[a] : from[a] - voxel[a];
+                tDelta[a] = 1 / fabsf(delta);
+                tMax[a] = boundary * tDelta[a];
+            }
+            else
+            {
+                tDelta[a] = FLT_MAX;
+                tMax[a] = FLT_MAX;
+            }
+        }
+
+        float t = 0;
+        for (;;)
+        {
+            if (remaining == 0 && !includeEnd)
+            {
+                return;
+            }
+            if (!visit(voxel[0], voxel[1], voxel[2], t))
+            {
+                return;
+            }
+            if (remaining-- == 0)
+            {
+                return;
+            }
+            int a = tMax[0] < tMax[1] ? (tMax[0] < tMax[2] ? 0 : 2) : (tMax[1] < tMax[2] ? 1 : 2);
+            t = tMax[a];
+            voxel[a] += step[a];
+            tMax[a] += tDelta[a];
+        }
+    }
+
+    void OccupancyMap::Configure(const OccupancyMapSettings& settings)
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+        bool voxelSizeChanged = settings.voxelSize != m_settings.voxelSize;
+        m_settings = settings;
+        m_settings.voxelSize = (std::max)(m_settings.voxelSize, 0.005f);
+        m_settings.maxBlocks = (std::max)(m_settings.maxBlocks, (size_t)1);
+        m_settings.maxRange = (std::max)(m_settings.maxRange, m_settings.voxelSize);
+        m_voxelScale = 1.0f / m_settings.voxelSize;
+        if (voxelSizeChanged)
+        {
+            ClearLocked();
+        }
+        m_index.reserve(m_settings.maxBlocks);
+    }
+
+    void OccupancyMap::Clear()
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+        ClearLocked();
+    }
+
+    void OccupancyMap::ClearLocked()
+    {
+        m_blocks.clear();
+        m_index.clear();
+    }
+
+    OccupancyMap::Voxel OccupancyMap::VoxelAt(float x, float y, float z) const
+    {
+        return Voxel{ (UINT)((int)floorf(x * m_voxelScale) + kVoxelOffset), (UINT)((int)floorf(y * m_voxelScale) + kVoxelOffset),
+            (UINT)((int)floorf(z * m_voxelScale) + kVoxelOffset) };
+    }
+
+    const OccupancyMap::Block* OccupancyMap::FindBlock(UINT64 key, BlockCursor& cursor) const
+    {
+        if (key != cursor.key)
+        {
+            auto found = m_index.find(key);
+            cursor.key = key;
+            cursor.pBlock = found == m_index.end() ? nullptr : &*found->second;
+        }
+        return cursor.pBlock;
+    }
+
+    OccupancyMap::Block* OccupancyMap::UpdateBlock(UINT64 key, BlockCursor& cursor)
+    {
+        if (key == cursor.key && cursor.pBlock)
+        {
+            return cursor.pBlock;
+        }
+        auto found = m_index.find(key);
+        BlockList::iterator block;
+        if (found == m_index.end())
+        {
+            m_blocks.emplace_back();
+            block = std::prev(m_blocks.end());
+            block->key = key;
+            block->lastUpdate = 0;
+            std::fill(block->logOdds, block->logOdds + kBlockVoxels, kUnknownLogOdds);
+            m_index.emplace(key, block);
+        }
+        else
+        {
+            block = found->second;
+        }
+
+        // first update in this frame: most recently updated, nothing updated yet
+        if (block->lastUpdate != m_frame)
+        {
+            block->lastUpdate = m_frame;
+            memset(block->updated, 0, sizeof(block->updated));
+            m_blocks.splice(m_blocks.end(), m_blocks, block);
+        }
+        cursor.key = key;
+        cursor.pBlock = &*block;
+        return cursor.pBlock;
+    }
+
+    bool OccupancyMap::UpdateVoxel(const Voxel& voxel, float delta, BlockCursor& cursor)
+    {
+        Block* pBlock = UpdateBlock(voxel.BlockKey(), cursor);
+        UINT index = voxel.Index();
+        UINT64 bit = 1ull << (index & 63);
+        if (pBlock->updated[index >> 6] & bit)
+        {
+            return false;
+        }
+        pBlock->updated[index >> 6] |= bit;
+        float& logOdds = pBlock->logOdds[index];
+        float current = logOdds == kUnknownLogOdds ? 0 : logOdds;
+        logOdds = (std::min)((std::max)(current + delta, m_settings.minLogOdds), m_settings.maxLogOdds);
+        return true;
+    }
+
+    void OccupancyMap::Integrate(const float* pPoints, size_t pointCount, const XMFLOAT3& sensorPosition)
+    {
+        auto start = StreamStats::Clock::now();
+        std::lock_guard<std::mutex> l(m_mutex);
+        m_frame++;
+        const float scale = m_voxelScale;
+        const float maxRangeSq = m_settings.maxRange * m_settings.maxRange;
+        BlockCursor cursor;
+        UINT64 hits = 0, misses = 0;
+
+        // hits first, so rays of this frame do not clear voxels occupied in this frame; one ray per end voxel
+        m_rayEnds.clear();
+        Voxel previous{ 0, 0, 0 };
+        for (size_t k = 0; k < pointCount; k++)
+        {
+            const float* p = pPoints + 3 * k;
+            // neighboring points of an organized cloud mostly fall into the voxel of the previous point
+            Voxel voxel = VoxelAt(p[0], p[1], p[2]);
+            if (voxel.x == previous.x && voxel.y == previous.y && voxel.z == previous.z)
+            {
+                continue;
+            }
+            previous = voxel;
+            XMFLOAT3 end(p[0], p[1], p[2]);
+            float dx = end.x - sensorPosition.x, dy = end.y - sensorPosition.y, dz = end.z - sensorPosition.z;
+            float distanceSq = dx * dx + dy * dy + dz * dz;
+            bool hit = distanceSq <= maxRangeSq;
+            if (!hit)
+            {
+                float truncate = m_settings.maxRange / sqrtf(distanceSq);
+                end = XMFLOAT3(sensorPosition.x + dx * truncate, sensorPosition.y + dy * truncate, sensorPosition.z + dz * truncate);
+                voxel = VoxelAt(end.x, end.y, end.z);
+            }
+            if (UpdateVoxel(voxel, hit ? m_settings.hitLogOdds : m_settings.missLogOdds, cursor))
+            {
+                (hit ? hits : misses)++;
+                m_rayEnds.push_back(end);
+            }
+        }
+
+        XMFLOAT3 begin(sensorPosition.x * scale, sensorPosition.y * scale, sensorPosition.z * scale);
+        for (const auto& end : m_rayEnds)
+        {
+            TraverseVoxels(begin, XMFLOAT3(end.x * scale, end.y * scale, end.z * scale), false, [&](int x, int y, int z, float) {
+                Voxel voxel{ (UINT)(x + kVoxelOffset), (UINT)(y + kVoxelOffset), (UINT)(z + kVoxelOffset) };
+                misses += UpdateVoxel(voxel, m_settings.missLogOdds, cursor);
+                return true;
+            });
+        }
+
+        while (m_blocks.size() > m_settings.maxBlocks)
+        {
+            m_index.erase(m_blocks.front().key);
+            m_blocks.pop_front();
+            m_evictedBlocks++;
+        }
+        m_hits = hits;
+        m_misses = misses;
+        m_durations.Add(std::chrono::duration<float, std::micro>(StreamStats::Clock::now() - start).count());
+    }
+
+    void OccupancyMap::QueryPoints(const float* pPoints, size_t count, float* pResults) const
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+        BlockCursor cursor;
+        for (size_t k = 0; k < count; k++)
+        {
+            const float* p = pPoints + 3 * k;
+            Voxel voxel = VoxelAt(p[0], p[1], p[2]);
+            const Block* pBlock = FindBlock(voxel.BlockKey(), cursor);
+            float logOdds = pBlock ? pBlock->logOdds[voxel.Index()] : kUnknownLogOdds;
+            pResults[k] = logOdds == kUnknownLogOdds ? -1.0f : OccupancyProbability(logOdds);
+        }
+    }
+
+    void OccupancyMap::QueryBoxes(const float* pBoxes, size_t count, float* pResults) const
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+        for (size_t k = 0; k < count; k++)
+        {
+            const float* box = pBoxes + 6 * k;
+            Voxel first = VoxelAt((std::min)(box[0], box[3]), (std::min)(box[1], box[4]), (std::min)(box[2], box[5]));
+            Voxel last = VoxelAt((std::max)(box[0], box[3]), (std::max)(box[1], box[4]), (std::max)(box[2], box[5]));
+            const UINT firstBlock[3] = { first.x >> kBlockShift, first.y >> kBlockShift, first.z >> kBlockShift };
+            const UINT lastBlock[3] = { last.x >> kBlockShift, last.y >> kBlockShift, last.z >> kBlockShift };
+            UINT64 blockCount = (UINT64)(lastBlock[0] - firstBlock[0] + 1) * (lastBlock[1] - firstBlock[1] + 1) * (lastBlock[2] - firstBlock[2] + 1);
+
+            // scan the voxels of one block within the box, returns true if one is occupied
+            bool unknown = false;
+            auto scanBlock = [&](const Block& block, UINT bx, UINT by, UINT bz) {
+                UINT x0 = (std::max)(first.x, bx << kBlockShift), x1 = (std::min)(last.x, ((bx + 1) << kBlockShift) - 1);
+                UINT y0 = (std::max)(first.y, by << kBlockShift), y1 = (std::min)(last.y, ((by + 1) << kBlockShift) - 1);
+                UINT z0 = (std::max)(first.z, bz << kBlockShift), z1 = (std::min)(last.z, ((bz + 1) << kBlockShift) - 1);
+                for (UINT z = z0; z <= z1; z++)
+                {
+                    for (UINT y = y0; y <= y1; y++)
+                    {
+                        for (UINT x = x0; x <= x1; x++)
+                        {
+                            float logOdds = block.logOdds[Voxel{ x, y, z }.Index()];
+                            if (logOdds > 0)
+                            {
+                                return true;
+                            }
+                            unknown |= logOdds == kUnknownLogOdds;
+                        }
+                    }
+                }
+                return false;
+            };
+
+            bool occupied = false;
+            if (blockCount <= m_index.size())
+            {
+                BlockCursor cursor;
+                for (UINT bz = firstBlock[2]; bz <= lastBlock[2] && !occupied; bz++)
+                {
+                    for (UINT by = firstBlock[1]; by <= lastBlock[1] && !occupied; by++)
+                    {
+                        for (UINT bx = firstBlock[0]; bx <= lastBlock[0] && !occupied; bx++)
+                        {
+                            const Block* pBlock = FindBlock(Voxel{ bx << kBlockShift, by << kBlockShift, bz << kBlockShift }.BlockKey(), cursor);
+                            if (!pBlock)
+                            {
+                                unknown = true;
+                                continue;
+                            }
+                            occupied = scanBlock(*pBlock, bx, by, bz);
+                        }
+                    }
+                }
+            }
+            else
+            {
+                // box larger than the map: visit the stored blocks instead of the block grid of the box
+                UINT64 overlapping = 0;
+                for (auto block = m_blocks.begin(); block != m_blocks.end() && !occupied; ++block)
+                {
+                    UINT bx = (UINT)(block->key & 0x1FFFFF), by = (UINT)((block->key >> 21) & 0x1FFFFF), bz = (UINT)(block->key >> 42);
+                    if (bx < firstBlock[0] || bx > lastBlock[0] || by < firstBlock[1] || by > lastBlock[1] || bz < firstBlock[2] || bz > lastBlock[2])
+                    {
+                        continue;
+                    }
+                    overlapping++;
+                    occupied = scanBlock(*block, bx, by, bz);
+                }
+                unknown |= overlapping < blockCount;
+            }
+            pResults[k] = occupied ? 1.0f : (unknown ? -1.0f : 0.0f);
+        }
+    }
+
+    void OccupancyMap::QueryRays(const float* pRays, size_t count, float maxDistance, float* pResults) const
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+        const float scale = m_voxelScale;
+        BlockCursor cursor;
+        for (size_t k = 0; k < count; k++)
+        {
+            const float* ray = pRays + 6 * k;
+            float* pResult = pResults + kRayResultSize * k;
+            XMVECTOR origin = XMVectorSet(ray[0], ray[1], ray[2], 0);
+            XMVECTOR direction = XMVectorSet(ray[3], ray[4], ray[5], 0);
+            float length = XMVectorGetX(XMVector3Length(direction));
+            pResult[0] = maxDistance;
+            pResult[1] = -1;
+            if (length == 0 || maxDistance <= 0)
+            {
+                continue;
+            }
+            XMFLOAT3 begin, end;
+            XMStoreFloat3(&begin, origin * scale);
+            XMStoreFloat3(&end, (origin + direction * (maxDistance / length)) * scale);
+
+            bool unknown = false;
+            TraverseVoxels(begin, end, true, [&](int x, int y, int z, float t) {
+                Voxel voxel{ (UINT)(x + kVoxelOffset), (UINT)(y + kVoxelOffset), (UINT)(z + kVoxelOffset) };
+                const Block* pBlock = FindBlock(voxel.BlockKey(), cursor);
+                float logOdds = pBlock ? pBlock->logOdds[voxel.Index()] : kUnknownLogOdds;
+                if (logOdds > 0)
+                {
+                    pResult[0] = t * maxDistance;
+                    pResult[1] = 1;
+                    return false;
+                }
+                unknown |= logOdds == kUnknownLogOdds;
+                return true;
+            });
+            if (pResult[1] != 1)
+            {
+                pResult[1] = unknown ? -1.0f : 0.0f;
+            }
+        }
+    }
+
+    std::string OccupancyMap::StatusJson() const
+    {
+        auto durations = m_durations.Summarize();
+        std::lock_guard<std::mutex> l(m_mutex);
+        std::stringstream ss;
+        ss << "{\"blocks\":" << m_blocks.size()
+            << ",\"max_blocks\":" << m_settings.maxBlocks
+            << ",\"voxel_size\":" << m_settings.voxelSize
+            << ",\"memory_kb\":" << m_blocks.size() * sizeof(Block) / 1024
+            << ",\"frames\":" << m_frame
+            << ",\"evicted_blocks\":" << m_evictedBlocks
+            << ",\"hits\":" << m_hits
+            << ",\"misses\":" << m_misses
+            << ",\"integrate_us\":{\"mean\":" << durations.mean
+            << ",\"p50\":" << durations.p50
+            << ",\"p95\":" << durations.p95
+            << ",\"max\":" << durations.max << "}}";
+        return ss.str();
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include "PipelineStats.h"
+#include "Platform.h"
+#include <DirectXMath.h>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    struct OccupancyMapSettings {
+        float voxelSize = 0.05f;    // Unit: m
+        size_t maxBlocks = 4096;    // memory budget in blocks of 8^3 voxels, the least recently updated are evicted first
+        float maxRange = 4.0f;      // Unit: m, points farther from the sensor only clear the free space up to maxRange
+        float hitLogOdds = 0.85f;   // added to the voxel of a point
+        float missLogOdds = -0.4f;  // added to the voxels a ray passes through
+        float minLogOdds = -2.0f;   // clamping keeps voxels able to change state within a few frames
+        float maxLogOdds = 3.5f;
+    };
+
+    // Probabilistic occupancy grid in world space with bounded memory. Voxels are stored in hashed blocks of 8^3 voxels
+    // kept in least recently updated order. Every integrated point raises the log-odds of its voxel and lowers those of
+    // the voxels between the sensor and the point (3D DDA), each voxel at most once per integrated frame and with hits
+    // taking precedence over misses. Queries take the map lock only for their own duration.
+    class OccupancyMap
+    {
+    public:
+        static const size_t kRayResultSize = 2;
+
+        // Changes the settings; a new voxel size clears the map
+        void Configure(const OccupancyMapSettings& settings);
+        void Clear();
+
+        // Integrate pointCount points (x, y, z) observed from sensorPosition
+        void Integrate(const float* pPoints, size_t pointCount, const DirectX::XMFLOAT3& sensorPosition);
+
+        // Per point (x, y, z): occupancy probability of its voxel, -1 if the voxel was never observed
+        void QueryPoints(const float* pPoints, size_t count, float* pResults) const;
+
+        // Per box (min x, y, z, max x, y, z): 1 if any voxel in the box is occupied, 0 if all are observed free,
+        // -1 if none is occupied but some were never observed
+        void QueryBoxes(const float* pBoxes, size_t count, float* pResults) const;
+
+        // Per ray (origin x, y, z, direction x, y, z), kRayResultSize floats: distance to the first occupied voxel
+        // (maxDistance if none), 1 if it hit an occupied voxel, 0 if the whole ray is observed free, -1 if it passes
+        // voxels that were never observed
+        void QueryRays(const float* pRays, size_t count, float maxDistance, float* pResults) const;
+
+        // {"blocks":...,"max_blocks":...,"voxel_size":...,"memory_kb":...,"frames":...,"evicted_blocks":...,
+        //  "hits":...,"misses":...,"integrate_us":{"mean":...,"p50":...,"p95":...,"max":...}}
+        std::string StatusJson() const;
+
+    private:
+        static const int kBlockShift = 3;
+        static const int kBlockSide = 1 << kBlockShift;
+        static const int kBlockVoxels = kBlockSide * kBlockSide * kBlockSide;
+
+        struct Block {
+            UINT64 key;
+            UINT64 lastUpdate;                  // frame of the last update
+            UINT64 updated[kBlockVoxels / 64];  // voxels already updated in frame lastUpdate
+            float logOdds[kBlockVoxels];
+        };
+        // least recently updated first
+        using BlockList = std::list<Block>;
+
+        // voxel coordinates offset by 2^20, so they are non-negative within +-2^20 voxels of the origin
+        struct Voxel {
+            UINT x, y, z;
+            UINT64 BlockKey() const { return (UINT64)(x >> kBlockShift) | ((UINT64)(y >> kBlockShift) << 21) | ((UINT64)(z >> kBlockShift) << 42); }
+            UINT Index() const { return ((z & (kBlockSide - 1)) * kBlockSide + (y & (kBlockSide - 1))) * kBlockSide + (x & (kBlockSide - 1)); }
+        };
+
+        // block lookups of one call, consecutive voxels mostly share their block
+        struct BlockCursor {
+            UINT64 key = ~0ull;
+            Block* pBlock = nullptr;
+        };
+
+        Voxel VoxelAt(float x, float y, float z) const;
+        const Block* FindBlock(UINT64 key, BlockCursor& cursor) const;
+        Block* UpdateBlock(UINT64 key, BlockCursor& cursor);
+        bool UpdateVoxel(const Voxel& voxel, float delta, BlockCursor& cursor);
+        void ClearLocked();
+
+        mutable std::mutex m_mutex;
+        OccupancyMapSettings m_settings;
+        float m_voxelScale = 1 / OccupancyMapSettings().voxelSize;
+        BlockList m_blocks;
+        std::unordered_map<UINT64, BlockList::iterator> m_index;
+        std::vector<DirectX::XMFLOAT3> m_rayEnds;  // of the current Integrate call
+        UINT64 m_frame = 0;
+        UINT64 m_evictedBlocks = 0;
+        UINT64 m_hits = 0;                          // voxel updates of the last frame
+        UINT64 m_misses = 0;
+        StageHistogram m_durations;
+    };
+}
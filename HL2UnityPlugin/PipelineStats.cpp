@@ -0,0 +1,99 @@
+#include "PipelineStats.h"
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    static const char* kStageNames[] = { "GetNextBuffer", "Locate", "Register", "Process", "Publish", "LockWait", "Fetch" };
+    static_assert(sizeof(kStageNames) / sizeof(kStageNames[0]) == (size_t)PipelineStage::Count, "missing stage name");
+
+    void StageHistogram::Add(float durationUs)
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+        m_samples[m_next] = durationUs;
+        m_next = (m_next + 1) % kCapacity;
+        if (m_count < kCapacity) m_count++;
+    }
+
+    StageHistogram::Summary StageHistogram::Summarize() const
+    {
+        float sorted[kCapacity];
+        Summary summary;
+        {
+            std::lock_guard<std::mutex> l(m_mutex);
+            summary.count = m_count;
+            std::copy(m_samples, m_samples + m_count, sorted);
+        }
+        if (summary.count == 0)
+        {
+            return summary;
+        }
+
+        std::sort(sorted, sorted + summary.count);
+        auto percentile = [&](float p) { return sorted[(size_t)(p * (summary.count - 1) + 0.5f)]; };
+        float sum = 0;
+        for (size_t i = 0; i < summary.count; i++) sum += sorted[i];
+        summary.mean = sum / summary.count;
+        summary.p50 = percentile(0.50f);
+        summary.p95 = percentile(0.95f);
+        summary.p99 = percentile(0.99f);
+        summary.max = sorted[summary.count - 1];
+        return summary;
+    }
+
+    void StreamStats::Record(PipelineStage stage, Clock::time_point start)
+    {
+        auto elapsed = std::chrono::duration<float, std::micro>(Clock::now() - start);
+        m_stages[(size_t)stage].Add(elapsed.count());
+    }
+
+    std::unique_lock<std::mutex> StreamStats::LockAndRecordWait(std::mutex& mutex)
+    {
+        auto start = Clock::now();
+        std::unique_lock<std::mutex> l(mutex);
+        Record(PipelineStage::LockWait, start);
+        return l;
+    }
+
+    std::string StreamStats::ToString() const
+    {
+        auto seconds = std::chrono::duration<double>(Clock::now() - m_startTime).count();
+        uint64_t frames = m_frames;
+
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(1);
+        ss << "[" << m_name << "] frames: " << frames
+            << " dropped: " << m_dropped
+            << " skipped: " << m_skipped
+            << " overwritten: " << m_overwritten
+            << " fps: " << (seconds > 0 ? frames / seconds : 0) << "\n";
+        for (size_t i = 0; i < (size_t)PipelineStage::Count; i++)
+        {
+            auto summary = m_stages[i].Summarize();
+            if (summary.count == 0) continue;
+            ss << "  " << kStageNames[i] << " (us) mean: " << summary.mean
+                << " p50: " << summary.p50
+                << " p95: " << summary.p95
+                << " p99: " << summary.p99
+                << " max: " << summary.max << "\n";
+        }
+        return ss.str();
+    }
+
+    bool StreamStats::DumpIfDue(int intervalMs, std::string& out)
+    {
+        if (intervalMs <= 0)
+        {
+            return false;
+        }
+        auto now = Clock::now();
+        if (now - m_lastDumpTime < std::chrono::milliseconds(intervalMs))
+        {
+            return false;
+        }
+        m_lastDumpTime = now;
+        out = ToString();
+        return true;
+    }
+}
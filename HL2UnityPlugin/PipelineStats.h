@@ -0,0 +1,91 @@
+#pragma once
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <string>
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    // Processing stages timed inside the sensor loops and the buffer getters
+    enum class PipelineStage
+    {
+        GetNextBuffer,
+        Locate,
+        Register,
+        Process,
+        Publish,
+        LockWait,
+        Fetch,
+        Count
+    };
+
+    // Ring buffer of the most recent stage durations, summarized as percentiles on request
+    class StageHistogram
+    {
+    public:
+        static constexpr size_t kCapacity = 512;
+
+        struct Summary {
+            size_t count = 0;
+            float mean = 0; // Unit: us
+            float p50 = 0;
+            float p95 = 0;
+            float p99 = 0;
+            float max = 0;
+        };
+
+        void Add(float durationUs);
+        Summary Summarize() const;
+
+    private:
+        mutable std::mutex m_mutex;
+        float m_samples[kCapacity]{};
+        size_t m_next = 0;
+        size_t m_count = 0;
+    };
+
+    // Per-stream timers and counters. Written by one sensor loop, read by any thread.
+    class StreamStats
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        explicit StreamStats(const char* name) : m_name(name) {}
+
+        void Record(PipelineStage stage, Clock::time_point start);
+        // Lock the mutex and record how long the caller waited for it
+        std::unique_lock<std::mutex> LockAndRecordWait(std::mutex& mutex);
+
+        void CountFrame() { m_frames++; }
+        void CountDropped() { m_dropped++; }
+        void CountSkipped() { m_skipped++; }
+        void CountOverwritten() { m_overwritten++; }
+
+        std::string ToString() const;
+        // Returns true (and the formatted stats) once every intervalMs, false otherwise
+        bool DumpIfDue(int intervalMs, std::string& out);
+
+    private:
+        const char* m_name;
+        StageHistogram m_stages[(size_t)PipelineStage::Count];
+        std::atomic_uint64_t m_frames = 0;
+        std::atomic_uint64_t m_dropped = 0;
+        std::atomic_uint64_t m_skipped = 0;
+        std::atomic_uint64_t m_overwritten = 0;
+        Clock::time_point m_startTime = Clock::now();
+        Clock::time_point m_lastDumpTime = Clock::now();
+    };
+
+    // Times the enclosing scope as one stage of a stream
+    class ScopedStageTimer
+    {
+    public:
+        ScopedStageTimer(StreamStats& stats, PipelineStage stage) : m_stats(stats), m_stage(stage), m_start(StreamStats::Clock::now()) {}
+        ~ScopedStageTimer() { m_stats.Record(m_stage, m_start); }
+
+    private:
+        StreamStats& m_stats;
+        PipelineStage m_stage;
+        StreamStats::Clock::time_point m_start;
+    };
+}
@@ -0,0 +1,249 @@
+#include "PlaneDetection.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    void PlaneDetector::SamplePoints(const PlaneDetectionSettings& settings, const AhatFrameParams& params, const UINT16* pDepth,
+        const XMFLOAT3* pUnitRays, const UINT8* pValidMask)
+    {
+        m_samples.Clear();
+        const auto& bounds = params.roiImageBounds;
+        XMMATRIX depthToWorld = XMLoadFloat4x4(&params.depthToWorld);
+        XMVECTOR roiCenter = XMLoadFloat3(&params.roiCenter);
+        XMVECTOR roiBound = XMLoadFloat3(&params.roiBound);
+        UINT step = (std::max)(settings.gridStep, 1u);
+        UINT rowEnd = (std::min)(bounds.rowEnd, params.height);
+        UINT colEnd = (std::min)(bounds.colEnd, params.width);
+
+        auto cameraPoint = [&](UINT i, UINT j, XMVECTOR& point) {
+            auto idx = params.width * i + j;
+            UINT16 depth = pDepth[idx];
+            depth = (depth > 4090) ? 0 : depth - params.depthOffset;
+            if (depth < bounds.depthMin || depth > bounds.depthMax || pUnitRays[idx].z == 0 || (pValidMask && !pValidMask[idx]))
+            {
+                return false;
+            }
+            point = (float)depth / 1000 * XMLoadFloat3(&pUnitRays[idx]);
+            return true;
+        };
+
+        for (UINT i = bounds.rowBegin; i + step < rowEnd; i += step)
+        {
+            for (UINT j = bounds.colBegin; j + step < colEnd; j += step)
+            {
+                XMVECTOR point, right, down;
+                if (!cameraPoint(i, j, point) || !cameraPoint(i, j + step, right) || !cameraPoint(i + step, j, down))
+                {
+                    continue;
+                }
+
+                // neighbors across a depth discontinuity do not give a surface normal
+                float maxNeighborDistance = 0.025f * step * XMVectorGetX(XMVector3Length(point));
+                if (XMVectorGetX(XMVector3Length(right - point)) > maxNeighborDistance ||
+                    XMVectorGetX(XMVector3Length(down - point)) > maxNeighborDistance)
+                {
+                    continue;
+                }
+
+                // normal facing the camera
+                XMVECTOR normal = XMVector3Normalize(XMVector3Cross(down - point, right - point));
+                if (XMVectorGetX(XMVector3Dot(normal, point)) > 0)
+                {
+                    normal = -normal;
+                }
+
+                XMVECTOR pointInWorld = XMVector3Transform(point, depthToWorld);
+                if (params.useRoiFilter && !XMVector3InBounds(pointInWorld - roiCenter, roiBound))
+                {
+                    continue;
+                }
+                XMFLOAT3 p, n;
+                XMStoreFloat3(&p, pointInWorld);
+                XMStoreFloat3(&n, XMVector3Normalize(XMVector3TransformNormal(normal, depthToWorld)));
+                m_samples.x.push_back(p.x); m_samples.y.push_back(p.y); m_samples.z.push_back(p.z);
+                m_samples.nx.push_back(n.x); m_samples.ny.push_back(n.y); m_samples.nz.push_back(n.z);
+            }
+        }
+    }
+
+    UINT PlaneDetector::CountInliers(const PlaneDetectionSettings& settings, const XMFLOAT3& normal, float offset)
+    {
+        size_t count = m_samples.Size();
+        m_inliers.resize(count);
+        const float* x = m_samples.x.data(); const float* y = m_samples.y.data(); const float* z = m_samples.z.data();
+        const float* nx = m_samples.nx.data(); const float* ny = m_samples.ny.data(); const float* nz = m_samples.nz.data();
+        const UINT8* pFree = m_free.data();
+        UINT8* pInliers = m_inliers.data();
+        const float distanceThreshold = settings.distanceThreshold;
+        const float normalThreshold = settings.normalThreshold;
+
+        // branch-free over the sample arrays so the compiler can vectorize the loop
+        UINT inlierCount = 0;
+        for (size_t k = 0; k < count; k++)
+        {
+            float distance = fabsf(normal.x * x[k] + normal.y * y[k] + normal.z * z[k] - offset);
+            float cosAngle = normal.x * nx[k] + normal.y * ny[k] + normal.z * nz[k];
+            UINT8 inlier = (UINT8)((distance <= distanceThreshold) & (cosAngle >= normalThreshold) & (pFree[k] != 0));
+            pInliers[k] = inlier;
+            inlierCount += inlier;
+        }
+        return inlierCount;
+    }
+
+    void PlaneDetector::FitInliers(DetectedPlane& plane)
+    {
+        // plane through the inlier centroid with the mean inlier normal
+        XMFLOAT3 centroid(0, 0, 0), normalSum(0, 0, 0);
+        UINT count = 0;
+        for (size_t k = 0; k < m_inliers.size(); k++)
+        {
+            if (!m_inliers[k]) continue;
+            centroid.x += m_samples.x[k]; centroid.y += m_samples.y[k]; centroid.z += m_samples.z[k];
+            normalSum.x += m_samples.nx[k]; normalSum.y += m_samples.ny[k]; normalSum.z += m_samples.nz[k];
+            count++;
+        }
+        if (count == 0)
+        {
+            return;
+        }
+        XMVECTOR normal = XMVector3Normalize(XMLoadFloat3(&normalSum));
+        XMVECTOR center = XMLoadFloat3(&centroid) / (float)count;
+        XMStoreFloat3(&plane.normal, normal);
+        plane.offset = XMVectorGetX(XMVector3Dot(normal, center));
+        plane.inlierCount = count;
+
+        // extent along two in-plane axes
+        XMVECTOR helper = fabsf(plane.normal.y) < 0.9f ? XMVectorSet(0, 1, 0, 0) : XMVectorSet(1, 0, 0, 0);
+        XMVECTOR axisU = XMVector3Normalize(XMVector3Cross(helper, normal));
+        XMVECTOR axisV = XMVector3Cross(normal, axisU);
+        XMFLOAT3 u, v;
+        XMStoreFloat3(&u, axisU);
+        XMStoreFloat3(&v, axisV);
+        float uMin = FLT_MAX, uMax = -FLT_MAX, vMin = FLT_MAX, vMax = -FLT_MAX;
+        for (size_t k = 0; k < m_inliers.size(); k++)
+        {
+            if (!m_inliers[k]) continue;
+            float pu = u.x * m_samples.x[k] + u.y * m_samples.y[k] + u.z * m_samples.z[k];
+            float pv = v.x * m_samples.x[k] + v.y * m_samples.y[k] + v.z * m_samples.z[k];
+            uMin = (std::min)(uMin, pu); uMax = (std::max)(uMax, pu);
+            vMin = (std::min)(vMin, pv); vMax = (std::max)(vMax, pv);
+        }
+        plane.extent[0] = uMax - uMin;
+        plane.extent[1] = vMax - vMin;
+        XMStoreFloat3(&plane.center, normal * plane.offset + axisU * ((uMin + uMax) / 2) + axisV * ((vMin + vMax) / 2));
+    }
+
+    void PlaneDetector::AssignInliers()
+    {
+        for (size_t k = 0; k < m_free.size(); k++)
+        {
+            m_free[k] &= (UINT8)!m_inliers[k];
+        }
+    }
+
+    void PlaneDetector::Update(const PlaneDetectionSettings& settings, const AhatFrameParams& params, const UINT16* pDepth,
+        const XMFLOAT3* pUnitRays, const UINT8* pValidMask)
+    {
+        SamplePoints(settings, params, pDepth, pUnitRays, pValidMask);
+        m_free.assign(m_samples.Size(), 1);
+
+        // re-verify tracked planes, largest first, and refine them with their new inliers
+        std::sort(m_planes.begin(), m_planes.end(), [](const DetectedPlane& a, const DetectedPlane& b) { return a.inlierCount > b.inlierCount; });
+        int confirmed = 0;
+        for (auto& plane : m_planes)
+        {
+            if (confirmed < settings.maxPlanes && CountInliers(settings, plane.normal, plane.offset) >= settings.minInliers)
+            {
+                FitInliers(plane);
+                AssignInliers();
+                plane.missedFrames = 0;
+                confirmed++;
+            }
+            else
+            {
+                plane.missedFrames++;
+            }
+        }
+        m_planes.erase(std::remove_if(m_planes.begin(), m_planes.end(),
+            [&](const DetectedPlane& plane) { return plane.missedFrames > settings.maxMissedFrames; }), m_planes.end());
+
+        // RANSAC on the samples not explained by tracked planes, one hypothesis per oriented sample
+        std::vector<UINT> freeSamples;
+        while (confirmed < settings.maxPlanes)
+        {
+            freeSamples.clear();
+            for (UINT k = 0; k < m_free.size(); k++)
+            {
+                if (m_free[k]) freeSamples.push_back(k);
+            }
+            if (freeSamples.size() < settings.minInliers)
+            {
+                break;
+            }
+
+            UINT bestCount = 0;
+            XMFLOAT3 bestNormal(0, 0, 0);
+            float bestOffset = 0;
+            for (int iteration = 0; iteration < settings.iterations; iteration++)
+            {
+                // xorshift32
+                m_randomState ^= m_randomState << 13;
+                m_randomState ^= m_randomState >> 17;
+                m_randomState ^= m_randomState << 5;
+                UINT k = freeSamples[m_randomState % freeSamples.size()];
+                XMFLOAT3 normal(m_samples.nx[k], m_samples.ny[k], m_samples.nz[k]);
+                float offset = normal.x * m_samples.x[k] + normal.y * m_samples.y[k] + normal.z * m_samples.z[k];
+                UINT count = CountInliers(settings, normal, offset);
+                if (count > bestCount)
+                {
+                    bestCount = count;
+                    bestNormal = normal;
+                    bestOffset = offset;
+                }
+            }
+            if (bestCount < settings.minInliers)
+            {
+                break;
+            }
+
+            DetectedPlane plane;
+            CountInliers(settings, bestNormal, bestOffset);
+            FitInliers(plane);
+            AssignInliers();
+            confirmed++;
+
+            // a plane lost in recent frames keeps its id
+            auto match = std::find_if(m_planes.begin(), m_planes.end(), [&](const DetectedPlane& tracked) {
+                return tracked.missedFrames > 0 &&
+                    tracked.normal.x * plane.normal.x + tracked.normal.y * plane.normal.y + tracked.normal.z * plane.normal.z >= settings.normalThreshold &&
+                    fabsf(tracked.offset - plane.offset) <= 2 * settings.distanceThreshold;
+            });
+            if (match != m_planes.end())
+            {
+                plane.id = match->id;
+                *match = plane;
+            }
+            else
+            {
+                plane.id = m_nextId++;
+                m_planes.push_back(plane);
+            }
+        }
+    }
+
+    void PlaneDetector::Pack(std::vector<float>& packed) const
+    {
+        packed.clear();
+        for (const auto& plane : m_planes)
+        {
+            if (plane.missedFrames > 0) continue;
+            const float values[kPackedPlaneSize] = { (float)plane.id, plane.normal.x, plane.normal.y, -plane.normal.z, plane.offset,
+                plane.center.x, plane.center.y, -plane.center.z, plane.extent[0], plane.extent[1], (float)plane.inlierCount };
+            packed.insert(packed.end(), values, values + kPackedPlaneSize);
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "SensorKernels.h"
+#include <DirectXMath.h>
+#include <vector>
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    struct PlaneDetectionSettings {
+        UINT gridStep = 4;               // sample every gridStep-th pixel of the organized grid
+        float distanceThreshold = 0.02f; // Unit: m, max point to plane distance of inliers
+        float normalThreshold = 0.9f;    // min cosine between point and plane normal of inliers
+        UINT minInliers = 150;           // in samples
+        int maxPlanes = 4;
+        int iterations = 32;             // RANSAC hypotheses per new plane
+        int maxMissedFrames = 10;        // tracked planes not confirmed for longer are dropped
+    };
+
+    // Plane in world space: dot(normal, p) = offset
+    struct DetectedPlane {
+        UINT id = 0;
+        DirectX::XMFLOAT3 normal{ 0,0,0 };
+        float offset = 0;
+        DirectX::XMFLOAT3 center{ 0,0,0 };  // center of the inlier extent, on the plane
+        float extent[2]{ 0,0 };             // Unit: m, size of the inliers along two in-plane axes
+        UINT inlierCount = 0;
+        int missedFrames = 0;               // frames since the plane was last confirmed
+    };
+
+    // Plane extraction on the organized AHAT grid with tracking across frames. Each frame first re-verifies the
+    // tracked planes against the new samples and refines them; RANSAC only runs on the samples they do not explain.
+    class PlaneDetector
+    {
+    public:
+        static const size_t kPackedPlaneSize = 11;
+
+        void Reset() { m_planes.clear(); }
+
+        // Sample the pixels within params.roiImageBounds (and pValidMask if set), estimate their normals from the grid
+        // neighbors and update the plane list
+        void Update(const PlaneDetectionSettings& settings, const AhatFrameParams& params, const UINT16* pDepth,
+            const DirectX::XMFLOAT3* pUnitRays, const UINT8* pValidMask);
+
+        // Planes confirmed in the last frame as kPackedPlaneSize floats each, in output coordinates (x, y, -z):
+        // id, normal x, y, z, offset, center x, y, z, extent u, extent v, inlier count
+        void Pack(std::vector<float>& packed) const;
+
+    private:
+        // world space samples with normals, structure of arrays
+        struct Samples {
+            std::vector<float> x, y, z, nx, ny, nz;
+            void Clear() { x.clear(); y.clear(); z.clear(); nx.clear(); ny.clear(); nz.clear(); }
+            size_t Size() const { return x.size(); }
+        };
+
+        void SamplePoints(const PlaneDetectionSettings& settings, const AhatFrameParams& params, const UINT16* pDepth,
+            const DirectX::XMFLOAT3* pUnitRays, const UINT8* pValidMask);
+        UINT CountInliers(const PlaneDetectionSettings& settings, const DirectX::XMFLOAT3& normal, float offset);
+        void FitInliers(DetectedPlane& plane);
+        void AssignInliers();
+
+        Samples m_samples;
+        std::vector<UINT8> m_free;      // samples not explained by a plane of this frame
+        std::vector<UINT8> m_inliers;   // of the last CountInliers call
+        std::vector<DetectedPlane> m_planes;
+        UINT m_nextId = 1;
+        UINT32 m_randomState = 0x9E3779B9u;
+    };
+}
@@ -0,0 +1,31 @@
+#pragma once
+// The processing modules use the Windows integer types and nothing else from the Windows headers, plus debug output.
+// Off-device (the CMake build at the root of the repository) they build with DirectXMath as the only dependency.
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cwchar>
+
+typedef uint8_t BYTE;
+typedef uint8_t UINT8;
+typedef uint16_t UINT16;
+typedef uint32_t UINT32;
+typedef uint64_t UINT64;
+typedef unsigned int UINT;
+typedef int16_t INT16;
+typedef int64_t INT64;
+
+inline void OutputDebugString(const wchar_t* message)
+{
+    fputws(message, stderr);
+}
+
+inline UINT64 GetTickCount64()
+{
+    return (UINT64)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
@@ -0,0 +1,204 @@
+#include "PointCloudExporter.h"
+#include <algorithm>
+#include <sstream>
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    static const char* kFormatNames[] = { "ply", "pcd", "stream" };
+
+    void PointCloudExporter::Start(const std::filesystem::path& directory, PointCloudFileFormat format, size_t queueCapacity)
+    {
+        Stop();
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        m_directory = directory;
+        m_format = format;
+        m_queueCapacity = (std::max)(queueCapacity, (size_t)1);
+
+        if (m_format == PointCloudFileFormat::Stream)
+        {
+            auto fileName = "pointcloud_stream_" + std::to_string(GetTickCount64()) + ".bin";
+            m_stream.open(m_directory / fileName, std::ios::binary | std::ios::trunc);
+            m_stream.write("HL2PCS1", 8);
+            if (!m_stream)
+            {
+                OutputDebugString(L"Failed to open point cloud stream file\n");
+                m_writeErrors++;
+            }
+        }
+
+        m_stopRequested = false;
+        m_running = true;
+        m_thread = std::thread(&PointCloudExporter::WriterLoop, this);
+    }
+
+    void PointCloudExporter::Stop()
+    {
+        if (!m_thread.joinable())
+        {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> l(m_mutex);
+            m_stopRequested = true;
+        }
+        m_queueChanged.notify_all();
+        m_thread.join();
+        m_running = false;
+        if (m_stream.is_open())
+        {
+            m_stream.close();
+        }
+    }
+
+    bool PointCloudExporter::Submit(ExportFrame&& frame)
+    {
+        {
+            std::lock_guard<std::mutex> l(m_mutex);
+            if (!m_running || m_stopRequested || m_queue.size() >= m_queueCapacity)
+            {
+                m_framesDropped++;
+                return false;
+            }
+            m_queue.push_back(std::move(frame));
+        }
+        m_queueChanged.notify_all();
+        return true;
+    }
+
+    size_t PointCloudExporter::QueueDepth() const
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+        return m_queue.size();
+    }
+
+    void PointCloudExporter::Flush()
+    {
+        std::unique_lock<std::mutex> l(m_mutex);
+        m_queueChanged.wait(l, [this]() { return !m_running || (m_queue.empty() && !m_writing); });
+    }
+
+    void PointCloudExporter::WriterLoop()
+    {
+        std::unique_lock<std::mutex> l(m_mutex);
+        while (true)
+        {
+            m_queueChanged.wait(l, [this]() { return m_stopRequested || !m_queue.empty(); });
+            if (m_queue.empty())
+            {
+                break; // stop requested and the queue is drained
+            }
+            ExportFrame frame = std::move(m_queue.front());
+            m_queue.pop_front();
+            m_writing = true;
+
+            // write without holding the queue lock
+            l.unlock();
+            if (WriteFrame(frame))
+            {
+                m_framesWritten++;
+            }
+            else
+            {
+                m_writeErrors++;
+            }
+            l.lock();
+            m_writing = false;
+            m_queueChanged.notify_all();
+        }
+    }
+
+    bool PointCloudExporter::WriteFrame(const ExportFrame& frame)
+    {
+        switch (m_format)
+        {
+        case PointCloudFileFormat::Ply:
+            return WritePly(frame);
+        case PointCloudFileFormat::Pcd:
+            return WritePcd(frame);
+        default:
+            return WriteStreamRecord(frame);
+        }
+    }
+
+    // Header and interleaved float data of a per-frame file
+    static bool WriteFile(const std::filesystem::path& path, const std::string& header, const ExportFrame& frame, std::atomic<UINT64>& bytesWritten)
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        size_t dataSize = frame.points.size() * sizeof(float);
+        file.write(header.data(), header.size());
+        file.write(reinterpret_cast<const char*>(frame.points.data()), dataSize);
+        if (!file)
+        {
+            return false;
+        }
+        bytesWritten += header.size() + dataSize;
+        return true;
+    }
+
+    bool PointCloudExporter::WritePly(const ExportFrame& frame)
+    {
+        size_t pointCount = frame.points.size() / frame.fieldCount;
+        std::stringstream header;
+        header << "ply\nformat binary_little_endian 1.0\n"
+            << "comment frame " << frame.frameIndex << " host_ticks " << frame.hostTicks << "\n"
+            << "element vertex " << pointCount << "\n"
+            << "property float x\nproperty float y\nproperty float z\n";
+        if (frame.fieldCount > 3)
+        {
+            header << "property float " << frame.attributeName << "\n";
+        }
+        header << "end_header\n";
+        return WriteFile(m_directory / (frame.name + ".ply"), header.str(), frame, m_bytesWritten);
+    }
+
+    bool PointCloudExporter::WritePcd(const ExportFrame& frame)
+    {
+        size_t pointCount = frame.points.size() / frame.fieldCount;
+        bool hasAttribute = frame.fieldCount > 3;
+        std::stringstream header;
+        header << "# .PCD v0.7 - Point Cloud Data file format\nVERSION 0.7\n"
+            << "FIELDS x y z" << (hasAttribute ? std::string(" ") + frame.attributeName : "") << "\n"
+            << "SIZE 4 4 4" << (hasAttribute ? " 4" : "") << "\n"
+            << "TYPE F F F" << (hasAttribute ? " F" : "") << "\n"
+            << "COUNT 1 1 1" << (hasAttribute ? " 1" : "") << "\n"
+            << "WIDTH " << pointCount << "\nHEIGHT 1\nVIEWPOINT 0 0 0 1 0 0 0\n"
+            << "POINTS " << pointCount << "\nDATA binary\n";
+        return WriteFile(m_directory / (frame.name + ".pcd"), header.str(), frame, m_bytesWritten);
+    }
+
+    bool PointCloudExporter::WriteStreamRecord(const ExportFrame& frame)
+    {
+        if (!m_stream.is_open())
+        {
+            return false;
+        }
+        UINT64 recordHeader[2] = { frame.frameIndex, frame.hostTicks };
+        UINT32 counts[2] = { (UINT32)(frame.points.size() / frame.fieldCount), frame.fieldCount };
+        size_t dataSize = frame.points.size() * sizeof(float);
+        m_stream.write(reinterpret_cast<const char*>(recordHeader), sizeof(recordHeader));
+        m_stream.write(reinterpret_cast<const char*>(counts), sizeof(counts));
+        m_stream.write(reinterpret_cast<const char*>(frame.points.data()), dataSize);
+        if (!m_stream)
+        {
+            return false;
+        }
+        m_bytesWritten += sizeof(recordHeader) + sizeof(counts) + dataSize;
+        return true;
+    }
+
+    std::string PointCloudExporter::StatusJson() const
+    {
+        size_t queued = QueueDepth();
+        std::stringstream ss;
+        ss << "{\"running\":" << (m_running ? "true" : "false")
+            << ",\"format\":\"" << kFormatNames[(int)m_format] << "\""
+            << ",\"queued\":" << queued
+            << ",\"written\":" << m_framesWritten
+            << ",\"dropped\":" << m_framesDropped
+            << ",\"errors\":" << m_writeErrors
+            << ",\"bytes\":" << m_bytesWritten
+            << "}";
+        return ss.str();
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include "Platform.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    enum class PointCloudFileFormat {
+        Ply = 0,    // one binary little endian PLY file per frame
+        Pcd = 1,    // one binary PCD file per frame
+        Stream = 2, // all frames appended to one file, see PointCloudExporter
+    };
+
+    // Point cloud queued for export. points holds fieldCount floats per point: x, y, z and an optional attribute.
+    struct ExportFrame {
+        std::string name;               // file name without extension (per-file formats)
+        UINT64 frameIndex = 0;
+        UINT64 hostTicks = 0;
+        std::vector<float> points;
+        UINT fieldCount = 3;            // 3, or 4 with attribute
+        const char* attributeName = ""; // e.g. "intensity"
+    };
+
+    // Writes point clouds on a dedicated thread. Submit never blocks: frames are dropped when the bounded queue is full.
+    // The stream format starts with the 8 byte magic "HL2PCS1\0", followed by one record per frame:
+    // UINT64 frame index, UINT64 host ticks, UINT32 point count, UINT32 field count, point count * field count floats.
+    class PointCloudExporter
+    {
+    public:
+        ~PointCloudExporter() { Stop(); }
+
+        void Start(const std::filesystem::path& directory, PointCloudFileFormat format, size_t queueCapacity);
+        // Write the queued frames and stop the writer thread
+        void Stop();
+        bool IsRunning() const { return m_running; }
+        size_t QueueDepth() const;
+
+        // Returns false if the frame was dropped (queue full or exporter stopped); a dropped frame is not moved from
+        bool Submit(ExportFrame&& frame);
+        // Wait until all queued frames are written
+        void Flush();
+
+        // {"running":...,"format":...,"queued":...,"written":...,"dropped":...,"errors":...,"bytes":...}
+        std::string StatusJson() const;
+
+    private:
+        void WriterLoop();
+        bool WriteFrame(const ExportFrame& frame);
+        bool WritePly(const ExportFrame& frame);
+        bool WritePcd(const ExportFrame& frame);
+        bool WriteStreamRecord(const ExportFrame& frame);
+
+        std::filesystem::path m_directory;
+        PointCloudFileFormat m_format = PointCloudFileFormat::Ply;
+        size_t m_queueCapacity = 0;
+        std::ofstream m_stream;
+
+        std::thread m_thread;
+        mutable std::mutex m_mutex;
+        std::condition_variable m_queueChanged;
+        std::deque<ExportFrame> m_queue;
+        bool m_writing = false;
+        bool m_stopRequested = false;
+        std::atomic_bool m_running = false;
+
+        std::atomic<UINT64> m_framesWritten = 0;
+        std::atomic<UINT64> m_framesDropped = 0;
+        std::atomic<UINT64> m_writeErrors = 0;
+        std::atomic<UINT64> m_bytesWritten = 0;
+    };
+}
@@ -0,0 +1,598 @@
+#include "ProcessingBenchmark.h"
+#include "SensorKernels.h"
+#include "PlaneDetection.h"
+#include "BlobSegmentation.h"
+#include "ChangeDetection.h"
+#include "TextureNormalization.h"
+#include "VlcFeatures.h"
+#include "PointCloudExporter.h"
+#include "OccupancyMap.h"
+#include "SharedFrameRing.h"
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <sstream>
+#include <cstring>
+#include <algorithm>
+#ifdef _WIN32
+#include <winrt/base.h>
+#endif
+
+using namespace DirectX;
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    namespace
+    {
+#ifdef _WIN32
+        typedef com_array<UINT16> GetterBuffer;
+#else
+        typedef std::vector<UINT16> GetterBuffer;  // off-device stand-in for the com_array the getters return
+#endif
+
+        const UINT kAhatWidth = 512;
+        const UINT kAhatHeight = 512;
+        const UINT kLongThrowWidth = 320;
+        const UINT kLongThrowHeight = 288;
+        const UINT kVlcWidth = 640;
+        const UINT kVlcHeight = 480;
+
+        struct BenchmarkResult {
+            std::string name;
+            std::string source;
+            int frames = 0;
+            size_t pixelsPerFrame = 0;
+            double nsPerFrame = 0;
+        };
+
+        // Time processFrame over frameCount frames after one warm-up frame, return ns per frame
+        template <typename F>
+        double TimeFrames(int frameCount, F&& processFrame)
+        {
+            processFrame();
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < frameCount; i++)
+            {
+                processFrame();
+            }
+            auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+            return elapsed.count() / frameCount;
+        }
+
+        // Pinhole rays roughly matching the AHAT field of view
+        std::vector<XMFLOAT3> SyntheticUnitRays(UINT width, UINT height)
+        {
+            const float focal = 0.43f * width;
+            std::vector<XMFLOAT3> unitRays(width * height);
+            for (UINT i = 0; i < height; i++)
+            {
+                for (UINT j = 0; j < width; j++)
+                {
+                    auto pointOnUnitPlane = XMFLOAT3((j - width * 0.5f) / focal, (i - height * 0.5f) / focal, 1);
+                    XMStoreFloat3(&unitRays[width * i + j], XMVector3Normalize(XMLoadFloat3(&pointOnUnitPlane)));
+                }
+            }
+            return unitRays;
+        }
+
+        // Tilted plane between 250 and 750 mm with every 20th pixel invalid
+        void SyntheticDepthFrame(UINT width, UINT height, UINT16 invalidValue, std::vector<UINT16>& depth, std::vector<UINT16>& abImage)
+        {
+            depth.resize(width * height);
+            abImage.resize(width * height);
+            for (UINT i = 0; i < height; i++)
+            {
+                for (UINT j = 0; j < width; j++)
+                {
+                    auto idx = width * i + j;
+                    depth[idx] = (idx % 20 == 0) ? invalidValue : (UINT16)(250 + 500 * i / height);
+                    abImage[idx] = (UINT16)((i + j) * 3 % 1500);
+                }
+            }
+        }
+
+        AhatFrameParams AhatParams(UINT width, UINT height, bool useRoiFilter)
+        {
+            AhatFrameParams params;
+            params.width = width;
+            params.height = height;
+            params.depthNearClip = 200;
+            params.depthFarClip = 800;
+            params.roiImageBounds.rowBegin = (UINT)(0.2f * height) + 1;
+            params.roiImageBounds.rowEnd = (UINT)(0.5f * height);
+            params.roiImageBounds.colBegin = (UINT)(0.3f * width) + 1;
+            params.roiImageBounds.colEnd = (UINT)(0.7f * width);
+            params.roiImageBounds.depthMin = params.depthNearClip + 1;
+            params.roiImageBounds.depthMax = params.depthFarClip - 1;
+            params.centerRow = (UINT)(0.35 * height);
+            params.centerCol = (UINT)(0.5 * width);
+            XMStoreFloat4x4(&params.depthToWorld, XMMatrixIdentity());
+            params.useRoiFilter = useRoiFilter;
+            params.roiCenter = XMFLOAT3(0, -0.05f, 0.5f);
+            params.roiBound = XMFLOAT3(0.1f, 0.1f, 0.1f);
+            params.textureLayout = MakeTextureLayout(TextureMode::Full, width, height, 0, 0, 0, 0);
+            return params;
+        }
+
+        using AhatKernel = AhatFrameResult(*)(const AhatFrameParams&, const UINT16*, const UINT16*, const XMFLOAT3*,
+            const UINT8*, const AhatFrameOutputs&);
+
+        BenchmarkResult BenchmarkAhat(const char* name, const char* source, int frameCount, const AhatFrameParams& params,
+            const UINT16* pDepth, const UINT16* pAbImage, const std::vector<XMFLOAT3>& unitRays, std::vector<float>& pointCloud,
+            const FlyingPixelFilterSettings* pFlyingPixelFilter = nullptr, AhatKernel kernel = ProcessAhatFrame)
+        {
+            size_t pixelCount = params.width * params.height;
+            std::vector<UINT8> depthTexture(pixelCount);
+            std::vector<UINT8> abTexture(pixelCount);
+            std::vector<UINT8> validMask(pixelCount);
+            std::vector<UINT16> encodedPointCloud;
+            std::vector<UINT32> depthColorTexture(params.pDepthColormap ? pixelCount : 0);
+            std::vector<UINT32> abColorTexture(params.pAbColormap ? pixelCount : 0);
+
+            BenchmarkResult result{ name, source, frameCount, pixelCount };
+            result.nsPerFrame = TimeFrames(frameCount, [&]() {
+                pointCloud.clear();
+                encodedPointCloud.clear();
+                if (pFlyingPixelFilter)
+                {
+                    MarkFlyingPixels(*pFlyingPixelFilter, pDepth, pAbImage, params.width, params.height, params.roiImageBounds, validMask.data());
+                }
+                AhatFrameOutputs outputs;
+                outputs.pDepthTexture = depthTexture.data();
+                outputs.pAbTexture = abTexture.data();
+                outputs.pDepthColorTexture = depthColorTexture.data();
+                outputs.pAbColorTexture = abColorTexture.data();
+                outputs.pPointCloud = &pointCloud;
+                outputs.pEncodedPointCloud = &encodedPointCloud;
+                kernel(params, pDepth, pAbImage, unitRays.data(), pFlyingPixelFilter ? validMask.data() : nullptr, outputs);
+            });
+            return result;
+        }
+
+        // AHAT textures through the adaptive ranges: histograms counted by the pixel pass, then the range update of both streams
+        BenchmarkResult BenchmarkNormalizedTexture(int frameCount, const AhatFrameParams& params, const UINT16* pDepth,
+            const UINT16* pAbImage, const std::vector<XMFLOAT3>& unitRays, std::vector<float>& pointCloud)
+        {
+            size_t pixelCount = params.width * params.height;
+            std::vector<UINT8> depthTexture(pixelCount);
+            std::vector<UINT8> abTexture(pixelCount);
+            std::vector<UINT16> encodedPointCloud;
+            TextureNormalizationSettings settings;
+            TextureNormalizer depthNormalizer, abNormalizer;
+
+            BenchmarkResult result{ "ahat_normalized_texture", "synthetic", frameCount, pixelCount };
+            result.nsPerFrame = TimeFrames(frameCount, [&]() {
+                pointCloud.clear();
+                auto frameParams = params;
+                frameParams.pDepthTextureLut = depthNormalizer.Lut();
+                frameParams.pAbTextureLut = abNormalizer.Lut();
+                AhatFrameOutputs outputs;
+                outputs.pDepthTexture = depthTexture.data();
+                outputs.pAbTexture = abTexture.data();
+                outputs.pPointCloud = &pointCloud;
+                outputs.pEncodedPointCloud = &encodedPointCloud;
+                outputs.pDepthHistogram = depthNormalizer.BeginFrame();
+                outputs.pAbHistogram = abNormalizer.BeginFrame();
+                ProcessAhatFrame(frameParams, pDepth, pAbImage, unitRays.data(), nullptr, outputs);
+                depthNormalizer.Update(settings);
+                abNormalizer.Update(settings);
+            });
+            return result;
+        }
+
+        // Plane detection on a static scene: tracked planes are only re-verified, or detected from scratch every frame
+        std::vector<BenchmarkResult> BenchmarkPlaneDetection(int frameCount, const AhatFrameParams& params, const UINT16* pDepth,
+            const std::vector<XMFLOAT3>& unitRays)
+        {
+            size_t pixelCount = params.width * params.height;
+            PlaneDetectionSettings settings;
+            PlaneDetector detector;
+
+            BenchmarkResult tracked{ "plane_detection_tracked", "synthetic", frameCount, pixelCount };
+            detector.Update(settings, params, pDepth, unitRays.data(), nullptr);
+            tracked.nsPerFrame = TimeFrames(frameCount, [&]() {
+                detector.Update(settings, params, pDepth, unitRays.data(), nullptr);
+            });
+
+            BenchmarkResult untracked{ "plane_detection_untracked", "synthetic", frameCount, pixelCount };
+            untracked.nsPerFrame = TimeFrames(frameCount, [&]() {
+                detector.Reset();
+                detector.Update(settings, params, pDepth, unitRays.data(), nullptr);
+            });
+            return { tracked, untracked };
+        }
+
+        // Blob segmentation of the full frame at the default grid step and at full resolution
+        std::vector<BenchmarkResult> BenchmarkBlobSegmentation(int frameCount, const AhatFrameParams& params, const UINT16* pDepth,
+            const std::vector<XMFLOAT3>& unitRays)
+        {
+            size_t pixelCount = params.width * params.height;
+            BlobSegmentationSettings settings;
+            BlobSegmenter segmenter;
+
+            BenchmarkResult grid{ "blob_segmentation", "synthetic", frameCount, pixelCount };
+            grid.nsPerFrame = TimeFrames(frameCount, [&]() {
+                segmenter.Update(settings, params, pDepth, unitRays.data(), nullptr);
+            });
+
+            settings.gridStep = 1;
+            BenchmarkResult full{ "blob_segmentation_full", "synthetic", frameCount, pixelCount };
+            full.nsPerFrame = TimeFrames(frameCount, [&]() {
+                segmenter.Update(settings, params, pDepth, unitRays.data(), nullptr);
+            });
+            return { grid, full };
+        }
+
+        // Change detection of a static frame with sensor-like noise against its reference, the cost every skipped frame pays
+        BenchmarkResult BenchmarkChangeDetection(int frameCount, const UINT16* pDepth)
+        {
+            size_t pixelCount = kAhatWidth * kAhatHeight;
+            std::vector<UINT16> noisyDepth(pDepth, pDepth + pixelCount);
+            for (size_t idx = 0; idx < pixelCount; idx++)
+            {
+                if (noisyDepth[idx] <= 4090)
+                {
+                    noisyDepth[idx] += (UINT16)(idx * 7 % 5);
+                }
+            }
+            ChangeDetectionSettings settings;
+            ChangeDetector detector;
+            detector.SetReference(pDepth, kAhatWidth, kAhatHeight, XMMatrixIdentity());
+
+            BenchmarkResult result{ "change_detection", "synthetic", frameCount, pixelCount };
+            result.nsPerFrame = TimeFrames(frameCount, [&]() {
+                detector.Compare(settings, noisyDepth.data(), kAhatWidth, kAhatHeight, XMMatrixIdentity());
+            });
+            return result;
+        }
+
+        using LongThrowKernel = void(*)(const UINT16*, const BYTE*, UINT, UINT, UINT16, const TextureLayout&, UINT8*,
+            const ColormapLut*, UINT32*, const TextureLut*, UINT32*);
+
+        BenchmarkResult BenchmarkLongThrow(const char* name, int frameCount, LongThrowKernel kernel)
+        {
+            size_t pixelCount = kLongThrowWidth * kLongThrowHeight;
+            std::vector<UINT16> depth, abImage;
+            SyntheticDepthFrame(kLongThrowWidth, kLongThrowHeight, 0, depth, abImage);
+            std::vector<BYTE> sigma(pixelCount);
+            for (size_t idx = 0; idx < pixelCount; idx++)
+            {
+                sigma[idx] = (idx % 20 == 0) ? 0x80 : 0;
+            }
+            std::vector<UINT8> depthTexture(pixelCount);
+            auto textureLayout = MakeTextureLayout(TextureMode::Full, kLongThrowWidth, kLongThrowHeight, 0, 0, 0, 0);
+
+            BenchmarkResult result{ name, "synthetic", frameCount, pixelCount };
+            result.nsPerFrame = TimeFrames(frameCount, [&]() {
+                kernel(depth.data(), sigma.data(), kLongThrowWidth, kLongThrowHeight, 0, textureLayout, depthTexture.data(), nullptr, nullptr, nullptr, nullptr);
+            });
+            return result;
+        }
+
+        BenchmarkResult BenchmarkVlcCopy(int frameCount)
+        {
+            size_t pixelCount = kVlcWidth * kVlcHeight;
+            std::vector<UINT8> LFImage(pixelCount, 0x40), RFImage(pixelCount, 0x80);
+            std::vector<UINT8> LFShared(pixelCount), RFShared(pixelCount);
+            std::mutex mu;
+
+            BenchmarkResult result{ "vlc_copy", "synthetic", frameCount, 2 * pixelCount };
+            result.nsPerFrame = TimeFrames(frameCount, [&]() {
+                std::lock_guard<std::mutex> l(mu);
+                memcpy(LFShared.data(), LFImage.data(), pixelCount * sizeof(UINT8));
+                memcpy(RFShared.data(), RFImage.data(), pixelCount * sizeof(UINT8));
+            });
+            return result;
+        }
+
+        // Pyramid and FAST keypoints of one VLC image showing a grid of rectangles of varying brightness
+        BenchmarkResult BenchmarkVlcFeatures(int frameCount)
+        {
+            size_t pixelCount = kVlcWidth * kVlcHeight;
+            std::vector<UINT8> image(pixelCount);
+            for (UINT i = 0; i < kVlcHeight; i++)
+            {
+                for (UINT j = 0; j < kVlcWidth; j++)
+                {
+                    UINT block = (i / 24) * 37 + (j / 40) * 11;
+                    image[i * kVlcWidth + j] = (UINT8)(40 + (block * 53) % 160 + ((i * 7 + j * 3) & 3));
+                }
+            }
+            FeatureExtractionSettings settings;
+            VlcFeatureExtractor extractor;
+
+            BenchmarkResult result{ "vlc_features", "synthetic", frameCount, pixelCount };
+            result.nsPerFrame = TimeFrames(frameCount, [&]() {
+                extractor.Extract(settings, image.data(), kVlcWidth, kVlcHeight);
+            });
+            return result;
+        }
+
+        BenchmarkResult BenchmarkPointCloudPublish(int frameCount, const std::vector<float>& pointCloud)
+        {
+            std::vector<float> shared(kAhatWidth * kAhatHeight * 3);
+            std::mutex mu;
+
+            BenchmarkResult result{ "point_cloud_publish", "synthetic", frameCount, pointCloud.size() / 3 };
+            result.nsPerFrame = TimeFrames(frameCount, [&]() {
+                std::lock_guard<std::mutex> l(mu);
+                memcpy(shared.data(), pointCloud.data(), pointCloud.size() * sizeof(float));
+            });
+            return result;
+        }
+
+        // Occupancy map update from a full AHAT point cloud seen from the origin, and a batch of 1000 clearance rays
+        // (pixels per frame counts the rays) against the resulting map
+        std::vector<BenchmarkResult> BenchmarkOccupancyMap(int frameCount, const std::vector<float>& pointCloud)
+        {
+            OccupancyMap map;
+            map.Configure(OccupancyMapSettings());
+            const XMFLOAT3 sensorPosition(0, 0, 0);
+
+            BenchmarkResult integrate{ "occupancy_integrate", "synthetic", frameCount, pointCloud.size() / 3 };
+            integrate.nsPerFrame = TimeFrames(frameCount, [&]() {
+                map.Integrate(pointCloud.data(), pointCloud.size() / 3, sensorPosition);
+            });
+
+            const size_t rayCount = 1000;
+            std::vector<float> rays(rayCount * 6), results(rayCount * OccupancyMap::kRayResultSize);
+            for (size_t k = 0; k < rayCount; k++)
+            {
+                const float* p = pointCloud.data() + 3 * ((k * 7919) % (pointCloud.size() / 3));
+                float ray[6] = { 0, 0, 0, p[0], p[1], p[2] };
+                std::copy(ray, ray + 6, rays.begin() + 6 * k);
+            }
+            BenchmarkResult query{ "occupancy_ray_query", "synthetic", frameCount, rayCount };
+            query.nsPerFrame = TimeFrames(frameCount, [&]() {
+                map.QueryRays(rays.data(), rayCount, 2.0f, results.data());
+            });
+            return { integrate, query };
+        }
+
+        // Disk throughput of the background writer: frames are queued as fast as the bounded queue accepts them, the time
+        // includes writing out the last frame
+        std::vector<BenchmarkResult> BenchmarkPointCloudExport(int frameCount, const std::vector<float>& pointCloud, const std::wstring& exportDirectory)
+        {
+            std::vector<BenchmarkResult> results;
+            auto directory = std::filesystem::path(exportDirectory) / L"benchmark_export";
+            const std::pair<const char*, PointCloudFileFormat> formats[] = {
+                { "point_cloud_export_ply", PointCloudFileFormat::Ply },
+                { "point_cloud_export_pcd", PointCloudFileFormat::Pcd },
+                { "point_cloud_export_stream", PointCloudFileFormat::Stream },
+            };
+            for (const auto& format : formats)
+            {
+                PointCloudExporter exporter;
+                exporter.Start(directory, format.second, 4);
+
+                auto start = std::chrono::steady_clock::now();
+                for (int i = 0; i < frameCount; i++)
+                {
+                    ExportFrame frame;
+                    frame.name = "benchmark_" + std::to_string(i);
+                    frame.frameIndex = i;
+                    frame.points = pointCloud;
+                    while (!exporter.Submit(std::move(frame)))
+                    {
+                        exporter.Flush();
+                    }
+                }
+                exporter.Flush();
+                auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+                exporter.Stop();
+
+                BenchmarkResult result{ format.first, "synthetic", frameCount, pointCloud.size() / 3 };
+                result.nsPerFrame = elapsed.count() / frameCount;
+                results.push_back(result);
+            }
+
+            std::error_code error;
+            std::filesystem::remove_all(directory, error);
+            return results;
+        }
+
+        // Publishing AHAT depth and AbImage into a shared memory ring, as the depth loop does with the transport on
+        BenchmarkResult BenchmarkSharedRingPublish(int frameCount, const std::vector<UINT16>& depth, const std::vector<UINT16>& abImage,
+            const std::wstring& exportDirectory)
+        {
+            auto directory = std::filesystem::path(exportDirectory) / L"benchmark_ring";
+            std::error_code error;
+            std::filesystem::create_directories(directory, error);
+
+            BenchmarkResult result{ "shared_ring_publish", "synthetic", frameCount, depth.size() };
+            {
+                SharedFrameRing ring;
+                if (ring.Create(directory / L"benchmark.ring", SharedRingStream::Depth, 4, 2 * depth.size() * sizeof(UINT16)))
+                {
+                    SharedFrameInfo info;
+                    info.width = kAhatWidth;
+                    info.height = kAhatHeight;
+                    SharedFramePlane planes[] = { { depth.data(), sizeof(UINT16) }, { abImage.data(), sizeof(UINT16) } };
+                    result.nsPerFrame = TimeFrames(frameCount, [&]() {
+                        ring.Publish(info, planes, 2);
+                        info.frameIndex++;
+                    });
+                }
+            }
+            std::filesystem::remove_all(directory, error);
+            return result;
+        }
+
+        // Consumer copies out of the shared buffer into a com_array (as the Get*Buffer getters do)
+        // while a producer thread keeps publishing frames under the same mutex
+        BenchmarkResult BenchmarkGetterContention(int frameCount)
+        {
+            size_t pixelCount = kAhatWidth * kAhatHeight;
+            std::vector<UINT16> depth, abImage;
+            SyntheticDepthFrame(kAhatWidth, kAhatHeight, 0, depth, abImage);
+            std::vector<UINT16> shared(pixelCount);
+            std::mutex mu;
+            std::atomic_bool producerRunning = true;
+
+            std::thread producer([&]() {
+                while (producerRunning)
+                {
+                    {
+                        std::lock_guard<std::mutex> l(mu);
+                        memcpy(shared.data(), depth.data(), pixelCount * sizeof(UINT16));
+                    }
+                    std::this_thread::yield();
+                }
+            });
+
+            BenchmarkResult result{ "getter_contention", "synthetic", frameCount, pixelCount };
+            result.nsPerFrame = TimeFrames(frameCount, [&]() {
+                std::lock_guard<std::mutex> l(mu);
+                GetterBuffer tempBuffer = GetterBuffer(shared.data(), shared.data() + pixelCount);
+            });
+
+            producerRunning = false;
+            producer.join();
+            return result;
+        }
+
+        std::string ToJson(const std::vector<BenchmarkResult>& results)
+        {
+            std::stringstream ss;
+            ss << "{\"benchmarks\":[";
+            for (size_t i = 0; i < results.size(); i++)
+            {
+                const auto& r = results[i];
+                ss << (i ? "," : "") << "{\"name\":\"" << r.name << "\""
+                    << ",\"source\":\"" << r.source << "\""
+                    << ",\"frames\":" << r.frames
+                    << ",\"pixels_per_frame\":" << r.pixelsPerFrame
+                    << ",\"ns_per_frame\":" << r.nsPerFrame
+                    << ",\"frames_per_second\":" << (r.nsPerFrame > 0 ? 1e9 / r.nsPerFrame : 0)
+                    << ",\"ns_per_pixel\":" << (r.pixelsPerFrame > 0 ? r.nsPerFrame / r.pixelsPerFrame : 0)
+                    << "}";
+            }
+            ss << "]}";
+            return ss.str();
+        }
+    }
+
+    std::string BenchmarkProcessingKernels(int frameCount, const RecordedAhatFrame* pRecordedFrame, const std::wstring& exportDirectory)
+    {
+        frameCount = (std::max)(frameCount, 1);
+        std::vector<BenchmarkResult> results;
+
+        std::vector<UINT16> depth, abImage;
+        SyntheticDepthFrame(kAhatWidth, kAhatHeight, 4095, depth, abImage);
+        auto unitRays = SyntheticUnitRays(kAhatWidth, kAhatHeight);
+        std::vector<float> pointCloud;
+
+        results.push_back(BenchmarkAhat("ahat", "synthetic", frameCount, AhatParams(kAhatWidth, kAhatHeight, false),
+            depth.data(), abImage.data(), unitRays, pointCloud));
+        auto fullPointCloud = pointCloud;
+        results.push_back(BenchmarkAhat("ahat_roi_filter", "synthetic", frameCount, AhatParams(kAhatWidth, kAhatHeight, true),
+            depth.data(), abImage.data(), unitRays, pointCloud));
+        auto halfParams = AhatParams(kAhatWidth, kAhatHeight, false);
+        halfParams.pointCloudFormat = PointCloudFormat::Half;
+        results.push_back(BenchmarkAhat("ahat_half_output", "synthetic", frameCount, halfParams,
+            depth.data(), abImage.data(), unitRays, pointCloud));
+        auto quarterTextureParams = AhatParams(kAhatWidth, kAhatHeight, false);
+        quarterTextureParams.textureLayout = MakeTextureLayout(TextureMode::Quarter, kAhatWidth, kAhatHeight, 0, 0, 0, 0);
+        results.push_back(BenchmarkAhat("ahat_quarter_texture", "synthetic", frameCount, quarterTextureParams,
+            depth.data(), abImage.data(), unitRays, pointCloud));
+        auto noTextureParams = AhatParams(kAhatWidth, kAhatHeight, false);
+        noTextureParams.textureLayout = MakeTextureLayout(TextureMode::Off, kAhatWidth, kAhatHeight, 0, 0, 0, 0);
+        results.push_back(BenchmarkAhat("ahat_no_texture", "synthetic", frameCount, noTextureParams,
+            depth.data(), abImage.data(), unitRays, pointCloud));
+        ColormapLut depthColormap, abColormap;
+        depthColormap.Build(Colormap::Turbo, 200, 1000);
+        abColormap.Build(Colormap::Grayscale, 0, 1000);
+        auto colormapParams = AhatParams(kAhatWidth, kAhatHeight, false);
+        colormapParams.pDepthColormap = &depthColormap;
+        colormapParams.pAbColormap = &abColormap;
+        results.push_back(BenchmarkAhat("ahat_colormap_texture", "synthetic", frameCount, colormapParams,
+            depth.data(), abImage.data(), unitRays, pointCloud));
+        FlyingPixelFilterSettings flyingPixelFilter;
+        results.push_back(BenchmarkAhat("ahat_flying_pixel_filter", "synthetic", frameCount, AhatParams(kAhatWidth, kAhatHeight, false),
+            depth.data(), abImage.data(), unitRays, pointCloud, &flyingPixelFilter));
+        results.push_back(BenchmarkNormalizedTexture(frameCount, AhatParams(kAhatWidth, kAhatHeight, false),
+            depth.data(), abImage.data(), unitRays, pointCloud));
+
+        // the same settings through the generic per-pixel branching loop
+        results.push_back(BenchmarkAhat("ahat_generic", "synthetic", frameCount, AhatParams(kAhatWidth, kAhatHeight, false),
+            depth.data(), abImage.data(), unitRays, pointCloud, nullptr, ProcessAhatFrameGeneric));
+        results.push_back(BenchmarkAhat("ahat_roi_filter_generic", "synthetic", frameCount, AhatParams(kAhatWidth, kAhatHeight, true),
+            depth.data(), abImage.data(), unitRays, pointCloud, nullptr, ProcessAhatFrameGeneric));
+        results.push_back(BenchmarkAhat("ahat_half_output_generic", "synthetic", frameCount, halfParams,
+            depth.data(), abImage.data(), unitRays, pointCloud, nullptr, ProcessAhatFrameGeneric));
+        results.push_back(BenchmarkAhat("ahat_no_texture_generic", "synthetic", frameCount, noTextureParams,
+            depth.data(), abImage.data(), unitRays, pointCloud, nullptr, ProcessAhatFrameGeneric));
+        results.push_back(BenchmarkAhat("ahat_colormap_texture_generic", "synthetic", frameCount, colormapParams,
+            depth.data(), abImage.data(), unitRays, pointCloud, nullptr, ProcessAhatFrameGeneric));
+        results.push_back(BenchmarkAhat("ahat_flying_pixel_filter_generic", "synthetic", frameCount, AhatParams(kAhatWidth, kAhatHeight, false),
+            depth.data(), abImage.data(), unitRays, pointCloud, &flyingPixelFilter, ProcessAhatFrameGeneric));
+
+        for (const auto& result : BenchmarkPlaneDetection(frameCount, AhatParams(kAhatWidth, kAhatHeight, false), depth.data(), unitRays))
+        {
+            results.push_back(result);
+        }
+        for (const auto& result : BenchmarkBlobSegmentation(frameCount, AhatParams(kAhatWidth, kAhatHeight, false), depth.data(), unitRays))
+        {
+            results.push_back(result);
+        }
+        results.push_back(BenchmarkChangeDetection(frameCount, depth.data()));
+
+        if (pRecordedFrame && pRecordedFrame->pDepth && pRecordedFrame->pAbImage && pRecordedFrame->pUnitRays)
+        {
+            size_t pixelCount = pRecordedFrame->width * pRecordedFrame->height;
+            std::vector<XMFLOAT3> recordedRays(pRecordedFrame->pUnitRays, pRecordedFrame->pUnitRays + pixelCount);
+            results.push_back(BenchmarkAhat("ahat", "recorded", frameCount, AhatParams(pRecordedFrame->width, pRecordedFrame->height, false),
+                pRecordedFrame->pDepth, pRecordedFrame->pAbImage, recordedRays, pointCloud));
+        }
+
+        results.push_back(BenchmarkLongThrow("long_throw", frameCount, ProcessLongThrowFrame));
+        results.push_back(BenchmarkLongThrow("long_throw_generic", frameCount, ProcessLongThrowFrameGeneric));
+        results.push_back(BenchmarkVlcCopy(frameCount));
+        results.push_back(BenchmarkVlcFeatures(frameCount));
+        results.push_back(BenchmarkPointCloudPublish(frameCount, fullPointCloud));
+        if (!fullPointCloud.empty())
+        {
+            for (const auto& result : BenchmarkOccupancyMap(frameCount, fullPointCloud))
+            {
+                results.push_back(result);
+            }
+        }
+        results.push_back(BenchmarkGetterContention(frameCount));
+
+        if (!exportDirectory.empty())
+        {
+            for (const auto& result : BenchmarkPointCloudExport(frameCount, fullPointCloud, exportDirectory))
+            {
+                results.push_back(result);
+            }
+            results.push_back(BenchmarkSharedRingPublish(frameCount, depth, abImage, exportDirectory));
+        }
+
+        return ToJson(results);
+    }
+
+    std::string SimulateGovernorLoad(const GovernorSettings& settings, int framesPerPhase)
+    {
+        auto phases = SimulateGovernorPhases(settings, framesPerPhase);
+        std::stringstream ss;
+        ss << "{\"phases\":[";
+        for (size_t p = 0; p < phases.size(); p++)
+        {
+            const auto& phase = phases[p];
+            ss << (p ? "," : "") << "{\"name\":\"" << phase.name << "\""
+                << ",\"frames\":" << phase.frames
+                << ",\"processed\":" << phase.processed
+                << ",\"skipped\":" << phase.skipped
+                << ",\"over_budget\":" << phase.overBudget
+                << ",\"mean_load\":" << phase.meanLoad
+                << ",\"frames_per_level\":[" << phase.framesPerLevel[0] << "," << phase.framesPerLevel[1] << ","
+                << phase.framesPerLevel[2] << "," << phase.framesPerLevel[3] << "]"
+                << ",\"governor\":" << phase.governorStatus
+                << "}";
+        }
+        ss << "]}";
+        return ss.str();
+    }
+}
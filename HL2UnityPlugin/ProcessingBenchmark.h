@@ -0,0 +1,33 @@
+#pragma once
+#include "ProcessingGovernor.h"
+#include "Platform.h"
+#include <DirectXMath.h>
+#include <string>
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    // AHAT frame recorded from the running sensor loop, used in addition to the synthetic frames
+    struct RecordedAhatFrame {
+        const UINT16* pDepth = nullptr;
+        const UINT16* pAbImage = nullptr;
+        const DirectX::XMFLOAT3* pUnitRays = nullptr;
+        UINT width = 0;
+        UINT height = 0;
+    };
+
+    // Run the sensor processing kernels over frameCount frames per case and report the results as JSON:
+    // {"benchmarks":[{"name":...,"source":...,"frames":...,"pixels_per_frame":...,"frames_per_second":...,"ns_per_pixel":...}]}
+    // Cases: AHAT frame processing (plain, Roi filter, half output, quarter, colormapped and no texture, flying pixel
+    // filter, adaptive texture ranges) and the same AHAT and long-throw cases through the generic loop (suffix _generic)
+    // for comparison with the specialized kernels, plane detection with and without tracking, blob segmentation on the
+    // grid and at full resolution, change detection of a static frame, long-throw masking and texture, VLC copy, VLC
+    // pyramid and FAST keypoints, point cloud publication, occupancy map update and ray queries, and buffer getters under
+    // contention with a publishing thread. If exportDirectory is set, also point cloud export throughput per file format
+    // and shared memory ring publishing, using a temporary folder in exportDirectory.
+    std::string BenchmarkProcessingKernels(int frameCount, const RecordedAhatFrame* pRecordedFrame, const std::wstring& exportDirectory);
+
+    // SimulateGovernorPhases reported per phase as JSON:
+    // {"phases":[{"name":...,"frames":...,"processed":...,"skipped":...,"over_budget":...,"mean_load":...,
+    // "frames_per_level":[full, half, quarter, texture only],"governor":{...}}]}
+    std::string SimulateGovernorLoad(const GovernorSettings& settings, int framesPerPhase);
+}
@@ -0,0 +1,231 @@
+#include "ProcessingGovernor.h"
+#include <algorithm>
+#include <sstream>
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    static const char* kLevelNames[] = { "full", "half_point_cloud", "quarter_point_cloud", "texture_only" };
+
+    UINT ProcessingGovernor::PointCloudStep(ProcessingLevel level)
+    {
+        static const UINT steps[] = { 1, 2, 4, 0 };
+        return steps[(int)level];
+    }
+
+    void ProcessingGovernor::Configure(const GovernorSettings& settings)
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+        m_settings = settings;
+        ResetLocked();
+    }
+
+    void ProcessingGovernor::Reset()
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+        ResetLocked();
+    }
+
+    void ProcessingGovernor::ResetLocked()
+    {
+        m_level = ProcessingLevel::Full;
+        m_lastHostTicks = 0;
+        m_frameIntervalUs = 0;
+        m_load = 0;
+        m_loadValid = false;
+        m_consumedRatio = 1;
+        m_queueOverloaded = false;
+        m_overloadFrames = 0;
+        m_headroomFrames = 0;
+        m_framesAtLevel = 0;
+        m_recoverBackoff = 1;
+        m_recovered = false;
+        m_consecutiveSkips = 0;
+        m_processed = 0;
+        m_skipped = 0;
+        m_degrades = 0;
+        m_recoveries = 0;
+    }
+
+    GovernorDecision ProcessingGovernor::Decide(const GovernorInput& input)
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+
+        // frame interval from the sensor clock, gaps of a second or more (stream restarts) are ignored
+        if (m_lastHostTicks != 0 && input.hostTicks > m_lastHostTicks && input.hostTicks - m_lastHostTicks < 10000000)
+        {
+            float intervalUs = (input.hostTicks - m_lastHostTicks) / 10.0f;
+            m_frameIntervalUs = m_frameIntervalUs > 0 ? 0.9f * m_frameIntervalUs + 0.1f * intervalUs : intervalUs;
+        }
+        m_lastHostTicks = input.hostTicks;
+        m_consumedRatio = 0.95f * m_consumedRatio + 0.05f * (input.previousConsumed ? 1.0f : 0.0f);
+        m_queueOverloaded = input.queueDepth >= m_settings.maxQueueDepth;
+
+        GovernorDecision decision;
+        decision.level = m_level;
+        decision.pointCloudStep = PointCloudStep(m_level);
+        if (m_settings.skipUnconsumedFrames && !input.needsEveryFrame && !input.previousConsumed &&
+            m_consecutiveSkips < m_settings.maxConsecutiveSkips)
+        {
+            decision.process = false;
+            m_consecutiveSkips++;
+            m_skipped++;
+        }
+        else
+        {
+            m_consecutiveSkips = 0;
+        }
+        return decision;
+    }
+
+    void ProcessingGovernor::RecordProcessTime(float processUs)
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+        m_processed++;
+        m_framesAtLevel++;
+        if (m_frameIntervalUs <= 0)
+        {
+            return;
+        }
+
+        float load = processUs / m_frameIntervalUs;
+        m_load = m_loadValid ? 0.8f * m_load + 0.2f * load : load;
+        m_loadValid = true;
+
+        if (m_load > m_settings.loadBudget || m_queueOverloaded)
+        {
+            m_overloadFrames++;
+            m_headroomFrames = 0;
+        }
+        else if (m_load < m_settings.recoverLoad)
+        {
+            m_headroomFrames++;
+            m_overloadFrames = 0;
+        }
+        else
+        {
+            m_overloadFrames = 0;
+            m_headroomFrames = 0;
+        }
+
+        if (m_recovered && m_framesAtLevel >= m_settings.recoverFrames)
+        {
+            // the recovered level held, recover at the normal pace again
+            m_recoverBackoff = 1;
+            m_recovered = false;
+        }
+
+        if (m_overloadFrames >= m_settings.degradeFrames && m_level != ProcessingLevel::TextureOnly)
+        {
+            if (m_recovered)
+            {
+                m_recoverBackoff = (std::min)(m_recoverBackoff * 2, 8);
+            }
+            ChangeLevel(1);
+            m_degrades++;
+            m_recovered = false;
+        }
+        else if (m_headroomFrames >= m_settings.recoverFrames * m_recoverBackoff && m_level != ProcessingLevel::Full)
+        {
+            ChangeLevel(-1);
+            m_recoveries++;
+            m_recovered = true;
+        }
+    }
+
+    void ProcessingGovernor::ChangeLevel(int delta)
+    {
+        // the averaged load belongs to the previous level
+        m_level = (ProcessingLevel)((int)m_level + delta);
+        m_loadValid = false;
+        m_overloadFrames = 0;
+        m_headroomFrames = 0;
+        m_framesAtLevel = 0;
+    }
+
+    std::string ProcessingGovernor::StatusJson() const
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+        float frameRate = m_frameIntervalUs > 0 ? 1e6f / m_frameIntervalUs : 0;
+        std::stringstream ss;
+        ss << "{\"level\":\"" << kLevelNames[(int)m_level] << "\""
+            << ",\"load\":" << m_load
+            << ",\"frame_interval_us\":" << m_frameIntervalUs
+            << ",\"consumer_fps\":" << frameRate * m_consumedRatio
+            << ",\"processed\":" << m_processed
+            << ",\"skipped\":" << m_skipped
+            << ",\"degrades\":" << m_degrades
+            << ",\"recoveries\":" << m_recoveries
+            << "}";
+        return ss.str();
+    }
+
+    std::vector<GovernorPhaseResult> SimulateGovernorPhases(const GovernorSettings& settings, int framesPerPhase)
+    {
+        struct Phase {
+            const char* name;
+            float costScale;
+            float consumerFps;
+        };
+        const Phase phases[] = {
+            { "nominal", 1, 45 },
+            { "slow_consumer", 1, 10 },
+            { "thermal_throttle", 3, 45 },
+            { "recovered", 1, 45 },
+        };
+        const UINT64 frameTicks = 222222;       // 45 fps, Unit: 100 ns
+        const float frameIntervalUs = frameTicks / 10.0f;
+        const float textureUs = 1500;           // modelled cost of a full processing level frame
+        const float pointCloudUs = 4500;
+        framesPerPhase = (std::max)(framesPerPhase, 1);
+
+        ProcessingGovernor governor;
+        governor.Configure(settings);
+        UINT64 hostTicks = frameTicks;
+        UINT64 nextFetchTicks = 0;
+        bool unread = false;
+
+        std::vector<GovernorPhaseResult> results;
+        for (const auto& phase : phases)
+        {
+            GovernorPhaseResult result;
+            result.name = phase.name;
+            result.frames = framesPerPhase;
+            UINT64 fetchTicks = (UINT64)(1e7f / phase.consumerFps);
+            double loadSum = 0;
+            for (int i = 0; i < framesPerPhase; i++, hostTicks += frameTicks)
+            {
+                // the consumer fetches the last published frame on its own clock
+                while (nextFetchTicks <= hostTicks)
+                {
+                    unread = false;
+                    nextFetchTicks += fetchTicks;
+                }
+
+                GovernorInput input;
+                input.hostTicks = hostTicks;
+                input.previousConsumed = !unread;
+                auto decision = governor.Decide(input);
+                result.framesPerLevel[(int)decision.level]++;
+                result.endLevel = decision.level;
+                if (!decision.process)
+                {
+                    result.skipped++;
+                    continue;
+                }
+
+                float pointFraction = decision.pointCloudStep ? 1.0f / (decision.pointCloudStep * decision.pointCloudStep) : 0;
+                float processUs = phase.costScale * (textureUs + pointCloudUs * pointFraction);
+                governor.RecordProcessTime(processUs);
+                float load = processUs / frameIntervalUs;
+                loadSum += load;
+                result.overBudget += load > settings.loadBudget;
+                result.processed++;
+                unread = true;
+            }
+            result.meanLoad = result.processed > 0 ? loadSum / result.processed : 0;
+            result.governorStatus = governor.StatusJson();
+            results.push_back(result);
+        }
+        return results;
+    }
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include "Platform.h"
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    // AHAT processing levels, from the most to the least work per frame
+    enum class ProcessingLevel {
+        Full = 0,               // point cloud from every pixel
+        HalfPointCloud = 1,     // every 2nd row and column
+        QuarterPointCloud = 2,  // every 4th row and column
+        TextureOnly = 3,        // no point cloud
+    };
+
+    struct GovernorSettings {
+        float loadBudget = 0.6f;        // processing time per frame interval above which the level drops
+        float recoverLoad = 0.3f;       // processing time per frame interval below which the level rises again
+        int degradeFrames = 5;          // consecutive frames over budget before dropping a level
+        int recoverFrames = 90;         // consecutive frames under recoverLoad before rising a level
+        bool skipUnconsumedFrames = true;
+        int maxConsecutiveSkips = 3;    // process at least every (maxConsecutiveSkips + 1)-th frame, for consumers that do not clear the updated flags
+        size_t maxQueueDepth = 4;       // queued export frames counted as overload
+    };
+
+    struct GovernorInput {
+        UINT64 hostTicks = 0;           // sensor timestamp of the frame, Unit: 100 ns
+        bool previousConsumed = true;   // the last published frame was fetched by the consumer
+        bool needsEveryFrame = false;   // in-process consumers (frame views, world map, export) use every processed frame
+        size_t queueDepth = 0;          // frames waiting in the export queue
+    };
+
+    struct GovernorDecision {
+        bool process = true;
+        ProcessingLevel level = ProcessingLevel::Full;
+        UINT pointCloudStep = 1;        // for AhatFrameParams::pointCloudStep
+    };
+
+    // Adapts the AHAT processing to the available budget. Frames are skipped while the consumer has not fetched the last
+    // published one, and the processing level drops one step after sustained overload (processing time relative to the
+    // sensor frame interval, which also rises under thermal throttling, or a full export queue). The level rises again
+    // after a longer period with headroom; recovering into overload doubles that period, up to 8 times.
+    // Uses sensor timestamps and measured durations only, so it can be driven by a synthetic load.
+    class ProcessingGovernor
+    {
+    public:
+        // Changes the settings and restarts at full processing
+        void Configure(const GovernorSettings& settings);
+        void Reset();
+
+        // Called for each sensor frame before processing
+        GovernorDecision Decide(const GovernorInput& input);
+        // Called after each processed frame with the duration of the processing stage
+        void RecordProcessTime(float processUs);
+
+        // {"level":...,"load":...,"frame_interval_us":...,"consumer_fps":...,"processed":...,"skipped":...,"degrades":...,"recoveries":...}
+        std::string StatusJson() const;
+
+        static UINT PointCloudStep(ProcessingLevel level);
+
+    private:
+        void ResetLocked();
+        void ChangeLevel(int delta);
+
+        mutable std::mutex m_mutex;
+        GovernorSettings m_settings;
+        ProcessingLevel m_level = ProcessingLevel::Full;
+        UINT64 m_lastHostTicks = 0;
+        float m_frameIntervalUs = 0;    // averaged
+        float m_load = 0;               // averaged at the current level
+        bool m_loadValid = false;
+        float m_consumedRatio = 1;      // averaged fraction of published frames fetched before the next frame
+        bool m_queueOverloaded = false;
+        int m_overloadFrames = 0;
+        int m_headroomFrames = 0;
+        int m_framesAtLevel = 0;
+        int m_recoverBackoff = 1;
+        bool m_recovered = false;       // the current level was reached by recovering
+        int m_consecutiveSkips = 0;
+        UINT64 m_processed = 0;
+        UINT64 m_skipped = 0;
+        UINT64 m_degrades = 0;
+        UINT64 m_recoveries = 0;
+    };
+
+    // One load phase of SimulateGovernorPhases
+    struct GovernorPhaseResult {
+        const char* name = "";
+        int frames = 0;
+        int processed = 0;
+        int skipped = 0;
+        int overBudget = 0;             // processed frames with a load above loadBudget
+        double meanLoad = 0;            // of the processed frames
+        int framesPerLevel[4]{};        // decisions per ProcessingLevel
+        ProcessingLevel endLevel = ProcessingLevel::Full;
+        std::string governorStatus;     // StatusJson at the end of the phase
+    };
+
+    // Drive a ProcessingGovernor with a synthetic 45 fps AHAT stream over four phases of framesPerPhase frames: nominal,
+    // slow consumer (10 fps), thermal throttling (3x processing cost) and recovered. Processing cost is modelled per
+    // level from a fixed texture and a point cloud part.
+    std::vector<GovernorPhaseResult> SimulateGovernorPhases(const GovernorSettings& settings, int framesPerPhase);
+}
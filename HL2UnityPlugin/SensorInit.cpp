@@ -0,0 +1,91 @@
+#include "SensorInit.h"
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    static bool IsReady(const std::shared_future<void>& task)
+    {
+        return task.valid() && task.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    void SensorInitScheduler::OpenDevice(std::function<void()> open)
+    {
+        m_deviceReady = std::async(std::launch::async, std::move(open)).share();
+    }
+
+    void SensorInitScheduler::WaitForDevice() const
+    {
+        m_deviceReady.get();
+    }
+
+    void SensorInitScheduler::Launch(int stream, std::function<void()> acquire)
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+        auto& task = m_tasks[stream];
+        if (task.valid())
+        {
+            return;
+        }
+        task = std::async(std::launch::async, [this, deviceReady = m_deviceReady, acquire = std::move(acquire)]() {
+            deviceReady.get();
+            std::lock_guard<std::mutex> device(m_deviceMutex);
+            acquire();
+        }).share();
+    }
+
+    bool SensorInitScheduler::Wait(int stream) const
+    {
+        std::shared_future<void> task;
+        {
+            std::lock_guard<std::mutex> l(m_mutex);
+            task = m_tasks[stream];
+        }
+        if (!task.valid())
+        {
+            return false;
+        }
+        task.get();
+        return true;
+    }
+
+    bool SensorInitScheduler::Ready(int stream) const
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+        return IsReady(m_tasks[stream]);
+    }
+
+    bool SensorInitScheduler::AllReady() const
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+        for (const auto& task : m_tasks)
+        {
+            if (task.valid() && !IsReady(task))
+            {
+                return false;
+            }
+        }
+        return IsReady(m_deviceReady);
+    }
+
+    void SensorInitScheduler::Release()
+    {
+        std::shared_future<void> tasks[kStreams];
+        {
+            std::lock_guard<std::mutex> l(m_mutex);
+            for (int i = 0; i < kStreams; i++)
+            {
+                tasks[i] = std::move(m_tasks[i]);
+            }
+        }
+        for (const auto& task : tasks)
+        {
+            if (task.valid())
+            {
+                task.wait();
+            }
+        }
+        if (m_deviceReady.valid())
+        {
+            m_deviceReady.wait();
+        }
+    }
+}
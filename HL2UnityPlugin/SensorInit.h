@@ -0,0 +1,41 @@
+#pragma once
+#include <functional>
+#include <future>
+#include <mutex>
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    // Acquires the sensors of the streams off the calling threads. The device is opened once on a thread of its own, so
+    // loading the library, requesting the camera consent and enumerating the sensors overlap with the callers. The
+    // acquisition of each stream waits for the open on its own thread and then runs with the device lock held: the
+    // Research Mode API does not document GetSensor or the sensor interfaces as safe for concurrent calls, so the
+    // acquisitions of the streams run one at a time.
+    class SensorInitScheduler
+    {
+    public:
+        static const int kStreams = 3;  // indexed by SensorStream
+
+        // Starts opening the device and returns right away; called once, before Launch
+        void OpenDevice(std::function<void()> open);
+        // Rethrows errors of the open
+        void WaitForDevice() const;
+
+        // Starts the acquisition of a stream and returns right away, unless it was started since the last Release.
+        // acquire runs after the device is open, with the device lock held; not at all if the open failed.
+        void Launch(int stream, std::function<void()> acquire);
+        // Rethrows errors of the open or the acquisition; false if the stream was not launched since the last Release
+        bool Wait(int stream) const;
+        bool Ready(int stream) const;
+        // True once the device is open and the acquisitions launched are done
+        bool AllReady() const;
+        // Waits for the open and the acquisitions in flight, and forgets the acquisitions
+        void Release();
+
+    private:
+        mutable std::mutex m_mutex;     // guards m_tasks, never held while waiting
+        std::mutex m_deviceMutex;       // held by the acquisitions
+        // declared last so they are destroyed first, waiting for the tasks still using the mutexes
+        std::shared_future<void> m_deviceReady;
+        std::shared_future<void> m_tasks[kStreams];
+    };
+}
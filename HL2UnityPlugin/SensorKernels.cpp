@@ -0,0 +1,413 @@
+#include "SensorKernels.h"
+#include "SensorPipeline.h"
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+
+using namespace DirectX;
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    // Depth and world point of the center pixel, independent of the Roi filter
+    static AhatFrameResult CenterPoint(const AhatFrameParams& params, const UINT16* pDepth, const XMFLOAT3* pUnitRays)
+    {
+        AhatFrameResult result;
+        auto centerIdx = params.width * params.centerRow + params.centerCol;
+        UINT16 centerDepth = pDepth[centerIdx];
+        result.centerDepth = (centerDepth > 4090) ? 0 : centerDepth - params.depthOffset;
+        if (result.centerDepth > params.depthNearClip && result.centerDepth < params.depthFarClip && pUnitRays[centerIdx].z != 0)
+        {
+            auto centerInWorld = XMVector3Transform((float)result.centerDepth / 1000 * XMLoadFloat3(&pUnitRays[centerIdx]), XMLoadFloat4x4(&params.depthToWorld));
+            result.centerPointValid = true;
+            result.centerPoint[0] = XMVectorGetX(centerInWorld);
+            result.centerPoint[1] = XMVectorGetY(centerInWorld);
+            result.centerPoint[2] = -XMVectorGetZ(centerInWorld);
+        }
+        return result;
+    }
+
+    AhatFrameResult ProcessAhatFrame(const AhatFrameParams& params, const UINT16* pDepth, const UINT16* pAbImage,
+        const XMFLOAT3* pUnitRays, const UINT8* pValidMask, const AhatFrameOutputs& outputs)
+    {
+        DepthFrameInput input;
+        input.pDepth = pDepth;
+        input.pAbImage = pAbImage;
+        input.pUnitRays = pUnitRays;
+        input.pValidMask = pValidMask;
+        bool texture = params.textureLayout.mode != TextureMode::Off;
+        bool normalized = params.pDepthTextureLut && params.pAbTextureLut && outputs.pDepthHistogram && outputs.pAbHistogram;
+        bool scaled = !params.pDepthTextureLut && !params.pAbTextureLut && !outputs.pDepthHistogram && !outputs.pAbHistogram;
+        if (texture && !normalized && !scaled)
+        {
+            // the sensor loop sets the tables and histograms together, other combinations take the generic pass
+            return ProcessAhatFrameGeneric(params, pDepth, pAbImage, pUnitRays, pValidMask, outputs);
+        }
+        bool color = (params.pDepthColormap && outputs.pDepthColorTexture) || (params.pAbColormap && outputs.pAbColorTexture);
+        auto format = outputs.pEncodedPointCloud ? params.pointCloudFormat : PointCloudFormat::Float;
+
+        DispatchTextureOutputs(params.textureLayout.mode, normalized, color, [&](auto kTextureMode, auto kNormalized, auto kColor) {
+            if (params.pointCloudStep == 0)
+            {
+                ProcessDepthPixels<AhatDepthRule, false, false, PointCloudFormat::Float, false, decltype(kTextureMode)::value,
+                    decltype(kNormalized)::value, decltype(kColor)::value>(params, input, outputs);
+                return;
+            }
+            DispatchFlag(params.useRoiFilter, [&](auto kRoiFilter) {
+                DispatchFlag(pValidMask != nullptr, [&](auto kValidMask) {
+                    DispatchPointCloudFormat(format, [&](auto kFormat) {
+                        ProcessDepthPixels<AhatDepthRule, true, decltype(kRoiFilter)::value, decltype(kFormat)::value,
+                            decltype(kValidMask)::value, decltype(kTextureMode)::value, decltype(kNormalized)::value,
+                            decltype(kColor)::value>(params, input, outputs);
+                    });
+                });
+            });
+        });
+        return CenterPoint(params, pDepth, pUnitRays);
+    }
+
+    AhatFrameResult ProcessAhatFrameGeneric(const AhatFrameParams& params, const UINT16* pDepth, const UINT16* pAbImage,
+        const XMFLOAT3* pUnitRays, const UINT8* pValidMask, const AhatFrameOutputs& outputs)
+    {
+        const auto& bounds = params.roiImageBounds;
+        XMMATRIX depthToWorld = XMLoadFloat4x4(&params.depthToWorld);
+        XMVECTOR roiCenter = XMLoadFloat3(&params.roiCenter);
+        XMVECTOR roiBound = XMLoadFloat3(&params.roiBound);
+        auto& pointCloud = *outputs.pPointCloud;
+
+        // encoding: flip z into output coordinates, then half conversion or offset and scale to int16 steps
+        const XMVECTORF32 flipZ = { { { 1, 1, -1, 1 } } };
+        XMVECTOR encodingOffset = XMLoadFloat3(&params.encodingOffset);
+        XMVECTOR encodingInvScale = XMVectorReplicate(1 / params.encodingScale);
+        bool encode = params.pointCloudFormat != PointCloudFormat::Float && outputs.pEncodedPointCloud;
+
+        // visit only the pixels needed by the point cloud and the textures
+        const auto& layout = params.textureLayout;
+        bool backProject = params.pointCloudStep != 0;
+        UINT rowBegin = backProject ? bounds.rowBegin : params.height, rowEnd = backProject ? bounds.rowEnd : 0;
+        UINT colBegin = backProject ? bounds.colBegin : params.width, colEnd = backProject ? bounds.colEnd : 0;
+        if (layout.mode == TextureMode::Crop)
+        {
+            rowBegin = (std::min)(rowBegin, layout.y0); rowEnd = (std::max)(rowEnd, layout.y0 + layout.height);
+            colBegin = (std::min)(colBegin, layout.x0); colEnd = (std::max)(colEnd, layout.x0 + layout.width);
+        }
+        else if (layout.mode != TextureMode::Off)
+        {
+            rowBegin = 0; rowEnd = params.height;
+            colBegin = 0; colEnd = params.width;
+        }
+        rowEnd = (std::min)(rowEnd, params.height);
+        colEnd = (std::min)(colEnd, params.width);
+        TextureWriter depthTexture(layout, outputs.pDepthTexture);
+        TextureWriter abTexture(layout, outputs.pAbTexture);
+        ColorTextureWriter depthColorTexture(ColorTextureLayout(layout, params.pDepthColormap, outputs.pDepthColorTexture),
+            outputs.pDepthColorTexture, ColormapTexel{ params.pDepthColormap });
+        ColorTextureWriter abColorTexture(ColorTextureLayout(layout, params.pAbColormap, outputs.pAbColorTexture),
+            outputs.pAbColorTexture, ColormapTexel{ params.pAbColormap });
+
+        // decimated point cloud: the pixel offsets within the Roi must be multiples of the step
+        const UINT pointStepMask = params.pointCloudStep - 1;
+
+        for (UINT i = rowBegin; i < rowEnd; i++)
+        {
+            bool rowInRoi = params.pointCloudStep != 0 && i >= bounds.rowBegin && i < bounds.rowEnd && ((i - bounds.rowBegin) & pointStepMask) == 0;
+            for (UINT j = colBegin; j < colEnd; j++)
+            {
+                auto idx = params.width * i + j;
+                UINT16 depth = pDepth[idx];
+                depth = (depth > 4090) ? 0 : depth - params.depthOffset;
+
+                // back-project point cloud within Roi
+                if (rowInRoi && j >= bounds.colBegin && j < bounds.colEnd && ((j - bounds.colBegin) & pointStepMask) == 0 &&
+                    depth >= bounds.depthMin && depth <= bounds.depthMax && pUnitRays[idx].z != 0 &&
+                    (!pValidMask || pValidMask[idx]))
+                {
+                    auto tempPoint = (float)depth / 1000 * XMLoadFloat3(&pUnitRays[idx]);
+                    // apply transformation
+                    auto pointInWorld = XMVector3Transform(tempPoint, depthToWorld);
+
+                    // filter point cloud based on region of interest
+                    if (!params.useRoiFilter || XMVector3InBounds(pointInWorld - roiCenter, roiBound))
+                    {
+                        pointCloud.push_back(XMVectorGetX(pointInWorld));
+                        pointCloud.push_back(XMVectorGetY(pointInWorld));
+                        pointCloud.push_back(-XMVectorGetZ(pointInWorld));
+
+                        if (encode)
+                        {
+                            XMVECTOR pointOut = XMVectorMultiply(pointInWorld, flipZ);
+                            UINT16 encoded[4];
+                            if (params.pointCloudFormat == PointCloudFormat::Half)
+                            {
+                                PackedVector::XMStoreHalf4(reinterpret_cast<PackedVector::XMHALF4*>(encoded), pointOut);
+                            }
+                            else
+                            {
+                                PackedVector::XMStoreShort4(reinterpret_cast<PackedVector::XMSHORT4*>(encoded),
+                                    XMVectorRound(XMVectorMultiply(XMVectorSubtract(pointOut, encodingOffset), encodingInvScale)));
+                            }
+                            outputs.pEncodedPointCloud->insert(outputs.pEncodedPointCloud->end(), encoded, encoded + 3);
+                        }
+                    }
+                }
+
+                if (layout.mode == TextureMode::Off)
+                {
+                    continue;
+                }
+
+                // save depth map as grayscale texture pixel
+                if (depth == 0) { depthTexture.Write(i, j, 0, false); }
+                else
+                {
+                    depthTexture.Write(i, j, params.pDepthTextureLut ? (*params.pDepthTextureLut)[depth] : (uint8_t)((float)depth / 1000 * 255), true);
+                    if (outputs.pDepthHistogram) outputs.pDepthHistogram[(std::min)((UINT)depth, TextureLut::kSize - 1)]++;
+                }
+
+                // save AbImage as grayscale texture pixel
+                UINT16 abValue = pAbImage[idx];
+                if (outputs.pAbHistogram) outputs.pAbHistogram[(std::min)((UINT)abValue, TextureLut::kSize - 1)]++;
+                if (params.pAbTextureLut) { abTexture.Write(i, j, (*params.pAbTextureLut)[abValue], true); }
+                else if (abValue > 1000) { abTexture.Write(i, j, 0xFF, true); }
+                else { abTexture.Write(i, j, (uint8_t)((float)abValue / 1000 * 255), true); }
+
+                // colormapped textures straight from the raw values
+                depthColorTexture.Write(i, j, depth, depth != 0);
+                abColorTexture.Write(i, j, abValue, true);
+            }
+            depthTexture.EndRow(i);
+            abTexture.EndRow(i);
+            depthColorTexture.EndRow(i);
+            abColorTexture.EndRow(i);
+        }
+
+        return CenterPoint(params, pDepth, pUnitRays);
+    }
+
+    float MaxNeighborRayAngle(const XMFLOAT3* pUnitRays, UINT width, UINT height)
+    {
+        float minCos = 1;
+        auto visitPair = [&](const XMFLOAT3& a, const XMFLOAT3& b) {
+            if (a.z != 0 && b.z != 0)
+            {
+                minCos = (std::min)(minCos, a.x * b.x + a.y * b.y + a.z * b.z);
+            }
+        };
+        for (UINT i = 0; i < height; i++)
+        {
+            for (UINT j = 0; j < width; j++)
+            {
+                auto idx = width * i + j;
+                if (j + 1 < width) { visitPair(pUnitRays[idx], pUnitRays[idx + 1]); }
+                if (i + 1 < height) { visitPair(pUnitRays[idx], pUnitRays[idx + width]); }
+            }
+        }
+        return acosf((std::max)(minCos, -1.0f));
+    }
+
+    // Slab test of the ray origin + t * direction, t >= 0, against the box +- halfExtent around the origin of the frame
+    static bool RayHitsBox(const XMFLOAT3& origin, const XMFLOAT3& direction, const XMFLOAT3& halfExtent)
+    {
+        const float o[3] = { origin.x, origin.y, origin.z };
+        const float d[3] = { direction.x, direction.y, direction.z };
+        const float h[3] = { halfExtent.x, halfExtent.y, halfExtent.z };
+        float tMin = 0, tMax = FLT_MAX;
+        for (int a = 0; a < 3; a++)
+        {
+            if (fabsf(d[a]) < 1e-9f)
+            {
+                if (fabsf(o[a]) > h[a])
+                {
+                    return false;
+                }
+                continue;
+            }
+            float t1 = (-h[a] - o[a]) / d[a];
+            float t2 = (h[a] - o[a]) / d[a];
+            tMin = (std::max)(tMin, (std::min)(t1, t2));
+            tMax = (std::min)(tMax, (std::max)(t1, t2));
+            if (tMin > tMax)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void BoundRoiImageWindow(const XMFLOAT3* pUnitRays, UINT width, FXMMATRIX depthToWorld, FXMVECTOR roiCenter, FXMVECTOR roiBound,
+        float rayAngle, float farthest, DepthRoiImageBounds& bounds)
+    {
+        // a ray of the cone passes within farthest * sin(rayAngle) of the pixel ray up to farthest, so testing the pixel
+        // ray against the box widened by that distance keeps every pixel whose cone reaches the box
+        float margin = farthest * sinf((std::min)(rayAngle, XM_PIDIV2));
+        XMFLOAT3 origin, halfExtent;
+        XMStoreFloat3(&origin, XMVector3Transform(XMVectorZero(), depthToWorld) - roiCenter);
+        XMStoreFloat3(&halfExtent, roiBound + XMVectorReplicate(margin));
+
+        UINT rowBegin = bounds.rowEnd, rowEnd = bounds.rowBegin, colBegin = bounds.colEnd, colEnd = bounds.colBegin;
+        for (UINT i = bounds.rowBegin; i < bounds.rowEnd; i++)
+        {
+            for (UINT j = bounds.colBegin; j < bounds.colEnd; j++)
+            {
+                const XMFLOAT3& ray = pUnitRays[width * i + j];
+                if (ray.z == 0)
+                {
+                    continue;
+                }
+                XMFLOAT3 direction;
+                XMStoreFloat3(&direction, XMVector3TransformNormal(XMLoadFloat3(&ray), depthToWorld));
+                if (RayHitsBox(origin, direction, halfExtent))
+                {
+                    rowBegin = (std::min)(rowBegin, i); rowEnd = (std::max)(rowEnd, i + 1);
+                    colBegin = (std::min)(colBegin, j); colEnd = (std::max)(colEnd, j + 1);
+                }
+            }
+        }
+
+        if (rowBegin >= rowEnd || colBegin >= colEnd)
+        {
+            bounds.rowEnd = bounds.rowBegin;
+            bounds.colEnd = bounds.colBegin;
+            return;
+        }
+        bounds.rowBegin = rowBegin; bounds.rowEnd = rowEnd;
+        bounds.colBegin = colBegin; bounds.colEnd = colEnd;
+    }
+
+    void MarkFlyingPixels(const FlyingPixelFilterSettings& settings, const UINT16* pDepth, const UINT16* pAbImage,
+        UINT width, UINT height, const DepthRoiImageBounds& bounds, UINT8* pValidMask)
+    {
+        // border pixels do not have a full neighborhood
+        UINT rowBegin = (std::max)(bounds.rowBegin, 1u), rowEnd = (std::min)(bounds.rowEnd, height - 1);
+        UINT colBegin = (std::max)(bounds.colBegin, 1u), colEnd = (std::min)(bounds.colEnd, width - 1);
+        const int thresholdAbsolute = settings.thresholdAbsolute;
+        const int thresholdRelative = (int)(settings.thresholdRelative * 1024); // fixed point, 10 fractional bits
+        const int minConsistent = settings.minConsistentNeighbors;
+        const int minAb = settings.minAbValue;
+
+        for (UINT i = rowBegin; i < rowEnd; i++)
+        {
+            const UINT16* up = pDepth + width * (i - 1);
+            const UINT16* mid = pDepth + width * i;
+            const UINT16* down = pDepth + width * (i + 1);
+            const UINT16* ab = pAbImage + width * i;
+            UINT8* mask = pValidMask + width * i;
+
+            // integer and branch-free so the compiler can vectorize along the row
+            for (UINT j = colBegin; j < colEnd; j++)
+            {
+                int depth = mid[j];
+                int threshold = (std::max)(thresholdAbsolute, (depth * thresholdRelative) >> 10);
+                int consistent =
+                    (abs(depth - up[j - 1]) <= threshold) + (abs(depth - up[j]) <= threshold) + (abs(depth - up[j + 1]) <= threshold) +
+                    (abs(depth - mid[j - 1]) <= threshold) + (abs(depth - mid[j + 1]) <= threshold) +
+                    (abs(depth - down[j - 1]) <= threshold) + (abs(depth - down[j]) <= threshold) + (abs(depth - down[j + 1]) <= threshold);
+                mask[j] = (UINT8)(depth > 0 && depth <= 4090 && consistent >= minConsistent && ab[j] >= minAb);
+            }
+        }
+    }
+
+    void ProcessLongThrowFrame(const UINT16* pDepth, const BYTE* pSigma, UINT width, UINT height, UINT16 depthOffset,
+        const TextureLayout& textureLayout, UINT8* pDepthTexture, const ColormapLut* pColormap, UINT32* pDepthColorTexture,
+        const TextureLut* pTextureLut, UINT32* pHistogram)
+    {
+        if (textureLayout.mode == TextureMode::Off)
+        {
+            return;
+        }
+        if ((pTextureLut != nullptr) != (pHistogram != nullptr))
+        {
+            // the sensor loop sets the table and the histogram together, other combinations take the generic pass
+            ProcessLongThrowFrameGeneric(pDepth, pSigma, width, height, depthOffset, textureLayout, pDepthTexture, pColormap,
+                pDepthColorTexture, pTextureLut, pHistogram);
+            return;
+        }
+        AhatFrameParams params;
+        params.width = width;
+        params.height = height;
+        params.depthOffset = depthOffset;
+        params.textureLayout = textureLayout;
+        params.pDepthColormap = pColormap;
+        params.pDepthTextureLut = pTextureLut;
+        params.pointCloudStep = 0;
+        AhatFrameOutputs outputs;
+        outputs.pDepthTexture = pDepthTexture;
+        outputs.pDepthColorTexture = pDepthColorTexture;
+        outputs.pDepthHistogram = pHistogram;
+        DepthFrameInput input;
+        input.pDepth = pDepth;
+        input.pSigma = pSigma;
+
+        DispatchTextureOutputs(textureLayout.mode, pTextureLut != nullptr, pColormap && pDepthColorTexture,
+            [&](auto kTextureMode, auto kNormalized, auto kColor) {
+            ProcessDepthPixels<LongThrowDepthRule, false, false, PointCloudFormat::Float, false, decltype(kTextureMode)::value,
+                decltype(kNormalized)::value, decltype(kColor)::value>(params, input, outputs);
+        });
+    }
+
+    void ProcessLongThrowFrameGeneric(const UINT16* pDepth, const BYTE* pSigma, UINT width, UINT height, UINT16 depthOffset,
+        const TextureLayout& textureLayout, UINT8* pDepthTexture, const ColormapLut* pColormap, UINT32* pDepthColorTexture,
+        const TextureLut* pTextureLut, UINT32* pHistogram)
+    {
+        if (textureLayout.mode == TextureMode::Off)
+        {
+            return;
+        }
+        bool crop = textureLayout.mode == TextureMode::Crop;
+        UINT rowBegin = crop ? textureLayout.y0 : 0, rowEnd = crop ? textureLayout.y0 + textureLayout.height : height;
+        UINT colBegin = crop ? textureLayout.x0 : 0, colEnd = crop ? textureLayout.x0 + textureLayout.width : width;
+        TextureWriter depthTexture(textureLayout, pDepthTexture);
+        ColorTextureWriter depthColorTexture(ColorTextureLayout(textureLayout, pColormap, pDepthColorTexture),
+            pDepthColorTexture, ColormapTexel{ pColormap });
+
+        for (UINT i = rowBegin; i < rowEnd; i++)
+        {
+            for (UINT j = colBegin; j < colEnd; j++)
+            {
+                auto idx = width * i + j;
+                UINT16 depth = pDepth[idx];
+                depth = (pSigma[idx] & 0x80) ? 0 : depth - depthOffset;
+
+                // save as grayscale texture pixel
+                if (depth == 0) { depthTexture.Write(i, j, 0, false); }
+                else
+                {
+                    depthTexture.Write(i, j, pTextureLut ? (*pTextureLut)[depth] : (uint8_t)((float)depth / 4000 * 255), true);
+                    if (pHistogram) pHistogram[(std::min)((UINT)depth, TextureLut::kSize - 1)]++;
+                }
+                depthColorTexture.Write(i, j, depth, depth != 0);
+            }
+            depthTexture.EndRow(i);
+            depthColorTexture.EndRow(i);
+        }
+    }
+
+    TextureLayout MakeTextureLayout(TextureMode mode, UINT imageWidth, UINT imageHeight, UINT cropX, UINT cropY, UINT cropWidth, UINT cropHeight)
+    {
+        TextureLayout layout;
+        layout.mode = mode;
+        switch (mode)
+        {
+        case TextureMode::Half:
+        case TextureMode::Quarter:
+            layout.factor = (mode == TextureMode::Half) ? 2 : 4;
+            layout.width = imageWidth / layout.factor;
+            layout.height = imageHeight / layout.factor;
+            break;
+        case TextureMode::Crop:
+            layout.x0 = (std::min)(cropX, imageWidth);
+            layout.y0 = (std::min)(cropY, imageHeight);
+            layout.width = (std::min)(cropWidth, imageWidth - layout.x0);
+            layout.height = (std::min)(cropHeight, imageHeight - layout.y0);
+            break;
+        case TextureMode::Full:
+            layout.width = imageWidth;
+            layout.height = imageHeight;
+            break;
+        default:
+            break;
+        }
+        return layout;
+    }
+}
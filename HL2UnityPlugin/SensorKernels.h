@@ -0,0 +1,248 @@
+#pragma once
+#include "Platform.h"
+#include <DirectXMath.h>
+#include <type_traits>
+#include <vector>
+#include "Colormap.h"
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    // Pixel rectangle [rowBegin, rowEnd) x [colBegin, colEnd) and depth interval [depthMin, depthMax]
+    // that can contain points of the current frame inside the region of interest
+    struct DepthRoiImageBounds {
+        UINT rowBegin = 0;
+        UINT rowEnd = 0;
+        UINT colBegin = 0;
+        UINT colEnd = 0;
+        UINT16 depthMin = 0; // Unit: mm
+        UINT16 depthMax = 0;
+    };
+
+    // Generation mode of the 8-bit preview textures
+    enum class TextureMode {
+        Off = 0,        // no texture is generated
+        Full = 1,       // full resolution
+        Half = 2,       // 2x2 box-downsampled
+        Quarter = 3,    // 4x4 box-downsampled
+        Crop = 4,       // full resolution crop of the image
+    };
+
+    struct TextureLayout {
+        TextureMode mode = TextureMode::Full;
+        UINT factor = 1;    // downsampling factor
+        UINT x0 = 0;        // crop origin in the image
+        UINT y0 = 0;
+        UINT width = 0;     // texture size
+        UINT height = 0;
+    };
+
+    // Texture size and position for an image of imageWidth x imageHeight. The crop rectangle is only used in Crop mode
+    // and is clamped to the image.
+    TextureLayout MakeTextureLayout(TextureMode mode, UINT imageWidth, UINT imageHeight, UINT cropX, UINT cropY, UINT cropWidth, UINT cropHeight);
+
+    // Texel conversions of BasicTextureWriter
+    struct GrayscaleTexel {
+        UINT8 operator()(UINT value) const { return (UINT8)value; }
+    };
+
+    struct ColormapTexel {
+        const ColormapLut* pLut = nullptr;
+        UINT32 operator()(UINT value) const { return (*pLut)[value]; }
+    };
+
+    // Texture mode policies of BasicTextureWriter: AnyTextureLayout follows the mode of the layout per pixel,
+    // FixedTextureLayout fixes it at compile time so the pixel pass has no mode branch. FixedTextureLayout<Half>
+    // stands for both downsampled modes, the factor comes from the layout.
+    struct AnyTextureLayout {};
+
+    template <TextureMode kTextureMode>
+    struct FixedTextureLayout {
+        static constexpr TextureMode kMode = kTextureMode == TextureMode::Quarter ? TextureMode::Half : kTextureMode;
+    };
+
+    // Writes a texture according to its layout while the pixels of a frame are visited in row-major order,
+    // so texture generation is fused into the pixel pass. Downsampled modes average the valid values of each block
+    // before they are converted to texels.
+    template <typename TTexel, typename TConvert, typename TLayoutPolicy = AnyTextureLayout>
+    class BasicTextureWriter
+    {
+    public:
+        BasicTextureWriter(const TextureLayout& layout, TTexel* pTexture, TConvert convert = TConvert())
+            : m_layout(layout), m_pTexture(pTexture), m_convert(convert),
+            m_sum(layout.factor > 1 ? layout.width : 0), m_count(layout.factor > 1 ? layout.width : 0) {}
+
+        void Write(UINT i, UINT j, UINT value, bool valid)
+        {
+            if constexpr (std::is_same_v<TLayoutPolicy, AnyTextureLayout>)
+            {
+                switch (m_layout.mode)
+                {
+                case TextureMode::Full: WriteAs<TextureMode::Full>(i, j, value, valid); break;
+                case TextureMode::Crop: WriteAs<TextureMode::Crop>(i, j, value, valid); break;
+                case TextureMode::Half:
+                case TextureMode::Quarter: WriteAs<TextureMode::Half>(i, j, value, valid); break;
+                default: break;
+                }
+            }
+            else
+            {
+                WriteAs<TLayoutPolicy::kMode>(i, j, value, valid);
+            }
+        }
+
+        // Flush the block row of downsampled textures after its last image row
+        void EndRow(UINT i)
+        {
+            if constexpr (!std::is_same_v<TLayoutPolicy, AnyTextureLayout>)
+            {
+                if constexpr (TLayoutPolicy::kMode != TextureMode::Half)
+                {
+                    return;
+                }
+            }
+            if (m_layout.factor == 1 || (i + 1) % m_layout.factor != 0 || i / m_layout.factor >= m_layout.height)
+            {
+                return;
+            }
+            TTexel* pRow = m_pTexture + m_layout.width * (i / m_layout.factor);
+            for (UINT col = 0; col < m_layout.width; col++)
+            {
+                pRow[col] = m_convert(m_count[col] ? m_sum[col] / m_count[col] : 0);
+                m_sum[col] = 0;
+                m_count[col] = 0;
+            }
+        }
+
+    private:
+        template <TextureMode kMode>
+        void WriteAs(UINT i, UINT j, UINT value, bool valid)
+        {
+            if constexpr (kMode == TextureMode::Full)
+            {
+                m_pTexture[m_layout.width * i + j] = m_convert(value);
+            }
+            else if constexpr (kMode == TextureMode::Crop)
+            {
+                if (i - m_layout.y0 < m_layout.height && j - m_layout.x0 < m_layout.width)
+                {
+                    m_pTexture[m_layout.width * (i - m_layout.y0) + (j - m_layout.x0)] = m_convert(value);
+                }
+            }
+            else if constexpr (kMode == TextureMode::Half)
+            {
+                UINT col = j / m_layout.factor;
+                if (col < m_layout.width)
+                {
+                    m_sum[col] += valid ? value : 0;
+                    m_count[col] += valid;
+                }
+            }
+        }
+
+        TextureLayout m_layout;
+        TTexel* m_pTexture;
+        TConvert m_convert;
+        std::vector<UINT32> m_sum;
+        std::vector<UINT32> m_count;
+    };
+
+    // 8-bit grayscale texture
+    using TextureWriter = BasicTextureWriter<UINT8, GrayscaleTexel>;
+
+    // RGBA8 texture of raw values through a colormap lookup table
+    using ColorTextureWriter = BasicTextureWriter<UINT32, ColormapTexel>;
+
+    // Encoding of the point cloud returned through GetEncodedPointCloudBuffer
+    enum class PointCloudFormat {
+        Float = 0,      // float32 x, y, z (GetPointCloudBuffer only)
+        Half = 1,       // float16 x, y, z
+        Fixed16 = 2,    // int16 x, y, z as (point - encodingOffset) / encodingScale
+    };
+
+    struct AhatFrameParams {
+        UINT width = 0;
+        UINT height = 0;
+        UINT16 depthOffset = 0;
+        DepthRoiImageBounds roiImageBounds;
+        bool useRoiFilter = false;
+        DirectX::XMFLOAT4X4 depthToWorld;
+        DirectX::XMFLOAT3 roiCenter{ 0,0,0 };
+        DirectX::XMFLOAT3 roiBound{ 0,0,0 };
+        UINT16 depthNearClip = 0; // Unit: mm
+        UINT16 depthFarClip = 0;
+        UINT centerRow = 0;
+        UINT centerCol = 0;
+        UINT pointCloudStep = 1;                   // back-project every step-th row and column of the Roi (power of 2), 0 = no point cloud
+        PointCloudFormat pointCloudFormat = PointCloudFormat::Float;
+        DirectX::XMFLOAT3 encodingOffset{ 0,0,0 }; // in output coordinates (x, y, -z)
+        float encodingScale = 1;                   // Unit: m per step
+        TextureLayout textureLayout;               // of both the depth and AbImage textures
+        const ColormapLut* pDepthColormap = nullptr; // color textures are generated in the texture layout
+        const ColormapLut* pAbColormap = nullptr;    // when their colormap and output are set
+        const TextureLut* pDepthTextureLut = nullptr; // 8-bit textures through these tables when set, otherwise with the
+        const TextureLut* pAbTextureLut = nullptr;    // fixed range of the stream
+    };
+
+    struct AhatFrameOutputs {
+        UINT8* pDepthTexture = nullptr;
+        UINT8* pAbTexture = nullptr;
+        UINT32* pDepthColorTexture = nullptr;
+        UINT32* pAbColorTexture = nullptr;
+        std::vector<float>* pPointCloud = nullptr;
+        std::vector<UINT16>* pEncodedPointCloud = nullptr; // filled unless pointCloudFormat is Float
+        UINT32* pDepthHistogram = nullptr;  // TextureLut::kSize bins incremented by the valid depth of the texture pixels
+        UINT32* pAbHistogram = nullptr;     // and by the AbImage of the texture pixels, if set
+    };
+
+    struct AhatFrameResult {
+        UINT16 centerDepth = 0;
+        bool centerPointValid = false;
+        float centerPoint[3]{ 0,0,0 };
+    };
+
+    struct FlyingPixelFilterSettings {
+        UINT16 thresholdAbsolute = 10;   // Unit: mm, neighbors closer than max(thresholdAbsolute,
+        float thresholdRelative = 0.03f; // thresholdRelative * depth) are consistent with the pixel
+        int minConsistentNeighbors = 4;  // out of the 8 neighbors
+        UINT16 minAbValue = 0;
+    };
+
+    // Process one AHAT frame: back-project the pixels within the Roi to world space (x, y, -z appended to the point cloud,
+    // and encoded in the same pass if requested) and write the 8-bit and colormapped depth and AbImage textures. pUnitRays holds the
+    // normalized camera ray of each pixel, a zero ray marks a pixel without valid mapping. If pValidMask is set, only
+    // pixels with non-zero mask are back-projected.
+    AhatFrameResult ProcessAhatFrame(const AhatFrameParams& params, const UINT16* pDepth, const UINT16* pAbImage,
+        const DirectX::XMFLOAT3* pUnitRays, const UINT8* pValidMask, const AhatFrameOutputs& outputs);
+
+    // Same as ProcessAhatFrame in one loop that branches on the settings per pixel. ProcessAhatFrame runs a pass
+    // specialized for the enabled outputs (SensorPipeline.h); this one is kept as the reference for the benchmark.
+    AhatFrameResult ProcessAhatFrameGeneric(const AhatFrameParams& params, const UINT16* pDepth, const UINT16* pAbImage,
+        const DirectX::XMFLOAT3* pUnitRays, const UINT8* pValidMask, const AhatFrameOutputs& outputs);
+
+    // Largest angle (rad) between the unit rays of horizontally or vertically neighboring pixels. Pixels without a ray
+    // (zero) are skipped.
+    float MaxNeighborRayAngle(const DirectX::XMFLOAT3* pUnitRays, UINT width, UINT height);
+
+    // Shrink the pixel rectangle of bounds to the pixels whose rays can reach the world-space box roiCenter +- roiBound
+    // within farthest (m). Each pixel stands for the cone of rays within rayAngle (rad) of its unit ray, so the result
+    // holds under any lens distortion of the ray table. The rectangle is empty (begin == end) if no pixel reaches the box.
+    void BoundRoiImageWindow(const DirectX::XMFLOAT3* pUnitRays, UINT width, DirectX::FXMMATRIX depthToWorld,
+        DirectX::FXMVECTOR roiCenter, DirectX::FXMVECTOR roiBound, float rayAngle, float farthest, DepthRoiImageBounds& bounds);
+
+    // Mark the pixels within bounds that are consistent with their 3x3 neighborhood (1) or are flying pixels,
+    // isolated outliers or below the AbImage floor (0). Pixels outside bounds are left untouched.
+    void MarkFlyingPixels(const FlyingPixelFilterSettings& settings, const UINT16* pDepth, const UINT16* pAbImage,
+        UINT width, UINT height, const DepthRoiImageBounds& bounds, UINT8* pValidMask);
+
+    // Mask invalid long-throw pixels (sigma bit 7) and write the 8-bit depth texture (through pTextureLut if set), and the
+    // RGBA8 depth texture if pColormap and pDepthColorTexture are set. pHistogram, if set, counts the valid texture pixels
+    // per depth as AhatFrameOutputs::pDepthHistogram.
+    void ProcessLongThrowFrame(const UINT16* pDepth, const BYTE* pSigma, UINT width, UINT height, UINT16 depthOffset,
+        const TextureLayout& textureLayout, UINT8* pDepthTexture, const ColormapLut* pColormap = nullptr, UINT32* pDepthColorTexture = nullptr,
+        const TextureLut* pTextureLut = nullptr, UINT32* pHistogram = nullptr);
+
+    // Generic reference of ProcessLongThrowFrame, see ProcessAhatFrameGeneric
+    void ProcessLongThrowFrameGeneric(const UINT16* pDepth, const BYTE* pSigma, UINT width, UINT height, UINT16 depthOffset,
+        const TextureLayout& textureLayout, UINT8* pDepthTexture, const ColormapLut* pColormap = nullptr, UINT32* pDepthColorTexture = nullptr,
+        const TextureLut* pTextureLut = nullptr, UINT32* pHistogram = nullptr);
+}
@@ -0,0 +1,248 @@
+#pragma once
+#include "SensorKernels.h"
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <type_traits>
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    // Inputs of one depth frame; unused pointers of a stream may be null
+    struct DepthFrameInput {
+        const UINT16* pDepth = nullptr;
+        const BYTE* pSigma = nullptr;               // long-throw invalid flags
+        const UINT16* pAbImage = nullptr;
+        const DirectX::XMFLOAT3* pUnitRays = nullptr;
+        const UINT8* pValidMask = nullptr;
+    };
+
+    // Stream rules: pixel validity, depth offset and texture scale of each depth stream
+
+    // AHAT: raw values above 4090 are invalid, textures span 0-1000 mm, with AbImage textures
+    struct AhatDepthRule {
+        static constexpr float kTextureRange = 1000;  // Unit: mm, mapped to 255
+        static constexpr bool kAbImage = true;
+        static UINT16 Depth(const DepthFrameInput& input, size_t idx, UINT16 depthOffset)
+        {
+            UINT16 depth = input.pDepth[idx];
+            return (depth > 4090) ? 0 : depth - depthOffset;
+        }
+    };
+
+    // Long throw: pixels with sigma bit 7 set are invalid, textures span 0-4000 mm
+    struct LongThrowDepthRule {
+        static constexpr float kTextureRange = 4000;
+        static constexpr bool kAbImage = false;
+        static UINT16 Depth(const DepthFrameInput& input, size_t idx, UINT16 depthOffset)
+        {
+            return (input.pSigma[idx] & 0x80) ? 0 : input.pDepth[idx] - depthOffset;
+        }
+    };
+
+    // Layout of a color texture: the texture layout, or off without colormap or output
+    inline TextureLayout ColorTextureLayout(const TextureLayout& layout, const ColormapLut* pColormap, const UINT32* pTexture)
+    {
+        return (pColormap && pTexture) ? layout : TextureLayout{ TextureMode::Off };
+    }
+
+    // Pixel pass over one depth frame, with the stream rule and the enabled outputs fixed at compile time so every
+    // combination gets its own inner loop without configuration branches. The Roi columns of each row are visited
+    // separately from the texture-only columns around them. kNormalized textures go through the texture tables and
+    // count the histograms of all textures of the stream, otherwise they scale the values over the stream range.
+    // Colormapped textures, for visualization only, keep the per-pixel mode switch as either may be without colormap.
+    // Produces the same outputs as ProcessAhatFrameGeneric, without the center point.
+    template <typename TRule, bool kPointCloud, bool kRoiFilter, PointCloudFormat kFormat, bool kValidMask,
+        TextureMode kTextureMode, bool kNormalized, bool kColor>
+    void ProcessDepthPixels(const AhatFrameParams& params, const DepthFrameInput& input, const AhatFrameOutputs& outputs)
+    {
+        using namespace DirectX;
+        constexpr bool kTexture = kTextureMode != TextureMode::Off;
+        constexpr bool kAbTexture = kTexture && TRule::kAbImage;
+        const auto& bounds = params.roiImageBounds;
+        const auto& layout = params.textureLayout;
+
+        // visit only the pixels needed by the point cloud and the textures
+        UINT rowBegin = 0, rowEnd = 0, colBegin = 0, colEnd = 0;
+        if constexpr (kPointCloud)
+        {
+            rowBegin = bounds.rowBegin; rowEnd = bounds.rowEnd;
+            colBegin = bounds.colBegin; colEnd = bounds.colEnd;
+        }
+        if constexpr (kTexture)
+        {
+            constexpr bool crop = kTextureMode == TextureMode::Crop;
+            UINT textureRowBegin = crop ? layout.y0 : 0, textureRowEnd = crop ? layout.y0 + layout.height : params.height;
+            UINT textureColBegin = crop ? layout.x0 : 0, textureColEnd = crop ? layout.x0 + layout.width : params.width;
+            rowBegin = kPointCloud ? (std::min)(rowBegin, textureRowBegin) : textureRowBegin;
+            rowEnd = kPointCloud ? (std::max)(rowEnd, textureRowEnd) : textureRowEnd;
+            colBegin = kPointCloud ? (std::min)(colBegin, textureColBegin) : textureColBegin;
+            colEnd = kPointCloud ? (std::max)(colEnd, textureColEnd) : textureColEnd;
+        }
+        rowEnd = (std::min)(rowEnd, params.height);
+        colEnd = (std::min)(colEnd, params.width);
+        UINT roiColBegin = (std::min)((std::max)(colBegin, bounds.colBegin), colEnd);
+        UINT roiColEnd = (std::max)(roiColBegin, (std::min)(colEnd, bounds.colEnd));
+
+        // the texture mode of each writer is fixed, so writing a texel does not branch on the layout
+        using Layout = FixedTextureLayout<kTextureMode>;
+        using Off = FixedTextureLayout<TextureMode::Off>;
+        const TextureLayout off{ TextureMode::Off };
+        BasicTextureWriter<UINT8, GrayscaleTexel, Layout> depthTexture(kTexture ? layout : off, outputs.pDepthTexture);
+        BasicTextureWriter<UINT8, GrayscaleTexel, std::conditional_t<kAbTexture, Layout, Off>> abTexture(
+            kAbTexture ? layout : off, outputs.pAbTexture);
+        ColorTextureWriter depthColorTexture(kColor ? ColorTextureLayout(layout, params.pDepthColormap, outputs.pDepthColorTexture) : off,
+            outputs.pDepthColorTexture, ColormapTexel{ params.pDepthColormap });
+        ColorTextureWriter abColorTexture(kColor && kAbTexture ? ColorTextureLayout(layout, params.pAbColormap, outputs.pAbColorTexture) : off,
+            outputs.pAbColorTexture, ColormapTexel{ params.pAbColormap });
+
+        XMMATRIX depthToWorld = XMLoadFloat4x4(&params.depthToWorld);
+        XMVECTOR roiCenter = XMLoadFloat3(&params.roiCenter);
+        XMVECTOR roiBound = XMLoadFloat3(&params.roiBound);
+        const XMVECTORF32 flipZ = { { { 1, 1, -1, 1 } } };
+        XMVECTOR encodingOffset = XMLoadFloat3(&params.encodingOffset);
+        XMVECTOR encodingInvScale = XMVectorReplicate(1 / params.encodingScale);
+        const UINT pointStepMask = params.pointCloudStep - 1;
+        const UINT16 depthOffset = params.depthOffset;
+        const TextureLut* pDepthTextureLut = params.pDepthTextureLut;
+        const TextureLut* pAbTextureLut = params.pAbTextureLut;
+        UINT32* pDepthHistogram = outputs.pDepthHistogram;
+        UINT32* pAbHistogram = outputs.pAbHistogram;
+
+        auto visitPixel = [&](UINT i, UINT j, auto backProject) {
+            auto idx = params.width * i + j;
+            UINT16 depth = TRule::Depth(input, idx, depthOffset);
+
+            if constexpr (decltype(backProject)::value)
+            {
+                if (depth >= bounds.depthMin && depth <= bounds.depthMax && input.pUnitRays[idx].z != 0 &&
+                    ((j - bounds.colBegin) & pointStepMask) == 0 && (!kValidMask || input.pValidMask[idx]))
+                {
+                    auto pointInWorld = XMVector3Transform((float)depth / 1000 * XMLoadFloat3(&input.pUnitRays[idx]), depthToWorld);
+                    if (!kRoiFilter || XMVector3InBounds(pointInWorld - roiCenter, roiBound))
+                    {
+                        auto& pointCloud = *outputs.pPointCloud;
+                        pointCloud.push_back(XMVectorGetX(pointInWorld));
+                        pointCloud.push_back(XMVectorGetY(pointInWorld));
+                        pointCloud.push_back(-XMVectorGetZ(pointInWorld));
+
+                        if constexpr (kFormat != PointCloudFormat::Float)
+                        {
+                            XMVECTOR pointOut = XMVectorMultiply(pointInWorld, flipZ);
+                            UINT16 encoded[4];
+                            if constexpr (kFormat == PointCloudFormat::Half)
+                            {
+                                PackedVector::XMStoreHalf4(reinterpret_cast<PackedVector::XMHALF4*>(encoded), pointOut);
+                            }
+                            else
+                            {
+                                PackedVector::XMStoreShort4(reinterpret_cast<PackedVector::XMSHORT4*>(encoded),
+                                    XMVectorRound(XMVectorMultiply(XMVectorSubtract(pointOut, encodingOffset), encodingInvScale)));
+                            }
+                            outputs.pEncodedPointCloud->insert(outputs.pEncodedPointCloud->end(), encoded, encoded + 3);
+                        }
+                    }
+                }
+            }
+
+            if constexpr (kTexture)
+            {
+                if (depth == 0) { depthTexture.Write(i, j, 0, false); }
+                else if constexpr (kNormalized)
+                {
+                    depthTexture.Write(i, j, (*pDepthTextureLut)[depth], true);
+                    pDepthHistogram[(std::min)((UINT)depth, TextureLut::kSize - 1)]++;
+                }
+                else
+                {
+                    depthTexture.Write(i, j, (uint8_t)((float)depth / TRule::kTextureRange * 255), true);
+                }
+                if constexpr (kColor)
+                {
+                    depthColorTexture.Write(i, j, depth, depth != 0);
+                }
+
+                if constexpr (kAbTexture)
+                {
+                    UINT16 abValue = input.pAbImage[idx];
+                    if constexpr (kNormalized)
+                    {
+                        pAbHistogram[(std::min)((UINT)abValue, TextureLut::kSize - 1)]++;
+                        abTexture.Write(i, j, (*pAbTextureLut)[abValue], true);
+                    }
+                    else if (abValue > 1000) { abTexture.Write(i, j, 0xFF, true); }
+                    else { abTexture.Write(i, j, (uint8_t)((float)abValue / 1000 * 255), true); }
+                    if constexpr (kColor)
+                    {
+                        abColorTexture.Write(i, j, abValue, true);
+                    }
+                }
+            }
+        };
+
+        for (UINT i = rowBegin; i < rowEnd; i++)
+        {
+            bool rowBackProjected = kPointCloud && i >= bounds.rowBegin && i < bounds.rowEnd && ((i - bounds.rowBegin) & pointStepMask) == 0;
+            if (rowBackProjected)
+            {
+                for (UINT j = colBegin; j < roiColBegin; j++) visitPixel(i, j, std::false_type());
+                for (UINT j = roiColBegin; j < roiColEnd; j++) visitPixel(i, j, std::true_type());
+                for (UINT j = roiColEnd; j < colEnd; j++) visitPixel(i, j, std::false_type());
+            }
+            else if constexpr (kTexture)
+            {
+                for (UINT j = colBegin; j < colEnd; j++) visitPixel(i, j, std::false_type());
+            }
+
+            if constexpr (kTexture)
+            {
+                depthTexture.EndRow(i);
+                abTexture.EndRow(i);
+                if constexpr (kColor)
+                {
+                    depthColorTexture.EndRow(i);
+                    abColorTexture.EndRow(i);
+                }
+            }
+        }
+    }
+
+    // Call f with std::true_type or std::false_type, turning a runtime flag into a template argument
+    template <typename F>
+    void DispatchFlag(bool flag, F&& f)
+    {
+        if (flag) f(std::true_type());
+        else f(std::false_type());
+    }
+
+    // Call f with the texture mode and the normalization and color flags of a frame as template arguments. Without
+    // a texture only the Off combination is instantiated.
+    template <typename F>
+    void DispatchTextureOutputs(TextureMode mode, bool normalized, bool color, F&& f)
+    {
+        auto dispatchFlags = [&](auto kMode) {
+            DispatchFlag(normalized, [&](auto kNormalized) {
+                DispatchFlag(color, [&](auto kColor) { f(kMode, kNormalized, kColor); });
+            });
+        };
+        switch (mode)
+        {
+        case TextureMode::Full: dispatchFlags(std::integral_constant<TextureMode, TextureMode::Full>()); break;
+        case TextureMode::Crop: dispatchFlags(std::integral_constant<TextureMode, TextureMode::Crop>()); break;
+        case TextureMode::Half:
+        case TextureMode::Quarter: dispatchFlags(std::integral_constant<TextureMode, TextureMode::Half>()); break;
+        default:
+            f(std::integral_constant<TextureMode, TextureMode::Off>(), std::false_type(), std::false_type());
+            break;
+        }
+    }
+
+    template <typename F>
+    void DispatchPointCloudFormat(PointCloudFormat format, F&& f)
+    {
+        switch (format)
+        {
+        case PointCloudFormat::Half: f(std::integral_constant<PointCloudFormat, PointCloudFormat::Half>()); break;
+        case PointCloudFormat::Fixed16: f(std::integral_constant<PointCloudFormat, PointCloudFormat::Fixed16>()); break;
+        default: f(std::integral_constant<PointCloudFormat, PointCloudFormat::Float>()); break;
+        }
+    }
+}
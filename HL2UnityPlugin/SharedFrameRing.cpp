@@ -0,0 +1,201 @@
+#include "SharedFrameRing.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring counters are shared across processes");
+
+    static const char kSharedRingMagic[8] = "HL2SHM1";
+
+    // Counters in the mapped file are accessed as lock-free atomics, which are address-free
+    static std::atomic<uint64_t>& SharedCounter(uint64_t& value)
+    {
+        return *reinterpret_cast<std::atomic<uint64_t>*>(&value);
+    }
+
+    bool SharedFrameRing::Create(const std::filesystem::path& path, SharedRingStream stream, uint32_t slotCount, size_t slotPayloadCapacity)
+    {
+        Close();
+        m_path = path;
+        m_slotCount = (std::max)(slotCount, 1u);
+        // cache line aligned slots, so the payload of one slot never shares a line with the header of the next
+        m_slotStride = (sizeof(SharedSlotHeader) + slotPayloadCapacity + 63) & ~(size_t)63;
+        m_payloadCapacity = m_slotStride - sizeof(SharedSlotHeader);
+        m_stream = stream;
+        m_published = 0;
+        m_oversized = 0;
+        if (!Map(sizeof(SharedRingHeader) + m_slotCount * m_slotStride))
+        {
+            Close();
+            return false;
+        }
+
+        // readers ignore the ring until the magic is back
+        auto pRing = reinterpret_cast<SharedRingHeader*>(m_pView);
+        memset(pRing->magic, 0, sizeof(pRing->magic));
+        std::atomic_thread_fence(std::memory_order_release);
+        pRing->headerSize = sizeof(SharedRingHeader);
+        pRing->slotHeaderSize = sizeof(SharedSlotHeader);
+        pRing->slotCount = m_slotCount;
+        pRing->streamId = (uint32_t)stream;
+        pRing->slotStride = m_slotStride;
+        pRing->slotPayloadCapacity = m_payloadCapacity;
+        pRing->reserved = 0;
+        SharedCounter(pRing->published).store(0, std::memory_order_relaxed);
+        SharedCounter(pRing->session).store((uint64_t)std::chrono::system_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+        for (uint32_t k = 0; k < m_slotCount; k++)
+        {
+            memset(m_pView + sizeof(SharedRingHeader) + k * m_slotStride, 0, sizeof(SharedSlotHeader));
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(pRing->magic, kSharedRingMagic, sizeof(kSharedRingMagic));
+        return true;
+    }
+
+    bool SharedFrameRing::Publish(const SharedFrameInfo& info, const SharedFramePlane* pPlanes, uint32_t planeCount)
+    {
+        if (!m_pView)
+        {
+            return false;
+        }
+        size_t planeSize = (size_t)info.width * info.height;
+        size_t payloadSize = 0;
+        for (uint32_t p = 0; p < planeCount; p++)
+        {
+            payloadSize += planeSize * pPlanes[p].bytesPerPixel;
+        }
+        if (planeCount > kSharedRingMaxPlanes || payloadSize > m_payloadCapacity)
+        {
+            m_oversized++;
+            return false;
+        }
+
+        uint64_t frameNumber = m_published + 1;
+        uint8_t* pSlot = m_pView + sizeof(SharedRingHeader) + ((frameNumber - 1) % m_slotCount) * m_slotStride;
+        auto pHeader = reinterpret_cast<SharedSlotHeader*>(pSlot);
+
+        // seqlock: odd while writing, the fence keeps the slot writes after the odd sequence
+        auto& sequence = SharedCounter(pHeader->sequence);
+        uint64_t begin = sequence.load(std::memory_order_relaxed) + 1;
+        sequence.store(begin, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        pHeader->frameNumber = frameNumber;
+        pHeader->streamId = (uint32_t)m_stream;
+        pHeader->width = info.width;
+        pHeader->height = info.height;
+        pHeader->planeCount = planeCount;
+        pHeader->frameIndex = info.frameIndex;
+        pHeader->hostTicks = info.hostTicks;
+        memcpy(pHeader->cameraToWorld, info.cameraToWorld, sizeof(pHeader->cameraToWorld));
+        memset(pHeader->planeBytesPerPixel, 0, sizeof(pHeader->planeBytesPerPixel));
+        pHeader->payloadSize = (uint32_t)payloadSize;
+        uint8_t* pPayload = pSlot + sizeof(SharedSlotHeader);
+        for (uint32_t p = 0; p < planeCount; p++)
+        {
+            pHeader->planeBytesPerPixel[p] = (uint8_t)pPlanes[p].bytesPerPixel;
+            size_t size = planeSize * pPlanes[p].bytesPerPixel;
+            memcpy(pPayload, pPlanes[p].pData, size);
+            pPayload += size;
+        }
+
+        sequence.store(begin + 1, std::memory_order_release);
+        SharedCounter(reinterpret_cast<SharedRingHeader*>(m_pView)->published).store(frameNumber, std::memory_order_release);
+        m_published = frameNumber;
+        return true;
+    }
+
+#ifdef _WIN32
+    bool SharedFrameRing::Map(size_t size)
+    {
+        // temporary file: the pages stay in memory instead of being written back while the ring is open
+        CREATEFILE2_EXTENDED_PARAMETERS params = { sizeof(params) };
+        params.dwFileAttributes = FILE_ATTRIBUTE_TEMPORARY;
+        HANDLE file = CreateFile2(m_path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            OPEN_ALWAYS, &params);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            OutputDebugString(L"Failed to open shared ring file\n");
+            return false;
+        }
+        m_file = file;
+        m_mapping = CreateFileMappingFromApp(file, nullptr, PAGE_READWRITE, size, nullptr);
+        if (!m_mapping)
+        {
+            OutputDebugString(L"Failed to map shared ring file\n");
+            return false;
+        }
+        m_pView = static_cast<uint8_t*>(MapViewOfFileFromApp(m_mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, size));
+        m_viewSize = size;
+        return m_pView != nullptr;
+    }
+
+    void SharedFrameRing::Close()
+    {
+        if (m_pView)
+        {
+            UnmapViewOfFile(m_pView);
+            m_pView = nullptr;
+        }
+        if (m_mapping)
+        {
+            CloseHandle(m_mapping);
+            m_mapping = nullptr;
+        }
+        if (m_file)
+        {
+            CloseHandle(m_file);
+            m_file = nullptr;
+        }
+        m_viewSize = 0;
+    }
+#else
+    bool SharedFrameRing::Map(size_t size)
+    {
+        m_file = open(m_path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (m_file < 0)
+        {
+            return false;
+        }
+        // only grow the file, attached readers may still map the previous size
+        struct stat fileStat;
+        if (fstat(m_file, &fileStat) != 0 || ((size_t)fileStat.st_size < size && ftruncate(m_file, size) != 0))
+        {
+            return false;
+        }
+        void* pView = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_file, 0);
+        if (pView == MAP_FAILED)
+        {
+            return false;
+        }
+        m_pView = static_cast<uint8_t*>(pView);
+        m_viewSize = size;
+        return true;
+    }
+
+    void SharedFrameRing::Close()
+    {
+        if (m_pView)
+        {
+            munmap(m_pView, m_viewSize);
+            m_pView = nullptr;
+        }
+        if (m_file >= 0)
+        {
+            close(m_file);
+            m_file = -1;
+        }
+        m_viewSize = 0;
+    }
+#endif
+}
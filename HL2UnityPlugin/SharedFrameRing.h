@@ -0,0 +1,131 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+// Builds without the precompiled header and without the WinRT headers, so the stand-in producer in the python folder
+// can use the ring on Linux.
+namespace winrt::HL2UnityPlugin::implementation
+{
+    // Streams carried by the shared memory transport, one ring file each
+    enum class SharedRingStream : uint32_t {
+        Depth = 0,      // planes: depth (UINT16), AbImage (UINT16)
+        LongDepth = 1,  // planes: depth (UINT16), sigma (UINT8)
+        LeftFront = 2,  // planes: image (UINT8)
+        RightFront = 3, // planes: image (UINT8)
+    };
+
+    static const uint32_t kSharedRingStreamCount = 4;
+    static const uint32_t kSharedRingMaxPlanes = 4;
+    static const char* const kSharedRingFileNames[kSharedRingStreamCount] = {
+        "hl2_depth.ring", "hl2_long_depth.ring", "hl2_left_front.ring", "hl2_right_front.ring" };
+
+    // Layout of a ring file, all values little endian:
+    //
+    // ring header (64 bytes)
+    //   0  char[8]  magic "HL2SHM1\0", written last when the ring is (re)created
+    //   8  UINT32   ring header size (64)          12  UINT32 slot header size (128)
+    //   16 UINT32   slot count                     20  UINT32 stream id
+    //   24 UINT64   slot stride (bytes)            32  UINT64 slot payload capacity (bytes)
+    //   40 UINT64   frames published, written after the slot of the frame is complete
+    //   48 UINT64   session, changes when the producer recreates the ring
+    //
+    // slot k (k = (frame number - 1) % slot count) at ring header size + k * slot stride, slot header (128 bytes):
+    //   0  UINT64   seqlock sequence, odd while the slot is written
+    //   8  UINT64   frame number (1-based count of frames published into the ring)
+    //   16 UINT32   stream id      20 UINT32 width      24 UINT32 height      28 UINT32 plane count
+    //   32 UINT64   frame index of the sensor loop
+    //   40 UINT64   host ticks of the sensor frame (Unit: 100 ns)
+    //   48 float[16] camera to world, row-major for row vectors (as FrameView::cameraToWorld)
+    //   112 UINT8[4] bytes per pixel of each plane                116 UINT32 payload size (bytes)
+    // followed by the planes, width * height * bytes per pixel each, back to back.
+    //
+    // Readers never write to the ring: a slot is valid if the sequence is even and unchanged after the copy, and holds
+    // the expected frame number. See python/shared_ring_reader.py.
+    struct SharedRingHeader {
+        char magic[8];
+        uint32_t headerSize;
+        uint32_t slotHeaderSize;
+        uint32_t slotCount;
+        uint32_t streamId;
+        uint64_t slotStride;
+        uint64_t slotPayloadCapacity;
+        uint64_t published;
+        uint64_t session;
+        uint64_t reserved;
+    };
+    static_assert(sizeof(SharedRingHeader) == 64, "ring header layout");
+
+    struct SharedSlotHeader {
+        uint64_t sequence;
+        uint64_t frameNumber;
+        uint32_t streamId;
+        uint32_t width;
+        uint32_t height;
+        uint32_t planeCount;
+        uint64_t frameIndex;
+        uint64_t hostTicks;
+        float cameraToWorld[16];
+        uint8_t planeBytesPerPixel[kSharedRingMaxPlanes];
+        uint32_t payloadSize;
+        uint64_t reserved;
+    };
+    static_assert(sizeof(SharedSlotHeader) == 128, "slot header layout");
+
+    struct SharedFramePlane {
+        const void* pData = nullptr;
+        uint32_t bytesPerPixel = 1;
+    };
+
+    struct SharedFrameInfo {
+        uint64_t frameIndex = 0;
+        uint64_t hostTicks = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        float cameraToWorld[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+    };
+
+    // Single-producer ring of fixed size frame slots in a memory mapped file. Publish copies a frame into the next slot
+    // under a per-slot seqlock and never waits for readers; readers that fall more than a ring behind lose frames.
+    class SharedFrameRing
+    {
+    public:
+        SharedFrameRing() = default;
+        SharedFrameRing(const SharedFrameRing&) = delete;
+        SharedFrameRing& operator=(const SharedFrameRing&) = delete;
+        ~SharedFrameRing() { Close(); }
+
+        // Map the ring file (created or reused) and reset it to an empty ring
+        bool Create(const std::filesystem::path& path, SharedRingStream stream, uint32_t slotCount, size_t slotPayloadCapacity);
+        void Close();
+        bool IsOpen() const { return m_pView != nullptr; }
+        size_t PayloadCapacity() const { return m_payloadCapacity; }
+        const std::filesystem::path& Path() const { return m_path; }
+
+        // Returns false if the planes do not fit into a slot
+        bool Publish(const SharedFrameInfo& info, const SharedFramePlane* pPlanes, uint32_t planeCount);
+
+        uint64_t Published() const { return m_published; }
+        uint64_t Oversized() const { return m_oversized; }
+
+    private:
+        bool Map(size_t size);
+
+        std::filesystem::path m_path;
+        uint8_t* m_pView = nullptr;
+        size_t m_viewSize = 0;
+        uint32_t m_slotCount = 0;
+        size_t m_slotStride = 0;
+        size_t m_payloadCapacity = 0;
+        SharedRingStream m_stream = SharedRingStream::Depth;
+        std::atomic<uint64_t> m_published = 0;
+        std::atomic<uint64_t> m_oversized = 0;
+#ifdef _WIN32
+        void* m_file = nullptr;
+        void* m_mapping = nullptr;
+#else
+        int m_file = -1;
+#endif
+    };
+}
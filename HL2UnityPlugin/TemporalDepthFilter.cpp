@@ -0,0 +1,59 @@
+#include "pch.h"
+#include "TemporalDepthFilter.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    void TemporalDepthFilter::Apply(const TemporalDepthFilterSettings& settings, const UINT16* pDepth, const UINT16* pAbImage,
+        const XMFLOAT3* pUnitRays, size_t pixelCount, FXMMATRIX depthToWorld, UINT16* pFiltered)
+    {
+        // position of the current camera in the previous camera frame (mm), and rotation angle between the two frames
+        XMFLOAT3 motion(0, 0, 0);
+        bool reset = !m_hasPreviousPose || m_average.size() != pixelCount;
+        if (!reset)
+        {
+            XMMATRIX currentToPrevious = depthToWorld * XMMatrixInverse(nullptr, XMLoadFloat4x4(&m_previousDepthToWorld));
+            XMVECTOR translation = currentToPrevious.r[3];
+            XMFLOAT4X4 delta;
+            XMStoreFloat4x4(&delta, currentToPrevious);
+            float cosAngle = (std::min)(1.0f, (std::max)(-1.0f, (delta._11 + delta._22 + delta._33 - 1) / 2));
+            float angle = XMConvertToDegrees(acosf(cosAngle));
+
+            reset = angle > settings.maxRotation || XMVectorGetX(XMVector3Length(translation)) > settings.maxTranslation;
+            XMStoreFloat3(&motion, translation * 1000);
+        }
+        XMStoreFloat4x4(&m_previousDepthToWorld, depthToWorld);
+        m_hasPreviousPose = true;
+
+        if (reset)
+        {
+            m_average.assign(pixelCount, 0.0f);
+        }
+
+        // branch-free per-pixel update so the compiler can vectorize the loop
+        float* pAverage = m_average.data();
+        const float alpha = settings.alpha;
+        const float minAb = settings.minAbValue;
+        for (size_t idx = 0; idx < pixelCount; idx++)
+        {
+            float raw = pDepth[idx];
+            float average = pAverage[idx];
+            const XMFLOAT3& ray = pUnitRays[idx];
+
+            // first-order range change of a static point seen along this ray after the camera moved
+            float predicted = average - (ray.x * motion.x + ray.y * motion.y + ray.z * motion.z);
+            bool hasHistory = average > 0 && predicted > 0;
+            bool depthValid = raw > 0 && raw <= 4090;
+            bool trusted = depthValid && pAbImage[idx] >= minAb;
+            bool consistent = hasHistory && fabsf(raw - predicted) <= (std::max)(settings.outlierAbsolute, settings.outlierRelative * raw);
+
+            float updated = consistent ? predicted + alpha * (raw - predicted) : raw;
+            float next = trusted ? updated : (hasHistory ? predicted : 0.0f);
+            pAverage[idx] = next;
+            pFiltered[idx] = (depthValid && next > 0) ? (UINT16)(next + 0.5f) : pDepth[idx];
+        }
+    }
+}
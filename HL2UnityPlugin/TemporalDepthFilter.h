@@ -0,0 +1,34 @@
+#pragma once
+#include <windows.h>
+#include <DirectXMath.h>
+#include <vector>
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    struct TemporalDepthFilterSettings {
+        float alpha = 0.3f;            // weight of the new measurement in the moving average
+        UINT16 minAbValue = 50;        // pixels with lower AbImage intensity do not update the average
+        float outlierAbsolute = 15.0f; // Unit: mm, jumps beyond max(outlierAbsolute, outlierRelative * depth)
+        float outlierRelative = 0.02f; // restart the average at the new depth
+        float maxRotation = 2.0f;      // Unit: degree, head motion between frames beyond these limits
+        float maxTranslation = 0.05f;  // Unit: m, resets the filter
+    };
+
+    // Exponential moving average over raw AHAT depth with outlier rejection.
+    // The running average of each pixel is kept in a preallocated buffer and compensated for small head
+    // translations by moving the average along the pixel ray; larger motions reset the filter.
+    class TemporalDepthFilter
+    {
+    public:
+        void Reset() { m_hasPreviousPose = false; }
+
+        // Filter the raw depth frame into pFiltered. Invalid raw pixels (0 or > 4090) are passed through.
+        void Apply(const TemporalDepthFilterSettings& settings, const UINT16* pDepth, const UINT16* pAbImage,
+            const DirectX::XMFLOAT3* pUnitRays, size_t pixelCount, DirectX::FXMMATRIX depthToWorld, UINT16* pFiltered);
+
+    private:
+        std::vector<float> m_average; // Unit: mm, 0 for pixels without history
+        DirectX::XMFLOAT4X4 m_previousDepthToWorld;
+        bool m_hasPreviousPose = false;
+    };
+}
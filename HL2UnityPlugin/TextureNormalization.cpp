@@ -0,0 +1,100 @@
+#include "TextureNormalization.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    void TextureNormalizer::Reset()
+    {
+        m_hasRange = false;
+        std::lock_guard<std::mutex> l(m_mutex);
+        m_rangeMin = m_rangeMax = 0;
+        m_frames = 0;
+    }
+
+    UINT32* TextureNormalizer::BeginFrame()
+    {
+        std::fill(m_histogram.begin(), m_histogram.end(), 0);
+        return m_histogram.data();
+    }
+
+    void TextureNormalizer::Update(const TextureNormalizationSettings& settings)
+    {
+        auto start = StreamStats::Clock::now();
+        UINT64 total = 0;
+        for (UINT32 count : m_histogram)
+        {
+            total += count;
+        }
+        if (total == 0)
+        {
+            return;
+        }
+
+        // first bins whose cumulative counts reach the percentiles
+        float lowFraction = (std::min)((std::max)(settings.lowPercentile, 0.0f), 1.0f);
+        float highFraction = (std::min)((std::max)(settings.highPercentile, lowFraction), 1.0f);
+        UINT64 lowCount = (UINT64)(lowFraction * total), highCount = (UINT64)(highFraction * total);
+        UINT low = 0, high = kBins - 1;
+        UINT64 cumulative = 0;
+        bool lowFound = false;
+        for (UINT bin = 0; bin < kBins; bin++)
+        {
+            cumulative += m_histogram[bin];
+            if (!lowFound && cumulative > lowCount)
+            {
+                low = bin;
+                lowFound = true;
+            }
+            if (cumulative >= highCount && cumulative > 0)
+            {
+                high = bin;
+                break;
+            }
+        }
+        high = (std::max)(high, low);
+
+        float weight = (std::min)((std::max)(settings.smoothing, 0.0f), 1.0f);
+        if (!m_hasRange || weight >= 1)
+        {
+            m_smoothedMin = (float)low;
+            m_smoothedMax = (float)high;
+        }
+        else
+        {
+            m_smoothedMin += weight * ((float)low - m_smoothedMin);
+            m_smoothedMax += weight * ((float)high - m_smoothedMax);
+        }
+
+        float center = (m_smoothedMin + m_smoothedMax) / 2;
+        float halfRange = (std::max)((m_smoothedMax - m_smoothedMin) / 2, (float)settings.minRange / 2);
+        float rangeMin = (std::max)(center - halfRange, 0.0f);
+        float rangeMax = (std::min)(rangeMin + 2 * halfRange, (float)(kBins - 1));
+        UINT16 lutMin = (UINT16)lroundf(rangeMin), lutMax = (UINT16)lroundf(rangeMax);
+        m_lut.Build(lutMin, lutMax);
+        m_hasRange = true;
+        m_durations.Add(std::chrono::duration<float, std::micro>(StreamStats::Clock::now() - start).count());
+
+        std::lock_guard<std::mutex> l(m_mutex);
+        m_rangeMin = lutMin;
+        m_rangeMax = lutMax;
+        m_frames++;
+    }
+
+    std::string TextureNormalizer::StatusJson() const
+    {
+        auto durations = m_durations.Summarize();
+        std::lock_guard<std::mutex> l(m_mutex);
+        std::stringstream ss;
+        ss << "{\"min\":" << m_rangeMin
+            << ",\"max\":" << m_rangeMax
+            << ",\"frames\":" << m_frames
+            << ",\"update_us\":{\"mean\":" << durations.mean
+            << ",\"p50\":" << durations.p50
+            << ",\"p95\":" << durations.p95
+            << ",\"max\":" << durations.max << "}}";
+        return ss.str();
+    }
+}
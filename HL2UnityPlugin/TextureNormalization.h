@@ -0,0 +1,51 @@
+#pragma once
+#include "Colormap.h"
+#include "PipelineStats.h"
+#include "Platform.h"
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    struct TextureNormalizationSettings {
+        float lowPercentile = 0.01f;    // fraction of the pixels mapped to 0 or below
+        float highPercentile = 0.99f;   // fraction of the pixels mapped below 255
+        float smoothing = 0.2f;         // weight of the newest frame in the range average, 1 = no smoothing
+        UINT16 minRange = 50;           // the range is widened around its center to at least this many values
+    };
+
+    // Texture range of one stream from the histogram of its raw values. The sensor loop passes the histogram returned by
+    // BeginFrame() to the pixel pass of a frame, which counts the values while writing the textures, then calls Update to
+    // move the range toward the percentiles of that frame; the table applies from the next frame on.
+    class TextureNormalizer
+    {
+    public:
+        static const UINT kBins = TextureLut::kSize;
+
+        void Reset();
+
+        // Clear the histogram for the next frame and return it, kBins counts
+        UINT32* BeginFrame();
+
+        // Move the range toward the percentiles of the histogram and rebuild the table; frames without counts are ignored
+        void Update(const TextureNormalizationSettings& settings);
+
+        // Table of the current range, null until the first update
+        const TextureLut* Lut() const { return m_hasRange ? &m_lut : nullptr; }
+
+        // {"min":...,"max":...,"frames":...,"update_us":{"mean":...,"p50":...,"p95":...,"max":...}}
+        std::string StatusJson() const;
+
+    private:
+        std::vector<UINT32> m_histogram = std::vector<UINT32>(kBins, 0);
+        TextureLut m_lut;
+        float m_smoothedMin = 0, m_smoothedMax = 0;
+        bool m_hasRange = false;
+
+        mutable std::mutex m_mutex;     // guards the members below, read by the status getter
+        UINT16 m_rangeMin = 0, m_rangeMax = 0;
+        UINT64 m_frames = 0;
+        StageHistogram m_durations;
+    };
+}
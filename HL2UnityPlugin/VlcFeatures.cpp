@@ -0,0 +1,230 @@
+#include "VlcFeatures.h"
+#include <algorithm>
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    namespace
+    {
+        // Bresenham circle of radius 3 around the center, clockwise from the top
+        const int kCircleX[16] = { 0, 1, 2, 3, 3, 3, 2, 1, 0, -1, -2, -3, -3, -3, -2, -1 };
+        const int kCircleY[16] = { -3, -3, -2, -1, 0, 1, 2, 3, 3, 3, 2, 1, 0, -1, -2, -3 };
+
+        // True if the 16 bit circle mask has 9 consecutive bits set, wrapping around
+        inline bool HasArc9(UINT mask)
+        {
+            UINT runs = mask | (mask << 16);
+            runs &= runs >> 1;  // runs of 2
+            runs &= runs >> 2;  // runs of 4
+            runs &= runs >> 4;  // runs of 8
+            runs &= runs >> 1;  // runs of 9
+            return runs != 0;
+        }
+    }
+
+    void DownsampleHalf(const BYTE* pSource, UINT width, UINT height, BYTE* pDestination)
+    {
+        UINT halfWidth = width / 2, halfHeight = height / 2;
+        for (UINT i = 0; i < halfHeight; i++)
+        {
+            const BYTE* pRow0 = pSource + 2 * i * width;
+            const BYTE* pRow1 = pRow0 + width;
+            BYTE* pOut = pDestination + i * halfWidth;
+            for (UINT j = 0; j < halfWidth; j++)
+            {
+                // 16 bit sums keep eight or more pixels per vector register
+                UINT16 top = (UINT16)(pRow0[2 * j] + pRow0[2 * j + 1]);
+                UINT16 bottom = (UINT16)(pRow1[2 * j] + pRow1[2 * j + 1]);
+                pOut[j] = (BYTE)((UINT16)(top + bottom + 2) >> 2);
+            }
+        }
+    }
+
+    void VlcFeatureExtractor::Extract(const FeatureExtractionSettings& settings, const BYTE* pImage, UINT width, UINT height)
+    {
+        m_keypoints.clear();
+        UINT levelCount = (std::max)(settings.levels, 1u);
+        m_levels.resize(levelCount);
+        m_levels[0].width = width;
+        m_levels[0].height = height;
+        for (UINT level = 1; level < levelCount; level++)
+        {
+            const auto& previous = m_levels[level - 1];
+            auto& current = m_levels[level];
+            current.width = previous.width / 2;
+            current.height = previous.height / 2;
+            current.image.resize(current.width * current.height);
+            DownsampleHalf(level == 1 ? pImage : previous.image.data(), previous.width, previous.height, current.image.data());
+        }
+
+        for (UINT level = 0; level < levelCount; level++)
+        {
+            const auto& current = m_levels[level];
+            DetectLevel(settings, level == 0 ? pImage : current.image.data(), current.width, current.height, level);
+        }
+
+        auto stronger = [](const Keypoint& a, const Keypoint& b) { return a.score > b.score; };
+        if (m_keypoints.size() > settings.maxKeypoints)
+        {
+            std::partial_sort(m_keypoints.begin(), m_keypoints.begin() + settings.maxKeypoints, m_keypoints.end(), stronger);
+            m_keypoints.resize(settings.maxKeypoints);
+        }
+        else
+        {
+            std::sort(m_keypoints.begin(), m_keypoints.end(), stronger);
+        }
+    }
+
+    void VlcFeatureExtractor::DetectLevel(const FeatureExtractionSettings& settings, const BYTE* pImage, UINT width, UINT height, UINT level)
+    {
+        const int border = 3;
+        if (width <= 2 * border || height <= 2 * border)
+        {
+            return;
+        }
+
+        // scores of all corners first, so corners can be compared with their neighbors; m_scores is kept zero outside
+        // the corners of the current level
+        if (m_scores.size() < width * height)
+        {
+            m_scores.assign(width * height, 0);
+        }
+        m_candidates.resize(width);
+        m_corners.clear();
+        int offsets[16];
+        for (int k = 0; k < 16; k++)
+        {
+            offsets[k] = kCircleY[k] * (int)width + kCircleX[k];
+        }
+        const int threshold = settings.threshold;
+        for (UINT i = border; i < height - border; i++)
+        {
+            const BYTE* pRow = pImage + i * width;
+            const BYTE* pUp = pRow - border * width;
+            const BYTE* pDown = pRow + border * width;
+            UINT8* pCandidates = m_candidates.data();
+
+            // an arc of 9 contains one of the opposite pixels 0 and 8, and one of 4 and 12; this branch-free test of
+            // the whole row in 16 bit vectorizes and rejects most pixels
+            const INT16 threshold16 = (INT16)threshold;
+            for (UINT j = border; j < width - border; j++)
+            {
+                INT16 center = pRow[j];
+                INT16 brighter = center + threshold16, darker = center - threshold16;
+                INT16 p0 = pUp[j], p4 = pRow[j + border], p8 = pDown[j], p12 = pRow[j - border];
+                UINT8 maybeBright = ((p0 > brighter) | (p8 > brighter)) & ((p4 > brighter) | (p12 > brighter));
+                UINT8 maybeDark = ((p0 < darker) | (p8 < darker)) & ((p4 < darker) | (p12 < darker));
+                pCandidates[j] = maybeBright | maybeDark;
+            }
+
+            for (UINT j = border; j < width - border; j++)
+            {
+                if (!pCandidates[j])
+                {
+                    continue;
+                }
+                const BYTE* p = pRow + j;
+                int brighter = *p + threshold, darker = *p - threshold;
+                UINT brightMask = 0, darkMask = 0;
+                int brightScore = 0, darkScore = 0;
+                for (int k = 0; k < 16; k++)
+                {
+                    int value = p[offsets[k]];
+                    if (value > brighter)
+                    {
+                        brightMask |= 1u << k;
+                        brightScore += value - brighter;
+                    }
+                    else if (value < darker)
+                    {
+                        darkMask |= 1u << k;
+                        darkScore += darker - value;
+                    }
+                }
+                int score = 0;
+                if (HasArc9(brightMask))
+                {
+                    score = brightScore;
+                }
+                if (HasArc9(darkMask))
+                {
+                    score = (std::max)(score, darkScore);
+                }
+                // every arc pixel adds at least 1, so corners score above 0
+                if (score > 0)
+                {
+                    m_scores[i * width + j] = (UINT16)(std::min)(score, 0xFFFF);
+                    m_corners.push_back(i * width + j);
+                }
+            }
+        }
+
+        // grid of cellSize cells of the full image, the same for all levels
+        const UINT cellSize = (std::max)(settings.cellSize, 1u);
+        const UINT maxPerCell = (std::max)(settings.maxPerCell, 1u);
+        const UINT fullWidth = width << level, fullHeight = height << level;
+        const UINT cellsX = (fullWidth + cellSize - 1) / cellSize;
+        const UINT cellsY = (fullHeight + cellSize - 1) / cellSize;
+        m_cells.resize(cellsX * cellsY * maxPerCell);
+        m_cellCounts.assign(cellsX * cellsY, 0);
+
+        // keep 3x3 local maxima only (ties go to the first pixel), then the strongest per cell
+        const int w = (int)width;
+        for (UINT idx : m_corners)
+        {
+            const UINT16* s = m_scores.data() + idx;
+            UINT16 score = *s;
+            if (score < s[-w - 1] || score < s[-w] || score < s[-w + 1] || score < s[-1] ||
+                score <= s[1] || score <= s[w - 1] || score <= s[w] || score <= s[w + 1])
+            {
+                continue;
+            }
+            UINT i = idx / width, j = idx % width;
+            UINT cell = ((i << level) / cellSize) * cellsX + (j << level) / cellSize;
+            Keypoint* pSlots = m_cells.data() + cell * maxPerCell;
+            UINT& count = m_cellCounts[cell];
+            if (count < maxPerCell)
+            {
+                pSlots[count++] = Keypoint{ (float)j, (float)i, (float)score, level };
+                continue;
+            }
+            Keypoint* pWeakest = std::min_element(pSlots, pSlots + maxPerCell,
+                [](const Keypoint& a, const Keypoint& b) { return a.score < b.score; });
+            if (pWeakest->score < score)
+            {
+                *pWeakest = Keypoint{ (float)j, (float)i, (float)score, level };
+            }
+        }
+        for (UINT idx : m_corners)
+        {
+            m_scores[idx] = 0;
+        }
+
+        // level pixel centers in full image pixel coordinates
+        const float scale = (float)(1u << level);
+        const float offset = 0.5f * scale - 0.5f;
+        for (UINT cell = 0; cell < cellsX * cellsY; cell++)
+        {
+            const Keypoint* pSlots = m_cells.data() + cell * maxPerCell;
+            for (UINT k = 0; k < m_cellCounts[cell]; k++)
+            {
+                Keypoint keypoint = pSlots[k];
+                keypoint.x = keypoint.x * scale + offset;
+                keypoint.y = keypoint.y * scale + offset;
+                m_keypoints.push_back(keypoint);
+            }
+        }
+    }
+
+    void VlcFeatureExtractor::Pack(std::vector<float>& packed) const
+    {
+        packed.clear();
+        packed.reserve(m_keypoints.size() * kPackedKeypointSize);
+        for (const auto& keypoint : m_keypoints)
+        {
+            packed.push_back(keypoint.x);
+            packed.push_back(keypoint.y);
+            packed.push_back(keypoint.score);
+            packed.push_back((float)keypoint.level);
+        }
+    }
+}
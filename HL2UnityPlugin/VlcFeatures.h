@@ -0,0 +1,58 @@
+#pragma once
+#include "Platform.h"
+#include <vector>
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    struct FeatureExtractionSettings {
+        UINT levels = 3;            // pyramid levels including the full image, each half the size of the previous
+        UINT8 threshold = 20;       // FAST: circle pixels brighter or darker than the center by more than this
+        UINT cellSize = 32;         // Unit: pixels of the full image, grid cell of the non-max suppression
+        UINT maxPerCell = 2;        // strongest corners kept per cell and level
+        UINT maxKeypoints = 500;    // strongest corners kept per image
+    };
+
+    struct Keypoint {
+        float x = 0;        // full image pixel coordinates
+        float y = 0;
+        float score = 0;    // sum of the circle differences beyond the threshold
+        UINT level = 0;
+    };
+
+    // FAST-9 corners on a 2x box-filtered image pyramid. Every level is split into a grid of cellSize cells of the full
+    // image and each cell keeps only its strongest corners, so keypoints spread over the image instead of clustering on
+    // the most textured parts. Buffers are kept between frames.
+    class VlcFeatureExtractor
+    {
+    public:
+        static const size_t kPackedKeypointSize = 4;
+
+        void Extract(const FeatureExtractionSettings& settings, const BYTE* pImage, UINT width, UINT height);
+
+        // Keypoints of the last image, strongest first
+        const std::vector<Keypoint>& Keypoints() const { return m_keypoints; }
+
+        // Keypoints of the last image as kPackedKeypointSize floats each: x, y, score, level
+        void Pack(std::vector<float>& packed) const;
+
+    private:
+        struct Level {
+            std::vector<BYTE> image;   // empty for level 0, which is the input image
+            UINT width = 0;
+            UINT height = 0;
+        };
+
+        void DetectLevel(const FeatureExtractionSettings& settings, const BYTE* pImage, UINT width, UINT height, UINT level);
+
+        std::vector<Level> m_levels;
+        std::vector<UINT16> m_scores;       // corner scores of the current level, 0 = no corner
+        std::vector<UINT8> m_candidates;    // pixels of the current row passing the quick test
+        std::vector<UINT> m_corners;        // pixel indices of the corners of the current level
+        std::vector<Keypoint> m_cells;      // maxPerCell slots per grid cell of the current level
+        std::vector<UINT> m_cellCounts;
+        std::vector<Keypoint> m_keypoints;
+    };
+
+    // 2x downsampling by averaging 2x2 blocks, written as plain per-row loops the compiler vectorizes
+    void DownsampleHalf(const BYTE* pSource, UINT width, UINT height, BYTE* pDestination);
+}
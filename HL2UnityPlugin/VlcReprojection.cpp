@@ -0,0 +1,153 @@
+#include "VlcReprojection.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+#ifdef _WIN32
+    void CameraProjectionLut::Build(IResearchModeCameraSensor* pCameraSensor, UINT width, UINT height)
+    {
+        CameraMapping mapping;
+        // the sensor takes array references
+        mapping.imageToUnitPlane = [pCameraSensor](const float uv[2], float xy[2]) {
+            float in[2] = { uv[0], uv[1] }, out[2] = { 0, 0 };
+            bool mapped = SUCCEEDED(pCameraSensor->MapImagePointToCameraUnitPlane(in, out));
+            xy[0] = out[0];
+            xy[1] = out[1];
+            return mapped;
+        };
+        mapping.unitPlaneToImage = [pCameraSensor](const float xy[2], float uv[2]) {
+            float in[2] = { xy[0], xy[1] }, out[2] = { 0, 0 };
+            bool mapped = SUCCEEDED(pCameraSensor->MapCameraSpaceToImagePoint(in, out));
+            uv[0] = out[0];
+            uv[1] = out[1];
+            return mapped;
+        };
+        Build(mapping, width, height);
+    }
+#endif
+
+    void CameraProjectionLut::Build(const CameraMapping& mapping, UINT width, UINT height)
+    {
+        m_width = width;
+        m_height = height;
+
+        // extent of the image on the unit plane, from the image border
+        float xMin = FLT_MAX, xMax = -FLT_MAX, yMin = FLT_MAX, yMax = -FLT_MAX;
+        const int borderSamples = 16;
+        for (int k = 0; k <= borderSamples; k++)
+        {
+            float t = (float)k / borderSamples;
+            float borderPoints[4][2] = { { t * (width - 1), 0 }, { t * (width - 1), (float)(height - 1) },
+                { 0, t * (height - 1) }, { (float)(width - 1), t * (height - 1) } };
+            for (auto& point : borderPoints)
+            {
+                float uv[2] = { point[0], point[1] };
+                float xy[2] = { 0, 0 };
+                if (!mapping.imageToUnitPlane(uv, xy))
+                {
+                    continue;
+                }
+                xMin = (std::min)(xMin, xy[0]); xMax = (std::max)(xMax, xy[0]);
+                yMin = (std::min)(yMin, xy[1]); yMax = (std::max)(yMax, xy[1]);
+            }
+        }
+        if (xMin >= xMax || yMin >= yMax)
+        {
+            m_uv.clear();
+            return;
+        }
+
+        m_xMin = xMin;
+        m_yMin = yMin;
+        m_xStep = (xMax - xMin) / kGridSize;
+        m_yStep = (yMax - yMin) / kGridSize;
+        m_uv.assign((kGridSize + 1) * (kGridSize + 1), XMFLOAT2(-1, -1));
+        for (int gy = 0; gy <= kGridSize; gy++)
+        {
+            for (int gx = 0; gx <= kGridSize; gx++)
+            {
+                float xy[2] = { m_xMin + gx * m_xStep, m_yMin + gy * m_yStep };
+                float uv[2] = { 0, 0 };
+                if (mapping.unitPlaneToImage(xy, uv))
+                {
+                    m_uv[gy * (kGridSize + 1) + gx] = XMFLOAT2(uv[0], uv[1]);
+                }
+            }
+        }
+    }
+
+    bool CameraProjectionLut::Project(float x, float y, float& u, float& v) const
+    {
+        float gxf = (x - m_xMin) / m_xStep;
+        float gyf = (y - m_yMin) / m_yStep;
+        if (!(gxf >= 0 && gyf >= 0 && gxf < kGridSize && gyf < kGridSize))
+        {
+            return false;
+        }
+        int gx = (int)gxf, gy = (int)gyf;
+        float fx = gxf - gx, fy = gyf - gy;
+        const XMFLOAT2& n00 = m_uv[gy * (kGridSize + 1) + gx];
+        const XMFLOAT2& n01 = m_uv[gy * (kGridSize + 1) + gx + 1];
+        const XMFLOAT2& n10 = m_uv[(gy + 1) * (kGridSize + 1) + gx];
+        const XMFLOAT2& n11 = m_uv[(gy + 1) * (kGridSize + 1) + gx + 1];
+        if (n00.x < 0 || n01.x < 0 || n10.x < 0 || n11.x < 0)
+        {
+            return false;
+        }
+        u = (n00.x * (1 - fx) + n01.x * fx) * (1 - fy) + (n10.x * (1 - fx) + n11.x * fx) * fy;
+        v = (n00.y * (1 - fx) + n01.y * fx) * (1 - fy) + (n10.y * (1 - fx) + n11.y * fx) * fy;
+        return u >= 0 && v >= 0 && u < m_width - 1 && v < m_height - 1;
+    }
+
+    static bool SampleCamera(FXMVECTOR pointInWorld, const VlcFrameSnapshot* pFrame, const CameraProjectionLut& lut, float& intensity)
+    {
+        if (!pFrame || !lut.IsBuilt())
+        {
+            return false;
+        }
+        XMFLOAT3 pointInCam;
+        XMStoreFloat3(&pointInCam, XMVector3Transform(pointInWorld, XMLoadFloat4x4(&pFrame->worldToCamera)));
+        float u, v;
+        if (pointInCam.z <= 0 || !lut.Project(pointInCam.x / pointInCam.z, pointInCam.y / pointInCam.z, u, v))
+        {
+            return false;
+        }
+
+        // bilinear sample
+        UINT x = (UINT)u, y = (UINT)v;
+        float fx = u - x, fy = v - y;
+        const UINT8* p = pFrame->image.data() + pFrame->width * y + x;
+        float top = p[0] * (1 - fx) + p[1] * fx;
+        float bottom = p[pFrame->width] * (1 - fx) + p[pFrame->width + 1] * fx;
+        intensity = (top * (1 - fy) + bottom * fy) / 255;
+        return true;
+    }
+
+    void SampleVlcIntensity(const std::vector<float>& pointCloud,
+        const VlcFrameSnapshot* pLF, const CameraProjectionLut& LFLut,
+        const VlcFrameSnapshot* pRF, const CameraProjectionLut& RFLut,
+        std::vector<float>& coloredPointCloud)
+    {
+        size_t pointCount = pointCloud.size() / 3;
+        coloredPointCloud.resize(pointCount * 4);
+        for (size_t k = 0; k < pointCount; k++)
+        {
+            const float* point = &pointCloud[3 * k];
+            XMVECTOR pointInWorld = XMVectorSet(point[0], point[1], -point[2], 1);
+            float intensity = -1;
+            if (!SampleCamera(pointInWorld, pLF, LFLut, intensity))
+            {
+                SampleCamera(pointInWorld, pRF, RFLut, intensity);
+            }
+            float* out = &coloredPointCloud[4 * k];
+            out[0] = point[0];
+            out[1] = point[1];
+            out[2] = point[2];
+            out[3] = intensity;
+        }
+    }
+}
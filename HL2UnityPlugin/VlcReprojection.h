@@ -0,0 +1,56 @@
+#pragma once
+#include "Platform.h"
+#ifdef _WIN32
+#include "ResearchModeApi.h"
+#endif
+#include <DirectXMath.h>
+#include <functional>
+#include <vector>
+#include <memory>
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    // Cached camera space to image mapping of a VLC camera. MapCameraSpaceToImagePoint is sampled once on a grid
+    // over the unit plane, projections are then bilinear lookups into that grid.
+    class CameraProjectionLut
+    {
+    public:
+        // Camera mapping in both directions, as MapImagePointToCameraUnitPlane and MapCameraSpaceToImagePoint of the
+        // sensor; false where the mapping fails
+        struct CameraMapping {
+            std::function<bool(const float uv[2], float xy[2])> imageToUnitPlane;
+            std::function<bool(const float xy[2], float uv[2])> unitPlaneToImage;
+        };
+
+#ifdef _WIN32
+        void Build(IResearchModeCameraSensor* pCameraSensor, UINT width, UINT height);
+#endif
+        void Build(const CameraMapping& mapping, UINT width, UINT height);
+        bool IsBuilt() const { return !m_uv.empty(); }
+        // Project a point on the unit plane (x/z, y/z) to image coordinates. Returns false if it falls outside the image.
+        bool Project(float x, float y, float& u, float& v) const;
+
+    private:
+        static const int kGridSize = 64;
+        float m_xMin = 0, m_yMin = 0, m_xStep = 1, m_yStep = 1;
+        UINT m_width = 0, m_height = 0;
+        std::vector<DirectX::XMFLOAT2> m_uv; // (kGridSize + 1)^2 nodes, negative u marks an unmapped node
+    };
+
+    // Copy of one VLC frame together with its capture time and world-to-camera transform
+    struct VlcFrameSnapshot {
+        std::vector<UINT8> image;
+        UINT width = 0;
+        UINT height = 0;
+        UINT64 hostTicks = 0;
+        DirectX::XMFLOAT4X4 worldToCamera;
+    };
+
+    // Write x, y, z, intensity for every point of pointCloud (x, y, -z in world space) into coloredPointCloud.
+    // Each point is projected into the LF image first and into the RF image if it is not visible in LF;
+    // points visible in neither camera get intensity -1. Intensity is in [0, 1].
+    void SampleVlcIntensity(const std::vector<float>& pointCloud,
+        const VlcFrameSnapshot* pLF, const CameraProjectionLut& LFLut,
+        const VlcFrameSnapshot* pRF, const CameraProjectionLut& RFLut,
+        std::vector<float>& coloredPointCloud);
+}
@@ -0,0 +1,180 @@
+#include "WorldPointMap.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    static const UINT64 kDistanceSweepInterval = 30; // Unit: frames
+
+    void WorldPointMap::Configure(const WorldPointMapSettings& settings)
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+        bool voxelSizeChanged = settings.voxelSize != m_settings.voxelSize;
+        m_settings = settings;
+        m_settings.voxelSize = (std::max)(m_settings.voxelSize, 0.001f);
+        m_settings.maxPoints = (std::max)(m_settings.maxPoints, (size_t)1);
+        if (voxelSizeChanged)
+        {
+            ClearLocked();
+        }
+        m_index.reserve(m_settings.maxPoints);
+    }
+
+    void WorldPointMap::Clear()
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+        ClearLocked();
+    }
+
+    void WorldPointMap::ClearLocked()
+    {
+        m_entries.clear();
+        m_index.clear();
+        m_evicted.clear();
+        // consumers that saw the cleared points need a full resync: the clear gets its own sequence number, so every
+        // sequence number from before it is older than the log
+        m_sequence++;
+        m_evictedLogSince = m_sequence;
+    }
+
+    size_t WorldPointMap::Size() const
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+        return m_entries.size();
+    }
+
+    UINT64 WorldPointMap::VoxelKey(float x, float y, float z) const
+    {
+        // 21 bits per axis around the origin
+        auto cell = [this](float v) { return (UINT64)((INT64)floorf(v / m_settings.voxelSize) + (1 << 20)) & 0x1FFFFF; };
+        return cell(x) | (cell(y) << 21) | (cell(z) << 42);
+    }
+
+    void WorldPointMap::Integrate(const float* pPoints, size_t pointCount, const XMFLOAT3& sensorPosition)
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+        m_sequence++;
+        const float maxWeight = (float)m_settings.maxWeight;
+
+        for (size_t k = 0; k < pointCount; k++)
+        {
+            const float* p = pPoints + 3 * k;
+            UINT64 key = VoxelKey(p[0], p[1], p[2]);
+            auto found = m_index.find(key);
+            if (found == m_index.end())
+            {
+                m_entries.push_back(Entry{ key, XMFLOAT3(p[0], p[1], p[2]), 1, m_sequence });
+                m_index.emplace(key, std::prev(m_entries.end()));
+                continue;
+            }
+
+            // running average, the weight of new observations stops decreasing at maxWeight
+            auto entry = found->second;
+            float weight = 1.0f / ((std::min)((float)entry->count, maxWeight) + 1);
+            entry->position.x += (p[0] - entry->position.x) * weight;
+            entry->position.y += (p[1] - entry->position.y) * weight;
+            entry->position.z += (p[2] - entry->position.z) * weight;
+            entry->count++;
+            if (entry->lastSeen != m_sequence)
+            {
+                entry->lastSeen = m_sequence;
+                m_entries.splice(m_entries.end(), m_entries, entry);
+            }
+        }
+
+        EvictOutsideLimits(sensorPosition);
+    }
+
+    void WorldPointMap::Evict(EntryList::iterator entry)
+    {
+        m_evicted.emplace_back(m_sequence, entry->position);
+        m_index.erase(entry->key);
+        m_entries.erase(entry);
+
+        // bound the eviction log to the point budget
+        while (m_evicted.size() > m_settings.maxPoints)
+        {
+            m_evictedLogSince = m_evicted.front().first;
+            m_evicted.pop_front();
+        }
+    }
+
+    void WorldPointMap::EvictOutsideLimits(const XMFLOAT3& sensorPosition)
+    {
+        // the least recently observed points are at the front
+        while (!m_entries.empty() && m_settings.maxAge > 0 && m_entries.front().lastSeen + m_settings.maxAge < m_sequence)
+        {
+            Evict(m_entries.begin());
+        }
+        while (m_entries.size() > m_settings.maxPoints)
+        {
+            Evict(m_entries.begin());
+        }
+
+        // distance limit needs a full pass, so only sweep every few frames
+        if (m_settings.maxDistance > 0 && m_sequence % kDistanceSweepInterval == 0)
+        {
+            float maxDistanceSq = m_settings.maxDistance * m_settings.maxDistance;
+            for (auto entry = m_entries.begin(); entry != m_entries.end();)
+            {
+                float dx = entry->position.x - sensorPosition.x;
+                float dy = entry->position.y - sensorPosition.y;
+                float dz = entry->position.z - sensorPosition.z;
+                auto next = std::next(entry);
+                if (dx * dx + dy * dy + dz * dz > maxDistanceSq)
+                {
+                    Evict(entry);
+                }
+                entry = next;
+            }
+        }
+    }
+
+    UINT64 WorldPointMap::ChangedSince(UINT64 sinceSequence, std::vector<float>& packed, bool& fullResync) const
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+        fullResync = sinceSequence == 0 || sinceSequence < m_evictedLogSince || sinceSequence > m_sequence;
+        UINT64 since = fullResync ? 0 : sinceSequence;
+        packed.clear();
+
+        if (!fullResync)
+        {
+            // the eviction log is ordered by sequence number
+            auto evicted = std::partition_point(m_evicted.begin(), m_evicted.end(),
+                [since](const std::pair<UINT64, XMFLOAT3>& eviction) { return eviction.first <= since; });
+            for (; evicted != m_evicted.end(); ++evicted)
+            {
+                const float values[kPackedPointSize] = { evicted->second.x, evicted->second.y, evicted->second.z, 0 };
+                packed.insert(packed.end(), values, values + kPackedPointSize);
+            }
+        }
+
+        // points changed since the sequence number are at the back of the list
+        auto changed = m_entries.end();
+        while (changed != m_entries.begin() && std::prev(changed)->lastSeen > since)
+        {
+            --changed;
+        }
+        for (; changed != m_entries.end(); ++changed)
+        {
+            const float values[kPackedPointSize] = { changed->position.x, changed->position.y, changed->position.z, (float)changed->count };
+            packed.insert(packed.end(), values, values + kPackedPointSize);
+        }
+        return m_sequence;
+    }
+
+    UINT64 WorldPointMap::Snapshot(std::vector<float>& packed) const
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+        packed.clear();
+        packed.reserve(m_entries.size() * kPackedPointSize);
+        for (const auto& entry : m_entries)
+        {
+            const float values[kPackedPointSize] = { entry.position.x, entry.position.y, entry.position.z, (float)entry.count };
+            packed.insert(packed.end(), values, values + kPackedPointSize);
+        }
+        return m_sequence;
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "Platform.h"
+#include <DirectXMath.h>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace winrt::HL2UnityPlugin::implementation
+{
+    struct WorldPointMapSettings {
+        float voxelSize = 0.01f;    // Unit: m, observations within one voxel are merged into one point
+        size_t maxPoints = 200000;  // memory budget, the least recently observed points are evicted first
+        float maxDistance = 0;      // Unit: m, points farther from the sensor are evicted, 0 = no limit
+        UINT64 maxAge = 0;          // Unit: frames, points not observed for longer are evicted, 0 = no limit
+        UINT maxWeight = 64;        // observation count after which the running average stops slowing down
+    };
+
+    // Persistent world-space point map with bounded memory. Points are keyed by a spatial hash of their voxel and
+    // merged into running averages. Every integrated frame increments the sequence number, and changes (updated,
+    // added and evicted points) can be queried incrementally since any earlier sequence number.
+    class WorldPointMap
+    {
+    public:
+        static const size_t kPackedPointSize = 4;
+
+        // Changes the settings; a new voxel size clears the map
+        void Configure(const WorldPointMapSettings& settings);
+        void Clear();
+
+        // Merge pointCount points (x, y, z) observed from sensorPosition and evict points outside the limits
+        void Integrate(const float* pPoints, size_t pointCount, const DirectX::XMFLOAT3& sensorPosition);
+
+        // Write x, y, z, observation count of each point changed after sinceSequence: evicted points first, with count 0,
+        // then added and updated points. A point stays within its voxel, which identifies it. If the changes since
+        // sinceSequence are no longer known, or sinceSequence is 0, all points are written and fullResync is set. Returns the
+        // current sequence number.
+        UINT64 ChangedSince(UINT64 sinceSequence, std::vector<float>& packed, bool& fullResync) const;
+
+        // Write x, y, z, observation count of each point in the map, without evicted points. Returns the current sequence number.
+        UINT64 Snapshot(std::vector<float>& packed) const;
+
+        size_t Size() const;
+
+    private:
+        struct Entry {
+            UINT64 key;
+            DirectX::XMFLOAT3 position;
+            UINT32 count;
+            UINT64 lastSeen;    // sequence number of the last observation, also the last change
+        };
+        // least recently observed first, so changes since a sequence number are at the back
+        using EntryList = std::list<Entry>;
+
+        UINT64 VoxelKey(float x, float y, float z) const;
+        void ClearLocked();
+        void Evict(EntryList::iterator entry);
+        void EvictOutsideLimits(const DirectX::XMFLOAT3& sensorPosition);
+
+        mutable std::mutex m_mutex;
+        WorldPointMapSettings m_settings;
+        EntryList m_entries;
+        std::unordered_map<UINT64, EntryList::iterator> m_index;
+        std::deque<std::pair<UINT64, DirectX::XMFLOAT3>> m_evicted; // sequence number and position, bounded
+        UINT64 m_evictedLogSince = 0;   // all evictions after this sequence number are in m_evicted
+        UINT64 m_sequence = 0;
+    };
+}
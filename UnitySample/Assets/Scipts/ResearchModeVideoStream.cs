@@ -45,6 +45,8 @@ public class ResearchModeVideoStream : MonoBehaviour
     public GameObject pointCloudRendererGo;
     public Color pointColor = Color.white;
     private PointCloudRenderer pointCloudRenderer;
+    // set from the sensor thread by the DepthFrameArrived event, unchanged frames keep the published point cloud
+    private int depthFramesArrived = 0;
 
     void Start()
     {
@@ -74,11 +76,17 @@ public class ResearchModeVideoStream : MonoBehaviour
 
 #if ENABLE_WINMD_SUPPORT
         researchMode = new HL2ResearchMode();
-        researchMode.InitializeDepthSensor();
-        researchMode.InitializeLongDepthSensor();
-        researchMode.InitializeSpatialCamerasFront();
+        // acquire the sensors off the main thread, each loop starts once its sensor is ready
+        researchMode.InitializeSensors(true, true, true);
 
         researchMode.SetPointCloudDepthOffset(0);
+        researchMode.DepthFrameArrived += (sender, args) =>
+        {
+            if (!args.Unchanged)
+            {
+                System.Threading.Interlocked.Increment(ref depthFramesArrived);
+            }
+        };
 
         // Depth sensor should be initialized in only one mode
         researchMode.StartDepthSensorLoop();
@@ -189,8 +197,9 @@ public class ResearchModeVideoStream : MonoBehaviour
             }
         }
 
-        // Update point cloud
-        if (renderPointCloud)
+        // Update point cloud when a new depth frame was published
+        bool depthFrameArrived = System.Threading.Interlocked.Exchange(ref depthFramesArrived, 0) > 0;
+        if (renderPointCloud && depthFrameArrived)
         {
             float[] pointCloud = researchMode.GetPointCloudBuffer();
             if (pointCloud.Length > 0)
@@ -214,6 +223,12 @@ public class ResearchModeVideoStream : MonoBehaviour
     public void TogglePreviewEvent()
     {
         startRealtimePreview = !startRealtimePreview;
+#if ENABLE_WINMD_SUPPORT
+        // depth textures are only generated while they are shown
+        int textureMode = startRealtimePreview ? 1 : 0;
+        researchMode.SetDepthTextureMode(textureMode, 0, 0, 0, 0);
+        researchMode.SetLongDepthTextureMode(textureMode, 0, 0, 0, 0);
+#endif
     }
 
     bool renderPointCloud = true;
@@ -0,0 +1,69 @@
+// Stand-in producer for the shared memory transport: publishes synthetic AHAT frames (depth and AbImage planes) through
+// the plugin's SharedFrameRing, so readers can be developed and tested without a device.
+//
+// Build and run (Linux):
+//   g++ -std=c++17 -O2 -I../HL2UnityPlugin shared_ring_producer.cpp ../HL2UnityPlugin/SharedFrameRing.cpp -o shared_ring_producer
+//   ./shared_ring_producer /dev/shm/hl2_depth.ring [frames] [fps]      (fps 0: as fast as possible)
+//   python shared_ring_reader.py /dev/shm/hl2_depth.ring --verify
+//
+// Pixel k of frame n holds depth (n + k) & 0xFFFF and AbImage ~depth, the pose translates by n mm along x; a reader
+// that sees any other combination got a torn frame.
+#include "SharedFrameRing.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace winrt::HL2UnityPlugin::implementation;
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        printf("usage: %s <ring file> [frames] [fps]\n", argv[0]);
+        return 1;
+    }
+    const uint32_t width = 512, height = 512;
+    long long frameCount = argc > 2 ? atoll(argv[2]) : 0;     // 0: until stopped
+    double fps = argc > 3 ? atof(argv[3]) : 45;
+
+    SharedFrameRing ring;
+    if (!ring.Create(argv[1], SharedRingStream::Depth, 4, (size_t)width * height * 2 * sizeof(uint16_t)))
+    {
+        printf("failed to create %s\n", argv[1]);
+        return 1;
+    }
+
+    std::vector<uint16_t> depth(width * height), abImage(width * height);
+    auto start = std::chrono::steady_clock::now();
+    auto nextFrame = start;
+    for (long long n = 0; frameCount == 0 || n < frameCount; n++)
+    {
+        for (size_t k = 0; k < depth.size(); k++)
+        {
+            depth[k] = (uint16_t)(n + k);
+            abImage[k] = (uint16_t)~depth[k];
+        }
+        SharedFrameInfo info;
+        info.frameIndex = n;
+        info.hostTicks = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() * 10;
+        info.width = width;
+        info.height = height;
+        info.cameraToWorld[12] = n / 1000.0f;
+        SharedFramePlane planes[] = { { depth.data(), sizeof(uint16_t) }, { abImage.data(), sizeof(uint16_t) } };
+        ring.Publish(info, planes, 2);
+
+        if (fps > 0)
+        {
+            nextFrame += std::chrono::microseconds((long long)(1e6 / fps));
+            std::this_thread::sleep_until(nextFrame);
+        }
+        if (n % 450 == 449)
+        {
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            printf("published %llu frames, %.1f fps\n", (unsigned long long)ring.Published(), ring.Published() / seconds);
+        }
+    }
+    return 0;
+}
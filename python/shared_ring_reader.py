@@ -0,0 +1,179 @@
+"""Reader for the plugin's shared memory frame rings (see HL2UnityPlugin/SharedFrameRing.h for the layout).
+
+Any number of readers can attach to a ring file: they only read, so the producer never waits for them. A frame is
+copied out of its slot and kept only if the slot's seqlock sequence was even and unchanged around the copy.
+
+    python shared_ring_reader.py <ring file> [--verify] [--seconds N]
+"""
+import argparse
+import mmap
+import os
+import struct
+import sys
+import time
+
+import numpy as np
+
+MAGIC = b'HL2SHM1\x00'
+RING_HEADER = struct.Struct('<8sIIIIQQQQQ')
+SLOT_HEADER = struct.Struct('<QQIIIIQQ16f4BIQ')
+STREAM_NAMES = {0: 'depth', 1: 'long_depth', 2: 'left_front', 3: 'right_front'}
+PIXEL_TYPES = {1: np.uint8, 2: np.uint16, 4: np.float32}
+
+
+class Frame:
+    def __init__(self, header, payload):
+        (_, self.frame_number, self.stream_id, self.width, self.height, plane_count,
+         self.frame_index, self.host_ticks) = header[:8]
+        self.camera_to_world = np.array(header[8:24], np.float32).reshape(4, 4)
+        bytes_per_pixel = header[24:24 + plane_count]
+        self.planes = []
+        offset = 0
+        for bpp in bytes_per_pixel:
+            size = self.width * self.height * bpp
+            plane = np.frombuffer(payload, PIXEL_TYPES[bpp], self.width * self.height, offset)
+            self.planes.append(plane.reshape(self.height, self.width))
+            offset += size
+
+    @property
+    def stream(self):
+        return STREAM_NAMES.get(self.stream_id, str(self.stream_id))
+
+
+class SharedFrameRing:
+    def __init__(self, path):
+        self.path = path
+        self.mm = None
+        self.session = None
+        self.last_frame_number = 0
+        self.lost = 0       # frames overwritten before this reader got to them
+        self.retries = 0    # slot copies discarded because the producer was writing the slot
+
+    def _u64(self, offset):
+        # one aligned 8 byte load, so counters are never seen half written
+        return int(np.frombuffer(self.mm, np.uint64, 1, offset)[0])
+
+    def _attach(self):
+        """Map the ring (again if the producer recreated it), returns False while there is no valid ring."""
+        if self.mm is None:
+            if not os.path.exists(self.path) or os.path.getsize(self.path) < RING_HEADER.size:
+                return False
+            with open(self.path, 'rb') as f:
+                self.mm = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        (magic, header_size, slot_header_size, self.slot_count, self.stream_id, self.slot_stride,
+         self.payload_capacity, _, _, _) = RING_HEADER.unpack_from(self.mm, 0)
+        if magic != MAGIC:
+            return False
+        session = self._u64(48)
+        if session != self.session:
+            if header_size + self.slot_count * self.slot_stride > len(self.mm):
+                self.mm.close()
+                self.mm = None
+                return False
+            self.header_size = header_size
+            self.slot_header_size = slot_header_size
+            self.session = session
+            # frames published before attaching are not counted as lost
+            self.last_frame_number = max(self._u64(40) - self.slot_count, 0)
+        return True
+
+    def _read_slot(self, frame_number):
+        """Copy the frame out of its slot, None if it was overwritten or torn."""
+        offset = self.header_size + ((frame_number - 1) % self.slot_count) * self.slot_stride
+        for _ in range(3):
+            begin = self._u64(offset)
+            if begin & 1:
+                self.retries += 1
+                continue
+            header = SLOT_HEADER.unpack_from(self.mm, offset)
+            payload_size = header[28]
+            if header[1] != frame_number or payload_size > self.payload_capacity:
+                return None
+            start = offset + self.slot_header_size
+            payload = self.mm[start:start + payload_size]
+            if self._u64(offset) == begin:
+                return Frame(header, payload)
+            self.retries += 1
+        return None
+
+    def published(self):
+        return self._u64(40) if self._attach() else 0
+
+    def latest(self):
+        """Most recent complete frame, or None."""
+        for _ in range(3):
+            frame_number = self.published()
+            if frame_number == 0:
+                return None
+            frame = self._read_slot(frame_number)
+            if frame is not None:
+                self.last_frame_number = frame_number
+                return frame
+        return None
+
+    def read_new(self):
+        """All frames published since the last call that are still in the ring, oldest first."""
+        frames = []
+        published = self.published()
+        first = max(self.last_frame_number + 1, published - self.slot_count + 1, 1) if published else 1
+        if published and first > self.last_frame_number + 1:
+            self.lost += first - self.last_frame_number - 1
+        for frame_number in range(first, published + 1):
+            frame = self._read_slot(frame_number)
+            if frame is None:
+                self.lost += 1
+            else:
+                frames.append(frame)
+            self.last_frame_number = frame_number
+        return frames
+
+    def close(self):
+        if self.mm is not None:
+            self.mm.close()
+            self.mm = None
+
+
+def verify_synthetic(frame):
+    """Check a frame of python/shared_ring_producer.cpp for consistency across planes and pose."""
+    n = frame.frame_index
+    expected = ((n + np.arange(frame.width * frame.height, dtype=np.uint64)) & 0xFFFF).astype(np.uint16)
+    depth, ab_image = frame.planes[0].ravel(), frame.planes[1].ravel()
+    return (np.array_equal(depth, expected) and np.array_equal(ab_image, ~expected) and
+            abs(frame.camera_to_world[3, 0] - n / 1000.0) < 1e-3)
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('path')
+    parser.add_argument('--verify', action='store_true', help='check frames of the stand-in producer')
+    parser.add_argument('--seconds', type=float, default=0, help='stop after N seconds (0: run until interrupted)')
+    args = parser.parse_args()
+
+    ring = SharedFrameRing(args.path)
+    received = torn = 0
+    start = report = time.time()
+    try:
+        while args.seconds == 0 or time.time() - start < args.seconds:
+            frames = ring.read_new()
+            if not frames:
+                time.sleep(0.002)
+                continue
+            for frame in frames:
+                received += 1
+                if args.verify and not verify_synthetic(frame):
+                    torn += 1
+            if time.time() - report >= 1:
+                last = frames[-1]
+                print('%s frame %d (%dx%d, %d planes): %d received, %d lost, %d retries, %d inconsistent' %
+                      (last.stream, last.frame_index, last.width, last.height, len(last.planes),
+                       received, ring.lost, ring.retries, torn))
+                report = time.time()
+    except KeyboardInterrupt:
+        pass
+    print('received %d frames, lost %d, retries %d, inconsistent %d' % (received, ring.lost, ring.retries, torn))
+    ring.close()
+    return 1 if torn else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,19 @@
+#pragma once
+// Minimal checks for the off-device tests: CHECK reports a failed condition and continues, main returns TestResult().
+#include <cstdio>
+
+inline int g_testFailures = 0;
+
+#define CHECK(condition) \
+    do { if (!(condition)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); g_testFailures++; } } while (0)
+
+inline int TestResult(const char* name)
+{
+    if (g_testFailures)
+    {
+        printf("%s: %d checks failed\n", name, g_testFailures);
+        return 1;
+    }
+    printf("%s: all checks passed\n", name);
+    return 0;
+}
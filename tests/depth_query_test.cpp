@@ -0,0 +1,52 @@
+// Checks the depth captured for queries: raw values without a return, saturated or within the point cloud depth offset
+// are invalid instead of wrapping around, and pixel queries over them report Invalid.
+#include "DepthQuery.h"
+#include "TestCheck.h"
+#include <memory>
+#include <vector>
+
+using namespace winrt::HL2UnityPlugin::implementation;
+using namespace DirectX;
+
+int main()
+{
+    const UINT width = 4, height = 4;
+    const UINT16 depthOffset = 50;
+    auto pGeometry = std::make_shared<DepthQueryGeometry>();
+    pGeometry->unitRays.assign(width * height, XMFLOAT3(0, 0, 1));
+
+    // left half at 1 m (plus the offset), right half within the offset or invalid
+    std::vector<UINT16> raw = {
+        1050, 1050, 0,    30,
+        1050, 1050, 50,   4095,
+        1050, 1050, 30,   0,
+        1050, 1050, 4091, 50,
+    };
+    DepthQueryFrame frame;
+    CaptureDepthQueryFrame(raw.data(), width, height, depthOffset, 0, XMMatrixIdentity(), pGeometry, frame);
+    CHECK(frame.depth.size() == raw.size());
+    for (size_t k = 0; k < raw.size(); k++)
+    {
+        CHECK(frame.depth[k] == (k % width < 2 ? 1000 : 0));
+    }
+
+    // x, y per query: inside the valid half, on the edge (nearest valid pixel), inside the offset half
+    const float pixels[] = { 0.5f, 1.5f, 1.5f, 1.5f, 2.5f, 1.5f };
+    float results[3 * kDepthQueryResultSize];
+    SampleDepthPixels(frame, pixels, 3, results);
+    CHECK(results[0] == (float)DepthQueryStatus::Bilinear);
+    CHECK(results[1] > 0.999f && results[1] < 1.001f);
+    CHECK(results[kDepthQueryResultSize] == (float)DepthQueryStatus::Nearest);
+    CHECK(results[kDepthQueryResultSize + 1] > 0.999f && results[kDepthQueryResultSize + 1] < 1.001f);
+    CHECK(results[2 * kDepthQueryResultSize] == (float)DepthQueryStatus::Invalid);
+    CHECK(results[2 * kDepthQueryResultSize + 1] == 0);
+
+    // without an offset only the raw invalid values are dropped
+    CaptureDepthQueryFrame(raw.data(), width, height, 0, 0, XMMatrixIdentity(), pGeometry, frame);
+    CHECK(frame.depth[3] == 30);
+    CHECK(frame.depth[6] == 50);
+    CHECK(frame.depth[2] == 0);
+    CHECK(frame.depth[7] == 0);
+
+    return TestResult("depth query");
+}
@@ -0,0 +1,89 @@
+// Checks the ProcessingGovernor against the synthetic load of SimulateGovernorPhases: skip rate per consumer rate and
+// one level step per sustained overload, with the recovery after the load drops.
+#include "ProcessingGovernor.h"
+#include "TestCheck.h"
+#include <string>
+
+using namespace winrt::HL2UnityPlugin::implementation;
+
+static const int kFramesPerPhase = 450;    // 10 s at 45 fps
+
+static void CheckNominal(const GovernorPhaseResult& phase)
+{
+    CHECK(std::string(phase.name) == "nominal");
+    CHECK(phase.skipped == 0);
+    CHECK(phase.overBudget == 0);
+    CHECK(phase.framesPerLevel[(int)ProcessingLevel::Full] == phase.frames);
+}
+
+// A 10 fps consumer of a 45 fps stream: most frames are skipped, but at least every (maxConsecutiveSkips + 1)-th frame
+// is processed, and the level stays at full since skipping is not overload
+static void CheckSlowConsumer(const GovernorPhaseResult& phase, const GovernorSettings& settings)
+{
+    CHECK(std::string(phase.name) == "slow_consumer");
+    CHECK(phase.processed + phase.skipped == phase.frames);
+    CHECK(phase.skipped * 2 >= phase.frames);
+    CHECK(phase.processed * (settings.maxConsecutiveSkips + 1) >= phase.frames);
+    CHECK(phase.framesPerLevel[(int)ProcessingLevel::Full] == phase.frames);
+}
+
+static void CheckThermal(const GovernorPhaseResult& phase, const GovernorSettings& settings, ProcessingLevel expectedLevel)
+{
+    CHECK(std::string(phase.name) == "thermal_throttle");
+    CHECK(phase.skipped == 0);
+    CHECK(phase.endLevel == expectedLevel);
+    // every level above the final one is left after degradeFrames over budget (plus the averaging of the load)
+    for (int level = 0; level < (int)expectedLevel; level++)
+    {
+        CHECK(phase.framesPerLevel[level] > 0);
+        CHECK(phase.framesPerLevel[level] <= 2 * settings.degradeFrames);
+    }
+    for (int level = (int)expectedLevel + 1; level <= (int)ProcessingLevel::TextureOnly; level++)
+    {
+        CHECK(phase.framesPerLevel[level] == 0);
+    }
+    CHECK(phase.overBudget <= 2 * settings.degradeFrames * (int)expectedLevel);
+}
+
+static void CheckRecovered(const GovernorPhaseResult& phase, const GovernorSettings& settings, ProcessingLevel thermalLevel)
+{
+    CHECK(std::string(phase.name) == "recovered");
+    CHECK(phase.skipped == 0);
+    CHECK(phase.overBudget == 0);
+    CHECK(phase.endLevel == ProcessingLevel::Full);
+    // one level up per recoverFrames with headroom
+    for (int level = 1; level <= (int)thermalLevel; level++)
+    {
+        CHECK(phase.framesPerLevel[level] >= settings.recoverFrames);
+        CHECK(phase.framesPerLevel[level] <= settings.recoverFrames + settings.degradeFrames);
+    }
+}
+
+static void CheckSimulation(const GovernorSettings& settings, ProcessingLevel thermalLevel)
+{
+    auto phases = SimulateGovernorPhases(settings, kFramesPerPhase);
+    CHECK(phases.size() == 4);
+    if (phases.size() != 4)
+    {
+        return;
+    }
+    CheckNominal(phases[0]);
+    CheckSlowConsumer(phases[1], settings);
+    CheckThermal(phases[2], settings, thermalLevel);
+    CheckRecovered(phases[3], settings, thermalLevel);
+}
+
+int main()
+{
+    // default budget: 3x cost at full (load 0.81) drops to half (0.35), which is within budget but without headroom
+    GovernorSettings settings;
+    CheckSimulation(settings, ProcessingLevel::HalfPointCloud);
+
+    // tighter budget: half is still over budget, so the level drops a second step to quarter (0.24)
+    GovernorSettings tight;
+    tight.loadBudget = 0.3f;
+    tight.recoverLoad = 0.15f;
+    CheckSimulation(tight, ProcessingLevel::QuarterPointCloud);
+
+    return TestResult("governor simulation");
+}
@@ -0,0 +1,154 @@
+// Checks the specialized pixel passes against the generic reference kernels: ProcessAhatFrame and
+// ProcessLongThrowFrame must produce the same point clouds, textures and histograms as their generic versions over
+// randomized parameters, texture layouts and output sets.
+#include "SensorKernels.h"
+#include "TestCheck.h"
+#include <random>
+#include <vector>
+
+using namespace winrt::HL2UnityPlugin::implementation;
+using namespace DirectX;
+
+namespace
+{
+    const TextureMode kModes[] = { TextureMode::Off, TextureMode::Full, TextureMode::Half, TextureMode::Quarter, TextureMode::Crop };
+
+    // Outputs of one kernel run, written over sentinel values so untouched texels compare as well
+    struct FrameOutputs {
+        std::vector<UINT8> depthTexture, abTexture;
+        std::vector<UINT32> depthColorTexture, abColorTexture;
+        std::vector<UINT32> depthHistogram, abHistogram;
+        std::vector<float> pointCloud;
+        std::vector<UINT16> encodedPointCloud;
+
+        FrameOutputs(size_t pixelCount)
+            : depthTexture(pixelCount, 0x5A), abTexture(pixelCount, 0x5A), depthColorTexture(pixelCount, 0xDEADBEEF),
+            abColorTexture(pixelCount, 0xDEADBEEF), depthHistogram(TextureLut::kSize, 0), abHistogram(TextureLut::kSize, 0) {}
+
+        bool operator==(const FrameOutputs& other) const
+        {
+            return depthTexture == other.depthTexture && abTexture == other.abTexture &&
+                depthColorTexture == other.depthColorTexture && abColorTexture == other.abColorTexture &&
+                depthHistogram == other.depthHistogram && abHistogram == other.abHistogram &&
+                pointCloud == other.pointCloud && encodedPointCloud == other.encodedPointCloud;
+        }
+    };
+
+    // Output pointers of a run; each output is enabled by its bit of outputMask
+    AhatFrameOutputs Bind(FrameOutputs& frame, unsigned outputMask)
+    {
+        AhatFrameOutputs outputs;
+        outputs.pDepthTexture = (outputMask & 1) ? frame.depthTexture.data() : nullptr;
+        outputs.pAbTexture = (outputMask & 1) ? frame.abTexture.data() : nullptr;
+        outputs.pDepthColorTexture = (outputMask & 2) ? frame.depthColorTexture.data() : nullptr;
+        outputs.pAbColorTexture = (outputMask & 4) ? frame.abColorTexture.data() : nullptr;
+        outputs.pDepthHistogram = (outputMask & 8) ? frame.depthHistogram.data() : nullptr;
+        outputs.pAbHistogram = (outputMask & 16) ? frame.abHistogram.data() : nullptr;
+        outputs.pPointCloud = &frame.pointCloud;
+        outputs.pEncodedPointCloud = (outputMask & 32) ? &frame.encodedPointCloud : nullptr;
+        return outputs;
+    }
+}
+
+int main()
+{
+    std::mt19937 rng(42);
+    auto uniform = [&](UINT lower, UINT upper) { return std::uniform_int_distribution<UINT>(lower, upper)(rng); };
+    auto real = [&](float lower, float upper) { return std::uniform_real_distribution<float>(lower, upper)(rng); };
+
+    ColormapLut depthColormap, abColormap;
+    depthColormap.Build(Colormap::Turbo, 200, 1200);
+    abColormap.Build(Colormap::Viridis, 0, 1500);
+    TextureLut depthTextureLut, abTextureLut;
+    depthTextureLut.Build(300, 900);
+    abTextureLut.Build(50, 1200);
+
+    for (int trial = 0; trial < 300; trial++)
+    {
+        // frame: valid depth within the texture range of the stream above the offset, plus missing and saturated values
+        const UINT width = 16 * uniform(2, 6), height = 8 * uniform(3, 8);
+        const size_t pixelCount = width * height;
+        const UINT16 depthOffset = (UINT16)uniform(0, 60);
+        std::vector<UINT16> depth(pixelCount), abImage(pixelCount);
+        std::vector<BYTE> sigma(pixelCount);
+        std::vector<UINT8> validMask(pixelCount);
+        std::vector<XMFLOAT3> unitRays(pixelCount);
+        for (size_t k = 0; k < pixelCount; k++)
+        {
+            UINT kind = uniform(0, 9);
+            depth[k] = kind == 0 ? 0 : kind == 1 ? (UINT16)uniform(4091, 4095) : (UINT16)(depthOffset + uniform(1, 1000));
+            abImage[k] = (UINT16)uniform(0, 1500);
+            sigma[k] = uniform(0, 7) == 0 ? 0x80 : 0;
+            validMask[k] = (UINT8)uniform(0, 1);
+            XMStoreFloat3(&unitRays[k], uniform(0, 20) == 0 ? XMVectorZero() :
+                XMVector3Normalize(XMVectorSet(real(-0.8f, 0.8f), real(-0.8f, 0.8f), 1, 0)));
+        }
+
+        AhatFrameParams params;
+        params.width = width;
+        params.height = height;
+        params.depthOffset = depthOffset;
+        params.depthNearClip = (UINT16)uniform(100, 400);
+        params.depthFarClip = (UINT16)uniform(600, 1100);
+        auto& bounds = params.roiImageBounds;
+        bounds.rowBegin = uniform(0, height - 1);
+        bounds.rowEnd = uniform(bounds.rowBegin, height);
+        bounds.colBegin = uniform(0, width - 1);
+        bounds.colEnd = uniform(bounds.colBegin, width);
+        bounds.depthMin = (UINT16)(params.depthNearClip + 1);
+        bounds.depthMax = (UINT16)(params.depthFarClip - 1);
+        params.centerRow = uniform(0, height - 1);
+        params.centerCol = uniform(0, width - 1);
+        XMStoreFloat4x4(&params.depthToWorld, XMMatrixRotationAxis(XMVectorSet(real(-1, 1), real(-1, 1), 1, 0), real(-1, 1)) *
+            XMMatrixTranslation(real(-1, 1), real(-1, 1), real(-1, 1)));
+        params.useRoiFilter = uniform(0, 1) == 1;
+        params.roiCenter = XMFLOAT3(real(-1, 1), real(-1, 1), real(-1, 1));
+        params.roiBound = XMFLOAT3(real(0.2f, 1), real(0.2f, 1), real(0.2f, 1));
+        params.pointCloudStep = uniform(0, 3) == 0 ? 0 : 1u << uniform(0, 2);
+        params.pointCloudFormat = (PointCloudFormat)uniform(0, 2);
+        params.encodingOffset = XMFLOAT3(real(-1, 1), real(-1, 1), real(-1, 1));
+        params.encodingScale = real(0.0005f, 0.002f);
+        params.textureLayout = MakeTextureLayout(kModes[uniform(0, 4)], width, height,
+            uniform(0, width - 1), uniform(0, height - 1), uniform(1, width), uniform(1, height));
+
+        // table, histogram and colormap sets as the sensor loops use them, and mixed ones
+        unsigned outputMask = uniform(0, 63) | 1;
+        bool normalized = uniform(0, 1) == 1;
+        bool mixed = uniform(0, 3) == 0;
+        if (!mixed)
+        {
+            outputMask = normalized ? (outputMask | 24) : (outputMask & ~24u);
+        }
+        params.pDepthTextureLut = (mixed ? uniform(0, 1) == 1 : normalized) ? &depthTextureLut : nullptr;
+        params.pAbTextureLut = (mixed ? uniform(0, 1) == 1 : normalized) ? &abTextureLut : nullptr;
+        params.pDepthColormap = uniform(0, 1) ? &depthColormap : nullptr;
+        params.pAbColormap = uniform(0, 1) ? &abColormap : nullptr;
+        const UINT8* pValidMask = uniform(0, 1) ? validMask.data() : nullptr;
+
+        FrameOutputs specialized(pixelCount), generic(pixelCount);
+        auto result = ProcessAhatFrame(params, depth.data(), abImage.data(), unitRays.data(), pValidMask, Bind(specialized, outputMask));
+        auto reference = ProcessAhatFrameGeneric(params, depth.data(), abImage.data(), unitRays.data(), pValidMask, Bind(generic, outputMask));
+        CHECK(specialized == generic);
+        CHECK(result.centerDepth == reference.centerDepth && result.centerPointValid == reference.centerPointValid);
+
+        // long throw: the same layouts over sigma-masked depth within the 4 m range
+        for (size_t k = 0; k < pixelCount; k++)
+        {
+            depth[k] = (UINT16)(depthOffset + uniform(0, 4000));
+        }
+        specialized.depthHistogram.assign(TextureLut::kSize, 0);
+        generic.depthHistogram.assign(TextureLut::kSize, 0);
+        const TextureLut* pTextureLut = params.pDepthTextureLut;
+        UINT32* pHistogram = (outputMask & 8) ? specialized.depthHistogram.data() : nullptr;
+        UINT32* pColorTexture = (outputMask & 2) ? specialized.depthColorTexture.data() : nullptr;
+        ProcessLongThrowFrame(depth.data(), sigma.data(), width, height, depthOffset, params.textureLayout,
+            specialized.depthTexture.data(), params.pDepthColormap, pColorTexture, pTextureLut, pHistogram);
+        pHistogram = (outputMask & 8) ? generic.depthHistogram.data() : nullptr;
+        pColorTexture = (outputMask & 2) ? generic.depthColorTexture.data() : nullptr;
+        ProcessLongThrowFrameGeneric(depth.data(), sigma.data(), width, height, depthOffset, params.textureLayout,
+            generic.depthTexture.data(), params.pDepthColormap, pColorTexture, pTextureLut, pHistogram);
+        CHECK(specialized == generic);
+    }
+
+    return TestResult("kernel equivalence");
+}
@@ -0,0 +1,145 @@
+// Checks the Roi image window on a fisheye ray table: every point of the Roi box lands on a pixel inside the window,
+// although the distortion bends the box edges away from the rectangle of its projected corners.
+#include "SensorKernels.h"
+#include "TestCheck.h"
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace winrt::HL2UnityPlugin::implementation;
+using namespace DirectX;
+
+namespace
+{
+    const UINT kWidth = 64, kHeight = 64;
+    const float kCenter = (kWidth - 1) / 2.0f;
+    const float kRadPerPixel = 1.4f / 32;   // equidistant fisheye, 80 degrees off axis at the image border
+
+    XMFLOAT3 PixelRay(float u, float v)
+    {
+        float du = u - kCenter, dv = v - kCenter;
+        float theta = sqrtf(du * du + dv * dv) * kRadPerPixel;
+        float phi = atan2f(dv, du);
+        return XMFLOAT3(sinf(theta) * cosf(phi), sinf(theta) * sinf(phi), cosf(theta));
+    }
+
+    // Image point of a camera-space point in front of the sensor
+    bool Project(const XMFLOAT3& p, float& u, float& v)
+    {
+        float theta = atan2f(sqrtf(p.x * p.x + p.y * p.y), p.z);
+        if (theta > 1.5f)
+        {
+            return false;
+        }
+        float r = theta / kRadPerPixel, phi = atan2f(p.y, p.x);
+        u = kCenter + r * cosf(phi);
+        v = kCenter + r * sinf(phi);
+        return true;
+    }
+
+    bool Inside(const DepthRoiImageBounds& bounds, UINT row, UINT col)
+    {
+        return row >= bounds.rowBegin && row < bounds.rowEnd && col >= bounds.colBegin && col < bounds.colEnd;
+    }
+}
+
+int main()
+{
+    std::vector<XMFLOAT3> unitRays(kWidth * kHeight);
+    for (UINT i = 0; i < kHeight; i++)
+    {
+        for (UINT j = 0; j < kWidth; j++)
+        {
+            unitRays[kWidth * i + j] = PixelRay((float)j, (float)i);
+        }
+    }
+    float rayAngle = MaxNeighborRayAngle(unitRays.data(), kWidth, kHeight);
+    CHECK(rayAngle >= kRadPerPixel * 0.99f && rayAngle < kRadPerPixel * 1.5f);
+
+    DepthRoiImageBounds window;
+    window.rowEnd = kHeight;
+    window.colEnd = kWidth;
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> unit(-1, 1);
+    int cornerRectMisses = 0;
+    for (int trial = 0; trial < 200; trial++)
+    {
+        // sensor pose and a box off axis in front of it, where the fisheye bends straight edges the most
+        XMMATRIX depthToWorld = XMMatrixRotationAxis(XMVectorSet(unit(rng), unit(rng), 1, 0), 0.5f * unit(rng)) *
+            XMMatrixTranslation(unit(rng), unit(rng), unit(rng));
+        XMMATRIX worldToDepth = XMMatrixInverse(nullptr, depthToWorld);
+        float offAxis = 1.2f * unit(rng), distance = 0.5f + 0.5f * (unit(rng) + 1);
+        XMFLOAT3 centerInCam(offAxis * distance, 0.6f * unit(rng) * distance, distance);
+        XMVECTOR roiCenter = XMVector3Transform(XMLoadFloat3(&centerInCam), depthToWorld);
+        XMVECTOR roiBound = XMVectorSet(0.05f + 0.2f * (unit(rng) + 1), 0.05f + 0.2f * (unit(rng) + 1), 0.05f + 0.2f * (unit(rng) + 1), 0);
+
+        float farthest = 0;
+        float uMin = 1e9f, uMax = -1e9f, vMin = 1e9f, vMax = -1e9f;
+        bool cornersProjectable = true;
+        for (int c = 0; c < 8; c++)
+        {
+            XMVECTOR corner = roiCenter + XMVectorMultiply(roiBound, XMVectorSet(c & 1 ? 1.f : -1.f, c & 2 ? 1.f : -1.f, c & 4 ? 1.f : -1.f, 0));
+            farthest = (std::max)(farthest, XMVectorGetX(XMVector3Length(corner - XMVector3Transform(XMVectorZero(), depthToWorld))));
+            XMFLOAT3 cornerInCam;
+            XMStoreFloat3(&cornerInCam, XMVector3Transform(corner, worldToDepth));
+            float u, v;
+            if (cornerInCam.z <= 0.01f || !Project(cornerInCam, u, v))
+            {
+                cornersProjectable = false;
+                continue;
+            }
+            uMin = (std::min)(uMin, u); uMax = (std::max)(uMax, u);
+            vMin = (std::min)(vMin, v); vMax = (std::max)(vMax, v);
+        }
+
+        DepthRoiImageBounds bounds = window;
+        BoundRoiImageWindow(unitRays.data(), kWidth, depthToWorld, roiCenter, roiBound, rayAngle, farthest, bounds);
+
+        // every point of the box that is seen by a pixel of the window is inside the window
+        const int steps = 24;
+        for (int a = 0; a <= steps; a++)
+        {
+            for (int b = 0; b <= steps; b++)
+            {
+                for (int c = 0; c <= steps; c++)
+                {
+                    XMVECTOR s = XMVectorSet(2.0f * a / steps - 1, 2.0f * b / steps - 1, 2.0f * c / steps - 1, 0);
+                    XMFLOAT3 pointInCam;
+                    XMStoreFloat3(&pointInCam, XMVector3Transform(roiCenter + XMVectorMultiply(s, roiBound), worldToDepth));
+                    float u, v;
+                    if (pointInCam.z <= 0 || !Project(pointInCam, u, v))
+                    {
+                        continue;
+                    }
+                    int row = (int)floorf(v + 0.5f), col = (int)floorf(u + 0.5f);
+                    if (row < 0 || col < 0 || row >= (int)kHeight || col >= (int)kWidth)
+                    {
+                        continue;
+                    }
+                    CHECK(Inside(bounds, row, col));
+                    if (cornersProjectable && (col < floorf(uMin - 1) || col > ceilf(uMax + 1) || row < floorf(vMin - 1) || row > ceilf(vMax + 1)))
+                    {
+                        cornerRectMisses++;
+                    }
+                }
+            }
+        }
+    }
+    // the rectangle of the projected corners with a one pixel margin is not enough under this distortion
+    CHECK(cornerRectMisses > 0);
+
+    // a box behind the sensor leaves no pixel
+    DepthRoiImageBounds behind = window;
+    BoundRoiImageWindow(unitRays.data(), kWidth, XMMatrixIdentity(), XMVectorSet(0, 0, -2, 0), XMVectorSet(0.5f, 0.5f, 0.5f, 0),
+        rayAngle, 3, behind);
+    CHECK(behind.rowBegin == behind.rowEnd && behind.colBegin == behind.colEnd);
+
+    // a box around the sensor keeps the whole window
+    DepthRoiImageBounds around = window;
+    BoundRoiImageWindow(unitRays.data(), kWidth, XMMatrixIdentity(), XMVectorSet(0, 0, 0, 0), XMVectorSet(1, 1, 1, 0),
+        rayAngle, 2, around);
+    CHECK(around.rowBegin == 0 && around.rowEnd == kHeight && around.colBegin == 0 && around.colEnd == kWidth);
+
+    return TestResult("Roi image bounds");
+}
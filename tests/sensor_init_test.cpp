@@ -0,0 +1,123 @@
+// Checks the SensorInitScheduler against a mock device with a slow open: Launch returns right away, the open overlaps
+// with the caller, the acquisitions of the streams never overlap, and a restart does not acquire again.
+#include "SensorInit.h"
+#include "TestCheck.h"
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+using namespace winrt::HL2UnityPlugin::implementation;
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    const int kOpenMs = 200;        // library load, consent request and sensor enumeration
+    const int kAcquireMs = 20;      // GetSensor, QueryInterface and extrinsics of one stream
+    const int kCallerMs = 200;      // work of the caller between InitializeSensors and Start
+
+    float MillisecondsSince(Clock::time_point start)
+    {
+        return std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+    }
+
+    struct MockDevice {
+        std::atomic_bool open{ false };
+        std::atomic_int acquiring{ 0 };
+        std::atomic_int maxAcquiring{ 0 };
+        std::atomic_int acquisitions{ 0 };
+        std::atomic_int acquiredBeforeOpen{ 0 };
+
+        void Open()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(kOpenMs));
+            open = true;
+        }
+
+        void Acquire()
+        {
+            int concurrent = ++acquiring;
+            int seen = maxAcquiring;
+            while (concurrent > seen && !maxAcquiring.compare_exchange_weak(seen, concurrent))
+            {
+            }
+            if (!open)
+            {
+                acquiredBeforeOpen++;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(kAcquireMs));
+            acquisitions++;
+            acquiring--;
+        }
+    };
+}
+
+int main()
+{
+    MockDevice device;
+    {
+        SensorInitScheduler scheduler;
+        auto start = Clock::now();
+        scheduler.OpenDevice([&]() { device.Open(); });
+        for (int stream = 0; stream < SensorInitScheduler::kStreams; stream++)
+        {
+            scheduler.Launch(stream, [&]() { device.Acquire(); });
+        }
+        float launchMs = MillisecondsSince(start);
+        CHECK(launchMs < kOpenMs / 4);
+        CHECK(!scheduler.AllReady());
+
+        // the caller works while the device opens, then waits for the sensors
+        std::this_thread::sleep_for(std::chrono::milliseconds(kCallerMs));
+        for (int stream = 0; stream < SensorInitScheduler::kStreams; stream++)
+        {
+            CHECK(scheduler.Wait(stream));
+        }
+        float readyMs = MillisecondsSince(start);
+        CHECK(scheduler.AllReady());
+        CHECK(device.acquisitions == SensorInitScheduler::kStreams);
+        CHECK(device.maxAcquiring == 1);
+        CHECK(device.acquiredBeforeOpen == 0);
+        CHECK(readyMs >= kOpenMs + SensorInitScheduler::kStreams * kAcquireMs - 5);
+        // serially the open, the caller and the acquisitions would take kOpenMs + kCallerMs + kStreams * kAcquireMs
+        CHECK(readyMs < kOpenMs + kCallerMs / 2 + SensorInitScheduler::kStreams * kAcquireMs);
+
+        // restart of a stream: the sensor is kept, nothing is acquired again
+        start = Clock::now();
+        scheduler.Launch(0, [&]() { device.Acquire(); });
+        CHECK(scheduler.Wait(0));
+        CHECK(MillisecondsSince(start) < kAcquireMs / 2);
+        CHECK(device.acquisitions == SensorInitScheduler::kStreams);
+
+        // after Release the streams are acquired again
+        scheduler.Release();
+        CHECK(!scheduler.Wait(1));
+        CHECK(!scheduler.Ready(1));
+        scheduler.Launch(1, [&]() { device.Acquire(); });
+        CHECK(scheduler.Wait(1));
+        CHECK(device.acquisitions == SensorInitScheduler::kStreams + 1);
+    }
+
+    // a failed open is rethrown by the waits and the acquisitions do not run
+    {
+        SensorInitScheduler scheduler;
+        std::atomic_int acquisitions{ 0 };
+        scheduler.OpenDevice([]() { throw std::runtime_error("no device"); });
+        scheduler.Launch(2, [&]() { acquisitions++; });
+        bool thrown = false;
+        try
+        {
+            scheduler.Wait(2);
+        }
+        catch (const std::runtime_error&)
+        {
+            thrown = true;
+        }
+        CHECK(thrown);
+        CHECK(acquisitions == 0);
+        CHECK(scheduler.AllReady());
+    }
+
+    return TestResult("sensor init");
+}
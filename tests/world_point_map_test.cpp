@@ -0,0 +1,97 @@
+// Checks that snapshots of the WorldPointMap (ExportWorldPointMap, ChangedSince(0)) hold only the current points, while
+// incremental changes still report evicted points with count 0.
+#include "WorldPointMap.h"
+#include "TestCheck.h"
+#include <cmath>
+#include <vector>
+
+using namespace winrt::HL2UnityPlugin::implementation;
+
+static bool ContainsPoint(const std::vector<float>& packed, float x, float y, float z)
+{
+    for (size_t k = 0; k + WorldPointMap::kPackedPointSize <= packed.size(); k += WorldPointMap::kPackedPointSize)
+    {
+        if (fabsf(packed[k] - x) < 1e-4f && fabsf(packed[k + 1] - y) < 1e-4f && fabsf(packed[k + 2] - z) < 1e-4f)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool AllObserved(const std::vector<float>& packed)
+{
+    for (size_t k = 0; k + WorldPointMap::kPackedPointSize <= packed.size(); k += WorldPointMap::kPackedPointSize)
+    {
+        if (packed[k + 3] <= 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    WorldPointMap map;
+    WorldPointMapSettings settings;
+    settings.maxPoints = 2;
+    map.Configure(settings);
+
+    // one point per frame, the third evicts the first (least recently observed)
+    const float points[3][3] = { { 1.0f, 0, 0 }, { 0, 1.0f, 0 }, { 0, 0, 1.0f } };
+    const DirectX::XMFLOAT3 sensorPosition(0, 0, 0);
+    for (const auto& point : points)
+    {
+        map.Integrate(point, 1, sensorPosition);
+    }
+    CHECK(map.Size() == 2);
+
+    std::vector<float> snapshot;
+    UINT64 sequence = map.Snapshot(snapshot);
+    CHECK(sequence == 3);
+    CHECK(snapshot.size() == 2 * WorldPointMap::kPackedPointSize);
+    CHECK(!ContainsPoint(snapshot, 1.0f, 0, 0));
+    CHECK(ContainsPoint(snapshot, 0, 1.0f, 0));
+    CHECK(ContainsPoint(snapshot, 0, 0, 1.0f));
+    CHECK(AllObserved(snapshot));
+
+    // a first incremental request is a full resync of the current points
+    std::vector<float> changes;
+    bool fullResync = false;
+    CHECK(map.ChangedSince(0, changes, fullResync) == 3);
+    CHECK(fullResync);
+    CHECK(changes == snapshot);
+
+    // after frame 1, the eviction is reported with count 0 ahead of the added points
+    CHECK(map.ChangedSince(1, changes, fullResync) == 3);
+    CHECK(!fullResync);
+    CHECK(changes.size() == 3 * WorldPointMap::kPackedPointSize);
+    CHECK(ContainsPoint(changes, 1.0f, 0, 0) && changes[3] == 0);
+
+    // a consumer that is up to date when the map is cleared must resync, the cleared points are not in the log
+    std::vector<float> beforeClear;
+    UINT64 upToDate = map.ChangedSince(3, beforeClear, fullResync);
+    CHECK(!fullResync && beforeClear.empty());
+    map.Clear();
+    const float afterClear[3] = { 2.0f, 0, 0 };
+    map.Integrate(afterClear, 1, sensorPosition);
+    sequence = map.ChangedSince(upToDate, changes, fullResync);
+    CHECK(fullResync);
+    CHECK(changes.size() == WorldPointMap::kPackedPointSize);
+    CHECK(ContainsPoint(changes, 2.0f, 0, 0));
+    // and incremental after that
+    map.Integrate(afterClear, 1, sensorPosition);
+    CHECK(map.ChangedSince(sequence, changes, fullResync) == sequence + 1);
+    CHECK(!fullResync);
+
+    // the same for a new voxel size, which clears the map
+    upToDate = map.ChangedSince(sequence + 1, changes, fullResync);
+    settings.voxelSize = 0.02f;
+    map.Configure(settings);
+    map.Integrate(afterClear, 1, sensorPosition);
+    map.ChangedSince(upToDate, changes, fullResync);
+    CHECK(fullResync);
+
+    return TestResult("world point map");
+}
@@ -0,0 +1,25 @@
+// Off-device driver of the processing benchmark: runs the sensor processing kernels over synthetic frames and prints
+// the same JSON as HL2ResearchMode::RunProcessingBenchmark (without the cases of the recorded frame).
+//
+// Build and run (Linux, from the root of the repository, see CMakeLists.txt):
+//   cmake -S . -B build -DCMAKE_BUILD_TYPE=Release && cmake --build build
+//   ./build/processing_benchmark [frames per case] [export directory] > benchmark.json
+//
+// With an export directory, point cloud export and shared memory ring publishing are measured in a temporary folder
+// inside it, as the plugin does in its LocalFolder.
+#include "ProcessingBenchmark.h"
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+
+using namespace winrt::HL2UnityPlugin::implementation;
+
+int main(int argc, char** argv)
+{
+    int frameCount = argc > 1 ? atoi(argv[1]) : 100;
+    std::wstring exportDirectory = argc > 2 ? std::filesystem::path(argv[2]).wstring() : std::wstring();
+
+    std::string json = BenchmarkProcessingKernels(frameCount, nullptr, exportDirectory);
+    printf("%s\n", json.c_str());
+    return 0;
+}